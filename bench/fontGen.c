@@ -0,0 +1,583 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Synthetic TrueType font generator for the benchmarks. It writes a minimal
+font with the glyf, cmap, kern and GPOS tables, so the benchmarks need no font
+file and run offline. Glyph k maps to the character FONTGEN_FIRST_CHAR + k, or
+to the k-th character of the -r ranges (decimal, as fontcvt -r), and is a star with a star shaped hole: the number of points per contour sets the
+outline complexity, the star shape changes with k so every glyph differs.
+Kerning pairs are picked with a fixed seed, the output is reproducible.
+
+usage: fontgen <out.ttf> [-g glyphs | -r ranges] [-c points] [-k pairs] */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <math.h>
+
+/* character of the first glyph; the benchmarks use this range */
+#define FONTGEN_FIRST_CHAR    19968
+#define L_MAX_GLYPHS          20000
+#define L_MAX_POINTS          1000
+/* pairs are limited by the 16 bit offsets of the kern and GPOS subtables */
+#define L_MAX_PAIRS           10000
+#define L_UNITS_PER_EM        1024
+#define L_ASCENDER            900
+#define L_DESCENDER           (-200)
+#define L_NUM_TABLES          10
+#define L_MAX_RANGES          64
+
+typedef struct
+{
+	uint8_t *data;
+	uint32_t size;
+	uint32_t max;
+} Buf_t;
+
+typedef struct
+{
+	uint16_t left;
+	uint16_t right;
+	int16_t value;
+} Pair_t;
+
+typedef struct
+{
+	uint16_t first;
+	uint16_t last;
+} Range_t;
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static void Put8 (Buf_t *buf, uint8_t val);
+static void Put16 (Buf_t *buf, uint16_t val);
+static void Put32 (Buf_t *buf, uint32_t val);
+static void Set16 (Buf_t *buf, uint32_t pos, uint16_t val);
+static void Set32 (Buf_t *buf, uint32_t pos, uint32_t val);
+static void PutSearchHeader (Buf_t *buf, uint16_t num, uint16_t unit);
+static uint32_t Checksum (const uint8_t *data, uint32_t size);
+static int ComparePairs (const void *a, const void *b);
+
+static void BuildGlyph (Buf_t *glyf, uint16_t index, uint16_t points, int16_t bbox[4]);
+static void BuildCmap (Buf_t *cmap, const Range_t *ranges, uint8_t num);
+static void BuildKern (Buf_t *kern, const Pair_t *pairs, uint16_t num);
+static void BuildGpos (Buf_t *gpos, const Pair_t *pairs, uint16_t num);
+static void BuildName (Buf_t *name);
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+int main (int argc, char *argv[])
+{
+	uint32_t glyphs = 100, points = 8, pairs_num = 500;
+	Buf_t tables[L_NUM_TABLES];
+	static const char *tags[L_NUM_TABLES] = {
+		"GPOS", "cmap", "glyf", "head", "hhea", "hmtx", "kern", "loca", "maxp", "name" };
+	Buf_t *gpos = &tables[0], *cmap = &tables[1], *glyf = &tables[2], *head = &tables[3], *hhea = &tables[4];
+	Buf_t *hmtx = &tables[5], *kern = &tables[6], *loca = &tables[7], *maxp = &tables[8], *name = &tables[9];
+	Buf_t font = { 0 };
+	Pair_t *pairs;
+	int16_t font_bbox[4] = { INT16_MAX, INT16_MAX, INT16_MIN, INT16_MIN };
+	Range_t ranges[L_MAX_RANGES] = { { FONTGEN_FIRST_CHAR, 0 } };
+	uint8_t ranges_num = 0;
+	uint32_t seed = 12345;
+	uint16_t num_glyphs;
+	uint32_t offset, head_pos = 0;
+	FILE *f;
+	int opt;
+
+	while ((opt = getopt (argc, argv, "g:r:c:k:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'g': glyphs = atol (optarg); break;
+			case 'c': points = atol (optarg); break;
+			case 'k': pairs_num = atol (optarg); break;
+			case 'r':
+			{
+				glyphs = 0;
+				for (char *save, *range = strtok_r (optarg, ",", &save);
+				     range && ranges_num < L_MAX_RANGES;
+				     range = strtok_r (NULL, ",", &save))
+				{
+					char *last = strchr (range, '-');
+
+					ranges[ranges_num].first = atol (range);
+					ranges[ranges_num].last = last ? atol (last + 1) : ranges[ranges_num].first;
+					if (ranges[ranges_num].first == 0 || ranges[ranges_num].first > ranges[ranges_num].last
+					 || ranges[ranges_num].last == 0xFFFF
+					 || (ranges_num && ranges[ranges_num].first <= ranges[ranges_num - 1].last))
+					{
+						fprintf (stderr, "ranges must be increasing and below 65535\n");
+						return 1;
+					}
+					glyphs += ranges[ranges_num].last - ranges[ranges_num].first + 1;
+					ranges_num++;
+				}
+				break;
+			}
+			default:
+				fprintf (stderr, "usage: fontgen <out.ttf> [-g glyphs | -r ranges] [-c points] [-k pairs]\n");
+				return 1;
+		}
+	}
+	if (ranges_num == 0)
+	{	/* -g glyphs from the default first character */
+		ranges[0].last = FONTGEN_FIRST_CHAR + glyphs - 1;
+		ranges_num = 1;
+	}
+	if (optind >= argc || glyphs < 1 || glyphs > L_MAX_GLYPHS || points < 4 || points > L_MAX_POINTS
+	 || pairs_num > L_MAX_PAIRS || pairs_num > glyphs * glyphs)
+	{
+		fprintf (stderr, "usage: fontgen <out.ttf> [-g 1..%d glyphs | -r ranges] [-c 4..%d points] [-k 0..%d pairs]\n",
+			L_MAX_GLYPHS, L_MAX_POINTS, L_MAX_PAIRS);
+		return 1;
+	}
+	memset (tables, 0, sizeof (tables));
+	num_glyphs = glyphs + 1; /* glyph 0 is .notdef */
+
+	/* glyphs, locations and metrics */
+	Put32 (loca, 0); /* .notdef has no outline */
+	Put16 (hmtx, L_UNITS_PER_EM / 2);
+	Put16 (hmtx, 0);
+	for (uint16_t k = 1; k < num_glyphs; k++)
+	{
+		int16_t bbox[4];
+
+		Put32 (loca, glyf->size);
+		BuildGlyph (glyf, k, points, bbox);
+		Put16 (hmtx, bbox[2] + 64);
+		Put16 (hmtx, bbox[0]);
+		for (uint8_t i = 0; i < 2; i++)
+		{
+			if (bbox[i] < font_bbox[i]) font_bbox[i] = bbox[i];
+			if (bbox[i + 2] > font_bbox[i + 2]) font_bbox[i + 2] = bbox[i + 2];
+		}
+	}
+	Put32 (loca, glyf->size);
+
+	/* unique kerning pairs, sorted by left and right glyph */
+	pairs = malloc (sizeof (Pair_t) * (pairs_num + 1));
+	if (pairs == NULL)
+	{
+		fprintf (stderr, "pairs allocation fail\n");
+		return 1;
+	}
+	for (uint32_t k = 0; k < pairs_num; )
+	{
+		Pair_t pair;
+		bool dup = false;
+
+		seed = seed * 1103515245 + 12345;
+		pair.left = 1 + (seed >> 8) % glyphs;
+		seed = seed * 1103515245 + 12345;
+		pair.right = 1 + (seed >> 8) % glyphs;
+		pair.value = -(int16_t)(64 + (seed >> 4) % 128);
+		for (uint32_t i = 0; i < k && !dup; i++)
+			dup = pairs[i].left == pair.left && pairs[i].right == pair.right;
+		if (!dup)
+			pairs[k++] = pair;
+	}
+	qsort (pairs, pairs_num, sizeof (Pair_t), ComparePairs);
+
+	BuildCmap (cmap, ranges, ranges_num);
+	BuildKern (kern, pairs, pairs_num);
+	BuildGpos (gpos, pairs, pairs_num);
+	BuildName (name);
+
+	/* head; checkSumAdjustment is set once the whole font is built */
+	Put32 (head, 0x00010000); /* version */
+	Put32 (head, 0x00010000); /* fontRevision */
+	Put32 (head, 0); /* checkSumAdjustment */
+	Put32 (head, 0x5F0F3CF5); /* magicNumber */
+	Put16 (head, 0x000B); /* flags */
+	Put16 (head, L_UNITS_PER_EM);
+	for (uint8_t k = 0; k < 4; k++)
+		Put32 (head, 0); /* created, modified */
+	for (uint8_t k = 0; k < 4; k++)
+		Put16 (head, font_bbox[k]);
+	Put16 (head, 0); /* macStyle */
+	Put16 (head, 8); /* lowestRecPPEM */
+	Put16 (head, 2); /* fontDirectionHint */
+	Put16 (head, 1); /* indexToLocFormat: long */
+	Put16 (head, 0); /* glyphDataFormat */
+
+	Put32 (hhea, 0x00010000);
+	Put16 (hhea, L_ASCENDER);
+	Put16 (hhea, L_DESCENDER);
+	Put16 (hhea, 0); /* lineGap */
+	Put16 (hhea, font_bbox[2] + 64); /* advanceWidthMax */
+	Put16 (hhea, font_bbox[0]); /* minLeftSideBearing */
+	Put16 (hhea, 64); /* minRightSideBearing */
+	Put16 (hhea, font_bbox[2]); /* xMaxExtent */
+	Put16 (hhea, 1); /* caretSlopeRise */
+	for (uint8_t k = 0; k < 6; k++)
+		Put16 (hhea, 0); /* caretSlopeRun, caretOffset, reserved */
+	Put16 (hhea, 0); /* metricDataFormat */
+	Put16 (hhea, num_glyphs); /* numberOfHMetrics */
+
+	Put32 (maxp, 0x00010000);
+	Put16 (maxp, num_glyphs);
+	Put16 (maxp, points * 2); /* maxPoints */
+	Put16 (maxp, 2); /* maxContours */
+	Put16 (maxp, 0); /* maxCompositePoints */
+	Put16 (maxp, 0); /* maxCompositeContours */
+	Put16 (maxp, 2); /* maxZones */
+	for (uint8_t k = 0; k < 8; k++)
+		Put16 (maxp, 0);
+
+	/* table directory, then the tables 4 bytes aligned */
+	Put32 (&font, 0x00010000);
+	PutSearchHeader (&font, L_NUM_TABLES, 16);
+	offset = 12 + 16 * L_NUM_TABLES;
+	for (uint8_t k = 0; k < L_NUM_TABLES; k++)
+	{
+		uint32_t size = tables[k].size;
+
+		while (tables[k].size % 4)
+			Put8 (&tables[k], 0);
+		for (uint8_t i = 0; i < 4; i++)
+			Put8 (&font, tags[k][i]);
+		Put32 (&font, Checksum (tables[k].data, tables[k].size));
+		Put32 (&font, offset);
+		Put32 (&font, size);
+		offset += tables[k].size;
+	}
+	for (uint8_t k = 0; k < L_NUM_TABLES; k++)
+	{
+		if (head == &tables[k])
+			head_pos = font.size;
+		for (uint32_t i = 0; i < tables[k].size; i++)
+			Put8 (&font, tables[k].data[i]);
+	}
+	Set32 (&font, head_pos + 8, 0xB1B0AFBA - Checksum (font.data, font.size));
+
+	f = fopen (argv[optind], "wb");
+	if (f == NULL || fwrite (font.data, 1, font.size, f) != font.size)
+	{
+		fprintf (stderr, "can't write %s\n", argv[optind]);
+		return 1;
+	}
+	fclose (f);
+	printf ("%s: %u glyphs in %d ranges, %u points per contour, %u kerning pairs, %u bytes\n",
+		argv[optind], glyphs, ranges_num, points, pairs_num, font.size);
+	return 0;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Append a byte to a growing buffer. Exits if out of memory. */
+static void Put8 (Buf_t *buf, uint8_t val)
+{
+	if (buf->size == buf->max)
+	{
+		buf->max = buf->max ? buf->max * 2 : 256;
+		buf->data = realloc (buf->data, buf->max);
+		if (buf->data == NULL)
+		{
+			fprintf (stderr, "buffer allocation fail\n");
+			exit (1);
+		}
+	}
+	buf->data[buf->size++] = val;
+}
+
+/* Append a big endian 16 bit value. */
+static void Put16 (Buf_t *buf, uint16_t val)
+{
+	Put8 (buf, val >> 8);
+	Put8 (buf, val);
+}
+
+/* Append a big endian 32 bit value. */
+static void Put32 (Buf_t *buf, uint32_t val)
+{
+	Put16 (buf, val >> 16);
+	Put16 (buf, val);
+}
+
+/* Overwrite a big endian 16 bit value at pos. */
+static void Set16 (Buf_t *buf, uint32_t pos, uint16_t val)
+{
+	buf->data[pos] = val >> 8;
+	buf->data[pos + 1] = val;
+}
+
+/* Overwrite a big endian 32 bit value at pos. */
+static void Set32 (Buf_t *buf, uint32_t pos, uint32_t val)
+{
+	Set16 (buf, pos, val >> 16);
+	Set16 (buf, pos + 2, val);
+}
+
+/* Append the count, searchRange, entrySelector and rangeShift fields shared by
+the table directory, the cmap format 4 and the kern format 0 headers.
+    Args:
+<num>[in] number of entries.
+<unit>[in] size of an entry in the searchRange units.
+    Ret:
+*/
+static void PutSearchHeader (Buf_t *buf, uint16_t num, uint16_t unit)
+{
+	uint16_t selector = 0;
+
+	if (num == 0)
+	{
+		for (uint8_t k = 0; k < 4; k++)
+			Put16 (buf, 0);
+		return;
+	}
+	while ((2u << selector) <= num)
+		selector++;
+	Put16 (buf, num);
+	Put16 (buf, (1 << selector) * unit);
+	Put16 (buf, selector);
+	Put16 (buf, num * unit - (1 << selector) * unit);
+}
+
+/* Sum of the big endian 32 bit words; size is a multiple of 4. */
+static uint32_t Checksum (const uint8_t *data, uint32_t size)
+{
+	uint32_t sum = 0;
+
+	for (uint32_t k = 0; k < size; k += 4)
+		sum += (data[k] << 24) | (data[k + 1] << 16) | (data[k + 2] << 8) | data[k + 3];
+	return sum;
+}
+
+/* qsort callback, pairs by left then right glyph. */
+static int ComparePairs (const void *a, const void *b)
+{
+	const Pair_t *pa = a, *pb = b;
+
+	if (pa->left != pb->left)
+		return pa->left - pb->left;
+	return pa->right - pb->right;
+}
+
+/* Append a glyph: a star of <points> points alternating on and off curve
+points, with a reversed smaller star as hole.
+    Args:
+<index>[in] glyph index, changes the star shape.
+<points>[in] points per contour.
+<bbox>[out] xMin, yMin, xMax, yMax of the glyph.
+    Ret:
+*/
+static void BuildGlyph (Buf_t *glyf, uint16_t index, uint16_t points, int16_t bbox[4])
+{
+	int16_t xs[2 * L_MAX_POINTS], ys[2 * L_MAX_POINTS];
+	double spikes = 0.15 + 0.35 * ((index * 7) % 11) / 10.0;
+	double turn = (index % 13) * 0.1;
+	int16_t x = 0, y = 0;
+
+	bbox[0] = bbox[1] = INT16_MAX;
+	bbox[2] = bbox[3] = INT16_MIN;
+	for (uint16_t c = 0; c < 2; c++)
+	{
+		double radius = c ? 180 : 420;
+
+		for (uint16_t k = 0; k < points; k++)
+		{	/* the hole goes clockwise the other way round */
+			double a = turn + (c ? -1 : 1) * 2 * M_PI * k / points;
+			double r = radius * ((k & 1) ? 1 - spikes : 1);
+			uint16_t p = c * points + k;
+
+			xs[p] = 480 + (int16_t)(r * sin (a));
+			ys[p] = 350 + (int16_t)(r * cos (a));
+			if (xs[p] < bbox[0]) bbox[0] = xs[p];
+			if (ys[p] < bbox[1]) bbox[1] = ys[p];
+			if (xs[p] > bbox[2]) bbox[2] = xs[p];
+			if (ys[p] > bbox[3]) bbox[3] = ys[p];
+		}
+	}
+
+	Put16 (glyf, 2); /* numberOfContours */
+	for (uint8_t k = 0; k < 4; k++)
+		Put16 (glyf, bbox[k]);
+	Put16 (glyf, points - 1); /* endPtsOfContours */
+	Put16 (glyf, 2 * points - 1);
+	Put16 (glyf, 0); /* instructionLength */
+	for (uint16_t p = 0; p < 2 * points; p++)
+		Put8 (glyf, (p & 1) ? 0x00 : 0x01); /* on curve flag, 16 bit deltas */
+	for (uint16_t p = 0; p < 2 * points; p++)
+	{
+		Put16 (glyf, xs[p] - x);
+		x = xs[p];
+	}
+	for (uint16_t p = 0; p < 2 * points; p++)
+	{
+		Put16 (glyf, ys[p] - y);
+		y = ys[p];
+	}
+	while (glyf->size % 4)
+		Put8 (glyf, 0);
+}
+
+/* cmap with a format 4 subtable, one segment per range. Glyphs follow the
+ranges order from glyph 1. */
+static void BuildCmap (Buf_t *cmap, const Range_t *ranges, uint8_t num)
+{
+	uint16_t segs = num + 1; /* the last segment ends the table */
+	uint16_t selector = 0;
+	uint16_t glyph = 1;
+
+	while ((2u << selector) <= segs)
+		selector++;
+	Put16 (cmap, 0); /* version */
+	Put16 (cmap, 1); /* numTables */
+	Put16 (cmap, 3); /* platformID: windows */
+	Put16 (cmap, 1); /* encodingID: unicode BMP */
+	Put32 (cmap, 12); /* subtable offset */
+
+	Put16 (cmap, 4); /* format */
+	Put16 (cmap, 16 + 8 * segs); /* length */
+	Put16 (cmap, 0); /* language */
+	Put16 (cmap, 2 * segs); /* segCountX2 */
+	Put16 (cmap, 2 << selector); /* searchRange */
+	Put16 (cmap, selector); /* entrySelector */
+	Put16 (cmap, 2 * segs - (2 << selector)); /* rangeShift */
+	for (uint8_t k = 0; k < num; k++)
+		Put16 (cmap, ranges[k].last); /* endCode */
+	Put16 (cmap, 0xFFFF);
+	Put16 (cmap, 0); /* reservedPad */
+	for (uint8_t k = 0; k < num; k++)
+		Put16 (cmap, ranges[k].first); /* startCode */
+	Put16 (cmap, 0xFFFF);
+	for (uint8_t k = 0; k < num; k++)
+	{
+		Put16 (cmap, (uint16_t)(glyph - ranges[k].first)); /* idDelta */
+		glyph += ranges[k].last - ranges[k].first + 1;
+	}
+	Put16 (cmap, 1);
+	for (uint8_t k = 0; k < segs; k++)
+		Put16 (cmap, 0); /* idRangeOffset */
+}
+
+/* kern with a format 0 subtable. */
+static void BuildKern (Buf_t *kern, const Pair_t *pairs, uint16_t num)
+{
+	Put16 (kern, 0); /* version */
+	Put16 (kern, 1); /* nTables */
+	Put16 (kern, 0); /* subtable version */
+	Put16 (kern, 14 + 6 * num); /* length */
+	Put16 (kern, 0x0001); /* coverage: horizontal, format 0 */
+	PutSearchHeader (kern, num, 6);
+	for (uint16_t k = 0; k < num; k++)
+	{
+		Put16 (kern, pairs[k].left);
+		Put16 (kern, pairs[k].right);
+		Put16 (kern, pairs[k].value);
+	}
+}
+
+/* GPOS with the same pairs as the kern table: one 'kern' feature for the
+default script and one pair adjustment lookup, format 1, x advance of the left
+glyph. */
+static void BuildGpos (Buf_t *gpos, const Pair_t *pairs, uint16_t num)
+{
+	uint16_t lefts = 0;
+	uint32_t coverage, pairset, sub;
+
+	for (uint16_t k = 0; k < num; k++)
+		if (k == 0 || pairs[k].left != pairs[k - 1].left)
+			lefts++;
+
+	Put32 (gpos, 0x00010000); /* version */
+	Put16 (gpos, 10); /* scriptList */
+	Put16 (gpos, 30); /* featureList */
+	Put16 (gpos, 44); /* lookupList */
+
+	/* script list at 10: DFLT with a default language system */
+	Put16 (gpos, 1);
+	Put32 (gpos, 0x44464C54); /* 'DFLT' */
+	Put16 (gpos, 8); /* script offset */
+	Put16 (gpos, 4); /* defaultLangSys offset */
+	Put16 (gpos, 0); /* langSysCount */
+	Put16 (gpos, 0); /* lookupOrder */
+	Put16 (gpos, 0xFFFF); /* requiredFeatureIndex */
+	Put16 (gpos, 1); /* featureIndexCount */
+	Put16 (gpos, 0);
+
+	/* feature list at 30: kern using lookup 0 */
+	Put16 (gpos, 1);
+	Put32 (gpos, 0x6B65726E); /* 'kern' */
+	Put16 (gpos, 8); /* feature offset */
+	Put16 (gpos, 0); /* featureParams */
+	Put16 (gpos, 1); /* lookupIndexCount */
+	Put16 (gpos, 0);
+
+	/* lookup list at 44 */
+	Put16 (gpos, 1);
+	Put16 (gpos, 4); /* lookup offset */
+	Put16 (gpos, 2); /* lookupType: pair adjustment */
+	Put16 (gpos, 0); /* lookupFlag */
+	Put16 (gpos, 1); /* subTableCount */
+	Put16 (gpos, 8); /* subtable offset */
+
+	/* pair positioning subtable */
+	sub = gpos->size;
+	Put16 (gpos, 1); /* format */
+	coverage = gpos->size;
+	Put16 (gpos, 0); /* coverage offset, set below */
+	Put16 (gpos, 0x0004); /* valueFormat1: x advance */
+	Put16 (gpos, 0); /* valueFormat2 */
+	Put16 (gpos, lefts); /* pairSetCount */
+	pairset = gpos->size;
+	for (uint16_t k = 0; k < lefts; k++)
+		Put16 (gpos, 0); /* pair set offsets, set below */
+	for (uint16_t k = 0, set = 0; k < num; set++)
+	{
+		uint16_t count = 0;
+
+		while (k + count < num && pairs[k + count].left == pairs[k].left)
+			count++;
+		Set16 (gpos, pairset + 2 * set, gpos->size - sub);
+		Put16 (gpos, count);
+		for (uint16_t i = 0; i < count; i++)
+		{
+			Put16 (gpos, pairs[k + i].right);
+			Put16 (gpos, pairs[k + i].value);
+		}
+		k += count;
+	}
+	Set16 (gpos, coverage, gpos->size - sub);
+	Put16 (gpos, 1); /* coverage format: glyph list */
+	Put16 (gpos, lefts);
+	for (uint16_t k = 0; k < num; k++)
+		if (k == 0 || pairs[k].left != pairs[k - 1].left)
+			Put16 (gpos, pairs[k].left);
+}
+
+/* name with the family name only. */
+static void BuildName (Buf_t *name)
+{
+	static const char family[] = "fontcvt bench";
+
+	Put16 (name, 0); /* format */
+	Put16 (name, 1); /* count */
+	Put16 (name, 6 + 12); /* stringOffset */
+	Put16 (name, 3); /* platformID: windows */
+	Put16 (name, 1); /* encodingID: unicode BMP */
+	Put16 (name, 0x0409); /* languageID */
+	Put16 (name, 1); /* nameID: family */
+	Put16 (name, 2 * (sizeof (family) - 1)); /* length */
+	Put16 (name, 0); /* offset */
+	for (uint8_t k = 0; k < sizeof (family) - 1; k++)
+		Put16 (name, family[k]);
+}
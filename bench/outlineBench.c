@@ -0,0 +1,170 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Host benchmark: the same characters exported as bitmaps (benchbmp) and as
+outlines (benchoutline) at the same size. Compares the flash taken by the two
+fonts and the time to get an 8 bpp coverage bitmap of each glyph. Run it with
+'make bench-outline'. */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "fontBuilderForC.h"
+#include "benchbmp.h"
+#include "benchoutline.h"
+
+#define L_ITERATIONS          200
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static double Now (void);
+static uint32_t BitmapsTableSize (const fontBuilderForC_Font_t *font);
+static uint32_t DescriptorsSize (const fontBuilderForC_Font_t *font);
+static double BenchBitmap (const fontBuilderForC_Font_t *font, uint8_t *dst);
+static double BenchOutline (const fontBuilderForC_Font_t *font, uint8_t *dst, int32_t *work);
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+int main (void)
+{
+	static uint8_t dst[512 * 512];
+	static int32_t work[514 * 512];
+	uint32_t bmp_flash, outline_flash;
+	double bmp_time, outline_time;
+	uint32_t glyphs = 0;
+
+	for (uint16_t k = 0; k < benchbmp_Font.num_ranges; k++)
+		glyphs += benchbmp_Font.ranges[k].num_characters;
+
+	bmp_flash = BitmapsTableSize (&benchbmp_Font) + DescriptorsSize (&benchbmp_Font);
+	outline_flash = BitmapsTableSize (&benchoutline_Font) + DescriptorsSize (&benchoutline_Font);
+	bmp_time = BenchBitmap (&benchbmp_Font, dst);
+	outline_time = BenchOutline (&benchoutline_Font, dst, work);
+
+	printf ("%u glyphs at %d px\n", glyphs, benchoutline_Font.pxl_ref_size);
+	printf ("bitmap  %d bpp: %8u bytes, %8.2f us/glyph\n", benchbmp_Font.bpp, bmp_flash, bmp_time * 1e6 / glyphs);
+	printf ("outline      : %8u bytes, %8.2f us/glyph\n", outline_flash, outline_time * 1e6 / glyphs);
+	printf ("outline flash %.1f%% of bitmap, render time x%.1f\n",
+		100.0 * outline_flash / bmp_flash, bmp_time > 0 ? outline_time / bmp_time : 0.0);
+	return 0;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Monotonic time in seconds. */
+static double Now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Bytes of the bitmaps table, computed from the descriptors. */
+static uint32_t BitmapsTableSize (const fontBuilderForC_Font_t *font)
+{
+	uint32_t end = 0;
+
+	for (uint16_t r = 0; r < font->num_ranges; r++)
+	{
+		for (uint32_t k = 0; k < font->ranges[r].num_characters; k++)
+		{
+			const fontBuilderForC_Character_t *ch = &font->ranges[r].characters[k];
+			const uint8_t *rd = (const uint8_t *)font->bitmaps_table + ch->bmp_offset;
+			uint32_t sz = 0;
+
+			if (font->pixel_format == FONTBUILDERFORC_PIXFMT_OUTLINE)
+			{	/* walk the contours up to the end marker */
+				for (uint16_t num = rd[0] | (rd[1] << 8); num; num = rd[sz] | (rd[sz + 1] << 8))
+				{
+					sz += 6;
+					while (--num)
+						sz += (rd[sz] == FONTBUILDERFORC_OUTLINE_ESCAPE) ? 5 : 2;
+				}
+				sz += 2;
+			}
+			else
+				sz = ((ch->bmp_pxl_width * font->bpp + 7) / 8) * ch->bmp_pxl_height;
+			if (ch->bmp_offset + sz > end)
+				end = ch->bmp_offset + sz;
+		}
+	}
+	return end;
+}
+
+/* Bytes of the character descriptors. */
+static uint32_t DescriptorsSize (const fontBuilderForC_Font_t *font)
+{
+	uint32_t sz = font->num_ranges * sizeof (fontBuilderForC_Range_t);
+
+	for (uint16_t r = 0; r < font->num_ranges; r++)
+		sz += font->ranges[r].num_characters * sizeof (fontBuilderForC_Character_t);
+	return sz;
+}
+
+/* Unpack every bitmap to 8 bpp, as a blit does. Returns the total time. */
+static double BenchBitmap (const fontBuilderForC_Font_t *font, uint8_t *dst)
+{
+	double start = Now ( );
+	uint8_t bpp = font->bpp;
+
+	for (uint16_t it = 0; it < L_ITERATIONS; it++)
+	{
+		for (uint16_t r = 0; r < font->num_ranges; r++)
+		{
+			for (uint32_t k = 0; k < font->ranges[r].num_characters; k++)
+			{
+				const fontBuilderForC_Character_t *ch = &font->ranges[r].characters[k];
+				const uint8_t *bmp = (const uint8_t *)font->bitmaps_table + ch->bmp_offset;
+				uint16_t row_bytes = (ch->bmp_pxl_width * bpp + 7) / 8;
+
+				for (uint16_t y = 0; y < ch->bmp_pxl_height; y++)
+				{
+					for (uint16_t x = 0; x < ch->bmp_pxl_width; x++)
+					{
+						uint32_t bit = x * bpp;
+						uint8_t v = bmp[y * row_bytes + bit / 8] >> (8 - bpp - bit % 8);
+
+						dst[x + y * ch->bmp_pxl_width] = (v & ((1 << bpp) - 1)) * 255 / ((1 << bpp) - 1);
+					}
+				}
+			}
+		}
+	}
+	return (Now ( ) - start) / L_ITERATIONS;
+}
+
+/* Rasterize every outline at the reference size. Returns the total time. */
+static double BenchOutline (const fontBuilderForC_Font_t *font, uint8_t *dst, int32_t *work)
+{
+	double start = Now ( );
+
+	for (uint16_t it = 0; it < L_ITERATIONS; it++)
+	{
+		for (uint16_t r = 0; r < font->num_ranges; r++)
+		{
+			for (uint32_t k = 0; k < font->ranges[r].num_characters; k++)
+			{
+				fontBuilderForC_Metrics_t metrics;
+
+				fontBuilderForC_OutlineRender (font, &font->ranges[r].characters[k], font->pxl_ref_size, work, dst, &metrics);
+			}
+		}
+	}
+	return (Now ( ) - start) / L_ITERATIONS;
+}
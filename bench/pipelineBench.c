@@ -0,0 +1,205 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Pipeline benchmark: generates a synthetic font with fontgen at every scale,
+runs the whole fontcvt export on it and prints glyphs/s, kerning pairs/s and
+output bytes/s as JSON. The time of a scale is the best of L_REPEATS runs; one
+more run with --stats=json adds the per phase breakdown. Run it with
+'make bench'.
+
+usage: pipelinebench <fontgen> <fontcvt> <work directory> */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+/* must match fontGen.c */
+#define FONTGEN_FIRST_CHAR    19968
+#define L_REPEATS             3
+#define L_PXL_SIZE            "-s24"
+#define L_BPP                 "-b4"
+
+typedef struct
+{
+	const char *name;
+	uint32_t glyphs;
+	uint32_t points; /* points per contour */
+	uint32_t pairs;
+} Scale_t;
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static double Now (void);
+static int Run (char *const argv[], const char *dir);
+static long FileSize (const char *dir, const char *name);
+static void PrintFile (const char *dir, const char *name);
+
+//___________________________________________________________________PRIVATE VAR
+static const Scale_t Scales[] = {
+	{ "small", 100, 8, 500 },
+	{ "medium", 1000, 16, 5000 },
+	{ "large", 4000, 32, 10000 },
+};
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+int main (int argc, char *argv[])
+{
+	uint8_t num_scales = sizeof (Scales) / sizeof (Scales[0]);
+
+	if (argc != 4)
+	{
+		fprintf (stderr, "usage: pipelinebench <fontgen> <fontcvt> <work directory>\n");
+		return 1;
+	}
+
+	printf ("{\n\t\"pxl_size\": %s, \"bpp\": %s,\n\t\"scales\": [\n", L_PXL_SIZE + 2, L_BPP + 2);
+	for (uint8_t s = 0; s < num_scales; s++)
+	{
+		const Scale_t *scale = &Scales[s];
+		char glyphs[16], points[16], pairs[16], ranges[32];
+		double best = 0;
+		long bytes;
+
+		snprintf (glyphs, sizeof (glyphs), "-g%u", scale->glyphs);
+		snprintf (points, sizeof (points), "-c%u", scale->points);
+		snprintf (pairs, sizeof (pairs), "-k%u", scale->pairs);
+		snprintf (ranges, sizeof (ranges), "-r%d-%u", FONTGEN_FIRST_CHAR, FONTGEN_FIRST_CHAR + scale->glyphs - 1);
+		{
+			char *const gen[] = { argv[1], "bench.ttf", glyphs, points, pairs, NULL };
+
+			if (Run (gen, argv[3]) != 0)
+			{
+				fprintf (stderr, "fontgen failed\n");
+				return 1;
+			}
+		}
+		for (uint8_t k = 0; k < L_REPEATS; k++)
+		{
+			char *const cvt[] = { argv[2], "bench.ttf", L_BPP, L_PXL_SIZE, ranges, "-o", "bench", NULL };
+			double start = Now ( ), elapsed;
+
+			if (Run (cvt, argv[3]) != 0)
+			{
+				fprintf (stderr, "fontcvt failed\n");
+				return 1;
+			}
+			elapsed = Now ( ) - start;
+			if (k == 0 || elapsed < best)
+				best = elapsed;
+		}
+		bytes = FileSize (argv[3], "bench.c") + FileSize (argv[3], "bench.h");
+
+		printf ("\t\t{\n\t\t\"name\": \"%s\", \"glyphs\": %u, \"points_per_contour\": %u, \"kerning_pairs\": %u,\n",
+			scale->name, scale->glyphs, scale->points, scale->pairs);
+		printf ("\t\t\"seconds\": %.6f, \"output_bytes\": %ld,\n", best, bytes);
+		printf ("\t\t\"glyphs_per_s\": %.1f, \"pairs_per_s\": %.1f, \"bytes_per_s\": %.1f,\n",
+			scale->glyphs / best, scale->pairs / best, bytes / best);
+		{
+			char *const cvt[] = { argv[2], "bench.ttf", L_BPP, L_PXL_SIZE, ranges, "-o", "bench", "--stats=json", NULL };
+
+			if (Run (cvt, argv[3]) != 0)
+			{
+				fprintf (stderr, "fontcvt failed\n");
+				return 1;
+			}
+			printf ("\t\t\"stats\": ");
+			PrintFile (argv[3], "bench.stats.json");
+		}
+		printf ("\t\t}%s\n", (s + 1 < num_scales) ? "," : "");
+	}
+	printf ("\t]\n}\n");
+	return 0;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Monotonic time in seconds. */
+static double Now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Run a program in dir, with its standard output discarded.
+    Args:
+<argv>[in] program path and arguments, NULL terminated.
+<dir>[in] working directory.
+    Ret:
+The exit status, -1 if it could not run.
+*/
+static int Run (char *const argv[], const char *dir)
+{
+	int status;
+	pid_t pid = fork ( );
+
+	if (pid < 0)
+		return -1;
+	if (pid == 0)
+	{
+		int null = open ("/dev/null", O_WRONLY);
+
+		if (chdir (dir) != 0)
+			_exit (127);
+		if (null >= 0)
+			dup2 (null, STDOUT_FILENO);
+		execv (argv[0], argv);
+		_exit (127);
+	}
+	if (waitpid (pid, &status, 0) < 0 || !WIFEXITED (status))
+		return -1;
+	return WEXITSTATUS (status);
+}
+
+/* Size of dir/name, 0 if it does not exist. */
+static long FileSize (const char *dir, const char *name)
+{
+	char path[4096];
+	struct stat st;
+
+	snprintf (path, sizeof (path), "%s/%s", dir, name);
+	if (stat (path, &st) != 0)
+		return 0;
+	return st.st_size;
+}
+
+/* Copy dir/name to the standard output, "null" if it does not exist. */
+static void PrintFile (const char *dir, const char *name)
+{
+	char path[4096];
+	FILE *f;
+	int c;
+
+	snprintf (path, sizeof (path), "%s/%s", dir, name);
+	f = fopen (path, "r");
+	if (f == NULL)
+	{
+		printf ("null\n");
+		return;
+	}
+	while ((c = fgetc (f)) != EOF)
+		putchar (c);
+	fclose (f);
+}
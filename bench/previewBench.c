@@ -0,0 +1,225 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* Preview benchmark: the latency of a font tweak seen by a designer tool.
+The subprocess way runs fontcvt and waits for the generated files. The
+in-process way opens the face once with libfontcvt and renders each tweak in
+memory with fontCvtLib_Render, then lays out a sample label with the memory
+font. Run it with 'make bench-preview'.
+
+usage: previewbench <fontcvt> <font file> <work directory> */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "fontCvtLib.h"
+
+#define L_REPEATS             5
+#define L_RANGES              "32-126,160-255"
+#define L_LABEL               "Settings: Wi-Fi, Bluetooth & Display"
+#define L_LABEL_PXL_WIDTH     480
+#define L_LABEL_PXL_HEIGHT    64
+
+typedef struct
+{	/* a font tweak */
+	uint8_t size;
+	uint8_t bpp;
+} Tweak_t;
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static double Now (void);
+static int Run (char *const argv[], const char *dir);
+static uint32_t DrawLabel (const builderMemory_Font_t *font, const char *text, uint8_t *fb);
+
+//___________________________________________________________________PRIVATE VAR
+static const Tweak_t Tweaks[] = {
+	{ 12, 4 }, { 14, 4 }, { 16, 4 }, { 16, 2 }, { 16, 8 }, { 20, 4 }, { 24, 4 }, { 32, 4 },
+};
+static const fontCvt_Range_t Ranges[] = { { 32, 126, 0 }, { 160, 255, 0 } };
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+int main (int argc, char *argv[])
+{
+	uint8_t num_tweaks = sizeof (Tweaks) / sizeof (Tweaks[0]);
+	static uint8_t fb[L_LABEL_PXL_WIDTH * L_LABEL_PXL_HEIGHT];
+	double sub_total = 0, lib_total = 0, open_time;
+	fontCvtLib_Options_t opt;
+	fontCvtLib_Face_t *face;
+
+	if (argc != 4)
+	{
+		fprintf (stderr, "usage: previewbench <fontcvt> <font file> <work directory>\n");
+		return 1;
+	}
+
+	fontCvtLib_Init ( );
+	fontCvtLib_DefaultOptions (&opt);
+	opt.ranges = Ranges;
+	opt.ranges_num = sizeof (Ranges) / sizeof (Ranges[0]);
+
+	open_time = Now ( );
+	face = fontCvtLib_OpenFace (argv[2]);
+	open_time = Now ( ) - open_time;
+	if (face == NULL)
+	{
+		fprintf (stderr, "can't open %s\n", argv[2]);
+		return 1;
+	}
+
+	printf ("%-10s %12s %12s %8s %12s\n", "tweak", "subprocess", "in-process", "speedup", "label width");
+	for (uint8_t t = 0; t < num_tweaks; t++)
+	{
+		char size[16], bpp[16];
+		char *const cvt[] = { argv[1], argv[2], bpp, size, "-r" L_RANGES, "-o", "preview", NULL };
+		double sub_best = 0, lib_best = 0;
+		uint32_t width = 0;
+
+		snprintf (size, sizeof (size), "-s%d", Tweaks[t].size);
+		snprintf (bpp, sizeof (bpp), "-b%d", Tweaks[t].bpp);
+		opt.size = Tweaks[t].size;
+		opt.bpp = Tweaks[t].bpp;
+		for (uint8_t k = 0; k < L_REPEATS; k++)
+		{
+			double start = Now ( ), elapsed;
+			builderMemory_Font_t *font;
+
+			if (Run (cvt, argv[3]) != 0)
+			{
+				fprintf (stderr, "fontcvt failed\n");
+				return 1;
+			}
+			elapsed = Now ( ) - start;
+			sub_best = (k == 0 || elapsed < sub_best) ? elapsed : sub_best;
+
+			start = Now ( );
+			font = fontCvtLib_Render (face, &opt);
+			if (font == NULL)
+			{
+				fprintf (stderr, "render failed\n");
+				return 1;
+			}
+			memset (fb, 0, sizeof (fb));
+			width = DrawLabel (font, L_LABEL, fb);
+			builderMemory_Free (font);
+			elapsed = Now ( ) - start;
+			lib_best = (k == 0 || elapsed < lib_best) ? elapsed : lib_best;
+		}
+		sub_total += sub_best;
+		lib_total += lib_best;
+		printf ("%3d px %d b %9.2f ms %9.2f ms %7.1fx %9u px\n", Tweaks[t].size, Tweaks[t].bpp,
+			sub_best * 1e3, lib_best * 1e3, sub_best / lib_best, width);
+	}
+	printf ("average    %9.2f ms %9.2f ms %7.1fx\n", sub_total * 1e3 / num_tweaks, lib_total * 1e3 / num_tweaks,
+		sub_total / lib_total);
+	printf ("ranges %s, best of %d runs, in-process face opened once in %.2f ms\n", L_RANGES, L_REPEATS,
+		open_time * 1e3);
+
+	fontCvtLib_CloseFace (face);
+	return 0;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Monotonic time in seconds. */
+static double Now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Run a program in dir, with its standard output discarded.
+    Args:
+<argv>[in] program path and arguments, NULL terminated.
+<dir>[in] working directory.
+    Ret:
+The exit status, -1 if it could not run.
+*/
+static int Run (char *const argv[], const char *dir)
+{
+	int status;
+	pid_t pid = fork ( );
+
+	if (pid < 0)
+		return -1;
+	if (pid == 0)
+	{
+		int null = open ("/dev/null", O_WRONLY);
+
+		if (chdir (dir) != 0)
+			_exit (127);
+		if (null >= 0)
+			dup2 (null, STDOUT_FILENO);
+		execv (argv[0], argv);
+		_exit (127);
+	}
+	if (waitpid (pid, &status, 0) < 0 || !WIFEXITED (status))
+		return -1;
+	return WEXITSTATUS (status);
+}
+
+/* Draw an ASCII label with kerning in an 8 bit frame buffer, as a preview
+would do with the memory font.
+    Args:
+<font>[in] memory font.
+<text>[in] label.
+<fb>[out] L_LABEL_PXL_WIDTH x L_LABEL_PXL_HEIGHT frame buffer.
+    Ret:
+the label width (pixel).
+*/
+static uint32_t DrawLabel (const builderMemory_Font_t *font, const char *text, uint8_t *fb)
+{
+	const builderMemory_Character_t *prev = NULL;
+	int32_t x = 0, baseline = font->font.pxl_max_glyph_height;
+
+	for (; *text; text++)
+	{
+		const builderMemory_Character_t *ch = builderMemory_Find (font, (uint8_t)*text);
+		const fontCvt_Character_t *c;
+
+		if (ch == NULL)
+			continue;
+		c = &ch->character;
+		if (prev)
+			x += builderMemory_GetKerning (font, prev, c->unicode);
+		for (uint16_t y = 0; y < c->bmp_pxl_height && c->bmp; y++)
+		{
+			int32_t fy = baseline - c->pxl_top + y;
+
+			for (uint16_t gx = 0; gx < c->bmp_pxl_width; gx++)
+			{
+				int32_t fx = x + c->pxl_left + gx;
+				uint8_t val = c->bmp[y * c->bmp_pxl_width + gx];
+
+				if (fx >= 0 && fx < L_LABEL_PXL_WIDTH && fy >= 0 && fy < L_LABEL_PXL_HEIGHT && val > fb[fy * L_LABEL_PXL_WIDTH + fx])
+					fb[fy * L_LABEL_PXL_WIDTH + fx] = val;
+			}
+		}
+		x += c->pxl_advance;
+		prev = ch;
+	}
+	return x;
+}
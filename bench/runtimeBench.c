@@ -0,0 +1,399 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Runtime rendering benchmark: the same generated font exported in every
+storage mode is used to lay out multilingual paragraphs in a frame buffer,
+through the runtime lookup, kerning and blit (or render) functions. For each
+mode it reports glyphs/s, cycles per glyph and the bytes the runtime reads per
+glyph (range table, descriptor, kerning pairs and bitmap). Run it on the host
+with 'make bench-runtime'.
+
+On a target define BENCH_CYCLES() to read the core cycle counter (for example
+the DWT CYCCNT register of a Cortex-M) and BENCH_CYCLES_HZ to its frequency,
+then build this file with the fonts and fontBuilderForC.c. */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "fontBuilderForC.h"
+#include "rt_bmp1.h"
+#include "rt_bmp2.h"
+#include "rt_bmp4.h"
+#include "rt_bmp8.h"
+#include "rt_atlas4.h"
+#include "rt_rgb565.h"
+#include "rt_pal565.h"
+#include "rt_l8.h"
+#include "rt_sdf.h"
+#include "rt_outline.h"
+
+#ifndef BENCH_CYCLES
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES()        __rdtsc ( )
+#elif defined(__aarch64__)
+static inline uint64_t ReadCntvct (void)
+{
+	uint64_t val;
+
+	__asm__ volatile ("mrs %0, cntvct_el0" : "=r" (val));
+	return val;
+}
+#define BENCH_CYCLES()        ReadCntvct ( )
+#else
+#define L_CYCLES_FROM_CLOCK
+#define BENCH_CYCLES()        NowNs ( )
+#define BENCH_CYCLES_HZ       1000000000ull
+#endif
+#endif
+
+#ifndef BENCH_CYCLES_HZ
+/* host counter: its frequency is measured against the monotonic clock */
+#define L_CYCLES_CALIBRATE
+#endif
+
+#if defined(L_CYCLES_FROM_CLOCK) || defined(L_CYCLES_CALIBRATE)
+#include <time.h>
+#endif
+
+#define L_FB_WIDTH            480
+#define L_FB_HEIGHT           272
+#define L_ITERATIONS          200
+/* size distance field and outline fonts are drawn at */
+#define L_SCALED_PXL_SIZE     16
+#define L_MAX_GLYPH_SIDE      128
+
+typedef struct
+{
+	const char *name;
+	const fontBuilderForC_Font_t *font;
+} BenchFont_t;
+
+typedef struct
+{	/* layout totals */
+	uint32_t glyphs; /* glyphs drawn */
+	uint32_t missing; /* characters not in the font */
+	uint64_t bytes; /* bytes read by the runtime */
+} BenchCount_t;
+
+//____________________________________________________________PRIVATE PROTOTYPES
+#if defined(L_CYCLES_FROM_CLOCK) || defined(L_CYCLES_CALIBRATE)
+static uint64_t NowNs (void);
+#endif
+static uint64_t CyclesHz (void);
+static uint32_t NextUnicode (const char **text);
+static void Layout (const fontBuilderForC_Font_t *font, const char *text, BenchCount_t *count);
+static uint32_t FetchedBytes (const fontBuilderForC_Font_t *font, const fontBuilderForC_Character_t *character, uint32_t unicode);
+static uint32_t FlashSize (const fontBuilderForC_Font_t *font);
+
+//___________________________________________________________________PRIVATE VAR
+static const BenchFont_t Fonts[] = {
+	{ "coverage 1 bpp", &rt_bmp1_Font },
+	{ "coverage 2 bpp", &rt_bmp2_Font },
+	{ "coverage 4 bpp", &rt_bmp4_Font },
+	{ "coverage 8 bpp", &rt_bmp8_Font },
+	{ "atlas 4 bpp", &rt_atlas4_Font },
+	{ "rgb565", &rt_rgb565_Font },
+	{ "rgb565 palette", &rt_pal565_Font },
+	{ "l8", &rt_l8_Font },
+	{ "sdf", &rt_sdf_Font },
+	{ "outline", &rt_outline_Font },
+};
+
+/* the character ranges of the benchmark fonts (Makefile) cover these texts */
+static const char *Paragraphs[] = {
+	"The quick brown fox jumps over the lazy dog. Pack my box with five dozen liquor jugs, "
+	"then sphinx of black quartz, judge my vow while the wizard quickly jinxes the gnomes.",
+	"Le cœur déçu mais l'âme plutôt naïve, Louÿs rêva de crapaüter en canoë au delà des îles, "
+	"près du mälström où brûlent les novæ. Voyez le brick géant que j'examine près du wharf.",
+	"Zwölf Boxkämpfer jagen Viktor quer über den großen Sylter Deich. Falsches Üben von "
+	"Xylophonmusik quält jeden größeren Zwerg.",
+	"Τάχιστη αλώπηξ βαφής ψημένη γη, δρασκελίζει υπέρ νωθρού κυνός. Ξεσκεπάζω την ψυχοφθόρα βδελυγμία.",
+	"Съешь же ещё этих мягких французских булок, да выпей чаю. Широкая электрификация южных губерний "
+	"даст мощный толчок подъёму сельского хозяйства.",
+	"今天天气很好，我们一起去公园散步。中国是一个历史悠久的国家，人口众多，文化丰富。"
+	"他们在北京大学学习中文和数学，每天早上六点起床。",
+};
+
+static uint8_t FrameBuffer[L_FB_WIDTH * L_FB_HEIGHT * 2];
+static uint8_t GlyphBuffer[L_MAX_GLYPH_SIDE * L_MAX_GLYPH_SIDE];
+static int32_t WorkBuffer[(L_MAX_GLYPH_SIDE + 2) * L_MAX_GLYPH_SIDE];
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+int main (void)
+{
+	uint64_t hz = CyclesHz ( );
+
+	printf ("%-16s %10s %12s %12s %10s %8s\n", "mode", "flash", "glyphs/s", "cycles/glyph", "bytes/glyph", "missing");
+	for (uint8_t f = 0; f < sizeof (Fonts) / sizeof (Fonts[0]); f++)
+	{
+		const fontBuilderForC_Font_t *font = Fonts[f].font;
+		BenchCount_t count = { 0 };
+		uint64_t start, cycles;
+
+		/* one pass counting what the runtime reads, not timed */
+		for (uint8_t p = 0; p < sizeof (Paragraphs) / sizeof (Paragraphs[0]); p++)
+			Layout (font, Paragraphs[p], &count);
+
+		start = BENCH_CYCLES ( );
+		for (uint16_t it = 0; it < L_ITERATIONS; it++)
+		{
+			for (uint8_t p = 0; p < sizeof (Paragraphs) / sizeof (Paragraphs[0]); p++)
+				Layout (font, Paragraphs[p], NULL);
+		}
+		cycles = BENCH_CYCLES ( ) - start;
+
+		printf ("%-16s %10u %12.0f %12.1f %10.1f %8u\n", Fonts[f].name, FlashSize (font),
+			(double)count.glyphs * L_ITERATIONS * hz / cycles,
+			(double)cycles / ((double)count.glyphs * L_ITERATIONS),
+			(double)count.bytes / count.glyphs, count.missing);
+	}
+	printf ("sdf and outline drawn at %d px, %dx%d frame buffer, cycle counter at %.1f MHz\n",
+		L_SCALED_PXL_SIZE, L_FB_WIDTH, L_FB_HEIGHT, hz / 1e6);
+	return 0;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+#if defined(L_CYCLES_FROM_CLOCK) || defined(L_CYCLES_CALIBRATE)
+/* Monotonic time in nanoseconds. */
+static uint64_t NowNs (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+#endif
+
+/* Frequency of the cycle counter, measured over 100 ms on the host. */
+static uint64_t CyclesHz (void)
+{
+#ifdef L_CYCLES_CALIBRATE
+	uint64_t ns = NowNs ( ), cycles = BENCH_CYCLES ( );
+
+	while (NowNs ( ) - ns < 100000000)
+		;
+	return (BENCH_CYCLES ( ) - cycles) * 1000000000ull / (NowNs ( ) - ns);
+#else
+	return BENCH_CYCLES_HZ;
+#endif
+}
+
+/* Decode the next UTF-8 character and advance the text.
+    Args:
+<text>[in/out] text pointer.
+    Ret:
+the unicode character, 0 at the end of the text.
+*/
+static uint32_t NextUnicode (const char **text)
+{
+	const uint8_t *s = (const uint8_t *)*text;
+	uint32_t unicode;
+	uint8_t len;
+
+	if (s[0] < 0x80)
+		unicode = s[0], len = 1;
+	else if (s[0] < 0xE0)
+		unicode = s[0] & 0x1F, len = 2;
+	else if (s[0] < 0xF0)
+		unicode = s[0] & 0x0F, len = 3;
+	else
+		unicode = s[0] & 0x07, len = 4;
+	for (uint8_t k = 1; k < len; k++)
+		unicode = (unicode << 6) | (s[k] & 0x3F);
+	if (unicode)
+		*text += len;
+	return unicode;
+}
+
+/* Lay out a paragraph in the frame buffer: lookup, kerning, line wrapping and
+blit (or render and merge for distance field and outline fonts).
+    Args:
+<font>[in] font.
+<text>[in] UTF-8 text.
+<count>[out] NULL when timed; otherwise incremented with the glyphs drawn and
+    the bytes read.
+    Ret:
+*/
+static void Layout (const fontBuilderForC_Font_t *font, const char *text, BenchCount_t *count)
+{
+	uint8_t scalable = font->pixel_format == FONTBUILDERFORC_PIXFMT_SDF || font->pixel_format == FONTBUILDERFORC_PIXFMT_OUTLINE;
+	uint16_t pxl_size = scalable ? L_SCALED_PXL_SIZE : font->pxl_ref_size;
+	uint8_t pxl_bytes = (font->pixel_format == FONTBUILDERFORC_PIXFMT_RGB565) ? 2 : 1;
+	uint16_t stride = L_FB_WIDTH * pxl_bytes;
+	uint16_t line = scalable ? (font->pxl_baseline_to_baseline * pxl_size + font->pxl_ref_size - 1) / font->pxl_ref_size
+		: font->pxl_baseline_to_baseline;
+	const fontBuilderForC_Character_t *prev = NULL;
+	uint32_t prev_unicode = 0, unicode;
+	int32_t x = 0, y = line;
+
+	while ((unicode = NextUnicode (&text)) != 0)
+	{
+		const fontBuilderForC_Character_t *ch = fontBuilderForC_FindCharacter (font, unicode);
+		fontBuilderForC_Metrics_t m;
+
+		if (ch == NULL)
+		{
+			if (count)
+				count->missing++;
+			prev = NULL;
+			continue;
+		}
+		if (prev)
+		{
+			int32_t adjust = fontBuilderForC_GetKerning (font, prev, prev_unicode, unicode);
+
+			x += scalable ? adjust * pxl_size / font->pxl_ref_size : adjust;
+		}
+
+		if (font->pixel_format == FONTBUILDERFORC_PIXFMT_SDF)
+			fontBuilderForC_SdfRender (font, ch, pxl_size, 1, NULL, &m);
+		else if (font->pixel_format == FONTBUILDERFORC_PIXFMT_OUTLINE)
+			fontBuilderForC_OutlineRender (font, ch, pxl_size, NULL, NULL, &m);
+		else
+		{
+			m.bmp_pxl_width = ch->bmp_pxl_width;
+			m.bmp_pxl_height = ch->bmp_pxl_height;
+			m.pxl_left = ch->pxl_left;
+			m.pxl_top = ch->pxl_top;
+			m.pxl_advance = ch->pxl_advance;
+		}
+		if (x + m.pxl_advance > L_FB_WIDTH)
+		{	/* new line, back to the top when the frame buffer is full */
+			x = 0;
+			y += line;
+			if (y + line > L_FB_HEIGHT)
+				y = line;
+		}
+
+		if (x + m.pxl_left >= 0 && y - m.pxl_top >= 0 && m.bmp_pxl_width <= L_MAX_GLYPH_SIDE && m.bmp_pxl_height <= L_MAX_GLYPH_SIDE
+		 && x + m.pxl_left + m.bmp_pxl_width <= L_FB_WIDTH && y - m.pxl_top + m.bmp_pxl_height <= L_FB_HEIGHT)
+		{
+			uint8_t *dst = &FrameBuffer[(y - m.pxl_top) * stride + (x + m.pxl_left) * pxl_bytes];
+
+			if (scalable)
+			{	/* render at the destination size and merge the coverage */
+				if (font->pixel_format == FONTBUILDERFORC_PIXFMT_SDF)
+					fontBuilderForC_SdfRender (font, ch, pxl_size, 1, GlyphBuffer, &m);
+				else
+					fontBuilderForC_OutlineRender (font, ch, pxl_size, WorkBuffer, GlyphBuffer, &m);
+				for (uint16_t gy = 0; gy < m.bmp_pxl_height; gy++, dst += stride)
+				{
+					for (uint16_t gx = 0; gx < m.bmp_pxl_width; gx++)
+					{
+						uint8_t val = GlyphBuffer[gy * m.bmp_pxl_width + gx];
+
+						dst[gx] = (val > dst[gx]) ? val : dst[gx];
+					}
+				}
+			}
+			else
+				fontBuilderForC_Blit (font, ch, dst, stride);
+			if (count)
+			{
+				count->glyphs++;
+				count->bytes += FetchedBytes (font, ch, unicode);
+				if (prev)
+				{	/* kerning pairs scanned */
+					for (uint32_t k = prev->kerning_index; k < font->num_kerning && font->kerning[k].left_ch == prev_unicode; k++)
+					{
+						count->bytes += sizeof (fontBuilderForC_Kerning_t);
+						if (font->kerning[k].right_ch == unicode)
+							break;
+					}
+				}
+			}
+		}
+		x += m.pxl_advance;
+		prev = ch;
+		prev_unicode = unicode;
+	}
+}
+
+/* Bytes the runtime reads to draw a character: the range table entries
+scanned, the descriptor and the bitmap (or outline) bytes.
+    Args:
+<font>[in] font.
+<character>[in] character descriptor.
+<unicode>[in] character unicode, 0 to get the bitmap bytes only.
+    Ret:
+the bytes.
+*/
+static uint32_t FetchedBytes (const fontBuilderForC_Font_t *font, const fontBuilderForC_Character_t *character, uint32_t unicode)
+{
+	const uint8_t *rd = (const uint8_t *)font->bitmaps_table + (font->num_atlas_pages ? 0 : character->bmp_offset);
+	uint32_t bytes = 0;
+
+	if (unicode)
+	{
+		for (uint16_t r = 0; r < font->num_ranges; r++)
+		{
+			bytes += sizeof (fontBuilderForC_Range_t);
+			if (unicode >= font->ranges[r].first && unicode - font->ranges[r].first < font->ranges[r].num_characters)
+				break;
+		}
+		bytes += sizeof (fontBuilderForC_Character_t);
+	}
+
+	if (font->pixel_format == FONTBUILDERFORC_PIXFMT_OUTLINE)
+	{	/* walk the contours up to the end marker */
+		uint32_t sz = 0;
+
+		for (uint16_t num = rd[0] | (rd[1] << 8); num; num = rd[sz] | (rd[sz + 1] << 8))
+		{
+			sz += 6;
+			while (--num)
+				sz += (rd[sz] == FONTBUILDERFORC_OUTLINE_ESCAPE) ? 5 : 2;
+		}
+		return bytes + sz + 2;
+	}
+	if (font->num_atlas_pages)
+	{	/* bytes touched by each row of the rectangle */
+		uint32_t first = (FONTBUILDERFORC_ATLAS_X (character->bmp_offset) * font->bpp) / 8;
+		uint32_t last = ((FONTBUILDERFORC_ATLAS_X (character->bmp_offset) + character->bmp_pxl_width) * font->bpp + 7) / 8;
+
+		return bytes + (last - first) * character->bmp_pxl_height;
+	}
+	return bytes + ((character->bmp_pxl_width * font->bpp + 7) / 8) * character->bmp_pxl_height;
+}
+
+/* Flash taken by a font: bitmaps table, descriptors, ranges and kerning. */
+static uint32_t FlashSize (const fontBuilderForC_Font_t *font)
+{
+	uint32_t end = 0; /* end of the bitmaps table */
+	uint32_t flash = font->num_ranges * sizeof (fontBuilderForC_Range_t)
+		+ font->num_kerning * sizeof (fontBuilderForC_Kerning_t);
+
+	if (font->num_atlas_pages)
+		end = (uint32_t)font->num_atlas_pages * font->atlas_pxl_height * ((font->atlas_pxl_width * font->bpp + 7) / 8);
+	for (uint16_t r = 0; r < font->num_ranges; r++)
+	{
+		flash += font->ranges[r].num_characters * sizeof (fontBuilderForC_Character_t);
+		for (uint32_t k = 0; k < font->ranges[r].num_characters && !font->num_atlas_pages; k++)
+		{
+			const fontBuilderForC_Character_t *ch = &font->ranges[r].characters[k];
+			uint32_t ch_end = ch->bmp_offset + FetchedBytes (font, ch, 0);
+
+			end = (ch_end > end) ? ch_end : end;
+		}
+	}
+	return flash + end;
+}
@@ -0,0 +1,580 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Flash budget optimizer. The export is rendered once in memory at 8 bpp;
+every character is measured at each bpp (bitmap bytes, with autobpp=0 storing
+the glyphs exact at a lower depth there, and coverage error against the 8 bit
+render), then a greedy search makes the moves saving the most bytes for the
+least quality until the C builder output fits the budget:
+    - lower the bpp of a range, the error is weighted by the corpus;
+    - leave out the least used character (with drop), a dropped character
+      counts as a full error;
+the ranges are always split where two or more characters in a row have no
+glyph (or are dropped), a descriptor costing as much as a range. The flash
+model is the one of the report builder: the C builder structures on a 32 bit
+target. */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "budget.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define L_MAX(a, b)           (((a) >= (b)) ? (a) : (b))
+
+/* sizes of the C builder structures (fontBuilderForC.h) on a 32 bit target */
+#define L_SIZEOF_CHARACTER    20
+#define L_SIZEOF_RANGE        12
+#define L_SIZEOF_KERNING      12
+#define L_SIZEOF_FONT         48
+
+#define L_NUM_BPP             4
+/* coverage error of a character left out of the font */
+#define L_DROP_ERROR          255.0
+#define L_NONE                UINT32_MAX
+
+typedef struct
+{	/* a character of the export */
+	uint32_t unicode;
+	uint32_t glyph_idx; /* 0 if the font has no glyph for it */
+	uint16_t range;
+	/* with its range at each bpp: bitmap bytes, bpp index the bitmap is stored
+	at (autobpp=0) and mean coverage error */
+	uint32_t bytes[L_NUM_BPP];
+	uint8_t stored[L_NUM_BPP];
+	double error[L_NUM_BPP];
+	uint32_t pairs; /* kerning pairs with the character on either side */
+	double weight; /* corpus occurrences, 1 without corpus */
+	bool kept;
+} Char_t;
+
+typedef struct
+{	/* optimizer state */
+	Char_t *chars; /* range after range, in unicode order inside a range */
+	uint32_t chars_num;
+	uint32_t *by_unicode; /* chars indexes sorted by unicode */
+	const fontCvt_Range_t *ranges;
+	uint16_t ranges_num;
+	uint32_t *range_first; /* first character of each range, ranges_num + 1 */
+	uint8_t *range_bpp; /* current bpp index of each range */
+	/* bytes and weighted error of the kept characters of each range at each
+	bpp */
+	double (*range_bytes)[L_NUM_BPP];
+	double (*range_error)[L_NUM_BPP];
+	uint32_t (*pairs)[2]; /* kerning pairs, chars indexes */
+	uint32_t pairs_num;
+	uint64_t *set; /* bitmaps stored, open addressing */
+	uint32_t set_max;
+	double weight; /* of the characters with a glyph */
+} Ctx_t;
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static bool Measure (Ctx_t *ctx, const builderMemory_Font_t *font, const corpus_Corpus_t *corpus);
+static void MeasureBitmap (Char_t *ch, const fontCvt_Character_t *character);
+static uint32_t FindChar (const Ctx_t *ctx, uint32_t unicode);
+static uint32_t Cost (Ctx_t *ctx);
+static uint32_t Split (const Ctx_t *ctx, uint16_t r, fontCvt_Range_t *out, uint32_t *descriptors);
+static void Drop (Ctx_t *ctx, uint32_t c);
+static double Error (const Ctx_t *ctx, double *kept_weight);
+static int CompareUnicode (const void *a, const void *b);
+static int CompareDrop (const void *a, const void *b);
+
+//___________________________________________________________________PRIVATE VAR
+static const uint8_t BppList[L_NUM_BPP] = { 1, 2, 4, 8 };
+/* CompareDrop needs the characters */
+static const Char_t *SortChars;
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Find the export configuration fitting a flash budget with the least
+quality loss.
+    Args:
+<font>[in] export rendered in memory at 8 bpp, with opt ranges.
+<opt>[in] export options: the ranges and, as the highest bpp to use, bpp. A
+    range bpp is the highest of that range.
+<corpus>[in] text the font has to draw, NULL to weigh every character the
+    same.
+<budget>[in] flash bytes.
+<drop>[in] characters can be left out.
+<result>[out] configuration found, release it with budget_Free. When the
+    budget can't be reached it is the smallest one found.
+    Ret:
+false on allocation fail or if no character is left.
+*/
+bool budget_Optimize (const builderMemory_Font_t *font, const fontCvtLib_Options_t *opt, const corpus_Corpus_t *corpus,
+	uint32_t budget, bool drop, budget_Result_t *result)
+{
+	Ctx_t ctx;
+	uint32_t *drops = NULL; /* drop candidates, least used first */
+	uint32_t drops_num = 0, next_drop = 0;
+	uint32_t est; /* estimated cost */
+	uint32_t descriptors;
+	double kept_weight;
+	bool ok;
+
+	memset (&ctx, 0, sizeof (ctx));
+	memset (result, 0, sizeof (*result));
+	ctx.ranges = opt->ranges;
+	ctx.ranges_num = opt->ranges_num;
+	for (uint16_t r = 0; r < opt->ranges_num; r++)
+		ctx.chars_num += opt->ranges[r].last - opt->ranges[r].first + 1;
+	ctx.chars = calloc (ctx.chars_num + 1, sizeof (Char_t));
+	ctx.by_unicode = malloc (sizeof (uint32_t) * (ctx.chars_num + 1));
+	ctx.range_first = malloc (sizeof (uint32_t) * (ctx.ranges_num + 1));
+	ctx.range_bpp = malloc (ctx.ranges_num + 1);
+	ctx.range_bytes = calloc (ctx.ranges_num + 1, sizeof (*ctx.range_bytes));
+	ctx.range_error = calloc (ctx.ranges_num + 1, sizeof (*ctx.range_error));
+	ctx.set_max = 1024;
+	while (ctx.set_max < 2 * ctx.chars_num)
+		ctx.set_max *= 2;
+	ctx.set = malloc (sizeof (uint64_t) * ctx.set_max);
+	drops = malloc (sizeof (uint32_t) * (ctx.chars_num + 1));
+	ok = ctx.chars && ctx.by_unicode && ctx.range_first && ctx.range_bpp && ctx.range_bytes && ctx.range_error
+	  && ctx.set && drops && Measure (&ctx, font, corpus);
+
+	for (uint16_t r = 0; r < ctx.ranges_num && ok; r++)
+	{	/* every range starts at its highest bpp */
+		uint8_t bpp = opt->ranges[r].bpp ? opt->ranges[r].bpp : opt->bpp;
+
+		for (ctx.range_bpp[r] = L_NUM_BPP - 1; ctx.range_bpp[r] && BppList[ctx.range_bpp[r]] > bpp; ctx.range_bpp[r]--)
+			;
+	}
+	for (uint32_t c = 0; c < ctx.chars_num && ok; c++)
+	{
+		if (ctx.chars[c].glyph_idx)
+			drops[drops_num++] = c;
+	}
+	if (ok)
+	{
+		SortChars = ctx.chars;
+		qsort (drops, drops_num, sizeof (uint32_t), CompareDrop);
+		result->start_bytes = est = Cost (&ctx);
+		result->start_error = Error (&ctx, &kept_weight);
+	}
+
+	while (ok && est > budget)
+	{	/* the move saving the most bytes per quality lost */
+		double best_score = 0, best_saving = 0;
+		int32_t best_range = -1;
+		bool best_drop = false;
+
+		for (uint16_t r = 0; r < ctx.ranges_num; r++)
+		{
+			uint8_t b = ctx.range_bpp[r];
+			double saving, loss;
+
+			if (b == 0)
+				continue;
+			saving = ctx.range_bytes[r][b] - ctx.range_bytes[r][b - 1];
+			loss = (ctx.range_error[r][b - 1] - ctx.range_error[r][b]) / L_MAX (ctx.weight, 1e-9);
+			if (saving > 0 && (loss > 0 ? saving / loss : saving * 1e12) > best_score)
+			{
+				best_score = (loss > 0) ? saving / loss : saving * 1e12;
+				best_saving = saving;
+				best_range = r;
+			}
+		}
+		while (drop && next_drop < drops_num && !ctx.chars[drops[next_drop]].kept)
+			next_drop++;
+		if (drop && next_drop < drops_num)
+		{	/* the descriptor goes away when the range gets split */
+			const Char_t *ch = &ctx.chars[drops[next_drop]];
+			double saving = ch->bytes[ctx.range_bpp[ch->range]] + ch->pairs * L_SIZEOF_KERNING + L_SIZEOF_CHARACTER;
+			double loss = ch->weight * L_DROP_ERROR / L_MAX (ctx.weight, 1e-9);
+
+			if ((loss > 0 ? saving / loss : saving * 1e12) > best_score)
+			{
+				best_score = (loss > 0) ? saving / loss : saving * 1e12;
+				best_saving = saving;
+				best_drop = true;
+			}
+		}
+
+		if (best_drop)
+			Drop (&ctx, drops[next_drop++]);
+		else if (best_range >= 0)
+			ctx.range_bpp[best_range]--;
+		else
+			break; /* nothing left to try */
+		est = (est > best_saving) ? est - (uint32_t)best_saving : 0;
+		if (est <= budget)
+			est = Cost (&ctx);
+	}
+
+	if (ok)
+	{	/* the ranges of the configuration found */
+		result->bytes = Cost (&ctx);
+		result->error = Error (&ctx, &kept_weight);
+		result->coverage = (ctx.weight > 0) ? kept_weight / ctx.weight : 1.0;
+		for (uint32_t c = 0; c < ctx.chars_num; c++)
+			result->dropped += (ctx.chars[c].glyph_idx && !ctx.chars[c].kept);
+		for (uint16_t r = 0; r < ctx.ranges_num; r++)
+			result->ranges_num += Split (&ctx, r, NULL, &descriptors);
+		result->ranges = calloc (result->ranges_num + 1, sizeof (fontCvt_Range_t));
+		ok = (result->ranges != NULL) && result->ranges_num;
+		result->ranges_num = 0;
+		for (uint16_t r = 0; r < ctx.ranges_num && ok; r++)
+		{
+			result->ranges_num += Split (&ctx, r, &result->ranges[result->ranges_num], &descriptors);
+			result->bpp = L_MAX (result->bpp, BppList[ctx.range_bpp[r]]);
+		}
+		if (!ok)
+			fprintf (stderr, "no character left inside the budget\n");
+	}
+	else
+		fprintf (stderr, "budget allocation fail\n");
+
+	free (ctx.chars);
+	free (ctx.by_unicode);
+	free (ctx.range_first);
+	free (ctx.range_bpp);
+	free (ctx.range_bytes);
+	free (ctx.range_error);
+	free (ctx.pairs);
+	free (ctx.set);
+	free (drops);
+	if (!ok)
+		budget_Free (result);
+	return ok;
+}
+
+/* Release the ranges of a result. */
+void budget_Free (budget_Result_t *result)
+{
+	free (result->ranges);
+	result->ranges = NULL;
+	result->ranges_num = 0;
+}
+
+/* Write the configuration found: the estimates as comments and the fontcvt
+command line giving the output.
+    Args:
+<fname>[in] destination file.
+<result>[in] configuration found.
+<opt>[in] export options.
+<fname_font>[in] font file.
+<budget>[in] flash bytes.
+    Ret:
+false if the file can't be written.
+*/
+bool budget_Save (const char *fname, const budget_Result_t *result, const fontCvtLib_Options_t *opt,
+	const char *fname_font, uint32_t budget)
+{
+	FILE *f = fopen (fname, "wb");
+
+	if (f == NULL)
+	{
+		fprintf (stderr, "can't create %s\n", fname);
+		return false;
+	}
+	fprintf (f, "# flash budget %u bytes%s\n", budget, (result->bytes > budget) ? ", not reached" : "");
+	fprintf (f, "# estimated %u bytes, %u as asked\n", result->bytes, result->start_bytes);
+	fprintf (f, "# %.2f%% of the characters drawn, %u characters left out\n", 100.0 * result->coverage, result->dropped);
+	fprintf (f, "# mean coverage error %.2f (8 bit), %.2f as asked\n", result->error, result->start_error);
+	fprintf (f, "fontcvt -s %d -b %d -r ", opt->size, result->bpp);
+	for (uint16_t k = 0; k < result->ranges_num; k++)
+	{
+		const fontCvt_Range_t *range = &result->ranges[k];
+
+		fprintf (f, "%s%d", k ? "," : "", range->first);
+		if (range->last != range->first)
+			fprintf (f, "-%d", range->last);
+		if (range->bpp != result->bpp)
+			fprintf (f, ":%d", range->bpp);
+	}
+	if (opt->builder_opt)
+		fprintf (f, " -j %s", opt->builder_opt);
+	fprintf (f, " %s -o %s\n", fname_font, opt->output);
+	fclose (f);
+	return true;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Measure every character of the export and resolve the kerning pairs.
+    Args:
+<ctx>[in] optimizer state with its arrays allocated.
+<font>[in] export rendered in memory.
+<corpus>[in] corpus, can be NULL.
+    Ret:
+false on allocation fail.
+*/
+static bool Measure (Ctx_t *ctx, const builderMemory_Font_t *font, const corpus_Corpus_t *corpus)
+{
+	uint32_t c = 0;
+
+	for (uint16_t r = 0; r < ctx->ranges_num; r++)
+	{
+		ctx->range_first[r] = c;
+		for (wchar_t unicode = ctx->ranges[r].first; unicode <= ctx->ranges[r].last; unicode++, c++)
+		{
+			const builderMemory_Character_t *mem = builderMemory_Find (font, unicode);
+			Char_t *ch = &ctx->chars[c];
+
+			ch->unicode = unicode;
+			ch->range = r;
+			ctx->by_unicode[c] = c;
+			if (mem == NULL || mem->character.glyph_idx == 0)
+				continue;
+			ch->glyph_idx = mem->character.glyph_idx;
+			ch->weight = corpus ? corpus_Count (corpus, unicode) : 1;
+			ch->kept = true;
+			MeasureBitmap (ch, &mem->character);
+			ctx->weight += ch->weight;
+			for (uint8_t b = 0; b < L_NUM_BPP; b++)
+			{
+				ctx->range_bytes[r][b] += ch->bytes[b];
+				ctx->range_error[r][b] += ch->weight * ch->error[b];
+			}
+		}
+	}
+	ctx->range_first[ctx->ranges_num] = c;
+	SortChars = ctx->chars;
+	qsort (ctx->by_unicode, ctx->chars_num, sizeof (uint32_t), CompareUnicode);
+
+	ctx->pairs = malloc (sizeof (*ctx->pairs) * (font->kernings_num + 1));
+	if (ctx->pairs == NULL)
+		return false;
+	for (uint32_t k = 0; k < font->kernings_num; k++)
+	{
+		uint32_t left = FindChar (ctx, font->kernings[k].left_char);
+		uint32_t right = FindChar (ctx, font->kernings[k].right_char);
+
+		if (left == L_NONE || right == L_NONE)
+			continue;
+		ctx->pairs[ctx->pairs_num][0] = left;
+		ctx->pairs[ctx->pairs_num++][1] = right;
+		ctx->chars[left].pairs++;
+		ctx->chars[right].pairs += (right != left);
+	}
+	return true;
+}
+
+/* Measure the bitmap of a character at every bpp.
+    Args:
+<ch>[out] character measures.
+<character>[in] character with its 8 bit bitmap.
+    Ret:
+*/
+static void MeasureBitmap (Char_t *ch, const fontCvt_Character_t *character)
+{
+	uint32_t size = (uint32_t)character->bmp_pxl_width * character->bmp_pxl_height;
+	const uint8_t *bmp = (const uint8_t *)character->bmp;
+
+	for (uint8_t b = 0; b < L_NUM_BPP; b++)
+	{
+		uint8_t bpp = BppList[b];
+		uint32_t error = 0;
+
+		ch->stored[b] = b;
+		for (uint32_t k = 0; k < size && bmp; k++)
+		{	/* 255 / (2^bpp - 1) is exact for 1, 2, 4 and 8 bpp */
+			int16_t val = (bmp[k] >> (8 - bpp)) * (255 / ((1 << bpp) - 1));
+
+			error += abs (val - bmp[k]);
+		}
+		ch->error[b] = size ? (double)error / size : 0;
+		/* autobpp=0: the lowest bpp drawing the same coverage */
+		for (uint8_t low = 0; low < b && ch->stored[b] == b && bmp; low++)
+		{
+			uint32_t k;
+
+			for (k = 0; k < size; k++)
+			{
+				if ((bmp[k] >> (8 - bpp)) * (255 / ((1 << bpp) - 1))
+				 != (bmp[k] >> (8 - BppList[low])) * (255 / ((1 << BppList[low]) - 1)))
+					break;
+			}
+			if (k == size)
+				ch->stored[b] = low;
+		}
+		ch->bytes[b] = ((character->bmp_pxl_width * BppList[ch->stored[b]] + 7) / 8) * character->bmp_pxl_height;
+	}
+}
+
+/* Look for a character of the export.
+    Ret:
+its index, L_NONE if it is not in the export.
+*/
+static uint32_t FindChar (const Ctx_t *ctx, uint32_t unicode)
+{
+	uint32_t lo = 0, hi = ctx->chars_num;
+
+	while (lo < hi)
+	{
+		uint32_t mid = (lo + hi) / 2;
+		uint32_t mid_unicode = ctx->chars[ctx->by_unicode[mid]].unicode;
+
+		if (mid_unicode == unicode)
+			return ctx->by_unicode[mid];
+		if (mid_unicode < unicode)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return L_NONE;
+}
+
+/* Flash of the C builder output with the current configuration: the
+bitmaps, each glyph stored once per bpp, the descriptors and the ranges after
+splitting, the kerning pairs of the kept characters and the font.
+    Args:
+<ctx>[in] optimizer state.
+    Ret:
+the bytes.
+*/
+static uint32_t Cost (Ctx_t *ctx)
+{
+	uint32_t bytes = L_SIZEOF_FONT;
+
+	memset (ctx->set, 0, sizeof (uint64_t) * ctx->set_max);
+	for (uint32_t c = 0; c < ctx->chars_num; c++)
+	{
+		const Char_t *ch = &ctx->chars[c];
+		uint8_t stored;
+		uint64_t key;
+		uint32_t slot;
+
+		if (!ch->kept || ch->bytes[ctx->range_bpp[ch->range]] == 0)
+			continue;
+		stored = ch->stored[ctx->range_bpp[ch->range]];
+		key = ((uint64_t)ch->glyph_idx << 2 | stored) + 1;
+		for (slot = (key * 2654435761u) & (ctx->set_max - 1); ctx->set[slot] && ctx->set[slot] != key;
+		     slot = (slot + 1) & (ctx->set_max - 1))
+			;
+		if (ctx->set[slot] == 0)
+		{	/* the first character with this bitmap stores it */
+			ctx->set[slot] = key;
+			bytes += ch->bytes[ctx->range_bpp[ch->range]];
+		}
+	}
+	for (uint16_t r = 0; r < ctx->ranges_num; r++)
+	{
+		uint32_t descriptors;
+
+		bytes += Split (ctx, r, NULL, &descriptors) * L_SIZEOF_RANGE;
+		bytes += descriptors * L_SIZEOF_CHARACTER;
+	}
+	for (uint32_t k = 0; k < ctx->pairs_num; k++)
+	{
+		if (ctx->chars[ctx->pairs[k][0]].kept && ctx->chars[ctx->pairs[k][1]].kept)
+			bytes += L_SIZEOF_KERNING;
+	}
+	return bytes;
+}
+
+/* Split a range around the runs of two or more characters without a glyph
+(or dropped): a descriptor costs as much as a range.
+    Args:
+<ctx>[in] optimizer state.
+<r>[in] range index.
+<out>[out] ranges the range is split in, with the range bpp. Can be NULL.
+<descriptors>[out] characters of those ranges.
+    Ret:
+the number of ranges, 0 if no character of the range is kept.
+*/
+static uint32_t Split (const Ctx_t *ctx, uint16_t r, fontCvt_Range_t *out, uint32_t *descriptors)
+{
+	uint32_t first = L_NONE, last = L_NONE; /* current piece */
+	uint32_t num = 0;
+
+	*descriptors = 0;
+	for (uint32_t c = ctx->range_first[r]; c <= ctx->range_first[r + 1]; c++)
+	{
+		bool end = (c == ctx->range_first[r + 1]);
+
+		if (!end && !ctx->chars[c].kept)
+			continue;
+		if (first != L_NONE && (end || ctx->chars[c].unicode - ctx->chars[last].unicode > 2))
+		{	/* close the piece */
+			if (out)
+			{
+				out[num].first = ctx->chars[first].unicode;
+				out[num].last = ctx->chars[last].unicode;
+				out[num].bpp = BppList[ctx->range_bpp[r]];
+			}
+			*descriptors += ctx->chars[last].unicode - ctx->chars[first].unicode + 1;
+			num++;
+			first = L_NONE;
+		}
+		if (end)
+			break;
+		if (first == L_NONE)
+			first = c;
+		last = c;
+	}
+	return num;
+}
+
+/* Leave a character out of the font. */
+static void Drop (Ctx_t *ctx, uint32_t c)
+{
+	Char_t *ch = &ctx->chars[c];
+
+	ch->kept = false;
+	for (uint8_t b = 0; b < L_NUM_BPP; b++)
+	{
+		ctx->range_bytes[ch->range][b] -= ch->bytes[b];
+		ctx->range_error[ch->range][b] -= ch->weight * ch->error[b];
+	}
+}
+
+/* Weighted mean coverage error of the kept characters.
+    Args:
+<ctx>[in] optimizer state.
+<kept_weight>[out] weight of the kept characters.
+    Ret:
+the error in 8 bit coverage units.
+*/
+static double Error (const Ctx_t *ctx, double *kept_weight)
+{
+	double error = 0;
+
+	*kept_weight = 0;
+	for (uint32_t c = 0; c < ctx->chars_num; c++)
+	{
+		const Char_t *ch = &ctx->chars[c];
+
+		if (!ch->kept)
+			continue;
+		error += ch->weight * ch->error[ctx->range_bpp[ch->range]];
+		*kept_weight += ch->weight;
+	}
+	return (*kept_weight > 0) ? error / *kept_weight : 0;
+}
+
+/* qsort compare function of the characters by unicode. */
+static int CompareUnicode (const void *a, const void *b)
+{
+	uint32_t ua = SortChars[*(const uint32_t *)a].unicode, ub = SortChars[*(const uint32_t *)b].unicode;
+
+	return (ua > ub) - (ua < ub);
+}
+
+/* qsort compare function of the drop candidates: the least used first, the
+biggest bitmap first among the same use. */
+static int CompareDrop (const void *a, const void *b)
+{
+	const Char_t *ca = &SortChars[*(const uint32_t *)a], *cb = &SortChars[*(const uint32_t *)b];
+
+	if (ca->weight != cb->weight)
+		return (ca->weight > cb->weight) - (ca->weight < cb->weight);
+	return (cb->bytes[L_NUM_BPP - 1] > ca->bytes[L_NUM_BPP - 1]) - (cb->bytes[L_NUM_BPP - 1] < ca->bytes[L_NUM_BPP - 1]);
+}
@@ -0,0 +1,54 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BUDGET_H_INCLUDED
+#define BUDGET_H_INCLUDED
+
+//____________________________________________________________INCLUDES - DEFINES
+#include <stdint.h>
+#include <stdbool.h>
+#include "fontCvtLib.h"
+#include "corpus.h"
+
+typedef struct
+{	/* configuration found by budget_Optimize */
+	fontCvt_Range_t *ranges; /* ranges to export, with their bpp */
+	uint16_t ranges_num;
+	uint8_t bpp; /* font bpp: the highest range one */
+	uint32_t bytes; /* estimated flash of the C builder output */
+	uint32_t start_bytes; /* estimated flash of the export as asked */
+	uint32_t dropped; /* characters with a glyph left out */
+	/* share of the corpus (of the characters without corpus) the kept glyphs
+	draw, 0 to 1 */
+	double coverage;
+	/* corpus weighted mean coverage error of the kept glyphs against their 8
+	bit render, in 8 bit coverage units: at the start and at the end */
+	double start_error;
+	double error;
+} budget_Result_t;
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+bool budget_Optimize (const builderMemory_Font_t *font, const fontCvtLib_Options_t *opt, const corpus_Corpus_t *corpus,
+	uint32_t budget, bool drop, budget_Result_t *result);
+void budget_Free (budget_Result_t *result);
+bool budget_Save (const char *fname, const budget_Result_t *result, const fontCvtLib_Options_t *opt,
+	const char *fname_font, uint32_t budget);
+
+#endif /* BUDGET_H_INCLUDED */
@@ -23,7 +23,11 @@
 #include <string.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <stdbool.h>
 #include "fontBuilderForC.h"
+#include "stats.h"
+#include "builderSlots.h"
+#include "corpus.h"
 
 #define L_MAX(a, b)           (((a) >= (b)) ? (a) : (b))
 #define L_MIN(a, b)           (((a) <= (b)) ? (a) : (b))
@@ -36,40 +40,193 @@
 #define L_TYPE_CHARACTER      L_TO_STRING(FONTBUILDERFORC_TYPE_CHARACTER)
 #define L_TYPE_KERNING        L_TO_STRING(FONTBUILDERFORC_TYPE_KERNING)
 
+/* glyphs are blended in a native pixel format */
+#define L_PREBLENDED          (ctx->pixfmt == L_PIXFMT_RGB565 || ctx->pixfmt == L_PIXFMT_RGB332 || ctx->pixfmt == L_PIXFMT_L8)
+
+/* limits given by the atlas fields of the character descriptor */
+#define L_ATLAS_MAX_SIDE      4096
+#define L_ATLAS_MAX_PAGES     256
+
+/* frequency order: flash page of the locality report and characters of the
+string it reads */
+#define L_PAGE_SIZE           4096
+#define L_TYPICAL_STRING      16
+
+typedef struct
+{	/* a horizontal segment of the skyline: the atlas page is full below it */
+	uint16_t x;
+	uint16_t y;
+	uint16_t w;
+} AtlasSkyline_t;
+
+typedef struct
+{
+	uint8_t *pxlmap; /* 8 bit page pixels */
+	AtlasSkyline_t *skyline; /* skyline segments from left to right */
+	uint16_t skyline_num;
+} AtlasPage_t;
+
+typedef struct
+{	/* where the bitmap of a glyph went, for the characters sharing it */
+	uint32_t glyph_idx; /* 0 for a free slot, first member (builderSlots.h) */
+	uint32_t bmp_offset;
+	uint16_t atlas_page;
+	uint16_t atlas_x;
+	uint16_t atlas_y;
+	uint8_t bpp; /* bpp the bitmap is stored at */
+	uint32_t block; /* frequency order block of the bitmap */
+} GlyphSlot_t;
+
+typedef struct
+{	/* a bitmap of the table and the characters drawing it, laid out again by
+	frequency at the end of the export */
+	long pos; /* where it starts in the bitmaps file */
+	long len; /* bytes it takes in the bitmaps file */
+	uint32_t bmp_offset; /* codepoint order offset */
+	uint32_t bytes;
+	uint64_t count; /* corpus occurrences of its characters */
+	uint32_t first; /* first corpus occurrence of its characters */
+} Block_t;
+
+typedef struct
+{	/* a descriptor offset written again once the blocks are laid out */
+	long pos; /* of the offset inside the descriptors file */
+	uint32_t block;
+} Patch_t;
+
+typedef struct
+{	/* frequency order sort key of a block */
+	uint64_t count;
+	uint32_t first;
+	uint32_t block;
+} BlockOrder_t;
+
+typedef enum
+{
+	L_FORMAT_C_ARRAY,
+	L_FORMAT_BIN_FILE,
+} OutFormat_t;
+
+typedef enum
+{
+	L_PIXFMT_COVERAGE,
+	L_PIXFMT_RGB565,
+	L_PIXFMT_RGB332,
+	L_PIXFMT_L8,
+	L_PIXFMT_SDF,
+	L_PIXFMT_OUTLINE,
+} PixFmt_t;
+
+typedef struct
+{	/* state of one export, the builder can run many exports at once */
+	FILE *f_source; /* exported c source file */
+	FILE *tmpf_font; /* temporary file to store the font structure */
+	FILE *tmpf_range; /* temporary file to store the character ranges array */
+	FILE *tmpf_character; /* temporary file to store characters descriptors */
+	FILE *tmpf_bitmap; /* temporary file to store characters bitmaps */
+	FILE *tmpf_kerning; /* temporary file to store kerning information */
+	FILE *bitmap_bin_file;
+
+	uint8_t bpp; /* bit per pixel for character bitmaps */
+	uint8_t coverage_bpp; /* bit per pixel of the coverage provided by fontCvt */
+	/* mixed depths: coverage bitmaps out of atlas pages can be stored at the
+	bpp of their range, or lower with autobpp. The descriptor tells the bpp of
+	the glyphs not at the font one */
+	uint8_t font_bpp;
+	uint8_t range_bpp; /* bpp of the current range */
+	bool mixed_bpp; /* the output allows mixed depths */
+	int16_t autobpp; /* max coverage error of a lower bpp, -1 to keep the range bpp */
+	uint32_t mixed_glyphs; /* glyphs stored at another bpp than the font one */
+	uint32_t font_bpp_bytes; /* bytes of the bitmaps at the font bpp */
+	uint16_t range_index; /* exported character rage index */
+	uint32_t bmp_array_offset;
+	uint32_t kerning_index;
+
+	char source_fname[256];
+	char bitmaps_bin_path[256];
+	OutFormat_t out_format;
+	PixFmt_t pixfmt;
+	uint32_t fg_color; /* pre-blending foreground color (0xRRGGBB) */
+	uint32_t bg_color; /* pre-blending background color (0xRRGGBB) */
+	bool use_palette; /* pre-blended colors are deduplicated into a palette */
+	/* native pixel value (or palette index) for each coverage level */
+	uint16_t level_to_pixel[256];
+	uint16_t palette[256];
+	uint16_t palette_num;
+	/* bytes the bitmaps would take as plain coverage. used to report the
+	pre-blending flash trade-off */
+	uint32_t coverage_bytes;
+	/* atlas output. With atlas_width 0 bitmaps are stored one after the other */
+	uint16_t atlas_width;
+	uint16_t atlas_height;
+	uint8_t atlas_pad; /* transparent pixels between atlas glyphs */
+	AtlasPage_t *atlas_pages;
+	uint16_t atlas_pages_num;
+	uint32_t atlas_glyphs_area; /* pixels covered by glyphs */
+	/* bitmaps written so far by glyph index (GlyphSlot_t): the characters
+	mapped to the same glyph share one bitmap */
+	builderSlots_Table_t glyph_slots;
+	uint32_t shared_num; /* characters sharing the bitmap of another one */
+	/* bitmaps table ordered by the frequency of the characters in a corpus
+	(order=<file>), NULL for codepoint order. The bitmaps are written in
+	codepoint order as blocks, the descriptor offsets patched at the end */
+	corpus_Corpus_t *order;
+	bool order_fail; /* allocation fail, the codepoint order is kept */
+	Block_t *blocks;
+	uint32_t blocks_num;
+	uint32_t blocks_max;
+	Patch_t *patches;
+	uint32_t patches_num;
+	uint32_t patches_max;
+	uint32_t page_size; /* flash page of the locality report */
+	char bin_fname[256]; /* bitmaps file, written at the end with order */
+	char header_fname[256];
+	bool disabled; /* the font can't be exported, the output is removed */
+} Ctx_t;
+
 //____________________________________________________________PRIVATE PROTOTYPES
-static void StartFont (fontCvt_Font_t *font, const char *output, const char *options);
-static void StartRange (fontCvt_Range_t *range);
-static void StartCharacter (fontCvt_Character_t *character);
-static void PutKerning (fontCvt_Kerning_t *kerning);
-static void EndCharacter (void);
-static void EndRange (void);
-static void EndFont (void);
+static void *Create (void);
+static void Destroy (void *context);
+static void StartFont (void *context, fontCvt_Font_t *font, const char *output, const char *options);
+static void StartRange (void *context, fontCvt_Range_t *range);
+static void StartCharacter (void *context, fontCvt_Character_t *character);
+static void PutKerning (void *context, fontCvt_Kerning_t *kerning);
+static void EndCharacter (void *context);
+static void EndRange (void *context);
+static void EndFont (void *context);
+static void PutCharacters (void *context, fontCvt_Character_t *characters, uint32_t num);
+static void PutKernings (void *context, fontCvt_Kerning_t *kernings, uint32_t num);
+static void PutCharacter (Ctx_t *ctx, fontCvt_Character_t *character, uint32_t kerning_index);
 static void BuildHeaderFile (const char *output);
 
-static void CloseAllFile (void);
+static void CloseAllFile (Ctx_t *ctx);
 static void AllFileWrite (FILE *f_dst, FILE *f_src);
+static void PutBitmapByte (Ctx_t *ctx, uint8_t byte);
+static void PutBitmapRow (Ctx_t *ctx, const uint8_t *row, uint16_t width);
+static uint8_t LowestBpp (Ctx_t *ctx, fontCvt_Character_t *character, uint8_t bpp);
+static bool AtlasPlace (Ctx_t *ctx, fontCvt_Character_t *character, uint16_t *page, uint16_t *x, uint16_t *y);
+static bool AtlasFit (Ctx_t *ctx, AtlasPage_t *page, uint16_t node, uint16_t w, uint16_t h, uint16_t *y);
+static void AtlasInsert (Ctx_t *ctx, AtlasPage_t *page, uint16_t node, uint16_t w, uint16_t h, uint16_t y);
+static void AtlasWritePages (Ctx_t *ctx);
+static void BuildBlendTable (Ctx_t *ctx, uint8_t coverage_bpp);
+static uint32_t OrderBlock (Ctx_t *ctx, fontCvt_Character_t *character, uint32_t block);
+static void OrderPatch (Ctx_t *ctx, uint32_t block);
+static void OrderLayOut (Ctx_t *ctx);
+static double OrderPagesRead (const Ctx_t *ctx, const uint32_t *offsets, uint64_t total);
+static void FileCopy (FILE *f_dst, FILE *f_src, long pos, long len);
+static int CompareBlockOrder (const void *a, const void *b);
+static uint16_t BlendColor (Ctx_t *ctx, uint8_t level, uint8_t max_level);
 
 //___________________________________________________________________PRIVATE VAR
-static FILE *FSource; /* exported c source file */
-static FILE *TmpfFont; /* temporary file to store the font structure */
-static FILE *TmpfRange; /* temporary file to store the character ranges array */
-static FILE *TmpfCharacter; /* temporary file to store characters descriptors */
-static FILE *TmpfBitmap; /* temporary file to store characters bitmaps */
-static FILE *TmpfKerning; /* temporary file to store kerning information */
-static FILE *BitmapBinFile;
-
-static uint8_t Bpp; /* bit per pixel for character bitmaps */
-static uint16_t RangeIndex; /* exported character rage index */
-static uint32_t BmpArrayOffset;
-static uint16_t KerningIndex;
-
-static char SourceFname[256];
-static char BitmapsBinPath[256];
-enum
+static const char *PixFmtNames[] =
 {
-	L_FORMAT_C_ARRAY,
-	L_FORMAT_BIN_FILE,
-} static OutFormat;
+	"FONTBUILDERFORC_PIXFMT_COVERAGE",
+	"FONTBUILDERFORC_PIXFMT_RGB565",
+	"FONTBUILDERFORC_PIXFMT_RGB332",
+	"FONTBUILDERFORC_PIXFMT_L8",
+	"FONTBUILDERFORC_PIXFMT_SDF",
+	"FONTBUILDERFORC_PIXFMT_OUTLINE",
+};
 
 //____________________________________________________________________GLOBAL VAR
 fontCvt_Builder_t builderForC_Builder;
@@ -84,6 +241,8 @@ void builderForC_Init (void)
 {
 	memset (&builderForC_Builder, 0, sizeof (builderForC_Builder));
 
+	builderForC_Builder.create = Create;
+	builderForC_Builder.destroy = Destroy;
 	builderForC_Builder.startFont = StartFont;
 	builderForC_Builder.startRange = StartRange;
 	builderForC_Builder.startCharacter = StartCharacter;
@@ -91,17 +250,71 @@ void builderForC_Init (void)
 	builderForC_Builder.endCharacter = EndCharacter;
 	builderForC_Builder.endRange = EndRange;
 	builderForC_Builder.endFont = EndFont;
+	builderForC_Builder.putCharacters = PutCharacters;
+	builderForC_Builder.putKernings = PutKernings;
 }
 
 //_____________________________________________________________PRIVATE FUNCTIONS
+/* Allocate the context of an export.
+    Args:
+    Ret:
+the context, NULL on allocation fail.
+*/
+static void *Create (void)
+{
+	Ctx_t *ctx = calloc (1, sizeof (Ctx_t));
+
+	if (ctx)
+		builderSlots_Init (&ctx->glyph_slots, sizeof (GlyphSlot_t));
+	return ctx;
+}
+
+/* Release the context of an export, closing the files it left open.
+    Args:
+<context>[in] export context.
+    Ret:
+*/
+static void Destroy (void *context)
+{
+	Ctx_t *ctx = context;
+
+	CloseAllFile (ctx);
+	for (uint16_t p = 0; p < ctx->atlas_pages_num && ctx->atlas_pages; p++)
+	{
+		free (ctx->atlas_pages[p].pxlmap);
+		free (ctx->atlas_pages[p].skyline);
+	}
+	free (ctx->atlas_pages);
+	builderSlots_Free (&ctx->glyph_slots);
+	corpus_Free (ctx->order);
+	free (ctx->blocks);
+	free (ctx->patches);
+	free (ctx);
+}
+
 /* Function description.
     Args:
     Ret:
 */
-static void StartFont (fontCvt_Font_t *font, const char *output, const char *options)
+static void StartFont (void *context, fontCvt_Font_t *font, const char *output, const char *options)
 {
-	OutFormat = L_FORMAT_C_ARRAY;
-	snprintf (BitmapsBinPath, sizeof(BitmapsBinPath), "%s.bitmap.bin", output);
+	Ctx_t *ctx = context;
+
+	ctx->out_format = L_FORMAT_C_ARRAY;
+	ctx->pixfmt = L_PIXFMT_COVERAGE;
+	ctx->fg_color = 0xFFFFFF;
+	ctx->bg_color = 0x000000;
+	ctx->use_palette = false;
+	ctx->atlas_width = 0;
+	ctx->atlas_height = 0;
+	ctx->atlas_pad = 1;
+	ctx->autobpp = -1;
+	ctx->order = NULL;
+	ctx->order_fail = false;
+	ctx->blocks_num = 0;
+	ctx->patches_num = 0;
+	ctx->page_size = L_PAGE_SIZE;
+	snprintf (ctx->bitmaps_bin_path, sizeof(ctx->bitmaps_bin_path), "%s.bitmap.bin", output);
 
 	// parse options
 	if (options)
@@ -123,7 +336,7 @@ static void StartFont (fontCvt_Font_t *font, const char *output, const char *opt
 				if (!strcmp (option, "format"))
 				{
 					if (!strcmp (strVal, "bin"))
-						OutFormat = L_FORMAT_BIN_FILE;
+						ctx->out_format = L_FORMAT_BIN_FILE;
 				}
 				else if (!strcmp (option, "binpath"))
 				{
@@ -137,280 +350,544 @@ static void StartFont (fontCvt_Font_t *font, const char *output, const char *opt
 						path[len + 1] = 0;
 					}
 
-					snprintf (BitmapsBinPath, sizeof(BitmapsBinPath), "%s%s.bitmap.bin", path, output);
+					snprintf (ctx->bitmaps_bin_path, sizeof(ctx->bitmaps_bin_path), "%s%s.bitmap.bin", path, output);
+				}
+				else if (!strcmp (option, "pixfmt"))
+				{
+					if (!strcmp (strVal, "rgb565"))
+						ctx->pixfmt = L_PIXFMT_RGB565;
+					else if (!strcmp (strVal, "rgb332"))
+						ctx->pixfmt = L_PIXFMT_RGB332;
+					else if (!strcmp (strVal, "l8"))
+						ctx->pixfmt = L_PIXFMT_L8;
+				}
+				else if (!strcmp (option, "fg"))
+					ctx->fg_color = strtoul (strVal, NULL, 16) & 0xFFFFFF;
+				else if (!strcmp (option, "bg"))
+					ctx->bg_color = strtoul (strVal, NULL, 16) & 0xFFFFFF;
+				else if (!strcmp (option, "palette"))
+					ctx->use_palette = !strcmp (strVal, "on");
+				else if (!strcmp (option, "atlas"))
+					ctx->atlas_width = atoi (strVal);
+				else if (!strcmp (option, "atlasheight"))
+					ctx->atlas_height = atoi (strVal);
+				else if (!strcmp (option, "atlaspad"))
+					ctx->atlas_pad = atoi (strVal);
+				else if (!strcmp (option, "autobpp"))
+					ctx->autobpp = L_MIN (L_MAX (atoi (strVal), 0), 255);
+				else if (!strcmp (option, "order"))
+				{
+					const char *fname = strVal;
+
+					corpus_Free (ctx->order);
+					ctx->order = corpus_Load (&fname, 1);
 				}
+				else if (!strcmp (option, "page"))
+					ctx->page_size = L_MAX (atoi (strVal), 1);
 			}
 		}
 	}
 
+	if (ctx->atlas_width > L_ATLAS_MAX_SIDE || ctx->atlas_height > L_ATLAS_MAX_SIDE)
+	{
+		fprintf (stderr, "atlas pages can't be bigger than %d pixel\n", L_ATLAS_MAX_SIDE);
+		ctx->atlas_width = L_MIN (ctx->atlas_width, L_ATLAS_MAX_SIDE);
+		ctx->atlas_height = L_MIN (ctx->atlas_height, L_ATLAS_MAX_SIDE);
+	}
+	if (ctx->atlas_height == 0)
+		ctx->atlas_height = ctx->atlas_width; /* square pages by default */
+	ctx->disabled = true;
+	if (ctx->atlas_width && !font->outline
+	 && (font->pxl_max_bmp_width + ctx->atlas_pad > ctx->atlas_width
+	  || font->pxl_max_bmp_height + ctx->atlas_pad > ctx->atlas_height))
+	{	/* some glyphs would be left out of the pages */
+		fprintf (stderr, "atlas pages %dx%d can't hold the glyphs of the font, up to %dx%d pixel with the padding\n",
+			ctx->atlas_width, ctx->atlas_height, font->pxl_max_bmp_width + ctx->atlas_pad,
+			font->pxl_max_bmp_height + ctx->atlas_pad);
+		return;
+	}
+	if (ctx->order && ctx->atlas_width)
+	{	/* the pages hold the glyphs where they fit */
+		fprintf (stderr, "order option ignored with atlas\n");
+		corpus_Free (ctx->order);
+		ctx->order = NULL;
+	}
+	ctx->atlas_pages = NULL;
+	ctx->atlas_pages_num = 0;
+	ctx->atlas_glyphs_area = 0;
+
 	printf ("exporting %s\n", output);
-	snprintf (SourceFname, sizeof (SourceFname), "%s.c", output);
+	snprintf (ctx->source_fname, sizeof (ctx->source_fname), "%s.c", output);
+	snprintf (ctx->header_fname, sizeof (ctx->header_fname), "%s.h", output);
 
+	stats_Begin (STATS_PHASE_FILE_IO);
 	BuildHeaderFile (output);
+	stats_End (STATS_PHASE_FILE_IO);
 
 	/* open temporary files
 	   those file are used to build different sections wich will be merged in a
 	   single source file during the last build step.
 	*/
-	if ((TmpfFont = tmpfile ( )) == NULL)
+	if ((ctx->tmpf_font = tmpfile ( )) == NULL)
 		goto __errexit;
-	if ((TmpfRange = tmpfile ( )) == NULL)
+	if ((ctx->tmpf_range = tmpfile ( )) == NULL)
 		goto __errexit;
-	if ((TmpfCharacter = tmpfile ( )) == NULL)
+	if ((ctx->tmpf_character = tmpfile ( )) == NULL)
 		goto __errexit;
-	if (OutFormat == L_FORMAT_C_ARRAY)
+	if (ctx->out_format == L_FORMAT_C_ARRAY)
 	{
-		if ((TmpfBitmap = tmpfile ( )) == NULL)
+		if ((ctx->tmpf_bitmap = tmpfile ( )) == NULL)
 			goto __errexit;
-	} else if (OutFormat == L_FORMAT_BIN_FILE)
+	} else if (ctx->out_format == L_FORMAT_BIN_FILE)
 	{
 		char binFile[256];
 
 		snprintf (binFile, sizeof(binFile), "%s.bitmap.bin", output);
-		if ((BitmapBinFile = fopen (binFile, "wb")) == NULL)
+		/* with order the bitmaps are laid out in the file at the end */
+		snprintf (ctx->bin_fname, sizeof (ctx->bin_fname), "%s", binFile);
+		if ((ctx->bitmap_bin_file = ctx->order ? tmpfile ( ) : fopen (binFile, "wb")) == NULL)
 			goto __errexit;
 	}
-	if ((FSource = fopen (SourceFname, "wb")) == NULL)
+	if ((ctx->f_source = fopen (ctx->source_fname, "wb")) == NULL)
 		goto __errexit;
-	if ((TmpfKerning = tmpfile ( )) == NULL)
+	if ((ctx->tmpf_kerning = tmpfile ( )) == NULL)
 		goto __errexit;
 
-	Bpp = font->bpp; /* save bpp for later use */
-	RangeIndex = 0;
-	BmpArrayOffset = 0;
-	KerningIndex = 0;
+	if (font->sdf_spread)
+	{	/* distances can't be blended */
+		if (ctx->pixfmt != L_PIXFMT_COVERAGE)
+			fprintf (stderr, "pixfmt option ignored with signed distance fields\n");
+		ctx->pixfmt = L_PIXFMT_SDF;
+		ctx->use_palette = false;
+	}
+	if (font->outline)
+	{	/* outlines are no bitmaps: no colors and no atlas */
+		if (ctx->pixfmt != L_PIXFMT_COVERAGE || ctx->atlas_width)
+			fprintf (stderr, "pixfmt and atlas options ignored with outlines\n");
+		ctx->pixfmt = L_PIXFMT_OUTLINE;
+		ctx->use_palette = false;
+		ctx->atlas_width = 0;
+	}
+	ctx->coverage_bpp = font->bpp;
+	ctx->bpp = font->bpp; /* save bpp for later use */
+	ctx->font_bpp = ctx->range_bpp = font->bpp;
+	/* atlas pages and pre-blended pixels have one depth */
+	ctx->mixed_bpp = (ctx->pixfmt == L_PIXFMT_COVERAGE && ctx->atlas_width == 0);
+	if (ctx->autobpp >= 0 && !ctx->mixed_bpp)
+	{
+		fprintf (stderr, "autobpp option ignored with atlas, pre-blended pixels and scalable fonts\n");
+		ctx->autobpp = -1;
+	}
+	ctx->mixed_glyphs = 0;
+	ctx->font_bpp_bytes = 0;
+	ctx->range_index = 0;
+	ctx->bmp_array_offset = 0;
+	ctx->kerning_index = 0;
+	ctx->coverage_bytes = 0;
+	ctx->shared_num = 0;
+	builderSlots_Clear (&ctx->glyph_slots);
+	if (L_PREBLENDED)
+	{
+		BuildBlendTable (ctx, ctx->coverage_bpp);
+		if (ctx->use_palette && ctx->bpp >= ctx->coverage_bpp)
+			fprintf (stderr, "palette saves no flash: its %d colors need %d bpp indexes, as the %d bpp coverage\n",
+				ctx->palette_num, ctx->bpp, ctx->coverage_bpp);
+	}
 
-	fprintf (FSource, "#include \"fontBuilderForC.h\"\n\n");
+	fprintf (ctx->f_source, "#include \"fontBuilderForC.h\"\n\n");
+	if (L_PREBLENDED && ctx->use_palette)
+	{
+		fprintf (ctx->f_source, "static const uint16_t FontPalette[] =\n");
+		fprintf (ctx->f_source, "{\t// fg 0x%06X bg 0x%06X\n\t", ctx->fg_color, ctx->bg_color);
+		for (uint16_t k = 0; k < ctx->palette_num; k++)
+			fprintf (ctx->f_source, "0x%04X, ", ctx->palette[k]);
+		fprintf (ctx->f_source, "\n};\n\n");
+	}
 	
-	fprintf (TmpfFont, "const " L_TYPE_FONT " %s_Font =\n", output);
-	fprintf (TmpfFont, "{\n");
-	fprintf (TmpfFont, "\t.bpp = %d,\n", font->bpp);
-	fprintf (TmpfFont, "\t.pxl_baseline_to_baseline = %d,\n", font->pxl_baseline_to_baseline);
-	fprintf (TmpfFont, "\t.pxl_max_glyph_height = %d,\n", font->pxl_max_glyph_height);
-	fprintf (TmpfFont, "\t.ranges = FontRanges,\n");
+	fprintf (ctx->tmpf_font, "const " L_TYPE_FONT " %s_Font =\n", output);
+	fprintf (ctx->tmpf_font, "{\n");
+	fprintf (ctx->tmpf_font, "\t.bpp = %d,\n", ctx->bpp);
+	fprintf (ctx->tmpf_font, "\t.pixel_format = %s,\n", PixFmtNames[ctx->pixfmt]);
+	if (ctx->pixfmt == L_PIXFMT_SDF)
+		fprintf (ctx->tmpf_font, "\t.sdf_spread = %d,\n", font->sdf_spread);
+	if (ctx->pixfmt == L_PIXFMT_SDF || ctx->pixfmt == L_PIXFMT_OUTLINE)
+		fprintf (ctx->tmpf_font, "\t.pxl_ref_size = %d,\n", font->pxl_em_square);
+	if (L_PREBLENDED && ctx->use_palette)
+	{
+		fprintf (ctx->tmpf_font, "\t.palette = FontPalette,\n");
+		fprintf (ctx->tmpf_font, "\t.num_palette = %d,\n", ctx->palette_num);
+	}
+	fprintf (ctx->tmpf_font, "\t.pxl_baseline_to_baseline = %d,\n", font->pxl_baseline_to_baseline);
+	fprintf (ctx->tmpf_font, "\t.pxl_max_glyph_height = %d,\n", font->pxl_max_glyph_height);
+	fprintf (ctx->tmpf_font, "\t.ranges = FontRanges,\n");
 	
 	{
 		const char *format = "";
 
-		if (OutFormat == L_FORMAT_C_ARRAY) {
-			fprintf (TmpfFont, "\t.bitmaps_table = FontBitmaps,\n");
+		if (ctx->out_format == L_FORMAT_C_ARRAY) {
+			fprintf (ctx->tmpf_font, "\t.bitmaps_table = FontBitmaps,\n");
 			format = "FONTBUILDERFORC_BITMAPS_IN_ARRAY";
 		}
-		else if (OutFormat == L_FORMAT_BIN_FILE) {
-			fprintf (TmpfFont, "\t.bitmaps_table = \"%s\",\n", BitmapsBinPath);
+		else if (ctx->out_format == L_FORMAT_BIN_FILE) {
+			fprintf (ctx->tmpf_font, "\t.bitmaps_table = \"%s\",\n", ctx->bitmaps_bin_path);
 			format = "FONTBUILDERFORC_BITMAPS_IN_FILE";
 		}
-		fprintf (TmpfFont, "\t.bitmaps_table_storage = %s,\n", format);
+		fprintf (ctx->tmpf_font, "\t.bitmaps_table_storage = %s,\n", format);
 	}
 	
 
-	fprintf (TmpfRange, "static const " L_TYPE_RANGE " FontRanges[] =\n");
-	fprintf (TmpfRange, "{\n");
+	fprintf (ctx->tmpf_range, "static const " L_TYPE_RANGE " FontRanges[] =\n");
+	fprintf (ctx->tmpf_range, "{\n");
 
-	if (OutFormat == L_FORMAT_C_ARRAY)
+	if (ctx->out_format == L_FORMAT_C_ARRAY)
 	{
-		fprintf (TmpfBitmap, "static const char FontBitmaps[] =\n");
-		fprintf (TmpfBitmap, "{\n");
+		fprintf (ctx->tmpf_bitmap, "static const char FontBitmaps[] =\n");
+		fprintf (ctx->tmpf_bitmap, "{\n");
 	}
 
-	fprintf (TmpfKerning, "static const " L_TYPE_KERNING " Kerning[] =\n");
-	fprintf (TmpfKerning, "{\t// Kerning informations\n");
+	fprintf (ctx->tmpf_kerning, "static const " L_TYPE_KERNING " Kerning[] =\n");
+	fprintf (ctx->tmpf_kerning, "{\t// Kerning informations\n");
+	ctx->disabled = false;
 	return;
 
 __errexit:
-	CloseAllFile ( );
+	CloseAllFile (ctx);
 }
 
 /* Function description.
     Args:
     Ret:
 */
-static void StartRange (fontCvt_Range_t *range)
+static void StartRange (void *context, fontCvt_Range_t *range)
 {
+	Ctx_t *ctx = context;
 	uint16_t char_num; /* number of characters in this range */
 
+	if (ctx->disabled)
+		return;
+	ctx->range_bpp = ctx->font_bpp;
+	if (range->bpp && range->bpp != ctx->font_bpp && ctx->mixed_bpp)
+		ctx->range_bpp = range->bpp;
+	else if (range->bpp && range->bpp != ctx->font_bpp)
+		fprintf (stderr, "range 0x%04X-0x%04X exported at %d bpp, atlas and pre-blended pixels have one bpp\n",
+			range->first, range->last, ctx->font_bpp);
 	char_num = range->last - range->first + 1;
-	fprintf (TmpfRange, "\t{");
-	fprintf (TmpfRange, " .first = %d,", range->first);
-	fprintf (TmpfRange, " .num_characters = %d,", char_num);
-	fprintf (TmpfRange, " .characters = FontCharacters%d", RangeIndex);
-	fprintf (TmpfRange, " },\n");
-
-	fprintf (TmpfCharacter, "static const " L_TYPE_CHARACTER " FontCharacters%d[] =\n", RangeIndex);
-	fprintf (TmpfCharacter, "{\t// Unicode character range [0x%04X-0x%04X] (%d characters)\n", range->first, range->last, char_num);
+	fprintf (ctx->tmpf_range, "\t{");
+	fprintf (ctx->tmpf_range, " .first = %d,", range->first);
+	fprintf (ctx->tmpf_range, " .num_characters = %d,", char_num);
+	fprintf (ctx->tmpf_range, " .characters = FontCharacters%d", ctx->range_index);
+	fprintf (ctx->tmpf_range, " },\n");
+
+	fprintf (ctx->tmpf_character, "static const " L_TYPE_CHARACTER " FontCharacters%d[] =\n", ctx->range_index);
+	fprintf (ctx->tmpf_character, "{\t// Unicode character range [0x%04X-0x%04X] (%d characters)\n", range->first, range->last, char_num);
 }
 
 /* Function description.
     Args:
     Ret:
 */
-static void StartCharacter (fontCvt_Character_t *character)
+static void StartCharacter (void *context, fontCvt_Character_t *character)
+{
+	Ctx_t *ctx = context;
+
+	PutCharacter (ctx, character, ctx->kerning_index);
+}
+
+/* Write the descriptor and the bitmap of a character.
+    Args:
+<ctx>[in] export context.
+<character>[in] character.
+<kerning_index>[in] first kerning pair with this character on the left.
+    Ret:
+*/
+static void PutCharacter (Ctx_t *ctx, fontCvt_Character_t *character, uint32_t kerning_index)
 {
+	GlyphSlot_t *slot;
+	uint8_t bpp = ctx->range_bpp;
+	bool shared;
+	GlyphSlot_t place; /* where the bitmap goes */
+
+	if (ctx->disabled)
+		return;
+	/* the slot of the glyph, already used if another character wrote it */
+	slot = character->glyph_idx ? builderSlots_Find (&ctx->glyph_slots, character->glyph_idx) : NULL;
+	if (ctx->autobpp >= 0)
+		bpp = LowestBpp (ctx, character, bpp);
+	/* a bitmap written at another bpp can't be shared */
+	shared = slot && slot->glyph_idx && slot->bpp == bpp;
+	if (slot && slot->glyph_idx && !shared)
+		slot = NULL;
+
+	if (shared)
+		place = *slot;
+	else
+	{
+		place.glyph_idx = character->glyph_idx;
+		place.bmp_offset = ctx->bmp_array_offset;
+		place.bpp = bpp;
+		place.block = UINT32_MAX;
+		/* the bitmap goes inside an atlas page, written at the end */
+		if (ctx->atlas_width && !AtlasPlace (ctx, character, &place.atlas_page, &place.atlas_x, &place.atlas_y))
+		{
+			ctx->disabled = true;
+			return;
+		}
+	}
+	if (ctx->order)
+		place.block = OrderBlock (ctx, character, place.block);
+
 	/* write the character information structure */
-	fprintf (TmpfCharacter, "\t{");
-	fprintf (TmpfCharacter, " .bmp_offset = % 7d,", BmpArrayOffset);
-	fprintf (TmpfCharacter, " .bmp_pxl_width = % 3d,", character->bmp_pxl_width);
-	fprintf (TmpfCharacter, " .bmp_pxl_height = % 3d,", character->bmp_pxl_height);
-	fprintf (TmpfCharacter, " .pxl_advance = % 3d,", character->pxl_advance);
+	fprintf (ctx->tmpf_character, "\t{");
+	if (ctx->atlas_width)
+	{
+		fprintf (ctx->tmpf_character, " .bmp_offset = FONTBUILDERFORC_ATLAS_POS (% 3d, % 4d, % 4d),",
+			place.atlas_page, place.atlas_x, place.atlas_y);
+	}
+	else if (ctx->order)
+	{	/* room for any offset, it is written again at the end */
+		fprintf (ctx->tmpf_character, " .bmp_offset = ");
+		OrderPatch (ctx, place.block);
+		fprintf (ctx->tmpf_character, "%10u,", place.bmp_offset);
+	}
+	else
+		fprintf (ctx->tmpf_character, " .bmp_offset = % 7d,", place.bmp_offset);
+	fprintf (ctx->tmpf_character, " .bmp_pxl_width = % 3d,", character->bmp_pxl_width);
+	fprintf (ctx->tmpf_character, " .bmp_pxl_height = % 3d,", character->bmp_pxl_height);
+	fprintf (ctx->tmpf_character, " .pxl_advance = % 3d,", character->pxl_advance);
 	/* those following two could be negative, meaning their string
 	   rappresentation could be 4 character long (es. "-123"). Thus % 4d */
-	fprintf (TmpfCharacter, " .pxl_left = % 4d,", character->pxl_left);
-	fprintf (TmpfCharacter, " .pxl_top = % 4d,", character->pxl_top);
-	fprintf (TmpfCharacter, " .kerning_index = % 5d", KerningIndex);
-	fprintf (TmpfCharacter, " },");
-	fprintf (TmpfCharacter, " // Unicode 0x%04X\n", character->unicode);
+	fprintf (ctx->tmpf_character, " .pxl_left = % 4d,", character->pxl_left);
+	fprintf (ctx->tmpf_character, " .pxl_top = % 4d,", character->pxl_top);
+	if (place.bpp != ctx->font_bpp)
+		fprintf (ctx->tmpf_character, " .bpp = %d,", place.bpp);
+	fprintf (ctx->tmpf_character, " .kerning_index = %5u", kerning_index);
+	fprintf (ctx->tmpf_character, " },");
+	fprintf (ctx->tmpf_character, " // Unicode 0x%04X\n", character->unicode);
+
+	if (shared)
+	{
+		ctx->shared_num++;
+		return;
+	}
+	if (slot)
+	{
+		*slot = place;
+		ctx->glyph_slots.num++;
+	}
+	if (ctx->atlas_width)
+		return;
 
+	if (ctx->order && place.block != UINT32_MAX)
+	{	/* the block starts here, its end is known when the next starts */
+		FILE *f = (ctx->out_format == L_FORMAT_C_ARRAY) ? ctx->tmpf_bitmap : ctx->bitmap_bin_file;
 
-	/* add this character bitmap to the array */
-	if (OutFormat == L_FORMAT_C_ARRAY)
-		fprintf (TmpfBitmap, "\t// Unicode 0x%04X\n", character->unicode);
-
-	for (uint8_t y = 0; y < character->bmp_pxl_height; y++)
-	{
-		/* destination bitmap byte wiating to be filled before write */
-		uint8_t wr_byte;
-		/* the next pixel value offset position inside wr_byte */
-		int8_t bit_pos;
-		/* just to make it esier to recognize a glyph we add a 4-level-only
-		   picture next it's byte rappresentation.
-		*/
-		char lview[256]; /* glyph picture line */
-		uint16_t lview_sz;
-
-		if (OutFormat == L_FORMAT_C_ARRAY)
-			fprintf (TmpfBitmap, "\t");
-
-		lview_sz = 0;
-		wr_byte = 0;
-		bit_pos = 8 - Bpp;
-		for (uint8_t x = 0; x < character->bmp_pxl_width; x++)
-		{
-			const uint8_t *src_pxl; /* pointer to the source bitamp pixel */
-			uint8_t gray_val; /* gray value for this pixel */ 
-
-			src_pxl = &character->bmp[x + y * character->bmp_pxl_width];
-
-			gray_val = *src_pxl >> (8 - Bpp);
-			{	/* add this pixel to the picture line */
-				uint8_t view_val;
-				char view_char = '.';
-
-				/* we only use max 4-level (.-1-2-3) always in 1-2-4 and 8 bpp */
-				/* translate the original pixel gray value to a max 4-level gray
-				   value. thus a 2 bit rappresentation.
-				*/
-				view_val = gray_val >> L_MAX (0, Bpp - 2);
-				if (view_val)
-					view_char = '0' + view_val;
-				
-				lview_sz += snprintf (lview + lview_sz, sizeof (lview) - lview_sz, "%c", view_char);
-			}
+		ctx->blocks[place.block].pos = ftell (f);
+		ctx->blocks[place.block].bmp_offset = place.bmp_offset;
+	}
 
-			wr_byte |= gray_val << bit_pos;
-			bit_pos -= Bpp; /* advance the position for the nex pixel */
-			if (bit_pos < 0)
-			{	/* wr_byte is fill of pixels */
-				if (OutFormat == L_FORMAT_C_ARRAY)
-					fprintf (TmpfBitmap, "0x%02X, ", wr_byte);
-				else if (OutFormat == L_FORMAT_BIN_FILE)
-					fputc (wr_byte, BitmapBinFile);
-				BmpArrayOffset ++;
-				/* refresh wr_byte and bit_pos */
-				wr_byte = 0;
-				bit_pos = 8 - Bpp;
-			}
-		}
+	/* add this character bitmap to the array */
+	if (ctx->out_format == L_FORMAT_C_ARRAY)
+		fprintf (ctx->tmpf_bitmap, "\t// Unicode 0x%04X\n", character->unicode);
 
-		if (bit_pos != (8 - Bpp))
-		{	/* some pixel are inside wr_byte waiting to be write */
-			if (OutFormat == L_FORMAT_C_ARRAY)
-				fprintf (TmpfBitmap, "0x%02X, ", wr_byte);
-			else if (OutFormat == L_FORMAT_BIN_FILE)
-				fputc (wr_byte, BitmapBinFile);
-			BmpArrayOffset ++;
-		}
-		/* add the picture line next to the byte line */
-		if (OutFormat == L_FORMAT_C_ARRAY)
+	if (ctx->pixfmt == L_PIXFMT_OUTLINE)
+	{	/* the outline is already encoded, 16 bytes per line */
+		for (uint32_t k = 0; k < character->outline_sz; k++)
 		{
-			fprintf (TmpfBitmap, "// %s", lview);
-			fprintf (TmpfBitmap, "\n");
+			if (ctx->out_format == L_FORMAT_C_ARRAY && k % 16 == 0)
+				fprintf (ctx->tmpf_bitmap, "%s\t", k ? "\n" : "");
+			PutBitmapByte (ctx, character->outline[k]);
 		}
-		
+		if (ctx->out_format == L_FORMAT_C_ARRAY)
+			fprintf (ctx->tmpf_bitmap, "%s\n", character->outline_sz ? "\n" : "");
+		return;
+	}
+
+	/* pack the bitmap at its bpp */
+	if (ctx->mixed_bpp)
+		ctx->bpp = ctx->coverage_bpp = place.bpp;
+	for (uint16_t y = 0; y < character->bmp_pxl_height; y++)
+	{
+		PutBitmapRow (ctx, (const uint8_t *)&character->bmp[y * character->bmp_pxl_width], character->bmp_pxl_width);
+	}
+	if (ctx->out_format == L_FORMAT_C_ARRAY)
+		fprintf (ctx->tmpf_bitmap, "\n");
+	if (ctx->mixed_bpp)
+	{
+		ctx->bpp = ctx->coverage_bpp = ctx->font_bpp;
+		ctx->font_bpp_bytes += character->bmp_pxl_height * ((character->bmp_pxl_width * ctx->font_bpp + 7) / 8);
+		ctx->mixed_glyphs += (place.bpp != ctx->font_bpp && character->bmp_pxl_width && character->bmp_pxl_height);
 	}
-	if (OutFormat == L_FORMAT_C_ARRAY)
-		fprintf (TmpfBitmap, "\n");
 }
 
 /* Function description.
     Args:
     Ret:
 */
-static void PutKerning (fontCvt_Kerning_t *kerning)
-{
-	fprintf (TmpfKerning, "\t{");
-	fprintf (TmpfKerning, ".left_ch = 0x%04X, ", kerning->left_char);
-	fprintf (TmpfKerning, ".right_ch = 0x%04X, ",  kerning->right_char);
-	fprintf (TmpfKerning, ".pxl_adjust = % 4d", kerning->x_pxl_adjust);
-	fprintf (TmpfKerning, "},\n");
-	KerningIndex++;
+static void PutKerning (void *context, fontCvt_Kerning_t *kerning)
+{
+	Ctx_t *ctx = context;
+
+	if (ctx->disabled)
+		return;
+	fprintf (ctx->tmpf_kerning, "\t{");
+	fprintf (ctx->tmpf_kerning, ".left_ch = 0x%04X, ", kerning->left_char);
+	fprintf (ctx->tmpf_kerning, ".right_ch = 0x%04X, ",  kerning->right_char);
+	fprintf (ctx->tmpf_kerning, ".pxl_adjust = % 4d", kerning->x_pxl_adjust);
+	fprintf (ctx->tmpf_kerning, "},\n");
+	ctx->kerning_index++;
 }
 
-/* Function description.
+/* Write the characters of a batch. The kerning index of each character is
+known from the pairs of the characters before it.
+    Args:
+<context>[in] export context.
+<characters>[in] characters of the batch.
+<num>[in] number of characters.
+    Ret:
+*/
+static void PutCharacters (void *context, fontCvt_Character_t *characters, uint32_t num)
+{
+	Ctx_t *ctx = context;
+	uint32_t kerning_index = ctx->kerning_index;
+
+	for (uint32_t k = 0; k < num; k++)
+	{
+		PutCharacter (ctx, &characters[k], kerning_index);
+		kerning_index += characters[k].kerning_num;
+	}
+}
+
+/* Write the kerning pairs of a batch.
     Args:
+<context>[in] export context.
+<kernings>[in] pairs of the batch.
+<num>[in] number of pairs.
     Ret:
 */
-static void EndCharacter (void)
+static void PutKernings (void *context, fontCvt_Kerning_t *kernings, uint32_t num)
 {
+	for (uint32_t k = 0; k < num; k++)
+		PutKerning (context, &kernings[k]);
+}
 
+/* Function description.
+    Args:
+    Ret:
+*/
+static void EndCharacter (void *context)
+{
+	(void)context;
 }
 
 /* Function description.
     Args:
     Ret:
 */
-static void EndRange (void)
+static void EndRange (void *context)
 {
-	fprintf (TmpfCharacter, "};\n\n");
-	RangeIndex++;
+	Ctx_t *ctx = context;
+
+	if (ctx->disabled)
+		return;
+	fprintf (ctx->tmpf_character, "};\n\n");
+	ctx->range_index++;
 }
 
 /* Function description.
     Args:
     Ret:
 */
-static void EndFont (void)
+static void EndFont (void *context)
 {
-	if (KerningIndex)
+	Ctx_t *ctx = context;
+
+	if (ctx->disabled)
+	{	/* the files of an export started and failed are removed */
+		if (ctx->f_source)
+		{
+			fprintf (stderr, "%s not exported\n", ctx->source_fname);
+			CloseAllFile (ctx);
+			remove (ctx->source_fname);
+			remove (ctx->header_fname);
+			if (ctx->out_format == L_FORMAT_BIN_FILE)
+				remove (ctx->bin_fname);
+		}
+		corpus_Free (ctx->order);
+		ctx->order = NULL;
+		return;
+	}
+	if (ctx->kerning_index)
 	{
-		fprintf (TmpfFont, "\t.kerning = Kerning,\n");
+		fprintf (ctx->tmpf_font, "\t.kerning = Kerning,\n");
 	}
 	else
 	{
-		fprintf (TmpfFont, "\t.kerning = NULL, // no kerning info founded\n");
-	}
-	fprintf (TmpfFont, "\t.num_kerning = %d,\n", KerningIndex);
-	fprintf (TmpfFont, "\t.num_ranges = %d,\n", RangeIndex);
-	fprintf (TmpfFont, "};\n");
-	fprintf (TmpfRange, "};\n");
-	if (OutFormat == L_FORMAT_C_ARRAY)
-		fprintf (TmpfBitmap, "};\n");
-	fprintf (TmpfKerning, "};\n");
-
-	if (OutFormat == L_FORMAT_C_ARRAY)
-		AllFileWrite (FSource, TmpfBitmap);
-	fprintf (FSource, "\n\n");
-	AllFileWrite (FSource, TmpfCharacter);
-	fprintf (FSource, "\n\n");
-	AllFileWrite (FSource, TmpfRange);
-	fprintf (FSource, "\n\n");
-	if (KerningIndex)
+		fprintf (ctx->tmpf_font, "\t.kerning = NULL, // no kerning info founded\n");
+	}
+	fprintf (ctx->tmpf_font, "\t.num_kerning = %u,\n", ctx->kerning_index);
+	fprintf (ctx->tmpf_font, "\t.num_ranges = %d,\n", ctx->range_index);
+	if (ctx->atlas_width)
+	{
+		fprintf (ctx->tmpf_font, "\t.atlas_pxl_width = %d,\n", ctx->atlas_width);
+		fprintf (ctx->tmpf_font, "\t.atlas_pxl_height = %d,\n", ctx->atlas_height);
+		fprintf (ctx->tmpf_font, "\t.num_atlas_pages = %d,\n", ctx->atlas_pages_num);
+		AtlasWritePages (ctx);
+	}
+	fprintf (ctx->tmpf_font, "};\n");
+	fprintf (ctx->tmpf_range, "};\n");
+	if (ctx->order && !ctx->order_fail)
+		OrderLayOut (ctx);
+	if (ctx->out_format == L_FORMAT_C_ARRAY)
+		fprintf (ctx->tmpf_bitmap, "};\n");
+	fprintf (ctx->tmpf_kerning, "};\n");
+
+	stats_Begin (STATS_PHASE_FILE_IO);
+	if (ctx->out_format == L_FORMAT_C_ARRAY)
+		AllFileWrite (ctx->f_source, ctx->tmpf_bitmap);
+	fprintf (ctx->f_source, "\n\n");
+	AllFileWrite (ctx->f_source, ctx->tmpf_character);
+	fprintf (ctx->f_source, "\n\n");
+	AllFileWrite (ctx->f_source, ctx->tmpf_range);
+	fprintf (ctx->f_source, "\n\n");
+	if (ctx->kerning_index)
 	{	/* write da kerinig table only if contains data */
-		AllFileWrite (FSource, TmpfKerning);
-		fprintf (FSource, "\n\n");
+		AllFileWrite (ctx->f_source, ctx->tmpf_kerning);
+		fprintf (ctx->f_source, "\n\n");
+	}
+	AllFileWrite (ctx->f_source, ctx->tmpf_font);
+	stats_Add (STATS_COUNTER_OUTPUT_BYTES, ftell (ctx->f_source));
+	if (ctx->bitmap_bin_file)
+		stats_Add (STATS_COUNTER_OUTPUT_BYTES, ftell (ctx->bitmap_bin_file));
+	stats_End (STATS_PHASE_FILE_IO);
+
+	if (L_PREBLENDED)
+	{	/* report the flash cost of pre-blending */
+		printf ("pre-blended bitmaps: %u bytes at %d bpp", ctx->bmp_array_offset, ctx->bpp);
+		if (ctx->use_palette)
+			printf (" (%d colors palette)", ctx->palette_num);
+		printf (", %u bytes as %d bpp coverage (%+.1f%%)\n", ctx->coverage_bytes, ctx->coverage_bpp,
+			ctx->coverage_bytes ? 100.0 * ((double)ctx->bmp_array_offset - ctx->coverage_bytes) / ctx->coverage_bytes : 0.0);
+	}
+	if (ctx->shared_num)
+		printf ("%u characters share the bitmap of another character\n", ctx->shared_num);
+	if (ctx->mixed_glyphs)
+	{	/* report what the range and glyph depths saved */
+		printf ("mixed bpp: %u glyphs not at %d bpp, bitmaps %u bytes, %u at %d bpp (%+.1f%%)\n",
+			ctx->mixed_glyphs, ctx->font_bpp, ctx->bmp_array_offset, ctx->font_bpp_bytes, ctx->font_bpp,
+			ctx->font_bpp_bytes ? 100.0 * ((double)ctx->bmp_array_offset - ctx->font_bpp_bytes) / ctx->font_bpp_bytes : 0.0);
+	}
+	if (ctx->atlas_width)
+	{	/* report how well the glyphs fill the pages */
+		uint32_t pages_area = (uint32_t)ctx->atlas_pages_num * ctx->atlas_width * ctx->atlas_height;
+
+		printf ("atlas: %d pages %dx%d, %u bytes, glyphs cover %u of %u pixels, packing efficiency %.1f%%\n",
+			ctx->atlas_pages_num, ctx->atlas_width, ctx->atlas_height, ctx->bmp_array_offset, ctx->atlas_glyphs_area, pages_area,
+			pages_area ? 100.0 * ctx->atlas_glyphs_area / pages_area : 0.0);
 	}
-	AllFileWrite (FSource, TmpfFont);
 
-	CloseAllFile ( );
+	CloseAllFile (ctx);
+	corpus_Free (ctx->order);
+	ctx->order = NULL;
 }
 
 
@@ -419,29 +896,29 @@ static void EndFont (void)
     Args:
     Ret:
 */
-static void CloseAllFile (void)
-{
-	if (FSource)
-		fclose (FSource);
-	if (TmpfFont)
-		fclose (TmpfFont);
-	if (TmpfRange)
-		fclose (TmpfRange);
-	if (TmpfCharacter)
-		fclose (TmpfCharacter);
-	if (TmpfBitmap)
-		fclose (TmpfBitmap);
-	if (TmpfKerning)
-		fclose (TmpfKerning);
-	if (BitmapBinFile)
-		fclose (BitmapBinFile);
-	FSource = NULL;
-	TmpfFont = NULL;
-	TmpfRange = NULL;
-	TmpfCharacter = NULL;
-	TmpfBitmap = NULL;
-	TmpfKerning = NULL;
-	BitmapBinFile = NULL;
+static void CloseAllFile (Ctx_t *ctx)
+{
+	if (ctx->f_source)
+		fclose (ctx->f_source);
+	if (ctx->tmpf_font)
+		fclose (ctx->tmpf_font);
+	if (ctx->tmpf_range)
+		fclose (ctx->tmpf_range);
+	if (ctx->tmpf_character)
+		fclose (ctx->tmpf_character);
+	if (ctx->tmpf_bitmap)
+		fclose (ctx->tmpf_bitmap);
+	if (ctx->tmpf_kerning)
+		fclose (ctx->tmpf_kerning);
+	if (ctx->bitmap_bin_file)
+		fclose (ctx->bitmap_bin_file);
+	ctx->f_source = NULL;
+	ctx->tmpf_font = NULL;
+	ctx->tmpf_range = NULL;
+	ctx->tmpf_character = NULL;
+	ctx->tmpf_bitmap = NULL;
+	ctx->tmpf_kerning = NULL;
+	ctx->bitmap_bin_file = NULL;
 }
 
 /* Write all the source file content at the end of the destination file.
@@ -461,6 +938,403 @@ static void AllFileWrite (FILE *f_dst, FILE *f_src)
 		fputc (ch, f_dst);
 }
 
+/* Pack a bitmap row in the output pixel format and append it to the bitmaps
+table. Rows always start on a new byte.
+    Args:
+<row>[in] 8 bit coverage (or distance) pixels.
+<width>[in] row width (pixel).
+    Ret:
+*/
+static void PutBitmapRow (Ctx_t *ctx, const uint8_t *row, uint16_t width)
+{
+	/* destination bitmap byte wiating to be filled before write */
+	uint8_t wr_byte;
+	/* the next pixel value offset position inside wr_byte */
+	int8_t bit_pos;
+	/* just to make it esier to recognize a glyph we add a 4-level-only
+	   picture next it's byte rappresentation.
+	*/
+	char lview[256]; /* glyph picture line */
+	uint16_t lview_sz;
+
+	if (ctx->out_format == L_FORMAT_C_ARRAY)
+		fprintf (ctx->tmpf_bitmap, "\t");
+
+	lview_sz = 0;
+	lview[0] = 0;
+	wr_byte = 0;
+	bit_pos = 8 - ctx->bpp;
+	for (uint16_t x = 0; x < width; x++)
+	{
+		const uint8_t *src_pxl; /* pointer to the source bitamp pixel */
+		uint8_t gray_val; /* gray value for this pixel */ 
+
+		src_pxl = &row[x];
+
+		gray_val = *src_pxl >> (8 - ctx->coverage_bpp);
+		{	/* add this pixel to the picture line */
+			uint8_t view_val;
+			char view_char = '.';
+
+			/* we only use max 4-level (.-1-2-3) always in 1-2-4 and 8 bpp */
+			/* translate the original pixel gray value to a max 4-level gray
+			   value. thus a 2 bit rappresentation.
+			*/
+			view_val = gray_val >> L_MAX (0, ctx->coverage_bpp - 2);
+			if (view_val)
+				view_char = '0' + view_val;
+			
+			if (lview_sz < sizeof (lview) - 1) /* wider glyphs get a cut picture */
+				lview_sz += snprintf (lview + lview_sz, sizeof (lview) - lview_sz, "%c", view_char);
+		}
+
+		if (L_PREBLENDED)
+		{
+			if (!ctx->use_palette)
+			{	/* native pixels are always byte aligned */
+				PutBitmapByte (ctx, ctx->level_to_pixel[gray_val] & 0xFF);
+				if (ctx->pixfmt == L_PIXFMT_RGB565)
+					PutBitmapByte (ctx, ctx->level_to_pixel[gray_val] >> 8);
+				continue;
+			}
+			/* pack the palette index in place of the coverage */
+			gray_val = ctx->level_to_pixel[gray_val];
+		}
+
+		wr_byte |= gray_val << bit_pos;
+		bit_pos -= ctx->bpp; /* advance the position for the nex pixel */
+		if (bit_pos < 0)
+		{	/* wr_byte is fill of pixels */
+			PutBitmapByte (ctx, wr_byte);
+			/* refresh wr_byte and bit_pos */
+			wr_byte = 0;
+			bit_pos = 8 - ctx->bpp;
+		}
+	}
+
+	if (bit_pos != (8 - ctx->bpp))
+	{	/* some pixel are inside wr_byte waiting to be write */
+		PutBitmapByte (ctx, wr_byte);
+	}
+	ctx->coverage_bytes += (width * ctx->coverage_bpp + 7) / 8;
+	/* add the picture line next to the byte line */
+	if (ctx->out_format == L_FORMAT_C_ARRAY)
+	{
+		fprintf (ctx->tmpf_bitmap, "// %s", lview);
+		fprintf (ctx->tmpf_bitmap, "\n");
+	}
+}
+
+/* Find the lowest bpp reproducing the coverage of a glyph at its range bpp
+within the autobpp error. Both are compared expanded to 8 bit.
+    Args:
+<ctx>[in] export context.
+<character>[in] character with a coverage bitmap.
+<bpp>[in] bpp of the range.
+    Ret:
+the bpp to store the glyph at, bpp itself if no lower one is close enough.
+*/
+static uint8_t LowestBpp (Ctx_t *ctx, fontCvt_Character_t *character, uint8_t bpp)
+{
+	uint32_t size = (uint32_t)character->bmp_pxl_width * character->bmp_pxl_height;
+	const uint8_t *bmp = (const uint8_t *)character->bmp;
+
+	if (bmp == NULL || size == 0)
+		return bpp;
+	for (uint8_t low = 1; low < bpp; low <<= 1)
+	{
+		uint32_t k;
+
+		for (k = 0; k < size; k++)
+		{	/* 255 / (2^bpp - 1) is exact for 1, 2, 4 and 8 bpp */
+			int16_t ref = (bmp[k] >> (8 - bpp)) * (255 / ((1 << bpp) - 1));
+			int16_t val = (bmp[k] >> (8 - low)) * (255 / ((1 << low) - 1));
+
+			if (abs (ref - val) > ctx->autobpp)
+				break;
+		}
+		if (k == size)
+			return low;
+	}
+	return bpp;
+}
+
+/* Place a character bitmap inside the first atlas page with room for it,
+using a bottom-left skyline packer. A new page is opened when no page fits.
+    Args:
+<character>[in] character to place.
+<page>[out] atlas page.
+<x>[out] x position of the bitmap top left corner inside the page.
+<y>[out] y position of the bitmap top left corner inside the page.
+    Ret:
+false if the bitmap can't be placed.
+*/
+static bool AtlasPlace (Ctx_t *ctx, fontCvt_Character_t *character, uint16_t *page, uint16_t *x, uint16_t *y)
+{
+	uint16_t w = character->bmp_pxl_width + ctx->atlas_pad;
+	uint16_t h = character->bmp_pxl_height + ctx->atlas_pad;
+	AtlasPage_t *atlas_page = NULL;
+	uint16_t best_node, best_y = UINT16_MAX;
+
+	*page = *x = *y = 0;
+	if (character->bmp_pxl_width == 0 || character->bmp_pxl_height == 0)
+		return true; /* nothing to draw */
+	if (w > ctx->atlas_width || h > ctx->atlas_height)
+	{
+		fprintf (stderr, "character 0x%04X doesn't fit the atlas page\n", character->unicode);
+		return false;
+	}
+
+	for (uint16_t p = 0; p < ctx->atlas_pages_num && best_y == UINT16_MAX; p++)
+	{
+		for (uint16_t node = 0; node < ctx->atlas_pages[p].skyline_num; node++)
+		{
+			uint16_t node_y;
+
+			/* lowest position first, leftmost on equal height */
+			if (AtlasFit (ctx, &ctx->atlas_pages[p], node, w, h, &node_y) && node_y < best_y)
+			{
+				best_y = node_y;
+				best_node = node;
+				atlas_page = &ctx->atlas_pages[p];
+				*page = p;
+			}
+		}
+	}
+
+	if (atlas_page == NULL)
+	{	/* open a new page */
+		AtlasPage_t *pages;
+
+		if (ctx->atlas_pages_num == L_ATLAS_MAX_PAGES)
+		{
+			fprintf (stderr, "character 0x%04X doesn't fit %d atlas pages\n", character->unicode, L_ATLAS_MAX_PAGES);
+			return false;
+		}
+		if ((pages = realloc (ctx->atlas_pages, sizeof (AtlasPage_t) * (ctx->atlas_pages_num + 1))) == NULL)
+		{
+			fprintf (stderr, "atlas pages allocation fail\n");
+			return false;
+		}
+		ctx->atlas_pages = pages;
+		atlas_page = &ctx->atlas_pages[ctx->atlas_pages_num];
+		atlas_page->pxlmap = calloc (ctx->atlas_width, ctx->atlas_height);
+		/* the skyline can't have more segments than pixels */
+		atlas_page->skyline = malloc (sizeof (AtlasSkyline_t) * (ctx->atlas_width + 1));
+		if (atlas_page->pxlmap == NULL || atlas_page->skyline == NULL)
+		{
+			free (atlas_page->pxlmap);
+			free (atlas_page->skyline);
+			fprintf (stderr, "atlas pages allocation fail\n");
+			return false;
+		}
+		atlas_page->skyline[0].x = 0;
+		atlas_page->skyline[0].y = 0;
+		atlas_page->skyline[0].w = ctx->atlas_width;
+		atlas_page->skyline_num = 1;
+		*page = ctx->atlas_pages_num++;
+		best_node = 0;
+		best_y = 0;
+	}
+
+	*x = atlas_page->skyline[best_node].x;
+	*y = best_y;
+	AtlasInsert (ctx, atlas_page, best_node, w, h, best_y);
+	for (uint16_t row = 0; row < character->bmp_pxl_height; row++)
+	{
+		memcpy (&atlas_page->pxlmap[*x + (*y + row) * ctx->atlas_width],
+			&character->bmp[row * character->bmp_pxl_width], character->bmp_pxl_width);
+	}
+	ctx->atlas_glyphs_area += character->bmp_pxl_width * character->bmp_pxl_height;
+	return true;
+}
+
+/* Check if a rectangle fits the atlas page with its left edge on a skyline
+segment.
+    Args:
+<page>[in] atlas page.
+<node>[in] skyline segment index.
+<w>[in] rectangle width.
+<h>[in] rectangle height.
+<y>[out] lowest y position of the rectangle over the skyline.
+    Ret:
+true if the rectangle fits.
+*/
+static bool AtlasFit (Ctx_t *ctx, AtlasPage_t *page, uint16_t node, uint16_t w, uint16_t h, uint16_t *y)
+{
+	int32_t remaining = w;
+
+	if (page->skyline[node].x + w > ctx->atlas_width)
+		return false;
+
+	*y = 0;
+	for (uint16_t k = node; remaining > 0; k++)
+	{	/* the rectangle lies on the highest segment below it */
+		*y = L_MAX (*y, page->skyline[k].y);
+		if (*y + h > ctx->atlas_height)
+			return false;
+		remaining -= page->skyline[k].w;
+	}
+	return true;
+}
+
+/* Raise the skyline where a rectangle has been placed.
+    Args:
+<page>[in] atlas page.
+<node>[in] skyline segment index the rectangle starts from.
+<w>[in] rectangle width.
+<h>[in] rectangle height.
+<y>[in] y position of the rectangle.
+    Ret:
+*/
+static void AtlasInsert (Ctx_t *ctx, AtlasPage_t *page, uint16_t node, uint16_t w, uint16_t h, uint16_t y)
+{
+	AtlasSkyline_t *sky = page->skyline;
+	uint16_t end;
+
+	(void)ctx;
+
+	memmove (&sky[node + 1], &sky[node], sizeof (AtlasSkyline_t) * (page->skyline_num - node));
+	sky[node].y = y + h;
+	sky[node].w = w;
+	page->skyline_num++;
+
+	/* shrink or remove the segments now below the rectangle */
+	end = sky[node].x + w;
+	for (uint16_t k = node + 1; k < page->skyline_num && sky[k].x < end; )
+	{
+		uint16_t shrink = end - sky[k].x;
+
+		if (sky[k].w > shrink)
+		{
+			sky[k].x += shrink;
+			sky[k].w -= shrink;
+			break;
+		}
+		memmove (&sky[k], &sky[k + 1], sizeof (AtlasSkyline_t) * (page->skyline_num - k - 1));
+		page->skyline_num--;
+	}
+
+	/* merge adjacent segments of the same height */
+	for (uint16_t k = 0; k + 1 < page->skyline_num; )
+	{
+		if (sky[k].y == sky[k + 1].y)
+		{
+			sky[k].w += sky[k + 1].w;
+			memmove (&sky[k + 1], &sky[k + 2], sizeof (AtlasSkyline_t) * (page->skyline_num - k - 2));
+			page->skyline_num--;
+		}
+		else
+			k++;
+	}
+}
+
+/* Write all the atlas pages to the bitmaps table, one after the other, and
+release them.
+    Args:
+    Ret:
+*/
+static void AtlasWritePages (Ctx_t *ctx)
+{
+	for (uint16_t p = 0; p < ctx->atlas_pages_num; p++)
+	{
+		if (ctx->out_format == L_FORMAT_C_ARRAY)
+			fprintf (ctx->tmpf_bitmap, "\t// atlas page %d\n", p);
+		for (uint16_t y = 0; y < ctx->atlas_height; y++)
+			PutBitmapRow (ctx, &ctx->atlas_pages[p].pxlmap[y * ctx->atlas_width], ctx->atlas_width);
+		if (ctx->out_format == L_FORMAT_C_ARRAY)
+			fprintf (ctx->tmpf_bitmap, "\n");
+		free (ctx->atlas_pages[p].pxlmap);
+		free (ctx->atlas_pages[p].skyline);
+	}
+	free (ctx->atlas_pages);
+	ctx->atlas_pages = NULL;
+}
+
+/* Append a byte to the bitmaps table.
+    Args:
+<byte>[in] byte to append.
+    Ret:
+*/
+static void PutBitmapByte (Ctx_t *ctx, uint8_t byte)
+{
+	if (ctx->out_format == L_FORMAT_C_ARRAY)
+		fprintf (ctx->tmpf_bitmap, "0x%02X, ", byte);
+	else if (ctx->out_format == L_FORMAT_BIN_FILE)
+		fputc (byte, ctx->bitmap_bin_file);
+	ctx->bmp_array_offset ++;
+}
+
+/* Blend the foreground color over the background color and convert the
+result in the selected native pixel format.
+    Args:
+<level>[in] coverage level.
+<max_level>[in] full coverage level.
+    Ret:
+the native pixel value.
+*/
+static uint16_t BlendColor (Ctx_t *ctx, uint8_t level, uint8_t max_level)
+{
+	uint8_t rgb[3];
+
+	for (uint8_t c = 0; c < 3; c++)
+	{
+		uint8_t fg = ctx->fg_color >> (16 - 8 * c);
+		uint8_t bg = ctx->bg_color >> (16 - 8 * c);
+
+		rgb[c] = bg + ((int)fg - bg) * level / max_level;
+	}
+
+	switch (ctx->pixfmt)
+	{
+		case L_PIXFMT_RGB565:
+			return ((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3);
+		case L_PIXFMT_RGB332:
+			return ((rgb[0] >> 5) << 5) | ((rgb[1] >> 5) << 2) | (rgb[2] >> 6);
+		case L_PIXFMT_L8:
+			return (rgb[0] * 77 + rgb[1] * 150 + rgb[2] * 29) >> 8;
+		default:
+			return level;
+	}
+}
+
+/* Build the coverage level to native pixel translation table. When the
+palette is enabled identical colors are merged and the table contains palette
+indexes, packed at the smallest bpp able to address the whole palette.
+    Args:
+<coverage_bpp>[in] bit per pixel of the coverage.
+    Ret:
+*/
+static void BuildBlendTable (Ctx_t *ctx, uint8_t coverage_bpp)
+{
+	uint8_t max_level = (1 << coverage_bpp) - 1;
+
+	ctx->palette_num = 0;
+	for (uint16_t level = 0; level <= max_level; level++)
+	{
+		uint16_t color = BlendColor (ctx, level, max_level);
+		uint16_t k;
+
+		ctx->level_to_pixel[level] = color;
+		if (!ctx->use_palette)
+			continue;
+		for (k = 0; k < ctx->palette_num; k++)
+			if (ctx->palette[k] == color)
+				break;
+		if (k == ctx->palette_num)
+			ctx->palette[ctx->palette_num++] = color;
+		ctx->level_to_pixel[level] = k;
+	}
+
+	if (ctx->use_palette)
+	{
+		for (ctx->bpp = 1; (1 << ctx->bpp) < ctx->palette_num; ctx->bpp <<= 1)
+			;
+	}
+	else
+		ctx->bpp = (ctx->pixfmt == L_PIXFMT_RGB565) ? 16 : 8;
+}
+
 /* Create the c header file.
     Args:
 <output>[in] name of the output to produce. This is appended with '.h' to
@@ -470,8 +1344,8 @@ static void AllFileWrite (FILE *f_dst, FILE *f_src)
 static void BuildHeaderFile (const char *output)
 {
 	FILE *fHeader;
-	static char HeaderFname[256];
-	static char UpperName[256];
+	char HeaderFname[256];
+	char UpperName[256] = { 0 };
 
 	snprintf (HeaderFname, sizeof (HeaderFname), "%s.h", output);
 	for (uint16_t k = 0; k < strlen (output); k++)
@@ -490,6 +1364,244 @@ static void BuildHeaderFile (const char *output)
 		fprintf (fHeader, "extern const " L_TYPE_FONT " %s_Font;\n", output);
 		fprintf (fHeader, "\n");
 		fprintf (fHeader, "#endif // %s_H_INCLUDED\n", UpperName);
+		stats_Add (STATS_COUNTER_OUTPUT_BYTES, ftell (fHeader));
 		fclose (fHeader);
 	}
 }
+
+/* Count a character in the frequency order block of its bitmap, opening a
+new block for a bitmap not written yet.
+    Args:
+<ctx>[in] export context.
+<character>[in] character.
+<block>[in] block of the bitmap shared by the character, UINT32_MAX for a new
+    bitmap.
+    Ret:
+the block, UINT32_MAX on allocation fail.
+*/
+static uint32_t OrderBlock (Ctx_t *ctx, fontCvt_Character_t *character, uint32_t block)
+{
+	const corpus_Corpus_t *corpus = ctx->order;
+	uint64_t count = corpus_Count (corpus, character->unicode);
+
+	if (ctx->order_fail)
+		return UINT32_MAX;
+	if (block == UINT32_MAX)
+	{
+		if (ctx->blocks_num == ctx->blocks_max)
+		{
+			uint32_t max = L_MAX (ctx->blocks_max * 2, 256);
+			Block_t *blocks = realloc (ctx->blocks, sizeof (Block_t) * max);
+
+			if (blocks == NULL)
+			{
+				fprintf (stderr, "order allocation fail, bitmaps left in codepoint order\n");
+				ctx->order_fail = true;
+				return UINT32_MAX;
+			}
+			ctx->blocks = blocks;
+			ctx->blocks_max = max;
+		}
+		block = ctx->blocks_num++;
+		memset (&ctx->blocks[block], 0, sizeof (Block_t));
+		ctx->blocks[block].pos = -1; /* set when the bitmap is written */
+		ctx->blocks[block].bmp_offset = ctx->bmp_array_offset;
+		ctx->blocks[block].first = UINT32_MAX;
+	}
+	ctx->blocks[block].count += count;
+	ctx->blocks[block].first = L_MIN (ctx->blocks[block].first, corpus_First (corpus, character->unicode));
+	return block;
+}
+
+/* Remember where the descriptor file gets the offset of a block bitmap.
+    Args:
+<ctx>[in] export context.
+<block>[in] block of the bitmap.
+    Ret:
+*/
+static void OrderPatch (Ctx_t *ctx, uint32_t block)
+{
+	if (ctx->order_fail || block == UINT32_MAX)
+		return;
+	if (ctx->patches_num == ctx->patches_max)
+	{
+		uint32_t max = L_MAX (ctx->patches_max * 2, 256);
+		Patch_t *patches = realloc (ctx->patches, sizeof (Patch_t) * max);
+
+		if (patches == NULL)
+		{
+			fprintf (stderr, "order allocation fail, bitmaps left in codepoint order\n");
+			ctx->order_fail = true;
+			return;
+		}
+		ctx->patches = patches;
+		ctx->patches_max = max;
+	}
+	ctx->patches[ctx->patches_num].pos = ftell (ctx->tmpf_character);
+	ctx->patches[ctx->patches_num++].block = block;
+}
+
+/* Lay the bitmaps out again, the most used first, and write the descriptor
+offsets of the new layout. Print the flash pages a string reads in both the
+layouts.
+    Args:
+<ctx>[in] export context.
+    Ret:
+*/
+static void OrderLayOut (Ctx_t *ctx)
+{
+	FILE *f_src = (ctx->out_format == L_FORMAT_C_ARRAY) ? ctx->tmpf_bitmap : ctx->bitmap_bin_file;
+	BlockOrder_t *order = malloc (sizeof (BlockOrder_t) * (ctx->blocks_num + 1));
+	uint32_t *old_offsets = malloc (sizeof (uint32_t) * (ctx->blocks_num + 1));
+	uint32_t *new_offsets = malloc (sizeof (uint32_t) * (ctx->blocks_num + 1));
+	FILE *f_dst = NULL;
+	long end = ftell (f_src);
+	uint32_t offset = 0, used = 0;
+	uint64_t total = 0;
+
+	if (order == NULL || old_offsets == NULL || new_offsets == NULL)
+		goto __exit;
+	f_dst = (ctx->out_format == L_FORMAT_C_ARRAY) ? tmpfile ( ) : fopen (ctx->bin_fname, "wb");
+	if (f_dst == NULL)
+		goto __exit;
+
+	/* the blocks are in codepoint order in the file */
+	for (uint32_t k = ctx->blocks_num; k-- > 0;)
+	{
+		Block_t *block = &ctx->blocks[k];
+
+		block->bytes = ((k + 1 < ctx->blocks_num) ? ctx->blocks[k + 1].bmp_offset : ctx->bmp_array_offset) - block->bmp_offset;
+		block->len = 0;
+		if (block->pos >= 0)
+		{
+			block->len = end - block->pos;
+			end = block->pos;
+		}
+		order[k].count = block->count;
+		order[k].first = block->first;
+		order[k].block = k;
+		old_offsets[k] = block->bmp_offset;
+		total += block->count;
+		used += (block->count && block->bytes);
+	}
+	qsort (order, ctx->blocks_num, sizeof (BlockOrder_t), CompareBlockOrder);
+
+	/* the table header stays first */
+	FileCopy (f_dst, f_src, 0, end);
+	for (uint32_t k = 0; k < ctx->blocks_num; k++)
+	{
+		const Block_t *block = &ctx->blocks[order[k].block];
+
+		new_offsets[order[k].block] = offset;
+		offset += block->bytes;
+		if (block->pos >= 0)
+			FileCopy (f_dst, f_src, block->pos, block->len);
+	}
+	for (uint32_t k = 0; k < ctx->patches_num; k++)
+	{
+		fseek (ctx->tmpf_character, ctx->patches[k].pos, SEEK_SET);
+		fprintf (ctx->tmpf_character, "%10u", new_offsets[ctx->patches[k].block]);
+	}
+	fseek (ctx->tmpf_character, 0, SEEK_END);
+	fclose (f_src);
+	if (ctx->out_format == L_FORMAT_C_ARRAY)
+		ctx->tmpf_bitmap = f_dst;
+	else
+		ctx->bitmap_bin_file = f_dst;
+	f_dst = NULL;
+
+	printf ("bitmaps by corpus frequency: %u of %u bitmaps used, a %d character string reads %.1f pages of %u bytes, %.1f in codepoint order\n",
+		used, ctx->blocks_num, L_TYPICAL_STRING, OrderPagesRead (ctx, new_offsets, total), ctx->page_size,
+		OrderPagesRead (ctx, old_offsets, total));
+
+__exit:
+	if (f_dst)
+	{
+		fclose (f_dst);
+		fprintf (stderr, "can't lay out the bitmaps, left in codepoint order\n");
+	}
+	else if (order == NULL || old_offsets == NULL || new_offsets == NULL)
+		fprintf (stderr, "order allocation fail, bitmaps left in codepoint order\n");
+	free (order);
+	free (old_offsets);
+	free (new_offsets);
+}
+
+/* Expected distinct flash pages a string of the corpus reads from the
+bitmaps table: its characters are drawn with the corpus frequencies, a page is
+read when one of them has its bitmap there.
+    Args:
+<ctx>[in] export context.
+<offsets>[in] bitmap offset of each block.
+<total>[in] corpus occurrences of all the blocks.
+    Ret:
+the pages, 0 when the corpus has none of the characters.
+*/
+static double OrderPagesRead (const Ctx_t *ctx, const uint32_t *offsets, uint64_t total)
+{
+	uint32_t pages_num = ctx->bmp_array_offset / ctx->page_size + 1;
+	double *hit = calloc (pages_num, sizeof (double)); /* chance a character reads a page */
+	double pages = 0;
+
+	if (hit == NULL || total == 0)
+	{
+		free (hit);
+		return 0;
+	}
+	for (uint32_t k = 0; k < ctx->blocks_num; k++)
+	{
+		const Block_t *block = &ctx->blocks[k];
+
+		if (block->count == 0 || block->bytes == 0)
+			continue;
+		for (uint32_t p = offsets[k] / ctx->page_size; p <= (offsets[k] + block->bytes - 1) / ctx->page_size; p++)
+			hit[p] += (double)block->count / total;
+	}
+	for (uint32_t p = 0; p < pages_num; p++)
+	{
+		double miss = 1;
+
+		for (uint16_t k = 0; k < L_TYPICAL_STRING; k++)
+			miss *= 1 - L_MIN (hit[p], 1);
+		pages += 1 - miss;
+	}
+	free (hit);
+	return pages;
+}
+
+/* Append a part of a file to another one.
+    Args:
+<f_dst>[in] destination file.
+<f_src>[in] source file.
+<pos>[in] start of the part.
+<len>[in] bytes of the part.
+    Ret:
+*/
+static void FileCopy (FILE *f_dst, FILE *f_src, long pos, long len)
+{
+	char buf[4096];
+
+	fseek (f_src, pos, SEEK_SET);
+	while (len > 0)
+	{
+		size_t num = fread (buf, 1, L_MIN ((long)sizeof (buf), len), f_src);
+
+		if (num == 0)
+			break;
+		fwrite (buf, 1, num, f_dst);
+		len -= num;
+	}
+}
+
+/* qsort compare function of the frequency order: the most used first, then
+the first used in the corpus, then in codepoint order. */
+static int CompareBlockOrder (const void *a, const void *b)
+{
+	const BlockOrder_t *oa = a, *ob = b;
+
+	if (oa->count != ob->count)
+		return (oa->count < ob->count) - (oa->count > ob->count);
+	if (oa->first != ob->first)
+		return (oa->first > ob->first) - (oa->first < ob->first);
+	return (oa->block > ob->block) - (oa->block < ob->block);
+}
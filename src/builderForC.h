@@ -23,7 +23,7 @@
 #include "fontCvt.h"
 
 //____________________________________________________________________GLOBAL VAR
-fontCvt_Builder_t builderForC_Builder;
+extern fontCvt_Builder_t builderForC_Builder;
 
 //______________________________________________________________GLOBAL FUNCTIONS
 void builderForC_Init (void);
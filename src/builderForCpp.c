@@ -0,0 +1,413 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* C++ builder. It writes a single C++17 header OUTPUT_NAME.hpp with the font
+as constexpr tables and a constexpr fontBuilderForCpp::Font<bpp> object (see
+fontBuilderForCpp.hpp), so string widths can be computed at compile time.
+Coverage bitmaps only: distance fields and outlines are not supported. */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "builderForCpp.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include "stats.h"
+#include "builderSlots.h"
+
+#define L_NAMESPACE           "fontBuilderForCpp"
+
+typedef struct
+{	/* where the bitmap of a glyph went, for the characters sharing it */
+	uint32_t glyph_idx; /* 0 for a free slot, first member (builderSlots.h) */
+	uint32_t bmp_offset;
+} GlyphSlot_t;
+
+typedef struct
+{	/* state of one export */
+	FILE *f_header; /* exported c++ header file */
+	FILE *tmpf_range; /* temporary file to store the character ranges array */
+	FILE *tmpf_character; /* temporary file to store characters descriptors */
+	FILE *tmpf_bitmap; /* temporary file to store characters bitmaps */
+	FILE *tmpf_kerning; /* temporary file to store kerning information */
+
+	uint8_t bpp; /* bit per pixel for character bitmaps */
+	uint16_t range_index; /* exported character rage index */
+	uint32_t bmp_array_offset;
+	uint32_t kerning_index;
+	bool disabled; /* the font can't be exported by this builder */
+	char name[256];
+	char upper_name[256];
+	fontCvt_Font_t font;
+	/* bitmaps written so far by glyph index (GlyphSlot_t): the characters
+	mapped to the same glyph share one bitmap */
+	builderSlots_Table_t glyph_slots;
+} Ctx_t;
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static void *Create (void);
+static void Destroy (void *context);
+static void StartFont (void *context, fontCvt_Font_t *font, const char *output, const char *options);
+static void StartRange (void *context, fontCvt_Range_t *range);
+static void StartCharacter (void *context, fontCvt_Character_t *character);
+static void PutKerning (void *context, fontCvt_Kerning_t *kerning);
+static void EndCharacter (void *context);
+static void EndRange (void *context);
+static void EndFont (void *context);
+
+static void CloseAllFile (Ctx_t *ctx);
+static void AllFileWrite (FILE *f_dst, FILE *f_src);
+static void PutBitmapRow (Ctx_t *ctx, const uint8_t *row, uint16_t width);
+
+//____________________________________________________________________GLOBAL VAR
+fontCvt_Builder_t builderForCpp_Builder;
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Initialize the builer before it can be used.
+    Args:
+    Ret:
+*/
+void builderForCpp_Init (void)
+{
+	memset (&builderForCpp_Builder, 0, sizeof (builderForCpp_Builder));
+
+	builderForCpp_Builder.create = Create;
+	builderForCpp_Builder.destroy = Destroy;
+	builderForCpp_Builder.startFont = StartFont;
+	builderForCpp_Builder.startRange = StartRange;
+	builderForCpp_Builder.startCharacter = StartCharacter;
+	builderForCpp_Builder.putKerning = PutKerning;
+	builderForCpp_Builder.endCharacter = EndCharacter;
+	builderForCpp_Builder.endRange = EndRange;
+	builderForCpp_Builder.endFont = EndFont;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Allocate the context of an export.
+    Args:
+    Ret:
+the context, NULL on allocation fail.
+*/
+static void *Create (void)
+{
+	Ctx_t *ctx = calloc (1, sizeof (Ctx_t));
+
+	if (ctx)
+		builderSlots_Init (&ctx->glyph_slots, sizeof (GlyphSlot_t));
+	return ctx;
+}
+
+/* Release the context of an export, closing the files it left open.
+    Args:
+<context>[in] export context.
+    Ret:
+*/
+static void Destroy (void *context)
+{
+	Ctx_t *ctx = context;
+
+	CloseAllFile (ctx);
+	builderSlots_Free (&ctx->glyph_slots);
+	free (ctx);
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void StartFont (void *context, fontCvt_Font_t *font, const char *output, const char *options)
+{
+	Ctx_t *ctx = context;
+	char fname[256];
+
+	(void)options;
+	ctx->disabled = true;
+	if (font->sdf_spread || font->outline)
+	{
+		fprintf (stderr, "the c++ builder supports coverage bitmaps only\n");
+		return;
+	}
+	if (font->bpp != 1 && font->bpp != 2 && font->bpp != 4 && font->bpp != 8)
+	{
+		fprintf (stderr, "the c++ builder supports 1, 2, 4 and 8 bpp only\n");
+		return;
+	}
+
+	printf ("exporting %s.hpp\n", output);
+	snprintf (ctx->name, sizeof (ctx->name), "%s", output);
+	for (uint16_t k = 0; k < sizeof (ctx->upper_name) && (ctx->upper_name[k] = toupper (ctx->name[k])); k++)
+		;
+	snprintf (fname, sizeof (fname), "%s.hpp", output);
+
+	/* sections are built in temporary files merged by EndFont */
+	if ((ctx->tmpf_range = tmpfile ( )) == NULL)
+		goto __errexit;
+	if ((ctx->tmpf_character = tmpfile ( )) == NULL)
+		goto __errexit;
+	if ((ctx->tmpf_bitmap = tmpfile ( )) == NULL)
+		goto __errexit;
+	if ((ctx->tmpf_kerning = tmpfile ( )) == NULL)
+		goto __errexit;
+	if ((ctx->f_header = fopen (fname, "wb")) == NULL)
+		goto __errexit;
+
+	ctx->font = *font;
+	ctx->bpp = font->bpp;
+	ctx->range_index = 0;
+	ctx->bmp_array_offset = 0;
+	ctx->kerning_index = 0;
+	ctx->disabled = false;
+	builderSlots_Clear (&ctx->glyph_slots);
+
+	fprintf (ctx->f_header, "#ifndef %s_HPP_INCLUDED\n", ctx->upper_name);
+	fprintf (ctx->f_header, "#define %s_HPP_INCLUDED\n\n", ctx->upper_name);
+	fprintf (ctx->f_header, "#include \"fontBuilderForCpp.hpp\"\n\n");
+	fprintf (ctx->f_header, "namespace %s_Data\n{\n\n", ctx->name);
+
+	fprintf (ctx->tmpf_bitmap, "inline constexpr uint8_t Bitmaps[] =\n{\n");
+	fprintf (ctx->tmpf_range, "inline constexpr " L_NAMESPACE "::Range Ranges[] =\n{\t// first, num_characters, characters\n");
+	fprintf (ctx->tmpf_kerning, "inline constexpr " L_NAMESPACE "::Kerning Kerning[] =\n{\t// left_ch, right_ch, pxl_adjust\n");
+	return;
+
+__errexit:
+	fprintf (stderr, "can't create %s\n", fname);
+	CloseAllFile (ctx);
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void StartRange (void *context, fontCvt_Range_t *range)
+{
+	Ctx_t *ctx = context;
+	uint32_t char_num = range->last - range->first + 1;
+
+	if (ctx->disabled)
+		return;
+	if (range->bpp && range->bpp != ctx->bpp)
+	{	/* the bpp is a template parameter of the whole font */
+		fprintf (stderr, "range 0x%04X-0x%04X exported at %d bpp, C++ fonts have one bpp\n",
+			range->first, range->last, ctx->bpp);
+	}
+	fprintf (ctx->tmpf_range, "\t{ %d, %d, Characters%d },\n", range->first, char_num, ctx->range_index);
+	fprintf (ctx->tmpf_character, "inline constexpr " L_NAMESPACE "::Character Characters%d[] =\n", ctx->range_index);
+	fprintf (ctx->tmpf_character, "{\t// Unicode character range [0x%04X-0x%04X] (%d characters)\n", range->first, range->last, char_num);
+	fprintf (ctx->tmpf_character, "\t// bmp_offset, bmp_pxl_width, bmp_pxl_height, pxl_advance, pxl_left, pxl_top, kerning_index\n");
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void StartCharacter (void *context, fontCvt_Character_t *character)
+{
+	Ctx_t *ctx = context;
+	/* the slot of the glyph, already used if another character wrote it */
+	GlyphSlot_t *slot;
+
+	if (ctx->disabled)
+		return;
+	slot = character->glyph_idx ? builderSlots_Find (&ctx->glyph_slots, character->glyph_idx) : NULL;
+	fprintf (ctx->tmpf_character, "\t{ % 7d, % 3d, % 3d, % 3d, % 4d, % 4d, %5u }, // Unicode 0x%04X\n",
+		(slot && slot->glyph_idx) ? slot->bmp_offset : ctx->bmp_array_offset,
+		character->bmp_pxl_width, character->bmp_pxl_height, character->pxl_advance,
+		character->pxl_left, character->pxl_top, ctx->kerning_index, character->unicode);
+	if (slot && slot->glyph_idx)
+		return;
+	if (slot)
+	{
+		slot->glyph_idx = character->glyph_idx;
+		slot->bmp_offset = ctx->bmp_array_offset;
+		ctx->glyph_slots.num++;
+	}
+
+	if (character->bmp_pxl_width && character->bmp_pxl_height)
+		fprintf (ctx->tmpf_bitmap, "\t// Unicode 0x%04X\n", character->unicode);
+	for (uint16_t y = 0; y < character->bmp_pxl_height; y++)
+	{
+		PutBitmapRow (ctx, (const uint8_t *)&character->bmp[y * character->bmp_pxl_width], character->bmp_pxl_width);
+	}
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void PutKerning (void *context, fontCvt_Kerning_t *kerning)
+{
+	Ctx_t *ctx = context;
+
+	if (ctx->disabled)
+		return;
+	fprintf (ctx->tmpf_kerning, "\t{ 0x%04X, 0x%04X, % 4d },\n", kerning->left_char, kerning->right_char, kerning->x_pxl_adjust);
+	ctx->kerning_index++;
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void EndCharacter (void *context)
+{
+	(void)context;
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void EndRange (void *context)
+{
+	Ctx_t *ctx = context;
+
+	if (ctx->disabled)
+		return;
+	fprintf (ctx->tmpf_character, "};\n\n");
+	ctx->range_index++;
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void EndFont (void *context)
+{
+	Ctx_t *ctx = context;
+
+	if (ctx->disabled)
+		return;
+	if (ctx->bmp_array_offset == 0)
+		fprintf (ctx->tmpf_bitmap, "\t0x00, // no bitmaps, arrays can't be empty\n");
+	fprintf (ctx->tmpf_bitmap, "};\n\n");
+	fprintf (ctx->tmpf_range, "};\n\n");
+	fprintf (ctx->tmpf_kerning, "};\n\n");
+
+	stats_Begin (STATS_PHASE_FILE_IO);
+	AllFileWrite (ctx->f_header, ctx->tmpf_bitmap);
+	AllFileWrite (ctx->f_header, ctx->tmpf_character);
+	AllFileWrite (ctx->f_header, ctx->tmpf_range);
+	if (ctx->kerning_index)
+		AllFileWrite (ctx->f_header, ctx->tmpf_kerning);
+	fprintf (ctx->f_header, "} // namespace %s_Data\n\n", ctx->name);
+
+	fprintf (ctx->f_header, "inline constexpr " L_NAMESPACE "::Font<%d> %s_Font =\n{\n", ctx->bpp, ctx->name);
+	fprintf (ctx->f_header, "\t%d, // pxl_baseline_to_baseline\n", ctx->font.pxl_baseline_to_baseline);
+	fprintf (ctx->f_header, "\t%d, // pxl_max_glyph_height\n", ctx->font.pxl_max_glyph_height);
+	fprintf (ctx->f_header, "\t%s_Data::Bitmaps,\n", ctx->name);
+	fprintf (ctx->f_header, "\t%s_Data::Ranges,\n", ctx->name);
+	fprintf (ctx->f_header, "\t%d, // num_ranges\n", ctx->range_index);
+	if (ctx->kerning_index)
+		fprintf (ctx->f_header, "\t%s_Data::Kerning,\n", ctx->name);
+	else
+		fprintf (ctx->f_header, "\tnullptr, // no kerning info founded\n");
+	fprintf (ctx->f_header, "\t%u, // num_kerning\n", ctx->kerning_index);
+	fprintf (ctx->f_header, "};\n\n");
+	fprintf (ctx->f_header, "#endif // %s_HPP_INCLUDED\n", ctx->upper_name);
+	stats_Add (STATS_COUNTER_OUTPUT_BYTES, ftell (ctx->f_header));
+	stats_End (STATS_PHASE_FILE_IO);
+
+	CloseAllFile (ctx);
+}
+
+/* Close all the open files.
+    Args:
+    Ret:
+*/
+static void CloseAllFile (Ctx_t *ctx)
+{
+	if (ctx->f_header)
+		fclose (ctx->f_header);
+	if (ctx->tmpf_range)
+		fclose (ctx->tmpf_range);
+	if (ctx->tmpf_character)
+		fclose (ctx->tmpf_character);
+	if (ctx->tmpf_bitmap)
+		fclose (ctx->tmpf_bitmap);
+	if (ctx->tmpf_kerning)
+		fclose (ctx->tmpf_kerning);
+	ctx->f_header = NULL;
+	ctx->tmpf_range = NULL;
+	ctx->tmpf_character = NULL;
+	ctx->tmpf_bitmap = NULL;
+	ctx->tmpf_kerning = NULL;
+}
+
+/* Write all the source file content at the end of the destination file.
+    Args:
+<f_dst>[in] destination file.
+<f_src>[in] source file.
+    Ret:
+*/
+static void AllFileWrite (FILE *f_dst, FILE *f_src)
+{
+	char buf[4096];
+	size_t n;
+
+	fseek (f_dst, 0, SEEK_END);
+	fseek (f_src, 0, SEEK_SET);
+	while ((n = fread (buf, 1, sizeof (buf), f_src)) > 0)
+		fwrite (buf, 1, n, f_dst);
+}
+
+/* Pack a bitmap row at ctx->bpp and append it to the bitmaps table, with a
+picture of the row next to it. Rows always start on a new byte.
+    Args:
+<row>[in] 8 bit coverage pixels.
+<width>[in] row width (pixel).
+    Ret:
+*/
+static void PutBitmapRow (Ctx_t *ctx, const uint8_t *row, uint16_t width)
+{
+	char lview[256]; /* glyph picture line */
+	uint8_t wr_byte = 0;
+	int8_t bit_pos = 8 - ctx->bpp;
+	uint16_t k;
+
+	fprintf (ctx->tmpf_bitmap, "\t");
+	for (k = 0; k < width && k < sizeof (lview) - 1; k++)
+	{	/* 4 levels picture: . 1 2 3 */
+		uint8_t view_val = row[k] >> 6;
+
+		lview[k] = view_val ? '0' + view_val : '.';
+	}
+	lview[k] = 0;
+
+	for (uint16_t x = 0; x < width; x++)
+	{
+		wr_byte |= (row[x] >> (8 - ctx->bpp)) << bit_pos;
+		bit_pos -= ctx->bpp;
+		if (bit_pos < 0)
+		{
+			fprintf (ctx->tmpf_bitmap, "0x%02X, ", wr_byte);
+			ctx->bmp_array_offset++;
+			wr_byte = 0;
+			bit_pos = 8 - ctx->bpp;
+		}
+	}
+	if (bit_pos != 8 - ctx->bpp)
+	{
+		fprintf (ctx->tmpf_bitmap, "0x%02X, ", wr_byte);
+		ctx->bmp_array_offset++;
+	}
+	fprintf (ctx->tmpf_bitmap, "// %s\n", lview);
+}
+
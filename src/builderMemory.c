@@ -0,0 +1,407 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* Memory builder. It writes no file: the font is kept in memory, with 8 bit
+bitmaps, so that a host application linking libfontcvt (see fontCvtLib.h) can
+draw previews without parsing any output back. */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "builderMemory.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#define L_MAX(a, b)           (((a) >= (b)) ? (a) : (b))
+
+typedef struct
+{	/* state of one export */
+	builderMemory_Font_t *font; /* font being built */
+	uint32_t characters_max;
+	uint32_t kernings_max;
+	uint32_t arena_max;
+	/* arena offset of each character bitmap, the arena moves while it grows */
+	uint32_t *offsets;
+	uint32_t offsets_max;
+	bool error;
+} Ctx_t;
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static void *Create (void);
+static void Destroy (void *context);
+static void StartFont (void *context, fontCvt_Font_t *font, const char *output, const char *options);
+static void StartRange (void *context, fontCvt_Range_t *range);
+static void StartCharacter (void *context, fontCvt_Character_t *character);
+static void PutKerning (void *context, fontCvt_Kerning_t *kerning);
+static void EndCharacter (void *context);
+static void EndRange (void *context);
+static void EndFont (void *context);
+static void PutCharacters (void *context, fontCvt_Character_t *characters, uint32_t num);
+static void PutKernings (void *context, fontCvt_Kerning_t *kernings, uint32_t num);
+
+static void AddCharacter (Ctx_t *ctx, fontCvt_Character_t *character, uint32_t kerning_index);
+static bool Grow (void **array, uint32_t *max, uint32_t num, uint32_t elem_size);
+static int CompareUnicode (const void *a, const void *b);
+
+//___________________________________________________________________PRIVATE VAR
+
+//____________________________________________________________________GLOBAL VAR
+fontCvt_Builder_t builderMemory_Builder;
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Initialize the builer before it can be used.
+    Args:
+    Ret:
+*/
+void builderMemory_Init (void)
+{
+	memset (&builderMemory_Builder, 0, sizeof (builderMemory_Builder));
+
+	builderMemory_Builder.create = Create;
+	builderMemory_Builder.destroy = Destroy;
+	builderMemory_Builder.startFont = StartFont;
+	builderMemory_Builder.startRange = StartRange;
+	builderMemory_Builder.startCharacter = StartCharacter;
+	builderMemory_Builder.putKerning = PutKerning;
+	builderMemory_Builder.endCharacter = EndCharacter;
+	builderMemory_Builder.endRange = EndRange;
+	builderMemory_Builder.endFont = EndFont;
+	builderMemory_Builder.putCharacters = PutCharacters;
+	builderMemory_Builder.putKernings = PutKernings;
+}
+
+/* Take the font built by the last export of a context.
+    Args:
+<ctx>[in] builder context.
+    Ret:
+the font, to be released with builderMemory_Free. NULL if the export failed.
+*/
+builderMemory_Font_t *builderMemory_Take (void *ctx)
+{
+	Ctx_t *mem = ctx;
+	builderMemory_Font_t *font = mem->font;
+
+	if (mem->error)
+		return NULL;
+	mem->font = NULL;
+	return font;
+}
+
+/* Release a font taken from the builder.
+    Args:
+<font>[in] font, can be NULL.
+    Ret:
+*/
+void builderMemory_Free (builderMemory_Font_t *font)
+{
+	if (font == NULL)
+		return;
+	free (font->characters);
+	free (font->kernings);
+	free (font->arena);
+	free (font);
+}
+
+/* Look for the character of a unicode value.
+    Args:
+<font>[in] font.
+<unicode>[in] unicode value.
+    Ret:
+the character, NULL if it is not inside the font.
+*/
+const builderMemory_Character_t *builderMemory_Find (const builderMemory_Font_t *font, uint32_t unicode)
+{
+	uint32_t lo = 0, hi = font->characters_num;
+
+	while (lo < hi)
+	{
+		uint32_t mid = lo + (hi - lo) / 2;
+		uint32_t mid_unicode = font->characters[mid].character.unicode;
+
+		if (mid_unicode == unicode)
+			return &font->characters[mid];
+		if (mid_unicode < unicode)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return NULL;
+}
+
+/* Look for the kerning between two characters.
+    Args:
+<font>[in] font.
+<left>[in] left character.
+<right_unicode>[in] unicode value of the right character.
+    Ret:
+the pixels to move the cursor before drawing the right character.
+*/
+int16_t builderMemory_GetKerning (const builderMemory_Font_t *font, const builderMemory_Character_t *left,
+	uint32_t right_unicode)
+{
+	for (uint32_t k = left->kerning_index;
+	     k < font->kernings_num && font->kernings[k].left_char == left->character.unicode;
+	     k++)
+	{
+		if ((uint32_t)font->kernings[k].right_char == right_unicode)
+			return font->kernings[k].x_pxl_adjust;
+	}
+	return 0;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Allocate the context of an export.
+    Args:
+    Ret:
+the context, NULL on allocation fail.
+*/
+static void *Create (void)
+{
+	return calloc (1, sizeof (Ctx_t));
+}
+
+/* Release the context of an export and the font not taken.
+    Args:
+<context>[in] export context.
+    Ret:
+*/
+static void Destroy (void *context)
+{
+	Ctx_t *ctx = context;
+
+	builderMemory_Free (ctx->font);
+	free (ctx->offsets);
+	free (ctx);
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void StartFont (void *context, fontCvt_Font_t *font, const char *output, const char *options)
+{
+	Ctx_t *ctx = context;
+
+	(void)output;
+	(void)options;
+	builderMemory_Free (ctx->font);
+	free (ctx->offsets);
+	ctx->offsets = NULL;
+	ctx->characters_max = ctx->kernings_max = ctx->arena_max = ctx->offsets_max = 0;
+	ctx->font = calloc (1, sizeof (builderMemory_Font_t));
+	ctx->error = (ctx->font == NULL);
+	if (ctx->error)
+		return;
+	ctx->font->font = *font;
+	/* names are not owned by the font */
+	ctx->font->font.family_name = NULL;
+	ctx->font->font.style_name = NULL;
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void StartRange (void *context, fontCvt_Range_t *range)
+{
+	(void)context;
+	(void)range;
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void StartCharacter (void *context, fontCvt_Character_t *character)
+{
+	Ctx_t *ctx = context;
+
+	if (!ctx->error)
+		AddCharacter (ctx, character, ctx->font->kernings_num);
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void PutKerning (void *context, fontCvt_Kerning_t *kerning)
+{
+	PutKernings (context, kerning, 1);
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void EndCharacter (void *context)
+{
+	(void)context;
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void EndRange (void *context)
+{
+	(void)context;
+}
+
+/* Point the characters to their bitmaps, now that the arena doesn't move
+anymore, and sort them for builderMemory_Find.
+    Args:
+<context>[in] export context.
+    Ret:
+*/
+static void EndFont (void *context)
+{
+	Ctx_t *ctx = context;
+	builderMemory_Font_t *font = ctx->font;
+
+	if (ctx->error)
+		return;
+	for (uint32_t k = 0; k < font->characters_num; k++)
+	{
+		fontCvt_Character_t *character = &font->characters[k].character;
+
+		if (character->outline)
+			character->outline = &font->arena[ctx->offsets[k]];
+		else if (character->bmp)
+			character->bmp = (const char *)&font->arena[ctx->offsets[k]];
+	}
+	qsort (font->characters, font->characters_num, sizeof (builderMemory_Character_t), CompareUnicode);
+}
+
+/* Add the characters of a batch. The kerning index of each character is
+known from the pairs of the characters before it.
+    Args:
+<context>[in] export context.
+<characters>[in] characters of the batch.
+<num>[in] number of characters.
+    Ret:
+*/
+static void PutCharacters (void *context, fontCvt_Character_t *characters, uint32_t num)
+{
+	Ctx_t *ctx = context;
+	uint32_t kerning_index;
+
+	if (ctx->error)
+		return;
+	kerning_index = ctx->font->kernings_num;
+	for (uint32_t k = 0; k < num; k++)
+	{
+		AddCharacter (ctx, &characters[k], kerning_index);
+		kerning_index += characters[k].kerning_num;
+	}
+}
+
+/* Add kerning pairs.
+    Args:
+<context>[in] export context.
+<kernings>[in] pairs.
+<num>[in] number of pairs.
+    Ret:
+*/
+static void PutKernings (void *context, fontCvt_Kerning_t *kernings, uint32_t num)
+{
+	Ctx_t *ctx = context;
+	builderMemory_Font_t *font = ctx->font;
+
+	if (ctx->error)
+		return;
+	if (!Grow ((void **)&font->kernings, &ctx->kernings_max, font->kernings_num + num, sizeof (fontCvt_Kerning_t)))
+	{
+		ctx->error = true;
+		return;
+	}
+	memcpy (&font->kernings[font->kernings_num], kernings, sizeof (fontCvt_Kerning_t) * num);
+	font->kernings_num += num;
+}
+
+/* Add a character, copying its bitmap (or outline) in the arena.
+    Args:
+<ctx>[in] export context.
+<character>[in] character.
+<kerning_index>[in] first kerning pair with this character on the left.
+    Ret:
+*/
+static void AddCharacter (Ctx_t *ctx, fontCvt_Character_t *character, uint32_t kerning_index)
+{
+	builderMemory_Font_t *font = ctx->font;
+	builderMemory_Character_t *dst;
+	const void *data = character->outline ? (const void *)character->outline : (const void *)character->bmp;
+	uint32_t size = character->outline ? character->outline_sz
+		: (uint32_t)character->bmp_pxl_width * character->bmp_pxl_height;
+
+	if (!Grow ((void **)&font->characters, &ctx->characters_max, font->characters_num + 1,
+	           sizeof (builderMemory_Character_t))
+	 || !Grow ((void **)&ctx->offsets, &ctx->offsets_max, font->characters_num + 1, sizeof (uint32_t))
+	 || (data && !Grow ((void **)&font->arena, &ctx->arena_max, font->arena_size + size, 1)))
+	{
+		ctx->error = true;
+		return;
+	}
+
+	dst = &font->characters[font->characters_num];
+	dst->character = *character;
+	dst->character.mono = NULL; /* the memory font keeps one variant */
+	dst->kerning_index = kerning_index;
+	ctx->offsets[font->characters_num++] = font->arena_size;
+	if (data)
+	{
+		memcpy (&font->arena[font->arena_size], data, size);
+		font->arena_size += size;
+	}
+}
+
+/* Make room for num elements inside an array, doubling its size.
+    Args:
+<array>[in/out] array, moved when it grows.
+<max>[in/out] elements the array can hold.
+<num>[in] elements needed.
+<elem_size>[in] size of an element.
+    Ret:
+false on allocation fail.
+*/
+static bool Grow (void **array, uint32_t *max, uint32_t num, uint32_t elem_size)
+{
+	void *grown;
+	uint32_t new_max;
+
+	if (num <= *max && *array)
+		return true;
+	new_max = L_MAX (L_MAX (*max * 2, num), 64);
+	grown = realloc (*array, (size_t)new_max * elem_size);
+	if (grown == NULL)
+		return false;
+	*array = grown;
+	*max = new_max;
+	return true;
+}
+
+/* qsort comparison of two characters by unicode value. */
+static int CompareUnicode (const void *a, const void *b)
+{
+	wchar_t ua = ((const builderMemory_Character_t *)a)->character.unicode;
+	wchar_t ub = ((const builderMemory_Character_t *)b)->character.unicode;
+
+	return (ua > ub) - (ua < ub);
+}
@@ -0,0 +1,56 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BUILDERMEMORY_H_INCLUDED
+#define BUILDERMEMORY_H_INCLUDED
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "fontCvt.h"
+
+typedef struct
+{
+	/* bmp (8 bit pixels, one byte per pixel, no padding) or outline point
+	inside the font arena */
+	fontCvt_Character_t character;
+	uint32_t kerning_index; /* first kerning pair with this character on the left */
+} builderMemory_Character_t;
+
+typedef struct
+{	/* font exported in memory */
+	fontCvt_Font_t font;
+	builderMemory_Character_t *characters; /* sorted by unicode */
+	uint32_t characters_num;
+	fontCvt_Kerning_t *kernings; /* pairs of the same left character are contiguous */
+	uint32_t kernings_num;
+	uint8_t *arena; /* bitmaps and outlines of all the characters */
+	uint32_t arena_size;
+} builderMemory_Font_t;
+
+//____________________________________________________________________GLOBAL VAR
+extern fontCvt_Builder_t builderMemory_Builder;
+
+//______________________________________________________________GLOBAL FUNCTIONS
+void builderMemory_Init (void);
+builderMemory_Font_t *builderMemory_Take (void *ctx);
+void builderMemory_Free (builderMemory_Font_t *font);
+const builderMemory_Character_t *builderMemory_Find (const builderMemory_Font_t *font, uint32_t unicode);
+int16_t builderMemory_GetKerning (const builderMemory_Font_t *font, const builderMemory_Character_t *left,
+	uint32_t right_unicode);
+
+#endif /* BUILDERMEMORY_H_INCLUDED */
@@ -0,0 +1,470 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* Metrics builder: the compact advance and kerning table of fontMetrics.h,
+for measuring text on a host. It keeps the 8 bit advances and kerning
+adjustments the C builder gives the device, so the host widths are the device
+ones. Use it with -m metrics, the glyphs are not rendered at all. The table is
+C source (OUTPUT.c and OUTPUT.h, with the table OUTPUT_Metrics), or with
+format=bin a binary file for fontMetrics_Load (OUTPUT.metrics.bin). */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "builderMetrics.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include "fontMetrics.h"
+#include "stats.h"
+
+#define L_MAX(a, b)           (((a) >= (b)) ? (a) : (b))
+
+typedef struct
+{	/* state of one export */
+	fontCvt_Font_t font;
+	bool bin; /* binary table rather than C source */
+	char name[256];
+	fontMetrics_Range_t *ranges;
+	uint32_t ranges_num;
+	uint32_t ranges_max;
+	uint8_t *advances;
+	uint32_t *kerning_index; /* one more entry than the characters */
+	uint32_t characters_num;
+	uint32_t advances_max;
+	uint32_t kerning_index_max;
+	fontMetrics_Kerning_t *kerning;
+	uint32_t kerning_num;
+	uint32_t kerning_max;
+	bool error; /* allocation fail, nothing is written */
+} Ctx_t;
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static void *Create (void);
+static void Destroy (void *context);
+static void StartFont (void *context, fontCvt_Font_t *font, const char *output, const char *options);
+static void StartRange (void *context, fontCvt_Range_t *range);
+static void StartCharacter (void *context, fontCvt_Character_t *character);
+static void PutKerning (void *context, fontCvt_Kerning_t *kerning);
+static void EndCharacter (void *context);
+static void EndRange (void *context);
+static void EndFont (void *context);
+
+static void WriteSource (Ctx_t *ctx);
+static void WriteBinary (Ctx_t *ctx);
+static void Put (FILE *f, uint32_t val, uint8_t bytes);
+static bool Grow (void **array, uint32_t *max, uint32_t num, uint32_t elem_size);
+static int CompareRight (const void *a, const void *b);
+static int CompareFirst (const void *a, const void *b);
+
+//____________________________________________________________________GLOBAL VAR
+fontCvt_Builder_t builderMetrics_Builder;
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Initialize the builer before it can be used.
+    Args:
+    Ret:
+*/
+void builderMetrics_Init (void)
+{
+	memset (&builderMetrics_Builder, 0, sizeof (builderMetrics_Builder));
+
+	builderMetrics_Builder.create = Create;
+	builderMetrics_Builder.destroy = Destroy;
+	builderMetrics_Builder.startFont = StartFont;
+	builderMetrics_Builder.startRange = StartRange;
+	builderMetrics_Builder.startCharacter = StartCharacter;
+	builderMetrics_Builder.putKerning = PutKerning;
+	builderMetrics_Builder.endCharacter = EndCharacter;
+	builderMetrics_Builder.endRange = EndRange;
+	builderMetrics_Builder.endFont = EndFont;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Allocate the context of an export.
+    Args:
+    Ret:
+the context, NULL on allocation fail.
+*/
+static void *Create (void)
+{
+	return calloc (1, sizeof (Ctx_t));
+}
+
+/* Release the context of an export and its tables.
+    Args:
+<context>[in] export context.
+    Ret:
+*/
+static void Destroy (void *context)
+{
+	Ctx_t *ctx = context;
+
+	free (ctx->ranges);
+	free (ctx->advances);
+	free (ctx->kerning_index);
+	free (ctx->kerning);
+	free (ctx);
+}
+
+/* Start a table. The only option is format=bin.
+    Args:
+<context>[in] export context.
+<font>[in] font.
+<output>[in] output name.
+<options>[in] comma separated options, can be NULL.
+    Ret:
+*/
+static void StartFont (void *context, fontCvt_Font_t *font, const char *output, const char *options)
+{
+	Ctx_t *ctx = context;
+
+	ctx->font = *font;
+	ctx->bin = false;
+	ctx->ranges_num = 0;
+	ctx->characters_num = 0;
+	ctx->kerning_num = 0;
+	ctx->error = false;
+	snprintf (ctx->name, sizeof (ctx->name), "%s", output);
+	if (options)
+	{
+		char copy[strlen (options) + 1];
+
+		strcpy (copy, options);
+		for (char *save, *option = strtok_r (copy, ",", &save); option; option = strtok_r (NULL, ",", &save))
+		{
+			if (!strcmp (option, "format=bin"))
+				ctx->bin = true;
+		}
+	}
+	printf ("exporting %s%s\n", output, ctx->bin ? ".metrics.bin" : "");
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void StartRange (void *context, fontCvt_Range_t *range)
+{
+	Ctx_t *ctx = context;
+
+	if (!Grow ((void **)&ctx->ranges, &ctx->ranges_max, ctx->ranges_num + 1, sizeof (fontMetrics_Range_t)))
+	{
+		ctx->error = true;
+		return;
+	}
+	ctx->ranges[ctx->ranges_num].first = range->first;
+	ctx->ranges[ctx->ranges_num].num_characters = range->last - range->first + 1;
+	ctx->ranges[ctx->ranges_num].characters = ctx->characters_num;
+	ctx->ranges_num++;
+}
+
+/* Add the advance of a character, as the 8 bit pxl_advance of the device.
+    Args:
+    Ret:
+*/
+static void StartCharacter (void *context, fontCvt_Character_t *character)
+{
+	Ctx_t *ctx = context;
+
+	if (!Grow ((void **)&ctx->advances, &ctx->advances_max, ctx->characters_num + 1, sizeof (uint8_t))
+	 || !Grow ((void **)&ctx->kerning_index, &ctx->kerning_index_max, ctx->characters_num + 2, sizeof (uint32_t)))
+	{
+		ctx->error = true;
+		return;
+	}
+	ctx->advances[ctx->characters_num] = (uint8_t)character->pxl_advance;
+	ctx->kerning_index[ctx->characters_num] = ctx->kerning_num;
+	ctx->characters_num++;
+}
+
+/* Add a pair of the current character, as the 8 bit pxl_adjust of the
+device.
+    Args:
+    Ret:
+*/
+static void PutKerning (void *context, fontCvt_Kerning_t *kerning)
+{
+	Ctx_t *ctx = context;
+
+	if (!Grow ((void **)&ctx->kerning, &ctx->kerning_max, ctx->kerning_num + 1, sizeof (fontMetrics_Kerning_t)))
+	{
+		ctx->error = true;
+		return;
+	}
+	ctx->kerning[ctx->kerning_num].right_ch = kerning->right_char;
+	ctx->kerning[ctx->kerning_num].pxl_adjust = (int8_t)kerning->x_pxl_adjust;
+	ctx->kerning_num++;
+}
+
+/* Sort the pairs of the character by right character, for the binary search
+of fontMetrics_Width.
+    Args:
+    Ret:
+*/
+static void EndCharacter (void *context)
+{
+	Ctx_t *ctx = context;
+	uint32_t first;
+
+	if (ctx->error || ctx->characters_num == 0)
+		return;
+	first = ctx->kerning_index[ctx->characters_num - 1];
+	qsort (&ctx->kerning[first], ctx->kerning_num - first, sizeof (fontMetrics_Kerning_t), CompareRight);
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void EndRange (void *context)
+{
+	(void)context;
+}
+
+/* Write the table.
+    Args:
+    Ret:
+*/
+static void EndFont (void *context)
+{
+	Ctx_t *ctx = context;
+
+	if (ctx->error)
+	{
+		fprintf (stderr, "metrics builder allocation fail\n");
+		return;
+	}
+	if (ctx->kerning_index == NULL
+	 && !Grow ((void **)&ctx->kerning_index, &ctx->kerning_index_max, 1, sizeof (uint32_t)))
+	{
+		fprintf (stderr, "metrics builder allocation fail\n");
+		return;
+	}
+	ctx->kerning_index[ctx->characters_num] = ctx->kerning_num;
+
+	/* sorted ranges without overlaps, for the binary search of fontMetrics:
+	an overlapping part has the same characters in both ranges */
+	qsort (ctx->ranges, ctx->ranges_num, sizeof (fontMetrics_Range_t), CompareFirst);
+	for (uint32_t k = 1, j = 0; k < ctx->ranges_num; k++)
+	{
+		fontMetrics_Range_t *last = &ctx->ranges[j];
+		fontMetrics_Range_t *range = &ctx->ranges[k];
+		uint64_t end = (uint64_t)last->first + last->num_characters;
+
+		if (range->first < end)
+		{
+			uint32_t skip = end - range->first;
+
+			if (skip >= range->num_characters)
+				range->num_characters = 0;
+			else
+			{
+				range->first += skip;
+				range->num_characters -= skip;
+				range->characters += skip;
+			}
+		}
+		if (range->num_characters)
+			ctx->ranges[++j] = *range;
+		if (k + 1 == ctx->ranges_num)
+			ctx->ranges_num = j + 1;
+	}
+	if (ctx->bin)
+		WriteBinary (ctx);
+	else
+		WriteSource (ctx);
+}
+
+/* Write the table as OUTPUT.c and OUTPUT.h.
+    Args:
+<ctx>[in] export context.
+    Ret:
+*/
+static void WriteSource (Ctx_t *ctx)
+{
+	char fname[300];
+	char upper_name[256] = { 0 };
+	FILE *f;
+
+	for (uint16_t k = 0; k < strlen (ctx->name); k++)
+		upper_name[k] = toupper (ctx->name[k]);
+	snprintf (fname, sizeof (fname), "%s.h", ctx->name);
+	if ((f = fopen (fname, "wb")) == NULL)
+	{
+		fprintf (stderr, "can't create %s\n", fname);
+		return;
+	}
+	fprintf (f, "#ifndef %s_H_INCLUDED\n", upper_name);
+	fprintf (f, "#define %s_H_INCLUDED\n\n", upper_name);
+	fprintf (f, "#include \"fontMetrics.h\"\n\n");
+	fprintf (f, "extern const fontMetrics_Font_t %s_Metrics;\n\n", ctx->name);
+	fprintf (f, "#endif // %s_H_INCLUDED\n", upper_name);
+	stats_Add (STATS_COUNTER_OUTPUT_BYTES, ftell (f));
+	fclose (f);
+
+	snprintf (fname, sizeof (fname), "%s.c", ctx->name);
+	if ((f = fopen (fname, "wb")) == NULL)
+	{
+		fprintf (stderr, "can't create %s\n", fname);
+		return;
+	}
+	fprintf (f, "#include \"fontMetrics.h\"\n\n");
+	if (ctx->ranges_num)
+	{
+		fprintf (f, "static const fontMetrics_Range_t Ranges[] =\n{\t// first, num_characters, characters\n");
+		for (uint32_t k = 0; k < ctx->ranges_num; k++)
+		{
+			fprintf (f, "\t{ %u, %u, %u },\n", ctx->ranges[k].first, ctx->ranges[k].num_characters,
+				ctx->ranges[k].characters);
+		}
+		fprintf (f, "};\n\n");
+	}
+	if (ctx->characters_num)
+	{
+		fprintf (f, "static const uint8_t Advances[] =\n{");
+		for (uint32_t k = 0; k < ctx->characters_num; k++)
+			fprintf (f, "%s%3u,", (k % 16) ? " " : "\n\t", ctx->advances[k]);
+		fprintf (f, "\n};\n\n");
+	}
+	fprintf (f, "static const uint32_t KerningIndex[] =\n{");
+	for (uint32_t k = 0; k <= ctx->characters_num; k++)
+		fprintf (f, "%s%u,", (k % 16) ? " " : "\n\t", ctx->kerning_index[k]);
+	fprintf (f, "\n};\n\n");
+	if (ctx->kerning_num)
+	{
+		fprintf (f, "static const fontMetrics_Kerning_t Kerning[] =\n{\t// right_ch, pxl_adjust\n");
+		for (uint32_t k = 0; k < ctx->kerning_num; k++)
+			fprintf (f, "\t{ 0x%04X, % 4d },\n", ctx->kerning[k].right_ch, ctx->kerning[k].pxl_adjust);
+		fprintf (f, "};\n\n");
+	}
+	fprintf (f, "const fontMetrics_Font_t %s_Metrics =\n{\n", ctx->name);
+	fprintf (f, "\t.pxl_baseline_to_baseline = %u,\n", (uint8_t)ctx->font.pxl_baseline_to_baseline);
+	fprintf (f, "\t.pxl_max_glyph_height = %u,\n", (uint8_t)ctx->font.pxl_max_glyph_height);
+	fprintf (f, "\t.num_ranges = %u,\n", ctx->ranges_num);
+	fprintf (f, "\t.num_characters = %u,\n", ctx->characters_num);
+	fprintf (f, "\t.num_kerning = %u,\n", ctx->kerning_num);
+	fprintf (f, "\t.ranges = %s,\n", ctx->ranges_num ? "Ranges" : "NULL");
+	fprintf (f, "\t.advances = %s,\n", ctx->characters_num ? "Advances" : "NULL");
+	fprintf (f, "\t.kerning_index = KerningIndex,\n");
+	fprintf (f, "\t.kerning = %s,\n", ctx->kerning_num ? "Kerning" : "NULL");
+	fprintf (f, "};\n");
+	stats_Add (STATS_COUNTER_OUTPUT_BYTES, ftell (f));
+	fclose (f);
+}
+
+/* Write the table as OUTPUT.metrics.bin, see fontMetrics.h.
+    Args:
+<ctx>[in] export context.
+    Ret:
+*/
+static void WriteBinary (Ctx_t *ctx)
+{
+	char fname[300];
+	FILE *f;
+
+	if (ctx->ranges_num > UINT16_MAX)
+	{
+		fprintf (stderr, "too many ranges for a metrics table\n");
+		return;
+	}
+	snprintf (fname, sizeof (fname), "%s.metrics.bin", ctx->name);
+	if ((f = fopen (fname, "wb")) == NULL)
+	{
+		fprintf (stderr, "can't create %s\n", fname);
+		return;
+	}
+	fwrite (FONTMETRICS_BIN_MAGIC, 1, 8, f);
+	Put (f, FONTMETRICS_BIN_VERSION, 2);
+	Put (f, (uint8_t)ctx->font.pxl_baseline_to_baseline, 1);
+	Put (f, (uint8_t)ctx->font.pxl_max_glyph_height, 1);
+	Put (f, ctx->ranges_num, 2);
+	Put (f, ctx->characters_num, 4);
+	Put (f, ctx->kerning_num, 4);
+	for (uint32_t k = 0; k < ctx->ranges_num; k++)
+	{
+		Put (f, ctx->ranges[k].first, 4);
+		Put (f, ctx->ranges[k].num_characters, 4);
+		Put (f, ctx->ranges[k].characters, 4);
+	}
+	fwrite (ctx->advances, 1, ctx->characters_num, f);
+	for (uint32_t k = 0; k <= ctx->characters_num; k++)
+		Put (f, ctx->kerning_index[k], 4);
+	for (uint32_t k = 0; k < ctx->kerning_num; k++)
+	{
+		Put (f, ctx->kerning[k].right_ch, 4);
+		Put (f, (uint8_t)ctx->kerning[k].pxl_adjust, 1);
+	}
+	stats_Add (STATS_COUNTER_OUTPUT_BYTES, ftell (f));
+	if (ferror (f))
+		fprintf (stderr, "can't write %s\n", fname);
+	fclose (f);
+}
+
+/* Write a little endian value. */
+static void Put (FILE *f, uint32_t val, uint8_t bytes)
+{
+	for (uint8_t k = 0; k < bytes; k++)
+		fputc ((val >> (8 * k)) & 0xFF, f);
+}
+
+/* Make room for num elements inside an array, doubling its size.
+    Args:
+<array>[in/out] array, moved when it grows.
+<max>[in/out] elements the array can hold.
+<num>[in] elements needed.
+<elem_size>[in] size of an element.
+    Ret:
+false on allocation fail.
+*/
+static bool Grow (void **array, uint32_t *max, uint32_t num, uint32_t elem_size)
+{
+	void *grown;
+	uint32_t new_max;
+
+	if (num <= *max && *array)
+		return true;
+	new_max = L_MAX (L_MAX (*max * 2, num), 64);
+	grown = realloc (*array, (size_t)new_max * elem_size);
+	if (grown == NULL)
+		return false;
+	*array = grown;
+	*max = new_max;
+	return true;
+}
+
+/* qsort comparison of two kerning pairs by right character. */
+static int CompareRight (const void *a, const void *b)
+{
+	uint32_t ra = ((const fontMetrics_Kerning_t *)a)->right_ch;
+	uint32_t rb = ((const fontMetrics_Kerning_t *)b)->right_ch;
+
+	return (ra > rb) - (ra < rb);
+}
+
+/* qsort comparison of two ranges by first character. */
+static int CompareFirst (const void *a, const void *b)
+{
+	uint32_t fa = ((const fontMetrics_Range_t *)a)->first;
+	uint32_t fb = ((const fontMetrics_Range_t *)b)->first;
+
+	return (fa > fb) - (fa < fb);
+}
@@ -0,0 +1,469 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Builder registry. Every builder is listed here with its name. The builders
+selected with -B name[:options] are fed by builderRegistry_FanOut: the export
+renders each glyph and computes each kerning pair once and the fan out passes
+it to every selected builder, in the order they were selected. Every selected
+builder has its own context, so a builder can be selected more than once (e.g.
+-B c -B c:format=bin,out=font_bin) and many exports can run at once.
+A builder can be selected at a bpp lower than the export one (-b 1,2,4): it
+gets the font with its own bpp and quantizes the same 8 bit bitmaps, the
+export renders each glyph once for all the depths. At 1 bpp it gets the mono
+variant of the characters, when the export renders it. */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "builderRegistry.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "builderForC.h"
+#include "builderForCpp.h"
+#include "builderMetrics.h"
+#include "builderReport.h"
+
+#define L_MAX_SELECTED        16
+
+typedef struct
+{
+	const char *name;
+	const char *help;
+	fontCvt_Builder_t *builder;
+	void (*init) (void);
+} Entry_t;
+
+typedef struct
+{
+	const Entry_t *entry;
+	void *ctx; /* builder context */
+	char *output; /* output name */
+	char *options; /* builder options */
+	uint8_t bpp; /* bpp of the builder, 0 for the export one */
+	bool mono; /* the builder takes the mono variant of the characters */
+} Selected_t;
+
+typedef struct
+{	/* fan out context: the builders selected for one export */
+	Selected_t selected[L_MAX_SELECTED];
+	uint8_t selected_num;
+	/* batch waiting for its kerning pairs */
+	fontCvt_Character_t *characters;
+	uint32_t characters_num;
+	/* mono variants of the batch (or of the current character) for the
+	builders with Selected_t.mono */
+	fontCvt_Character_t *monos;
+	uint32_t monos_num;
+	uint32_t monos_max;
+	fontCvt_Character_t mono;
+} FanOut_t;
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static void *Create (void);
+static void Destroy (void *context);
+static void StartFont (void *context, fontCvt_Font_t *font, const char *output, const char *options);
+static void StartRange (void *context, fontCvt_Range_t *range);
+static void StartCharacter (void *context, fontCvt_Character_t *character);
+static void PutKerning (void *context, fontCvt_Kerning_t *kerning);
+static void EndCharacter (void *context);
+static void EndRange (void *context);
+static void EndFont (void *context);
+static void PutCharacters (void *context, fontCvt_Character_t *characters, uint32_t num);
+static void PutKernings (void *context, fontCvt_Kerning_t *kernings, uint32_t num);
+static fontCvt_Character_t MonoVariant (const fontCvt_Character_t *character);
+
+//___________________________________________________________________PRIVATE VAR
+static const Entry_t Entries[] =
+{
+	{ "c", "C source and header, see fontBuilderForC.h. Options are the -j ones.",
+		&builderForC_Builder, builderForC_Init },
+	{ "cpp", "C++17 header with constexpr tables, see fontBuilderForCpp.hpp.",
+		&builderForCpp_Builder, builderForCpp_Init },
+	{ "report", "flash footprint report with what-if estimates, writes no file.",
+		&builderReport_Builder, builderReport_Init },
+	{ "metrics", "advance and kerning table for host text measurement, see fontMetrics.h.\n"
+		"        Default with -m metrics. Options: format=bin.",
+		&builderMetrics_Builder, builderMetrics_Init },
+};
+
+//____________________________________________________________________GLOBAL VAR
+fontCvt_Builder_t builderRegistry_FanOut;
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Initialize every builder and the fan out. Call it once, before starting
+any export.
+    Args:
+    Ret:
+*/
+void builderRegistry_Init (void)
+{
+	for (uint8_t k = 0; k < sizeof (Entries) / sizeof (Entries[0]); k++)
+		Entries[k].init ( );
+
+	memset (&builderRegistry_FanOut, 0, sizeof (builderRegistry_FanOut));
+	builderRegistry_FanOut.create = Create;
+	builderRegistry_FanOut.destroy = Destroy;
+	builderRegistry_FanOut.startFont = StartFont;
+	builderRegistry_FanOut.startRange = StartRange;
+	builderRegistry_FanOut.startCharacter = StartCharacter;
+	builderRegistry_FanOut.putKerning = PutKerning;
+	builderRegistry_FanOut.endCharacter = EndCharacter;
+	builderRegistry_FanOut.endRange = EndRange;
+	builderRegistry_FanOut.endFont = EndFont;
+	builderRegistry_FanOut.putCharacters = PutCharacters;
+	builderRegistry_FanOut.putKernings = PutKernings;
+}
+
+/* Select a builder for the export. The out=<name> option sets the output
+name of this builder, the other options are given to the builder.
+    Args:
+<fan_out>[in] fan out context of the export.
+<spec>[in] name[:options] of the builder.
+<output>[in] output name used when the options have no out=.
+<options>[in] options used when spec has none, can be NULL.
+<bpp>[in] bpp of the builder, 0 for the export one. Otherwise _<bpp>bpp is
+    appended to the output name, out= included.
+    Ret:
+false if the builder does not exist or can't be selected.
+*/
+bool builderRegistry_Select (void *fan_out, const char *spec, const char *output, const char *options, uint8_t bpp)
+{
+	FanOut_t *ctx = fan_out;
+	const char *colon = strchr (spec, ':');
+	size_t name_len = colon ? (size_t)(colon - spec) : strlen (spec);
+	const Entry_t *entry = NULL;
+	Selected_t *sel;
+
+	for (uint8_t k = 0; k < sizeof (Entries) / sizeof (Entries[0]); k++)
+	{
+		if (strlen (Entries[k].name) == name_len && !strncmp (Entries[k].name, spec, name_len))
+			entry = &Entries[k];
+	}
+	if (entry == NULL)
+	{
+		fprintf (stderr, "unknown builder %.*s\n", (int)name_len, spec);
+		return false;
+	}
+	if (ctx->selected_num == L_MAX_SELECTED)
+	{
+		fprintf (stderr, "too many builders\n");
+		return false;
+	}
+
+	sel = &ctx->selected[ctx->selected_num];
+	sel->entry = entry;
+	sel->ctx = entry->builder->create ( );
+	sel->output = strdup (output);
+	sel->options = NULL;
+	sel->bpp = bpp;
+	sel->mono = false;
+	if (colon)
+		options = colon + 1;
+	if (options)
+	{	/* take out=<name> away from the builder options */
+		char copy[strlen (options) + 1];
+		size_t len = 0;
+
+		strcpy (copy, options);
+		sel->options = calloc (strlen (options) + 1, 1);
+		for (char *save, *option = strtok_r (copy, ",", &save);
+		     option && sel->options;
+		     option = strtok_r (NULL, ",", &save))
+		{
+			if (!strncmp (option, "out=", 4))
+			{
+				free (sel->output);
+				sel->output = strdup (option + 4);
+			}
+			else
+				len += sprintf (sel->options + len, "%s%s", len ? "," : "", option);
+		}
+	}
+	if (bpp && sel->output)
+	{
+		char *name = malloc (strlen (sel->output) + sizeof ("_8bpp"));
+
+		if (name)
+			sprintf (name, "%s_%ubpp", sel->output, bpp);
+		free (sel->output);
+		sel->output = name;
+	}
+	/* count the builder in anyway, so that Destroy releases it */
+	ctx->selected_num++;
+	if (sel->ctx == NULL || sel->output == NULL || (options && sel->options == NULL))
+	{
+		fprintf (stderr, "builder allocation fail\n");
+		return false;
+	}
+	return true;
+}
+
+/* Number of builders selected on a fan out context. */
+uint8_t builderRegistry_SelectedNum (void *fan_out)
+{
+	return ((FanOut_t *)fan_out)->selected_num;
+}
+
+/* Print the list of the builders.
+    Args:
+<f>[in] destination file.
+    Ret:
+*/
+void builderRegistry_PrintHelp (FILE *f)
+{
+	for (uint8_t k = 0; k < sizeof (Entries) / sizeof (Entries[0]); k++)
+		fprintf (f, "      %s: %s\n", Entries[k].name, Entries[k].help);
+}
+
+/* Give a batch of characters to a builder, through its batched interface
+when it has one. Otherwise the batch is split into the per character calls:
+startCharacter, putKerning for each pair of the character and endCharacter.
+    Args:
+<builder>[in] builder.
+<ctx>[in] builder context.
+<characters>[in] characters of the batch.
+<characters_num>[in] number of characters.
+<kernings>[in] pairs of the batch, kerning_num of every character.
+<kernings_num>[in] number of pairs.
+    Ret:
+*/
+void builderRegistry_PutBatch (fontCvt_Builder_t *builder, void *ctx, fontCvt_Character_t *characters,
+	uint32_t characters_num, fontCvt_Kerning_t *kernings, uint32_t kernings_num)
+{
+	if (builder->putCharacters)
+	{
+		builder->putCharacters (ctx, characters, characters_num);
+		builder->putKernings (ctx, kernings, kernings_num);
+		return;
+	}
+
+	for (uint32_t k = 0; k < characters_num; k++)
+	{
+		builder->startCharacter (ctx, &characters[k]);
+		for (uint16_t j = 0; j < characters[k].kerning_num; j++)
+			builder->putKerning (ctx, kernings++);
+		builder->endCharacter (ctx);
+	}
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Allocate a fan out context with no builder selected.
+    Args:
+    Ret:
+the context, NULL on allocation fail.
+*/
+static void *Create (void)
+{
+	return calloc (1, sizeof (FanOut_t));
+}
+
+/* Release a fan out context and the contexts of its builders.
+    Args:
+<context>[in] fan out context.
+    Ret:
+*/
+static void Destroy (void *context)
+{
+	FanOut_t *ctx = context;
+
+	for (uint8_t k = 0; k < ctx->selected_num; k++)
+	{
+		Selected_t *sel = &ctx->selected[k];
+
+		if (sel->ctx)
+			sel->entry->builder->destroy (sel->ctx);
+		free (sel->output);
+		free (sel->options);
+	}
+	free (ctx->monos);
+	free (ctx);
+}
+
+/* Start the font on every selected builder, each with its own output name,
+options and bpp; the arguments of the export are ignored.
+    Args:
+    Ret:
+*/
+static void StartFont (void *context, fontCvt_Font_t *font, const char *output, const char *options)
+{
+	FanOut_t *ctx = context;
+
+	(void)output;
+	(void)options;
+	for (uint8_t k = 0; k < ctx->selected_num; k++)
+	{
+		Selected_t *sel = &ctx->selected[k];
+		fontCvt_Font_t sel_font = *font;
+
+		if (sel->bpp)
+			sel_font.bpp = sel->bpp;
+		sel->mono = (sel_font.bpp == 1 && font->bpp != 1);
+		sel->entry->builder->startFont (sel->ctx, &sel_font, sel->output, sel->options);
+	}
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void StartRange (void *context, fontCvt_Range_t *range)
+{
+	FanOut_t *ctx = context;
+
+	for (uint8_t k = 0; k < ctx->selected_num; k++)
+		ctx->selected[k].entry->builder->startRange (ctx->selected[k].ctx, range);
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void StartCharacter (void *context, fontCvt_Character_t *character)
+{
+	FanOut_t *ctx = context;
+
+	ctx->mono = MonoVariant (character);
+	for (uint8_t k = 0; k < ctx->selected_num; k++)
+	{
+		ctx->selected[k].entry->builder->startCharacter (ctx->selected[k].ctx,
+			ctx->selected[k].mono ? &ctx->mono : character);
+	}
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void PutKerning (void *context, fontCvt_Kerning_t *kerning)
+{
+	FanOut_t *ctx = context;
+
+	for (uint8_t k = 0; k < ctx->selected_num; k++)
+		ctx->selected[k].entry->builder->putKerning (ctx->selected[k].ctx, kerning);
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void EndCharacter (void *context)
+{
+	FanOut_t *ctx = context;
+
+	for (uint8_t k = 0; k < ctx->selected_num; k++)
+		ctx->selected[k].entry->builder->endCharacter (ctx->selected[k].ctx);
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void EndRange (void *context)
+{
+	FanOut_t *ctx = context;
+
+	for (uint8_t k = 0; k < ctx->selected_num; k++)
+		ctx->selected[k].entry->builder->endRange (ctx->selected[k].ctx);
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void EndFont (void *context)
+{
+	FanOut_t *ctx = context;
+
+	for (uint8_t k = 0; k < ctx->selected_num; k++)
+		ctx->selected[k].entry->builder->endFont (ctx->selected[k].ctx);
+}
+
+/* Keep the batch until its kerning pairs arrive: builders without the batched
+interface need both to be fed.
+    Args:
+    Ret:
+*/
+static void PutCharacters (void *context, fontCvt_Character_t *characters, uint32_t num)
+{
+	FanOut_t *ctx = context;
+
+	ctx->characters = characters;
+	ctx->characters_num = num;
+}
+
+/* Give the batch to every selected builder.
+    Args:
+    Ret:
+*/
+static void PutKernings (void *context, fontCvt_Kerning_t *kernings, uint32_t num)
+{
+	FanOut_t *ctx = context;
+
+	ctx->monos_num = 0;
+	for (uint8_t k = 0; k < ctx->selected_num; k++)
+	{
+		fontCvt_Character_t *characters = ctx->characters;
+
+		if (ctx->selected[k].mono && ctx->monos_num == 0 && ctx->characters_num)
+		{	/* the mono variants are made once for all the 1 bpp builders */
+			if (ctx->characters_num > ctx->monos_max)
+			{
+				fontCvt_Character_t *monos = realloc (ctx->monos, ctx->characters_num * sizeof (*monos));
+
+				if (monos == NULL)
+				{
+					fprintf (stderr, "builder allocation fail\n");
+					continue;
+				}
+				ctx->monos = monos;
+				ctx->monos_max = ctx->characters_num;
+			}
+			for (uint32_t j = 0; j < ctx->characters_num; j++)
+				ctx->monos[j] = MonoVariant (&ctx->characters[j]);
+			ctx->monos_num = ctx->characters_num;
+		}
+		if (ctx->selected[k].mono)
+			characters = ctx->monos;
+		builderRegistry_PutBatch (ctx->selected[k].entry->builder, ctx->selected[k].ctx,
+			characters, ctx->characters_num, kernings, num);
+	}
+	ctx->characters = NULL;
+	ctx->characters_num = 0;
+}
+
+/* The character as the 1 bpp builders get it: its mono variant when the
+export has one, with the character unicode and kerning.
+    Args:
+<character>[in] character.
+    Ret:
+the character to give to the 1 bpp builders.
+*/
+static fontCvt_Character_t MonoVariant (const fontCvt_Character_t *character)
+{
+	fontCvt_Character_t mono = *character;
+
+	if (character->mono)
+	{
+		mono = *character->mono;
+		mono.unicode = character->unicode;
+		mono.kerning_num = character->kerning_num;
+		mono.glyph_idx = character->glyph_idx;
+	}
+	mono.mono = NULL;
+	return mono;
+}
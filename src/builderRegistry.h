@@ -0,0 +1,40 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BUILDERREGISTRY_H_INCLUDED
+#define BUILDERREGISTRY_H_INCLUDED
+
+//____________________________________________________________INCLUDES - DEFINES
+#include <stdio.h>
+#include <stdbool.h>
+#include "fontCvt.h"
+
+//____________________________________________________________________GLOBAL VAR
+/* builder feeding every selected builder, give it to the export. The builders
+are selected on a context made by builderRegistry_FanOut.create */
+extern fontCvt_Builder_t builderRegistry_FanOut;
+
+//______________________________________________________________GLOBAL FUNCTIONS
+void builderRegistry_Init (void);
+bool builderRegistry_Select (void *fan_out, const char *spec, const char *output, const char *options, uint8_t bpp);
+uint8_t builderRegistry_SelectedNum (void *fan_out);
+void builderRegistry_PrintHelp (FILE *f);
+void builderRegistry_PutBatch (fontCvt_Builder_t *builder, void *ctx, fontCvt_Character_t *characters,
+	uint32_t characters_num, fontCvt_Kerning_t *kernings, uint32_t kernings_num);
+
+#endif /* BUILDERREGISTRY_H_INCLUDED */
@@ -0,0 +1,493 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Footprint report builder. It writes no output: it prints the flash the C
+builder output takes, section by section and range by range, and estimates
+how big the font would be at every bpp, with identical bitmaps stored once,
+with run length compressed bitmaps and with sparse ranges split. */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "builderReport.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#define L_MAX(a, b)           (((a) >= (b)) ? (a) : (b))
+
+/* sizes of the C builder structures (fontBuilderForC.h) on a 32 bit target */
+#define L_SIZEOF_CHARACTER    20
+#define L_SIZEOF_RANGE        12
+#define L_SIZEOF_KERNING      12
+#define L_SIZEOF_FONT         48
+
+#define L_NUM_BPP             4
+
+typedef struct
+{
+	uint32_t first;
+	uint32_t last;
+	uint32_t missing; /* characters without a glyph */
+	uint32_t bitmap_bytes; /* at the font bpp */
+	uint32_t kerning; /* pairs with the left character in this range */
+	uint32_t split_saving; /* descriptors bytes saved splitting the range */
+	int32_t split_ranges; /* ranges added splitting the range */
+} RangeReport_t;
+
+typedef struct
+{	/* what-if estimates at one bpp */
+	uint32_t bytes; /* plain bitmaps */
+	uint32_t dedup; /* identical bitmaps stored once */
+	uint32_t rle; /* run length compressed bitmaps */
+	uint32_t dedup_rle; /* both */
+	uint64_t *hashes; /* open addressing set of the stored bitmaps hashes */
+	uint32_t hashes_num;
+	uint32_t hashes_max;
+} BppReport_t;
+
+typedef struct
+{	/* state of one export */
+	BppReport_t bpp_reports[L_NUM_BPP];
+	RangeReport_t *ranges;
+	uint16_t ranges_num;
+	uint8_t bpp; /* font bpp */
+	bool outline; /* characters are outlines, no bpp estimates */
+	uint32_t outline_bytes;
+	uint32_t kerning_num;
+	uint32_t missing_run; /* missing characters in a row in the current range */
+	bool range_has_glyph; /* the current range has a glyph before missing_run */
+	uint16_t max_width, max_height; /* largest bitmap */
+	uint32_t max_packed; /* largest packed bitmap */
+	char name[256];
+} Ctx_t;
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static void *Create (void);
+static void Destroy (void *context);
+static void StartFont (void *context, fontCvt_Font_t *font, const char *output, const char *options);
+static void StartRange (void *context, fontCvt_Range_t *range);
+static void StartCharacter (void *context, fontCvt_Character_t *character);
+static void PutKerning (void *context, fontCvt_Kerning_t *kerning);
+static void EndCharacter (void *context);
+static void EndRange (void *context);
+static void EndFont (void *context);
+
+static void EstimateBitmap (BppReport_t *report, uint8_t bpp, fontCvt_Character_t *character);
+static bool HashInsert (BppReport_t *report, uint64_t hash);
+static uint32_t PackBitsSize (const uint8_t *data, uint32_t size);
+
+//___________________________________________________________________PRIVATE VAR
+static const uint8_t BppList[L_NUM_BPP] = { 1, 2, 4, 8 };
+
+//____________________________________________________________________GLOBAL VAR
+fontCvt_Builder_t builderReport_Builder;
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Initialize the builer before it can be used.
+    Args:
+    Ret:
+*/
+void builderReport_Init (void)
+{
+	memset (&builderReport_Builder, 0, sizeof (builderReport_Builder));
+
+	builderReport_Builder.create = Create;
+	builderReport_Builder.destroy = Destroy;
+	builderReport_Builder.startFont = StartFont;
+	builderReport_Builder.startRange = StartRange;
+	builderReport_Builder.startCharacter = StartCharacter;
+	builderReport_Builder.putKerning = PutKerning;
+	builderReport_Builder.endCharacter = EndCharacter;
+	builderReport_Builder.endRange = EndRange;
+	builderReport_Builder.endFont = EndFont;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Allocate the context of an export.
+    Args:
+    Ret:
+the context, NULL on allocation fail.
+*/
+static void *Create (void)
+{
+	return calloc (1, sizeof (Ctx_t));
+}
+
+/* Release the context of an export and the tables it still holds.
+    Args:
+<context>[in] export context.
+    Ret:
+*/
+static void Destroy (void *context)
+{
+	Ctx_t *ctx = context;
+
+	for (uint8_t k = 0; k < L_NUM_BPP; k++)
+		free (ctx->bpp_reports[k].hashes);
+	free (ctx->ranges);
+	free (ctx);
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void StartFont (void *context, fontCvt_Font_t *font, const char *output, const char *options)
+{
+	Ctx_t *ctx = context;
+
+	(void)options;
+	snprintf (ctx->name, sizeof (ctx->name), "%s", output);
+	ctx->bpp = font->bpp;
+	ctx->outline = font->outline;
+	ctx->outline_bytes = 0;
+	ctx->kerning_num = 0;
+	ctx->max_width = ctx->max_height = 0;
+	ctx->max_packed = 0;
+	free (ctx->ranges);
+	ctx->ranges = NULL;
+	ctx->ranges_num = 0;
+	for (uint8_t k = 0; k < L_NUM_BPP; k++)
+	{
+		free (ctx->bpp_reports[k].hashes);
+		memset (&ctx->bpp_reports[k], 0, sizeof (BppReport_t));
+	}
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void StartRange (void *context, fontCvt_Range_t *range)
+{
+	Ctx_t *ctx = context;
+	RangeReport_t *ranges;
+
+	ranges = realloc (ctx->ranges, sizeof (RangeReport_t) * (ctx->ranges_num + 1));
+	if (ranges == NULL)
+	{
+		fprintf (stderr, "report ranges allocation fail\n");
+		return;
+	}
+	ctx->ranges = ranges;
+	memset (&ctx->ranges[ctx->ranges_num], 0, sizeof (RangeReport_t));
+	ctx->ranges[ctx->ranges_num].first = range->first;
+	ctx->ranges[ctx->ranges_num].last = range->last;
+	ctx->ranges_num++;
+	ctx->missing_run = 0;
+	ctx->range_has_glyph = false;
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void StartCharacter (void *context, fontCvt_Character_t *character)
+{
+	Ctx_t *ctx = context;
+	RangeReport_t *range = &ctx->ranges[ctx->ranges_num - 1];
+
+	if (character->bmp_pxl_width == 0 && character->bmp_pxl_height == 0 && character->pxl_advance == 0)
+	{	/* no glyph: the descriptor is wasted */
+		range->missing++;
+		ctx->missing_run++;
+		return;
+	}
+
+	if (ctx->missing_run)
+	{	/* a hole before this glyph */
+		if (!ctx->range_has_glyph)
+			range->split_saving += ctx->missing_run * L_SIZEOF_CHARACTER; /* start the range later */
+		else if (ctx->missing_run * L_SIZEOF_CHARACTER > L_SIZEOF_RANGE)
+		{	/* split the range around the hole */
+			range->split_saving += ctx->missing_run * L_SIZEOF_CHARACTER - L_SIZEOF_RANGE;
+			range->split_ranges++;
+		}
+		ctx->missing_run = 0;
+	}
+	ctx->range_has_glyph = true;
+
+	ctx->max_width = L_MAX (ctx->max_width, character->bmp_pxl_width);
+	ctx->max_height = L_MAX (ctx->max_height, character->bmp_pxl_height);
+	if (ctx->outline)
+	{
+		range->bitmap_bytes += character->outline_sz;
+		ctx->outline_bytes += character->outline_sz;
+		ctx->max_packed = L_MAX (ctx->max_packed, character->outline_sz);
+		return;
+	}
+
+	for (uint8_t k = 0; k < L_NUM_BPP; k++)
+	{
+		EstimateBitmap (&ctx->bpp_reports[k], BppList[k], character);
+	}
+	{
+		uint32_t packed = ((character->bmp_pxl_width * ctx->bpp + 7) / 8) * character->bmp_pxl_height;
+
+		range->bitmap_bytes += packed;
+		ctx->max_packed = L_MAX (ctx->max_packed, packed);
+	}
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void PutKerning (void *context, fontCvt_Kerning_t *kerning)
+{
+	Ctx_t *ctx = context;
+
+	(void)kerning;
+	ctx->kerning_num++;
+	ctx->ranges[ctx->ranges_num - 1].kerning++;
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void EndCharacter (void *context)
+{
+	(void)context;
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void EndRange (void *context)
+{
+	Ctx_t *ctx = context;
+	RangeReport_t *range = &ctx->ranges[ctx->ranges_num - 1];
+
+	if (!ctx->range_has_glyph)
+	{	/* the range can be dropped */
+		range->split_saving = (range->last - range->first + 1) * L_SIZEOF_CHARACTER + L_SIZEOF_RANGE;
+		range->split_ranges = -1;
+	}
+	else
+		range->split_saving += ctx->missing_run * L_SIZEOF_CHARACTER; /* end the range earlier */
+}
+
+/* Function description.
+    Args:
+    Ret:
+*/
+static void EndFont (void *context)
+{
+	Ctx_t *ctx = context;
+	uint32_t characters = 0, bitmaps = 0, split_saving = 0;
+	int32_t split_ranges = 0;
+	uint32_t descriptors, ranges, kerning, fixed;
+
+	for (uint16_t r = 0; r < ctx->ranges_num; r++)
+	{
+		characters += ctx->ranges[r].last - ctx->ranges[r].first + 1;
+		bitmaps += ctx->ranges[r].bitmap_bytes;
+		split_saving += ctx->ranges[r].split_saving;
+		split_ranges += ctx->ranges[r].split_ranges;
+	}
+	descriptors = characters * L_SIZEOF_CHARACTER;
+	ranges = ctx->ranges_num * L_SIZEOF_RANGE;
+	kerning = ctx->kerning_num * L_SIZEOF_KERNING;
+	/* everything but the bitmaps */
+	fixed = descriptors + ranges + kerning + L_SIZEOF_FONT;
+
+	printf ("%s footprint (%s at %d bpp, 32 bit target)\n", ctx->name, ctx->outline ? "outlines" : "bitmaps", ctx->bpp);
+	printf ("  %-14s %10u\n", ctx->outline ? "outlines" : "bitmaps", bitmaps);
+	printf ("  %-14s %10u (%u characters)\n", "descriptors", descriptors, characters);
+	printf ("  %-14s %10u (%d ranges)\n", "ranges", ranges, ctx->ranges_num);
+	printf ("  %-14s %10u (%u pairs)\n", "kerning", kerning, ctx->kerning_num);
+	printf ("  %-14s %10u\n", "font", L_SIZEOF_FONT);
+	printf ("  %-14s %10u\n", "total", bitmaps + fixed);
+	printf ("  largest glyph %dx%d: %u bytes packed, %u bytes as 8 bpp render buffer\n",
+		ctx->max_width, ctx->max_height, ctx->max_packed, ctx->max_width * ctx->max_height);
+
+	printf ("\n  %-17s %8s %8s %12s %8s %8s\n", "range", "chars", "missing", "bitmaps", "descr", "kerning");
+	for (uint16_t r = 0; r < ctx->ranges_num; r++)
+	{
+		RangeReport_t *range = &ctx->ranges[r];
+		uint32_t chars = range->last - range->first + 1;
+
+		printf ("  0x%06X-0x%06X %8u %8u %12u %8u %8u\n", range->first, range->last, chars, range->missing,
+			range->bitmap_bytes, chars * L_SIZEOF_CHARACTER, range->kerning * L_SIZEOF_KERNING);
+	}
+
+	if (!ctx->outline)
+	{
+		printf ("\n  %-22s", "what-if total bytes");
+		for (uint8_t k = 0; k < L_NUM_BPP; k++)
+		{	/* depths above the render one are marked as estimates */
+			char head[16];
+
+			snprintf (head, sizeof (head), "%s%d bpp", (BppList[k] > ctx->bpp) ? "~" : "", BppList[k]);
+			printf (" %13s", head);
+		}
+		printf ("\n  %-22s", "plain");
+		for (uint8_t k = 0; k < L_NUM_BPP; k++)
+			printf (" %13u", ctx->bpp_reports[k].bytes + fixed);
+		printf ("\n  %-22s", "dedup");
+		for (uint8_t k = 0; k < L_NUM_BPP; k++)
+			printf (" %13u", ctx->bpp_reports[k].dedup + fixed);
+		printf ("\n  %-22s", "rle");
+		for (uint8_t k = 0; k < L_NUM_BPP; k++)
+			printf (" %13u", ctx->bpp_reports[k].rle + fixed);
+		printf ("\n  %-22s", "dedup + rle");
+		for (uint8_t k = 0; k < L_NUM_BPP; k++)
+			printf (" %13u", ctx->bpp_reports[k].dedup_rle + fixed);
+		printf ("\n");
+		if (ctx->bpp < 8)
+			printf ("  (~: estimated from the %d bpp render, export with -b 8 for exact figures)\n", ctx->bpp);
+	}
+	printf ("  sparse range splitting: %+d ranges, saves %u bytes\n", split_ranges, split_saving);
+
+	for (uint8_t k = 0; k < L_NUM_BPP; k++)
+	{
+		free (ctx->bpp_reports[k].hashes);
+		ctx->bpp_reports[k].hashes = NULL;
+	}
+	free (ctx->ranges);
+	ctx->ranges = NULL;
+	ctx->ranges_num = 0;
+}
+
+/* Pack a character bitmap at the given bpp and account it in the estimates.
+    Args:
+<report>[in] estimates at this bpp.
+<bpp>[in] bit per pixel.
+<character>[in] character.
+    Ret:
+*/
+static void EstimateBitmap (BppReport_t *report, uint8_t bpp, fontCvt_Character_t *character)
+{
+	uint16_t row_bytes = (character->bmp_pxl_width * bpp + 7) / 8;
+	uint32_t size = row_bytes * character->bmp_pxl_height;
+	uint64_t hash = 14695981039346656037ull; /* FNV-1a */
+	uint8_t *packed;
+	uint32_t rle;
+
+	if (size == 0)
+		return;
+	packed = calloc (size, 1);
+	if (packed == NULL)
+		return;
+
+	for (uint16_t y = 0; y < character->bmp_pxl_height; y++)
+	{
+		for (uint16_t x = 0; x < character->bmp_pxl_width; x++)
+		{
+			uint8_t val = (uint8_t)character->bmp[x + y * character->bmp_pxl_width] >> (8 - bpp);
+			uint32_t bit = x * bpp;
+
+			packed[y * row_bytes + bit / 8] |= val << (8 - bpp - bit % 8);
+		}
+	}
+
+	/* identical bitmaps must have identical size too */
+	hash = (hash ^ character->bmp_pxl_width) * 1099511628211ull;
+	hash = (hash ^ character->bmp_pxl_height) * 1099511628211ull;
+	for (uint32_t k = 0; k < size; k++)
+		hash = (hash ^ packed[k]) * 1099511628211ull;
+
+	rle = PackBitsSize (packed, size);
+	report->bytes += size;
+	report->rle += rle;
+	if (HashInsert (report, hash))
+	{
+		report->dedup += size;
+		report->dedup_rle += rle;
+	}
+	free (packed);
+}
+
+/* Insert a hash in the set of the stored bitmaps.
+    Args:
+<report>[in] estimates holding the set.
+<hash>[in] bitmap hash, never 0.
+    Ret:
+true if the hash was not in the set yet.
+*/
+static bool HashInsert (BppReport_t *report, uint64_t hash)
+{
+	uint32_t slot;
+
+	hash |= 1; /* 0 marks the empty slots */
+	if (report->hashes_num * 2 >= report->hashes_max)
+	{	/* keep the set half empty */
+		uint64_t *old = report->hashes;
+		uint32_t old_max = report->hashes_max;
+
+		report->hashes_max = old_max ? old_max * 2 : 1024;
+		report->hashes = calloc (report->hashes_max, sizeof (uint64_t));
+		if (report->hashes == NULL)
+		{
+			report->hashes = old;
+			report->hashes_max = old_max;
+			return true;
+		}
+		report->hashes_num = 0;
+		for (uint32_t k = 0; k < old_max; k++)
+			if (old[k])
+				HashInsert (report, old[k]);
+		free (old);
+	}
+
+	for (slot = hash % report->hashes_max; report->hashes[slot]; slot = (slot + 1) % report->hashes_max)
+		if (report->hashes[slot] == hash)
+			return false;
+	report->hashes[slot] = hash;
+	report->hashes_num++;
+	return true;
+}
+
+/* Size of the data compressed with PackBits: runs of 2 to 128 identical bytes
+take 2 bytes, literal runs of up to 128 bytes take 1 byte more than their size.
+    Args:
+<data>[in] data.
+<size>[in] data size.
+    Ret:
+the compressed size.
+*/
+static uint32_t PackBitsSize (const uint8_t *data, uint32_t size)
+{
+	uint32_t out = 0;
+	uint32_t literal = 0; /* pending literal bytes */
+
+	for (uint32_t k = 0; k < size; )
+	{
+		uint32_t run = 1;
+
+		while (k + run < size && run < 128 && data[k + run] == data[k])
+			run++;
+		if (run >= 2)
+		{
+			if (literal)
+				out += literal + (literal + 127) / 128;
+			literal = 0;
+			out += 2;
+		}
+		else
+			literal++;
+		k += run;
+	}
+	if (literal)
+		out += literal + (literal + 127) / 128;
+	return out;
+}
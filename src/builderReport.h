@@ -0,0 +1,31 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BUILDERREPORT_H_INCLUDED
+#define BUILDERREPORT_H_INCLUDED
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "fontCvt.h"
+
+//____________________________________________________________________GLOBAL VAR
+extern fontCvt_Builder_t builderReport_Builder;
+
+//______________________________________________________________GLOBAL FUNCTIONS
+void builderReport_Init (void);
+
+#endif /* BUILDERREPORT_H_INCLUDED */
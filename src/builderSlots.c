@@ -0,0 +1,121 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* Glyph slots of the builders storing the bitmap of a glyph once: a hash
+table by glyph index, with linear probing. The builders keep their own data
+in the slot, after the glyph index. */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "builderSlots.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define L_MAX(a, b)           (((a) >= (b)) ? (a) : (b))
+#define L_SLOT(table, k)      ((table)->slots + (size_t)(k) * (table)->slot_size)
+#define L_GLYPH_IDX(slot)     (*(const uint32_t *)(slot))
+
+//____________________________________________________________PRIVATE PROTOTYPES
+
+//___________________________________________________________________PRIVATE VAR
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Initialize an empty table, allocated by the first builderSlots_Find.
+    Args:
+<table>[out] table.
+<slot_size>[in] bytes of a slot, starting with its uint32_t glyph index.
+    Ret:
+*/
+void builderSlots_Init (builderSlots_Table_t *table, size_t slot_size)
+{
+	table->slots = NULL;
+	table->slot_size = slot_size;
+	table->num = 0;
+	table->max = 0;
+}
+
+/* Free every slot, keeping the memory for the next export.
+    Args:
+<table>[in] table.
+    Ret:
+*/
+void builderSlots_Clear (builderSlots_Table_t *table)
+{
+	table->num = 0;
+	if (table->slots)
+		memset (table->slots, 0, (size_t)table->max * table->slot_size);
+}
+
+/* Release the memory of a table.
+    Args:
+<table>[in] table.
+    Ret:
+*/
+void builderSlots_Free (builderSlots_Table_t *table)
+{
+	free (table->slots);
+	builderSlots_Init (table, table->slot_size);
+}
+
+/* Look for the slot of a glyph, growing the table when it is half full. A
+free slot returned is used filling it and counting it in table->num.
+    Args:
+<table>[in] table.
+<glyph_idx>[in] glyph index, not 0.
+    Ret:
+the slot of the glyph, free (glyph index 0) if no character wrote it yet.
+NULL on allocation fail.
+*/
+void *builderSlots_Find (builderSlots_Table_t *table, uint32_t glyph_idx)
+{
+	uint32_t k;
+
+	if (2 * (table->num + 1) > table->max)
+	{	/* rehash in a table twice as big */
+		uint32_t max = L_MAX (table->max * 2, 256);
+		uint8_t *slots = calloc (max, table->slot_size);
+
+		if (slots == NULL)
+			return NULL;
+		for (uint32_t j = 0; j < table->max; j++)
+		{
+			const uint8_t *slot = L_SLOT (table, j);
+
+			if (L_GLYPH_IDX (slot) == 0)
+				continue;
+			for (k = L_GLYPH_IDX (slot) * 2654435761u & (max - 1);
+			     L_GLYPH_IDX (slots + (size_t)k * table->slot_size);
+			     k = (k + 1) & (max - 1))
+				;
+			memcpy (slots + (size_t)k * table->slot_size, slot, table->slot_size);
+		}
+		free (table->slots);
+		table->slots = slots;
+		table->max = max;
+	}
+
+	for (k = glyph_idx * 2654435761u & (table->max - 1);
+	     L_GLYPH_IDX (L_SLOT (table, k)) && L_GLYPH_IDX (L_SLOT (table, k)) != glyph_idx;
+	     k = (k + 1) & (table->max - 1))
+		;
+	return L_SLOT (table, k);
+}
@@ -0,0 +1,45 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BUILDERSLOTS_H_INCLUDED
+#define BUILDERSLOTS_H_INCLUDED
+
+//____________________________________________________________INCLUDES - DEFINES
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct
+{	/* bitmaps written so far by glyph index, open addressing: the characters
+	mapped to the same glyph share one bitmap. A slot is a structure of the
+	builder starting with the uint32_t glyph index, 0 for a free slot */
+	uint8_t *slots;
+	size_t slot_size;
+	uint32_t num; /* slots in use */
+	uint32_t max; /* power of two */
+} builderSlots_Table_t;
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+void builderSlots_Init (builderSlots_Table_t *table, size_t slot_size);
+void builderSlots_Clear (builderSlots_Table_t *table);
+void builderSlots_Free (builderSlots_Table_t *table);
+void *builderSlots_Find (builderSlots_Table_t *table, uint32_t glyph_idx);
+
+#endif /* BUILDERSLOTS_H_INCLUDED */
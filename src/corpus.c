@@ -0,0 +1,280 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Character and character pair frequencies of a text corpus: the strings
+the firmware shows, in UTF-8. They weigh the characters and the kerning pairs
+when a font has to be trimmed. */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "corpus.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define L_MIN(a, b)           (((a) <= (b)) ? (a) : (b))
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static uint32_t NextUnicode (const uint8_t **text);
+static int ComparePair (const void *a, const void *b);
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Count the characters and the pairs of consecutive characters of UTF-8
+text files.
+    Args:
+<fnames>[in] text files.
+<fnames_num>[in] number of files.
+    Ret:
+the corpus, free it with corpus_Free. NULL if a file can't be read or on
+allocation fail.
+*/
+corpus_Corpus_t *corpus_Load (const char *const *fnames, uint16_t fnames_num)
+{
+	corpus_Corpus_t *corpus = calloc (1, sizeof (corpus_Corpus_t));
+	/* every character of the texts, unicode << 32 | position */
+	uint64_t *all = NULL;
+	uint64_t *pairs = NULL; /* every pair, left << 32 | right */
+	uint64_t num = 0, pairs_num = 0;
+	bool ok = (corpus != NULL);
+
+	for (uint16_t j = 0; j < fnames_num && ok; j++)
+	{
+		uint8_t *data = NULL;
+		long size = 0;
+		FILE *f = fopen (fnames[j], "rb");
+
+		ok = (f != NULL) && fseek (f, 0, SEEK_END) == 0 && (size = ftell (f)) >= 0 && fseek (f, 0, SEEK_SET) == 0
+		  && (data = malloc (size + 1)) != NULL && fread (data, 1, size, f) == (size_t)size;
+		if (ok)
+		{	/* a character takes at least one byte */
+			uint64_t *grown_all = realloc (all, sizeof (uint64_t) * (num + size + 1));
+			uint64_t *grown_pairs = realloc (pairs, sizeof (uint64_t) * (pairs_num + size + 1));
+
+			all = grown_all ? grown_all : all;
+			pairs = grown_pairs ? grown_pairs : pairs;
+			ok = grown_all && grown_pairs;
+		}
+		if (ok)
+		{
+			const uint8_t *text = data;
+			uint32_t prev = 0; /* pairs don't cross the files */
+
+			data[size] = 0;
+			while (text < data + size)
+			{
+				uint32_t unicode = NextUnicode (&text);
+
+				if (unicode == 0)
+				{	/* a 0 byte or a cut sequence, skip it */
+					text++;
+					prev = 0;
+					continue;
+				}
+				all[num] = (uint64_t)unicode << 32 | L_MIN (num, UINT32_MAX);
+				num++;
+				if (prev)
+					pairs[pairs_num++] = (uint64_t)prev << 32 | unicode;
+				prev = unicode;
+			}
+		}
+		else
+			fprintf (stderr, "can't read the corpus %s\n", fnames[j]);
+		if (f)
+			fclose (f);
+		free (data);
+	}
+
+	if (ok)
+	{
+		qsort (all, num, sizeof (uint64_t), ComparePair);
+		qsort (pairs, pairs_num, sizeof (uint64_t), ComparePair);
+		corpus->unicodes = malloc (sizeof (uint32_t) * (num + 1));
+		corpus->counts = malloc (sizeof (uint64_t) * (num + 1));
+		corpus->firsts = malloc (sizeof (uint32_t) * (num + 1));
+		corpus->pairs = malloc (sizeof (uint64_t) * (pairs_num + 1));
+		corpus->pair_counts = malloc (sizeof (uint64_t) * (pairs_num + 1));
+		ok = corpus->unicodes && corpus->counts && corpus->firsts && corpus->pairs && corpus->pair_counts;
+		if (!ok)
+			fprintf (stderr, "corpus allocation fail\n");
+	}
+	for (uint64_t k = 0; k < num && ok; k++)
+	{
+		if (corpus->num == 0 || corpus->unicodes[corpus->num - 1] != all[k] >> 32)
+		{	/* the first of a character is where it occurs first */
+			corpus->unicodes[corpus->num] = all[k] >> 32;
+			corpus->firsts[corpus->num] = all[k] & UINT32_MAX;
+			corpus->counts[corpus->num++] = 0;
+		}
+		corpus->counts[corpus->num - 1]++;
+	}
+	for (uint64_t k = 0; k < pairs_num && ok; k++)
+	{
+		if (corpus->pairs_num == 0 || corpus->pairs[corpus->pairs_num - 1] != pairs[k])
+		{
+			corpus->pairs[corpus->pairs_num] = pairs[k];
+			corpus->pair_counts[corpus->pairs_num++] = 0;
+		}
+		corpus->pair_counts[corpus->pairs_num - 1]++;
+	}
+	free (all);
+	free (pairs);
+	if (!ok)
+	{
+		corpus_Free (corpus);
+		return NULL;
+	}
+	corpus->total = num;
+	corpus->pairs_total = pairs_num;
+	return corpus;
+}
+
+/* Release a corpus. */
+void corpus_Free (corpus_Corpus_t *corpus)
+{
+	if (corpus == NULL)
+		return;
+	free (corpus->unicodes);
+	free (corpus->counts);
+	free (corpus->firsts);
+	free (corpus->pairs);
+	free (corpus->pair_counts);
+	free (corpus);
+}
+
+/* Occurrences of a character in the corpus.
+    Args:
+<corpus>[in] corpus.
+<unicode>[in] character.
+    Ret:
+how many times the character occurs, 0 if it doesn't.
+*/
+uint64_t corpus_Count (const corpus_Corpus_t *corpus, uint32_t unicode)
+{
+	uint32_t lo = 0, hi = corpus->num;
+
+	while (lo < hi)
+	{
+		uint32_t mid = (lo + hi) / 2;
+
+		if (corpus->unicodes[mid] == unicode)
+			return corpus->counts[mid];
+		if (corpus->unicodes[mid] < unicode)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return 0;
+}
+
+/* Position of the first occurrence of a character in the corpus.
+    Args:
+<corpus>[in] corpus.
+<unicode>[in] character.
+    Ret:
+the position in characters, UINT32_MAX if the character doesn't occur.
+*/
+uint32_t corpus_First (const corpus_Corpus_t *corpus, uint32_t unicode)
+{
+	uint32_t lo = 0, hi = corpus->num;
+
+	while (lo < hi)
+	{
+		uint32_t mid = (lo + hi) / 2;
+
+		if (corpus->unicodes[mid] == unicode)
+			return corpus->firsts[mid];
+		if (corpus->unicodes[mid] < unicode)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return UINT32_MAX;
+}
+
+/* Occurrences of a pair of consecutive characters in the corpus.
+    Args:
+<corpus>[in] corpus.
+<left>[in] first character.
+<right>[in] character following it.
+    Ret:
+how many times the pair occurs, 0 if it doesn't.
+*/
+uint64_t corpus_PairCount (const corpus_Corpus_t *corpus, uint32_t left, uint32_t right)
+{
+	uint64_t pair = (uint64_t)left << 32 | right;
+	uint32_t lo = 0, hi = corpus->pairs_num;
+
+	while (lo < hi)
+	{
+		uint32_t mid = (lo + hi) / 2;
+
+		if (corpus->pairs[mid] == pair)
+			return corpus->pair_counts[mid];
+		if (corpus->pairs[mid] < pair)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return 0;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Decode the next UTF-8 character and advance the text, as NextUnicode of
+fontBuilderForCpp.hpp does. A sequence cut by the end of the text ends it.
+    Args:
+<text>[in/out] text.
+    Ret:
+the unicode character, 0 at the end of the text.
+*/
+static uint32_t NextUnicode (const uint8_t **text)
+{
+	const uint8_t *t = *text;
+	uint32_t unicode = t[0];
+	uint8_t len = 1;
+
+	if (unicode < 0x80)
+	{	/* most of the text */
+		*text += (unicode != 0);
+		return unicode;
+	}
+	if (t[0] >= 0xF0)
+		unicode = t[0] & 0x07, len = 4;
+	else if (t[0] >= 0xE0)
+		unicode = t[0] & 0x0F, len = 3;
+	else
+		unicode = t[0] & 0x1F, len = 2;
+	for (uint8_t k = 1; k < len; k++)
+	{
+		if (t[k] == 0)
+			return 0;
+		unicode = (unicode << 6) | (t[k] & 0x3F);
+	}
+	if (unicode)
+		*text += len;
+	return unicode;
+}
+
+/* qsort compare function of two 64 bit keys: characters with their position
+or character pairs. */
+static int ComparePair (const void *a, const void *b)
+{
+	uint64_t pa = *(const uint64_t *)a, pb = *(const uint64_t *)b;
+
+	return (pa > pb) - (pa < pb);
+}
@@ -0,0 +1,49 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORPUS_H_INCLUDED
+#define CORPUS_H_INCLUDED
+
+//____________________________________________________________INCLUDES - DEFINES
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{	/* how many times each character and each pair of consecutive characters
+	occur in UTF-8 texts */
+	uint32_t *unicodes; /* sorted */
+	uint64_t *counts;
+	uint32_t *firsts; /* position of the first occurrence, in characters */
+	uint32_t num;
+	uint64_t total; /* characters of the text */
+	uint64_t *pairs; /* left << 32 | right, sorted */
+	uint64_t *pair_counts;
+	uint32_t pairs_num;
+	uint64_t pairs_total; /* pairs of the text */
+} corpus_Corpus_t;
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+corpus_Corpus_t *corpus_Load (const char *const *fnames, uint16_t fnames_num);
+void corpus_Free (corpus_Corpus_t *corpus);
+uint64_t corpus_Count (const corpus_Corpus_t *corpus, uint32_t unicode);
+uint32_t corpus_First (const corpus_Corpus_t *corpus, uint32_t unicode);
+uint64_t corpus_PairCount (const corpus_Corpus_t *corpus, uint32_t left, uint32_t right);
+
+#endif /* CORPUS_H_INCLUDED */
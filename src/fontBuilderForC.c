@@ -0,0 +1,449 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Runtime helpers for the fonts produced by the C builder. This file is meant
+to be compiled together with the generated fonts on the target. It uses integer
+arithmetic only. */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "fontBuilderForC.h"
+
+#include <string.h>
+
+#define L_MIN(a, b)           (((a) <= (b)) ? (a) : (b))
+#define L_MAX(a, b)           (((a) >= (b)) ? (a) : (b))
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static uint8_t GetPixel (const uint8_t *bmp, uint16_t row_bytes, uint8_t bpp, uint16_t x, uint16_t y);
+static void DrawLine (int32_t *acc, uint16_t w, uint16_t h, int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+static int16_t ReadInt16 (const uint8_t *src);
+
+//___________________________________________________________________PRIVATE VAR
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Look for the character descriptor of a unicode character.
+    Args:
+<font>[in] font.
+<unicode>[in] unicode character.
+    Ret:
+the character descriptor or NULL if the character is not inside the font.
+*/
+const FONTBUILDERFORC_TYPE_CHARACTER *fontBuilderForC_FindCharacter (const FONTBUILDERFORC_TYPE_FONT *font, uint32_t unicode)
+{
+	for (uint16_t k = 0; k < font->num_ranges; k++)
+	{
+		const FONTBUILDERFORC_TYPE_RANGE *range = &font->ranges[k];
+
+		if (unicode >= range->first && unicode - range->first < range->num_characters)
+			return &range->characters[unicode - range->first];
+	}
+	return NULL;
+}
+
+/* Look for the kerning between two characters.
+    Args:
+<font>[in] font.
+<left>[in] descriptor of the left character.
+<left_unicode>[in] unicode of the left character.
+<right_unicode>[in] unicode of the right character.
+    Ret:
+the pixels to move the cursor before drawing the right character, 0 if the
+pair has no kerning.
+*/
+int16_t fontBuilderForC_GetKerning (const FONTBUILDERFORC_TYPE_FONT *font, const FONTBUILDERFORC_TYPE_CHARACTER *left,
+	uint32_t left_unicode, uint32_t right_unicode)
+{
+	/* the pairs of a left character are contiguous and start at its
+	   kerning_index */
+	for (uint32_t k = left->kerning_index; k < font->num_kerning && font->kerning[k].left_ch == left_unicode; k++)
+	{
+		if (font->kerning[k].right_ch == right_unicode)
+			return font->kerning[k].pxl_adjust;
+	}
+	return 0;
+}
+
+/* Copy a character bitmap to a frame buffer. COVERAGE bitmaps are expanded to
+8 bit coverage, one byte per pixel, and merged keeping the highest coverage
+so that kerned glyphs can overlap; blend the buffer with your colors. Pre-
+blended bitmaps are copied as native pixels, two bytes for RGB565, one for
+RGB332 and L8, through the palette if the font has one.
+    Args:
+<font>[in] font with COVERAGE, RGB565, RGB332 or L8 bitmaps in array, atlas
+    pages are supported. Other fonts are ignored.
+<character>[in] character to draw.
+<dst>[out] frame buffer address of the top left corner of the bitmap.
+<dst_stride>[in] bytes per frame buffer row.
+    Ret:
+*/
+void fontBuilderForC_Blit (const FONTBUILDERFORC_TYPE_FONT *font, const FONTBUILDERFORC_TYPE_CHARACTER *character,
+	uint8_t *dst, uint16_t dst_stride)
+{
+	const uint8_t *bmp;
+	uint8_t bpp = character->bpp ? character->bpp : font->bpp;
+	uint16_t w = character->bmp_pxl_width;
+	uint16_t row_bytes = (w * bpp + 7) / 8;
+	uint16_t ox = 0, oy = 0; /* bitmap position inside the atlas page */
+	uint8_t pxl_bytes = (font->pixel_format == FONTBUILDERFORC_PIXFMT_RGB565) ? 2 : 1;
+
+	if (font->bitmaps_table_storage != FONTBUILDERFORC_BITMAPS_IN_ARRAY
+	 || font->pixel_format == FONTBUILDERFORC_PIXFMT_SDF
+	 || font->pixel_format == FONTBUILDERFORC_PIXFMT_OUTLINE)
+		return;
+	bmp = (const uint8_t *)font->bitmaps_table;
+	if (font->num_atlas_pages)
+	{
+		row_bytes = (font->atlas_pxl_width * bpp + 7) / 8;
+		bmp += FONTBUILDERFORC_ATLAS_PAGE (character->bmp_offset) * row_bytes * font->atlas_pxl_height;
+		ox = FONTBUILDERFORC_ATLAS_X (character->bmp_offset);
+		oy = FONTBUILDERFORC_ATLAS_Y (character->bmp_offset);
+	}
+	else
+		bmp += character->bmp_offset;
+	bmp += oy * row_bytes;
+
+	for (uint16_t y = 0; y < character->bmp_pxl_height; y++, bmp += row_bytes, dst += dst_stride)
+	{
+		if (font->pixel_format != FONTBUILDERFORC_PIXFMT_COVERAGE && font->palette == NULL)
+		{	/* native pixels, bitmap rows are whole bytes */
+			memcpy (dst, bmp + ox * pxl_bytes, w * pxl_bytes);
+			continue;
+		}
+		for (uint16_t x = 0; x < w; x++)
+		{
+			uint32_t bit = (uint32_t)(ox + x) * bpp;
+			uint8_t val = (bmp[bit / 8] >> (8 - bpp - bit % 8)) & ((1 << bpp) - 1);
+
+			if (font->pixel_format == FONTBUILDERFORC_PIXFMT_COVERAGE)
+			{	/* 255 / (2^bpp - 1) is exact for 1, 2, 4 and 8 bpp */
+				val *= 255 / ((1 << bpp) - 1);
+				dst[x] = L_MAX (dst[x], val);
+			}
+			else if (pxl_bytes == 2)
+			{
+				dst[2 * x] = font->palette[val];
+				dst[2 * x + 1] = font->palette[val] >> 8;
+			}
+			else
+				dst[x] = font->palette[val];
+		}
+	}
+}
+
+/* Render a signed distance field glyph at the given pixel size. The distance
+field is sampled with bilinear interpolation and turned into 8 bit coverage
+by a threshold or a smoothstep over one destination pixel.
+    Args:
+<font>[in] font with FONTBUILDERFORC_PIXFMT_SDF bitmaps in array, atlas pages
+    are supported.
+<character>[in] character to render.
+<pxl_size>[in] destination pixel size.
+<smooth>[in] 0 for a plain threshold (1 bpp look), anything else to
+    anti-alias with a smoothstep.
+<dst>[out] destination 8 bpp coverage bitmap, 'scaled->bmp_pxl_width' bytes
+    per row. Can be NULL to get the scaled metrics only.
+<scaled>[out] the character metrics at the destination size.
+    Ret:
+*/
+void fontBuilderForC_SdfRender (const FONTBUILDERFORC_TYPE_FONT *font, const FONTBUILDERFORC_TYPE_CHARACTER *character,
+	uint16_t pxl_size, uint8_t smooth, uint8_t *dst, FONTBUILDERFORC_TYPE_METRICS *scaled)
+{
+	const uint8_t *bmp; /* source distance field */
+	uint8_t lut[256]; /* 8 bit distance to coverage */
+	uint16_t src_w = character->bmp_pxl_width;
+	uint16_t src_h = character->bmp_pxl_height;
+	uint16_t row_bytes = (src_w * font->bpp + 7) / 8;
+	uint8_t bpp = font->bpp;
+	uint16_t ox = 0, oy = 0; /* bitmap position inside the atlas page */
+	/* destination to source coordinates ratio (16.16 fixed point) */
+	uint32_t inv_q16 = ((uint32_t)font->pxl_ref_size << 16) / pxl_size;
+
+	scaled->bmp_pxl_width = (src_w * pxl_size + font->pxl_ref_size - 1) / font->pxl_ref_size;
+	scaled->bmp_pxl_height = (src_h * pxl_size + font->pxl_ref_size - 1) / font->pxl_ref_size;
+	scaled->pxl_left = (character->pxl_left * (int32_t)pxl_size) / font->pxl_ref_size;
+	scaled->pxl_top = (character->pxl_top * (int32_t)pxl_size) / font->pxl_ref_size;
+	scaled->pxl_advance = (character->pxl_advance * pxl_size + font->pxl_ref_size / 2) / font->pxl_ref_size;
+
+	if (dst == NULL
+	 || src_w == 0 || src_h == 0
+	 || font->bitmaps_table_storage != FONTBUILDERFORC_BITMAPS_IN_ARRAY)
+		return;
+	bmp = (const uint8_t *)font->bitmaps_table;
+	if (font->num_atlas_pages)
+	{
+		row_bytes = (font->atlas_pxl_width * bpp + 7) / 8;
+		bmp += FONTBUILDERFORC_ATLAS_PAGE (character->bmp_offset) * row_bytes * font->atlas_pxl_height;
+		ox = FONTBUILDERFORC_ATLAS_X (character->bmp_offset);
+		oy = FONTBUILDERFORC_ATLAS_Y (character->bmp_offset);
+	}
+	else
+		bmp += character->bmp_offset;
+
+	for (uint16_t v = 0; v < 256; v++)
+	{
+		/* distance in destination pixels (24.8 fixed point). 128 is the
+		   outline and 128 steps are 'sdf_spread' source pixels */
+		int32_t d = ((int32_t)v - 128) * 2 * font->sdf_spread * pxl_size / font->pxl_ref_size;
+
+		if (smooth)
+		{	/* smoothstep from -0.5 to +0.5 pixel */
+			int32_t t = L_MIN (L_MAX (d + 128, 0), 256);
+
+			lut[v] = ((uint32_t)(t * t * (768 - 2 * t)) * 255) >> 24;
+		}
+		else
+			lut[v] = (d >= 0) ? 255 : 0;
+	}
+
+	for (uint16_t y = 0; y < scaled->bmp_pxl_height; y++)
+	{
+		/* source coordinates of the destination pixel center (16.16) */
+		int32_t sy = (int32_t)(((2 * y + 1) * inv_q16) >> 1) - 0x8000;
+		uint16_t y0, y1;
+		uint8_t fy;
+
+		sy = L_MIN (L_MAX (sy, 0), (int32_t)(src_h - 1) << 16);
+		y0 = oy + (sy >> 16);
+		y1 = oy + L_MIN ((sy >> 16) + 1, src_h - 1);
+		fy = (sy >> 8) & 0xFF;
+
+		for (uint16_t x = 0; x < scaled->bmp_pxl_width; x++)
+		{
+			int32_t sx = (int32_t)(((2 * x + 1) * inv_q16) >> 1) - 0x8000;
+			uint16_t x0, x1;
+			uint8_t fx;
+			uint32_t top, bottom;
+
+			sx = L_MIN (L_MAX (sx, 0), (int32_t)(src_w - 1) << 16);
+			x0 = ox + (sx >> 16);
+			x1 = ox + L_MIN ((sx >> 16) + 1, src_w - 1);
+			fx = (sx >> 8) & 0xFF;
+
+			top = GetPixel (bmp, row_bytes, bpp, x0, y0) * (256 - fx) + GetPixel (bmp, row_bytes, bpp, x1, y0) * fx;
+			bottom = GetPixel (bmp, row_bytes, bpp, x0, y1) * (256 - fx) + GetPixel (bmp, row_bytes, bpp, x1, y1) * fx;
+			dst[x + y * scaled->bmp_pxl_width] = lut[(top * (256 - fy) + bottom * fy) >> 16];
+		}
+	}
+}
+
+/* Rasterize an outline glyph at the given pixel size with 8 bit anti-aliasing.
+Each outline segment adds its signed area to an accumulation buffer, one
+running sum per row then gives the pixel coverage (non-zero winding).
+    Args:
+<font>[in] font with FONTBUILDERFORC_PIXFMT_OUTLINE bitmaps in array.
+<character>[in] character to render.
+<pxl_size>[in] destination pixel size.
+<work>[in] work buffer of FONTBUILDERFORC_OUTLINE_WORK_SIZE(scaled) int32_t.
+<dst>[out] destination 8 bpp coverage bitmap, 'scaled->bmp_pxl_width' bytes
+    per row. Can be NULL to get the scaled metrics only.
+<scaled>[out] the character metrics at the destination size.
+    Ret:
+*/
+void fontBuilderForC_OutlineRender (const FONTBUILDERFORC_TYPE_FONT *font, const FONTBUILDERFORC_TYPE_CHARACTER *character,
+	uint16_t pxl_size, int32_t *work, uint8_t *dst, FONTBUILDERFORC_TYPE_METRICS *scaled)
+{
+	const uint8_t *rd; /* encoded outline read pointer */
+	int32_t left_q8, top_q8; /* box corner at the destination size (24.8) */
+	int32_t off_x, off_y; /* box corner offset from the destination pixel grid */
+	uint16_t w, h;
+
+	left_q8 = character->pxl_left * 256 * (int32_t)pxl_size / font->pxl_ref_size;
+	top_q8 = character->pxl_top * 256 * (int32_t)pxl_size / font->pxl_ref_size;
+	scaled->pxl_left = left_q8 >> 8; /* floor */
+	scaled->pxl_top = (top_q8 + 255) >> 8; /* ceil */
+	off_x = left_q8 - scaled->pxl_left * 256;
+	off_y = scaled->pxl_top * 256 - top_q8;
+	scaled->bmp_pxl_width = (off_x + character->bmp_pxl_width * 256 * (int32_t)pxl_size / font->pxl_ref_size + 255) >> 8;
+	scaled->bmp_pxl_height = (off_y + character->bmp_pxl_height * 256 * (int32_t)pxl_size / font->pxl_ref_size + 255) >> 8;
+	scaled->pxl_advance = (character->pxl_advance * pxl_size + font->pxl_ref_size / 2) / font->pxl_ref_size;
+
+	if (dst == NULL || font->bitmaps_table_storage != FONTBUILDERFORC_BITMAPS_IN_ARRAY)
+		return;
+
+	w = scaled->bmp_pxl_width;
+	h = scaled->bmp_pxl_height;
+	memset (work, 0, sizeof (int32_t) * FONTBUILDERFORC_OUTLINE_WORK_SIZE (scaled));
+	rd = (const uint8_t *)font->bitmaps_table + character->bmp_offset;
+	for (uint16_t num = rd[0] | (rd[1] << 8); num; num = rd[0] | (rd[1] << 8))
+	{	/* for all the contours */
+		int32_t px, py; /* current point, outline units */
+		int32_t x0, y0, x, y; /* first and current point, destination 24.8 */
+
+		px = ReadInt16 (rd + 2);
+		py = ReadInt16 (rd + 4);
+		rd += 6;
+		/* outline units to destination pixels (24.8) */
+		x0 = x = off_x + (px << (8 - FONTBUILDERFORC_OUTLINE_FRAC_BITS)) * (int32_t)pxl_size / font->pxl_ref_size;
+		y0 = y = off_y + (py << (8 - FONTBUILDERFORC_OUTLINE_FRAC_BITS)) * (int32_t)pxl_size / font->pxl_ref_size;
+		while (--num)
+		{
+			int32_t nx, ny;
+
+			if (rd[0] == FONTBUILDERFORC_OUTLINE_ESCAPE)
+			{
+				px += ReadInt16 (rd + 1);
+				py += ReadInt16 (rd + 3);
+				rd += 5;
+			}
+			else
+			{
+				px += (int8_t)rd[0];
+				py += (int8_t)rd[1];
+				rd += 2;
+			}
+			nx = off_x + (px << (8 - FONTBUILDERFORC_OUTLINE_FRAC_BITS)) * (int32_t)pxl_size / font->pxl_ref_size;
+			ny = off_y + (py << (8 - FONTBUILDERFORC_OUTLINE_FRAC_BITS)) * (int32_t)pxl_size / font->pxl_ref_size;
+			DrawLine (work, w, h, x, y, nx, ny);
+			x = nx;
+			y = ny;
+		}
+		DrawLine (work, w, h, x, y, x0, y0); /* close the contour */
+	}
+
+	for (uint16_t row = 0; row < h; row++)
+	{
+		const int32_t *cell = &work[row * (w + 2)];
+		int32_t acc = 0; /* coverage, 16.16 */
+
+		for (uint16_t col = 0; col < w; col++)
+		{
+			int32_t cov;
+
+			acc += cell[col];
+			cov = (acc < 0) ? -acc : acc;
+			dst[col + row * w] = L_MIN (cov, 0xFFFF) >> 8;
+		}
+	}
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Add the signed area of a line segment to the accumulation buffer. Every
+cell gets the coverage change the segment causes from that cell on, so that a
+row running sum is the pixel coverage.
+    Args:
+<acc>[in] accumulation buffer, 'w + 2' cells per row, 16.16 coverage.
+<w>[in] bitmap width.
+<h>[in] bitmap height.
+<x0>[in] segment start x (24.8).
+<y0>[in] segment start y (24.8).
+<x1>[in] segment end x (24.8).
+<y1>[in] segment end y (24.8).
+    Ret:
+*/
+static void DrawLine (int32_t *acc, uint16_t w, uint16_t h, int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+	int32_t dir = 1; /* winding direction */
+	int32_t dxdy; /* x step per y unit (16.16) */
+	int32_t x; /* x on the upper edge of the current row (24.8) */
+
+	if (y0 == y1)
+		return; /* horizontal segments don't change the coverage */
+	if (y0 > y1)
+	{
+		int32_t t;
+
+		t = x0; x0 = x1; x1 = t;
+		t = y0; y0 = y1; y1 = t;
+		dir = -1;
+	}
+	dxdy = ((int64_t)(x1 - x0) << 16) / (y1 - y0);
+	x = x0;
+	if (y0 < 0)
+		x -= ((int64_t)y0 * dxdy) >> 16;
+
+	for (int32_t row = L_MAX (y0, 0) >> 8; row < h && row * 256 < y1; row++)
+	{
+		int32_t *cell = &acc[row * (w + 2)];
+		int32_t dy = L_MIN ((row + 1) * 256, y1) - L_MAX (row * 256, y0); /* 24.8 */
+		int32_t xnext = x + (((int64_t)dy * dxdy) >> 16);
+		int32_t d = dy * dir;
+		int32_t xa = L_MIN (L_MAX (L_MIN (x, xnext), 0), w * 256);
+		int32_t xb = L_MIN (L_MAX (L_MAX (x, xnext), 0), w * 256);
+		int32_t xai = xa >> 8; /* first touched cell */
+		int32_t xbi = (xb + 255) >> 8; /* last touched cell + 1 */
+
+		if (xbi <= xai + 1)
+		{	/* the segment is inside one cell: split by its mean x */
+			int32_t xmf = ((xa + xb) >> 1) - xai * 256;
+
+			cell[xai] += (d * (256 - xmf));
+			cell[xai + 1] += (d * xmf);
+		}
+		else
+		{	/* the covered area grows as a trapezoid over the touched cells */
+			int64_t s = (1 << 24) / (xb - xa); /* 1 / segment width (16.16) */
+			int32_t x0f = xa - xai * 256;
+			int32_t x1f = xb - xbi * 256 + 256;
+			int32_t a0 = (s * (256 - x0f) * (256 - x0f)) >> 17;
+			int32_t am = (s * x1f * x1f) >> 17;
+
+			cell[xai] += ((int64_t)d * a0) >> 8;
+			if (xbi == xai + 2)
+				cell[xai + 1] += ((int64_t)d * (65536 - a0 - am)) >> 8;
+			else
+			{
+				int32_t a1 = (s * (384 - x0f)) >> 8;
+				int32_t a2 = a1 + (xbi - xai - 3) * s;
+
+				cell[xai + 1] += ((int64_t)d * (a1 - a0)) >> 8;
+				for (int32_t k = xai + 2; k < xbi - 1; k++)
+					cell[k] += (d * s) >> 8;
+				cell[xbi - 1] += ((int64_t)d * (65536 - a2 - am)) >> 8;
+			}
+			cell[xbi] += ((int64_t)d * am) >> 8;
+		}
+		x = xnext;
+	}
+}
+
+/* Read a little endian int16.
+    Args:
+<src>[in] first byte.
+    Ret:
+the value.
+*/
+static int16_t ReadInt16 (const uint8_t *src)
+{
+	return (int16_t)(src[0] | (src[1] << 8));
+}
+
+/* Read a pixel of a packed bitmap and expand it to 8 bit. Quantized values are
+expanded to the center of their interval.
+    Args:
+<bmp>[in] packed bitmap.
+<row_bytes>[in] bytes per bitmap row.
+<bpp>[in] bit per pixel.
+<x>[in] pixel column.
+<y>[in] pixel row.
+    Ret:
+the 8 bit pixel value.
+*/
+static uint8_t GetPixel (const uint8_t *bmp, uint16_t row_bytes, uint8_t bpp, uint16_t x, uint16_t y)
+{
+	uint32_t bit = (uint32_t)x * bpp;
+	uint8_t val;
+
+	val = bmp[y * row_bytes + bit / 8] >> (8 - bpp - bit % 8);
+	val &= (1 << bpp) - 1;
+	if (bpp == 8)
+		return val;
+	return (val << (8 - bpp)) | (1 << (7 - bpp));
+}
@@ -26,23 +26,63 @@
 #define FONTBUILDERFORC_TYPE_RANGE          fontBuilderForC_Range_t
 #define FONTBUILDERFORC_TYPE_CHARACTER      fontBuilderForC_Character_t
 #define FONTBUILDERFORC_TYPE_KERNING        fontBuilderForC_Kerning_t
+#define FONTBUILDERFORC_TYPE_METRICS        fontBuilderForC_Metrics_t
 
 #define FONTBUILDERFORC_BITMAPS_IN_ARRAY    0
 #define FONTBUILDERFORC_BITMAPS_IN_FILE     1
 
+/* pixel formats of the bitmaps table.
+COVERAGE: each pixel is a 'bpp' bit alpha coverage value, you have to blend it.
+RGB565 / RGB332 / L8: glyphs are pre-blended over a fixed background color.
+Bitmap rows are made of native pixels (RGB565 little endian) and can be copied
+to the frame buffer as they are, one memcpy per row. If 'palette' is not NULL
+each pixel is a 'bpp' bit index inside the palette instead. */
+#define FONTBUILDERFORC_PIXFMT_COVERAGE     0
+#define FONTBUILDERFORC_PIXFMT_RGB565       1
+#define FONTBUILDERFORC_PIXFMT_RGB332       2
+#define FONTBUILDERFORC_PIXFMT_L8           3
+/* SDF: each pixel is a 'bpp' bit signed distance from the outline. The middle
+value is the outline, bigger values are inside. Render them with
+fontBuilderForC_SdfRender at any pixel size. */
+#define FONTBUILDERFORC_PIXFMT_SDF          4
+/* OUTLINE: the bitmaps table contains glyph outlines with curves flattened to
+lines. Render them with fontBuilderForC_OutlineRender at any pixel size.
+Each glyph is a list of closed contours. A contour is a little endian uint16
+point count, the first point as two little endian int16 (x, y) and the
+following points as int8 (dx, dy) deltas. A 0x80 dx escapes to a pair of
+int16 deltas. A 0 point count ends the glyph. Coordinates are 1/16 pixel at
+pxl_ref_size, relative to the top left corner of the glyph box, y downward. */
+#define FONTBUILDERFORC_PIXFMT_OUTLINE      5
+#define FONTBUILDERFORC_OUTLINE_FRAC_BITS   4
+#define FONTBUILDERFORC_OUTLINE_ESCAPE      0x80
+/* size of the work buffer (int32_t) needed by fontBuilderForC_OutlineRender */
+#define FONTBUILDERFORC_OUTLINE_WORK_SIZE(metrics) (((metrics)->bmp_pxl_width + 2) * (metrics)->bmp_pxl_height)
+/* position of an atlas bitmap packed in bmp_offset: x and y on 12 bits, page
+on 8 */
+#define FONTBUILDERFORC_ATLAS_POS(page, x, y) (((uint32_t)(page) << 24) | ((uint32_t)(y) << 12) | (uint32_t)(x))
+#define FONTBUILDERFORC_ATLAS_X(bmp_offset) ((bmp_offset) & 0xFFF)
+#define FONTBUILDERFORC_ATLAS_Y(bmp_offset) (((bmp_offset) >> 12) & 0xFFF)
+#define FONTBUILDERFORC_ATLAS_PAGE(bmp_offset) ((bmp_offset) >> 24)
+
 typedef struct
 {
-	uint32_t bmp_offset; // bitmap offset inside the 
-	uint8_t bmp_pxl_width; // width of the bitmap (in pixel)
-	uint8_t bmp_pxl_height; // height of the bitmap (in pixel)
+	/* bitmap offset inside the bitmaps table. Atlas fonts (num_atlas_pages >
+	0): the position of the bitmap rectangle inside its page, read it with
+	FONTBUILDERFORC_ATLAS_X, FONTBUILDERFORC_ATLAS_Y and FONTBUILDERFORC_ATLAS_PAGE */
+	uint32_t bmp_offset;
+	uint16_t bmp_pxl_width; // width of the bitmap (in pixel)
+	uint16_t bmp_pxl_height; // height of the bitmap (in pixel)
 	/* after rendering the glyph you have to advance the cursor x postion about
 	this quantity */
-	uint8_t pxl_advance;
+	uint16_t pxl_advance;
 	/* you have to position the glyph bitmap with the top left corner on
 	coordinates (cursorX + pxl_left, cursorY - pxl_top) */
-	int8_t pxl_left;
-	int8_t pxl_top;
-	uint16_t kerning_index;
+	int16_t pxl_left;
+	int16_t pxl_top;
+	/* COVERAGE bitmaps out of atlas pages: bpp of this bitmap, 0 if it is the
+	font one. Ranges and glyphs can be stored at their own depth */
+	uint8_t bpp;
+	uint32_t kerning_index;
 } FONTBUILDERFORC_TYPE_CHARACTER;
 
 typedef struct
@@ -60,7 +100,7 @@ typedef struct
 	/* if you are writing glyph 'right_ch' and the glyph right before this, is
 	'legt_ch', you should move the cursor position of 'pxl_adjust' pixels before
 	rendering 'right_ch' */
-	int8_t pxl_adjust;
+	int16_t pxl_adjust;
 } FONTBUILDERFORC_TYPE_KERNING;
 
 typedef struct
@@ -68,14 +108,44 @@ typedef struct
 	uint8_t bpp;
 	/* you have to move the cursor y position of this quantity when you proceed
 	with rendering a new line */
-	uint8_t pxl_baseline_to_baseline;
-	uint8_t pxl_max_glyph_height;
+	uint16_t pxl_baseline_to_baseline;
+	uint16_t pxl_max_glyph_height;
 	const char *bitmaps_table; // byte array containing all glyphs bitmap or binary filename
 	uint8_t bitmaps_table_storage; // bitmaps as c array or as binary file
+	uint8_t pixel_format; // one of FONTBUILDERFORC_PIXFMT_xxx
+	const uint16_t *palette; // native colors of the pre-blended palette or NULL
+	uint16_t num_palette; // palette array size
+	uint8_t sdf_spread; // distance field spread (pixel at pxl_ref_size)
+	uint16_t pxl_ref_size; // pixel size distance fields and outlines are exported at
+	/* atlas fonts: the bitmaps table is made of 'num_atlas_pages' pages of
+	atlas_pxl_width x atlas_pxl_height pixels, rows start on a new byte */
+	uint16_t atlas_pxl_width;
+	uint16_t atlas_pxl_height;
+	uint16_t num_atlas_pages; // 0 if bitmaps are stored one after the other
 	const FONTBUILDERFORC_TYPE_RANGE *ranges;
 	const FONTBUILDERFORC_TYPE_KERNING *kerning; // null if no kerning info available
-	uint16_t num_kerning; // kerning array size
+	uint32_t num_kerning; // kerning array size
 	uint16_t num_ranges; // ranges array size
 } FONTBUILDERFORC_TYPE_FONT;
 
+typedef struct
+{	/* character metrics of scalable fonts (SDF, OUTLINE) at the rendering size */
+	uint16_t bmp_pxl_width;
+	uint16_t bmp_pxl_height;
+	int16_t pxl_left;
+	int16_t pxl_top;
+	uint16_t pxl_advance;
+} FONTBUILDERFORC_TYPE_METRICS;
+
+/* runtime functions (fontBuilderForC.c) */
+const FONTBUILDERFORC_TYPE_CHARACTER *fontBuilderForC_FindCharacter (const FONTBUILDERFORC_TYPE_FONT *font, uint32_t unicode);
+int16_t fontBuilderForC_GetKerning (const FONTBUILDERFORC_TYPE_FONT *font, const FONTBUILDERFORC_TYPE_CHARACTER *left,
+	uint32_t left_unicode, uint32_t right_unicode);
+void fontBuilderForC_Blit (const FONTBUILDERFORC_TYPE_FONT *font, const FONTBUILDERFORC_TYPE_CHARACTER *character,
+	uint8_t *dst, uint16_t dst_stride);
+void fontBuilderForC_SdfRender (const FONTBUILDERFORC_TYPE_FONT *font, const FONTBUILDERFORC_TYPE_CHARACTER *character,
+	uint16_t pxl_size, uint8_t smooth, uint8_t *dst, FONTBUILDERFORC_TYPE_METRICS *scaled);
+void fontBuilderForC_OutlineRender (const FONTBUILDERFORC_TYPE_FONT *font, const FONTBUILDERFORC_TYPE_CHARACTER *character,
+	uint16_t pxl_size, int32_t *work, uint8_t *dst, FONTBUILDERFORC_TYPE_METRICS *scaled);
+
 #endif // FONTBUILDERFORC_H_INCLUDED
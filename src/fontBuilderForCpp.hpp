@@ -0,0 +1,251 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Types and functions for the C++17 fonts produced by the C++ builder. The
+fonts are constexpr objects: lookup, kerning and string width can be computed
+by the compiler, e.g.
+    constexpr auto w = lato_Font.width (u8"Settings");
+The bpp is a template parameter of the font, so the blit functions are
+specialized for it at compile time. Header only, include it in your firmware. */
+
+#ifndef FONTBUILDERFORCPP_HPP_INCLUDED
+#define FONTBUILDERFORCPP_HPP_INCLUDED
+
+#include <cstdint>
+#include <cstddef>
+
+namespace fontBuilderForCpp
+{
+
+struct Character
+{
+	uint32_t bmp_offset; // bitmap offset inside the bitmaps table
+	uint16_t bmp_pxl_width; // width of the bitmap (in pixel)
+	uint16_t bmp_pxl_height; // height of the bitmap (in pixel)
+	/* after rendering the glyph you have to advance the cursor x postion about
+	this quantity */
+	uint16_t pxl_advance;
+	/* you have to position the glyph bitmap with the top left corner on
+	coordinates (cursorX + pxl_left, cursorY - pxl_top) */
+	int16_t pxl_left;
+	int16_t pxl_top;
+	uint32_t kerning_index; // first kerning pair with this character on the left
+};
+
+struct Range
+{
+	uint32_t first; // unicode value of the first glyph of this range
+	uint32_t num_characters;
+	const Character *characters;
+};
+
+struct Kerning
+{	/* move the cursor of 'pxl_adjust' pixels before drawing 'right_ch' when
+	the character before it is 'left_ch' */
+	uint32_t left_ch;
+	uint32_t right_ch;
+	int16_t pxl_adjust;
+};
+
+/* Decode the next UTF-8 character and advance the text.
+    Args:
+<text>[in/out] text pointer, char or char8_t.
+    Ret:
+the unicode character, 0 at the end of the text.
+*/
+template <typename Char>
+constexpr uint32_t NextUnicode (const Char *&text)
+{
+	uint8_t lead = static_cast<uint8_t> (text[0]);
+	uint32_t unicode = lead;
+	uint8_t len = 1;
+
+	if (lead >= 0xF0)
+		unicode = lead & 0x07, len = 4;
+	else if (lead >= 0xE0)
+		unicode = lead & 0x0F, len = 3;
+	else if (lead >= 0x80)
+		unicode = lead & 0x1F, len = 2;
+	for (uint8_t k = 1; k < len; k++)
+		unicode = (unicode << 6) | (static_cast<uint8_t> (text[k]) & 0x3F);
+	if (unicode)
+		text += len;
+	return unicode;
+}
+
+template <uint8_t Bpp>
+struct Font
+{
+	static_assert (Bpp == 1 || Bpp == 2 || Bpp == 4 || Bpp == 8, "bpp must be 1, 2, 4 or 8");
+	static constexpr uint8_t bpp = Bpp;
+
+	/* you have to move the cursor y position of this quantity when you proceed
+	with rendering a new line */
+	uint16_t pxl_baseline_to_baseline;
+	uint16_t pxl_max_glyph_height;
+	const uint8_t *bitmaps_table;
+	const Range *ranges;
+	uint16_t num_ranges;
+	const Kerning *kerning; // nullptr if no kerning info available
+	uint32_t num_kerning;
+
+	/* Look for the character descriptor of a unicode character.
+	    Ret:
+	the character descriptor or nullptr if the character is not inside the font.
+	*/
+	constexpr const Character *findCharacter (uint32_t unicode) const
+	{
+		for (uint16_t k = 0; k < num_ranges; k++)
+		{
+			if (unicode >= ranges[k].first && unicode - ranges[k].first < ranges[k].num_characters)
+				return &ranges[k].characters[unicode - ranges[k].first];
+		}
+		return nullptr;
+	}
+
+	/* Look for the kerning between two characters.
+	    Ret:
+	the pixels to move the cursor before drawing the right character.
+	*/
+	constexpr int16_t getKerning (const Character &left, uint32_t left_unicode, uint32_t right_unicode) const
+	{
+		for (uint32_t k = left.kerning_index; k < num_kerning && kerning[k].left_ch == left_unicode; k++)
+		{
+			if (kerning[k].right_ch == right_unicode)
+				return kerning[k].pxl_adjust;
+		}
+		return 0;
+	}
+
+	/* Width of a UTF-8 string: advances plus kerning. Characters missing
+	from the font are skipped.
+	    Ret:
+	the width in pixel.
+	*/
+	template <typename Char>
+	constexpr int32_t width (const Char *utf8) const
+	{
+		const Character *prev = nullptr;
+		uint32_t prev_unicode = 0;
+		int32_t w = 0;
+
+		for (uint32_t unicode = NextUnicode (utf8); unicode; unicode = NextUnicode (utf8))
+		{
+			const Character *ch = findCharacter (unicode);
+
+			if (ch == nullptr)
+			{
+				prev = nullptr;
+				continue;
+			}
+			if (prev)
+				w += getKerning (*prev, prev_unicode, unicode);
+			w += ch->pxl_advance;
+			prev = ch;
+			prev_unicode = unicode;
+		}
+		return w;
+	}
+
+	/* 8 bit coverage of a bitmap pixel. */
+	constexpr uint8_t coverage (const Character &ch, uint16_t x, uint16_t y) const
+	{
+		constexpr uint8_t mask = (1 << Bpp) - 1;
+		uint32_t bit = static_cast<uint32_t> (x) * Bpp;
+		const uint8_t *row = bitmaps_table + ch.bmp_offset + y * ((ch.bmp_pxl_width * Bpp + 7) / 8);
+
+		/* 255 / (2^bpp - 1) is exact for 1, 2, 4 and 8 bpp */
+		return ((row[bit / 8] >> (8 - Bpp - bit % 8)) & mask) * (255 / mask);
+	}
+
+	/* Blit a glyph calling plot (x, y, coverage) for each covered pixel.
+	    Args:
+	<ch>[in] character.
+	<x>, <y>[in] cursor position, y is the baseline.
+	<plot>[in] callable taking (int32_t x, int32_t y, uint8_t coverage).
+	*/
+	template <typename Plot>
+	void blit (const Character &ch, int32_t x, int32_t y, Plot &&plot) const
+	{
+		x += ch.pxl_left;
+		y -= ch.pxl_top;
+		for (uint16_t gy = 0; gy < ch.bmp_pxl_height; gy++)
+		{
+			for (uint16_t gx = 0; gx < ch.bmp_pxl_width; gx++)
+			{
+				uint8_t val = coverage (ch, gx, gy);
+
+				if (val)
+					plot (x + gx, y + gy, val);
+			}
+		}
+	}
+
+	/* Blit a glyph in an 8 bit coverage buffer keeping the highest coverage,
+	so that kerned glyphs can overlap.
+	    Args:
+	<ch>[in] character.
+	<dst>[out] buffer address of the top left corner of the bitmap.
+	<dst_stride>[in] bytes per buffer row.
+	*/
+	void blit (const Character &ch, uint8_t *dst, uint16_t dst_stride) const
+	{
+		for (uint16_t gy = 0; gy < ch.bmp_pxl_height; gy++, dst += dst_stride)
+		{
+			for (uint16_t gx = 0; gx < ch.bmp_pxl_width; gx++)
+			{
+				uint8_t val = coverage (ch, gx, gy);
+
+				dst[gx] = (val > dst[gx]) ? val : dst[gx];
+			}
+		}
+	}
+
+	/* Draw a UTF-8 string with kerning, calling plot (x, y, coverage).
+	    Ret:
+	the cursor x position after the string.
+	*/
+	template <typename Char, typename Plot>
+	int32_t draw (const Char *utf8, int32_t x, int32_t y, Plot &&plot) const
+	{
+		const Character *prev = nullptr;
+		uint32_t prev_unicode = 0;
+
+		for (uint32_t unicode = NextUnicode (utf8); unicode; unicode = NextUnicode (utf8))
+		{
+			const Character *ch = findCharacter (unicode);
+
+			if (ch == nullptr)
+			{
+				prev = nullptr;
+				continue;
+			}
+			if (prev)
+				x += getKerning (*prev, prev_unicode, unicode);
+			blit (*ch, x, y, plot);
+			x += ch->pxl_advance;
+			prev = ch;
+			prev_unicode = unicode;
+		}
+		return x;
+	}
+};
+
+} // namespace fontBuilderForCpp
+
+#endif // FONTBUILDERFORCPP_HPP_INCLUDED
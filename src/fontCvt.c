@@ -21,48 +21,102 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <getopt.h>
 
-// FreeType 2 library headers
-#include "ft2build.h"
-#include FT_FREETYPE_H
-
-#include "builderForC.h"
+#include "fontCvtLib.h"
+#include "builderRegistry.h"
+#include "stats.h"
+#include "serve.h"
+#include "shard.h"
+#include "budget.h"
+#include "kerning.h"
 
 
 #define L_PRINT_GEN_ERR                                fprintf (stderr, "ERROR ON %s:%d\n", __FILE__, __LINE__)
-#define L_NELEMENTS(array)                             (sizeof (array) / sizeof (array[0]))
+
+/* long options identifiers, out of the short options characters range */
+#define L_OPT_STATS                                    256
+#define L_OPT_PROFILE                                  257
+#define L_OPT_TRACE                                    258
+#define L_OPT_REPORT                                   259
+#define L_OPT_SERVE                                    260
+#define L_OPT_SHARD                                    261
+#define L_OPT_THREADS                                  262
+#define L_OPT_QUEUE_DEPTH                              263
+#define L_OPT_EXACT_MONO                               264
+#define L_OPT_BUDGET                                   265
+#define L_OPT_CORPUS                                   266
+#define L_OPT_DROP_GLYPHS                              267
+#define L_OPT_KERN_BUDGET                              268
+
+#define L_MAX_BPPS                                     4
+#define L_MAX_PXL_SIZE                                 1024
+
+typedef enum
+{	/* print statistics at the end of the export */
+	L_STATS_NONE,
+	L_STATS_TEXT,
+	L_STATS_JSON,
+} StatsMode_t;
+
+typedef enum
+{	/* command line parsing result */
+	L_ARGS_OK,
+	L_ARGS_ERROR,
+	L_ARGS_HELP, /* the help has been printed */
+} Args_t;
 
 typedef struct
-{
-	wchar_t first; /* first unicode character's code (included) */
-	wchar_t last; /* last unicode character's code (included) */
-} UnicodeRange_t;
+{	/* command line options */
+	fontCvtLib_Options_t lib; /* export options */
+	/* -b depths. With more than one the export renders at 8 bpp and every
+	builder is selected once per depth */
+	uint8_t bpps[L_MAX_BPPS];
+	uint8_t bpps_num;
+	bool exact_mono; /* 1 bpp rendered in FreeType mono mode with more depths */
+	fontCvt_Range_t *ranges; /* lib.ranges while they are parsed */
+	bool ranges_all; /* -r all: the ranges are the coverage of the font */
+	bool ranges_bpp; /* some ranges have their own bpp (-r first-last:bpp) */
+	char *fname_font; /* font file path */
+	const char **builders; /* output builders (-B name[:options]) */
+	uint8_t builders_num;
+	/* fixed pixel sizes the signed distance field table is compared with */
+	uint16_t *compare_sizes;
+	uint16_t compare_sizes_num;
+	StatsMode_t stats;
+	/* number of most expensive glyphs to print, 0 disables glyph profiling */
+	uint16_t profile_top;
+	const char *fname_trace; /* chrome trace destination file */
+	bool serve; /* daemon mode */
+	const char *socket_path; /* daemon socket, NULL for the standard input */
+	uint32_t budget; /* flash bytes the C output has to fit, 0 for no budget */
+	/* texts weighing the characters of the budget and the kerning pairs */
+	const char **fnames_corpus;
+	uint16_t fnames_corpus_num;
+	bool drop_glyphs; /* the budget can leave characters out */
+	char *budget_builder_opt; /* -j with autobpp=0 for the budget */
+	bool kern_prune; /* keep only the kerning pairs the corpus needs */
+	uint32_t kern_budget; /* most kerning pairs kept */
+} Options_t;
 
 
 //____________________________________________________________PRIVATE PROTOTYPES
+static Args_t ParseArgs (int argc, char *argv[], Options_t *opt);
+static void FreeOptions (Options_t *opt);
+static bool ReportOnly (const Options_t *opt);
+static bool ServeJob (int argc, char *argv[]);
 static void PrintHelp (void);
-static void Export (void);
-static void DoExportFont (fontCvt_Builder_t *builder, FT_Face face, UnicodeRange_t *ranges, uint8_t ranges_sz);
-static void DoExportKerinig (fontCvt_Builder_t *builder, FT_Face face, wchar_t left_char, UnicodeRange_t *ranges, uint8_t ranges_sz);
-void ConvertBitmap (FT_Bitmap *ft_bmp, char *pxlmap);
+static bool Export (Options_t *opt, fontCvtLib_Face_t *face);
+static bool ExportShard (fontCvtLib_Face_t *face, const Options_t *opt);
+static bool Budget (fontCvtLib_Face_t *face, Options_t *opt, const corpus_Corpus_t *corpus);
+static bool ExportPruned (fontCvtLib_Face_t *face, const Options_t *opt, const corpus_Corpus_t *corpus,
+	fontCvt_Builder_t *builder, void *builder_ctx, uint32_t *bitmaps_size);
+static void ReportSdfSavings (fontCvtLib_Face_t *face, const Options_t *opt, uint32_t sdf_bytes);
 
 //___________________________________________________________________PRIVATE VAR
-/* ArgIn_xxx variable substitutes what should be parsed from the command line */
-static UnicodeRange_t *ArgIn_UnicodeRanges = NULL;
-static uint16_t ArgIn_UnicodeRangesNum = 0;
-/* font file path */
-static char *ArgIn_FnameFont = NULL;
-/* output file path */
-static char *ArgIn_FnameOut = NULL;
-/* font EM square scaled pixel height */
-static uint8_t ArgIn_Size = 30;
-/* export font bpp */
-static uint8_t ArgIn_Bpp = 4;
-/* builder options */
-static const char *ArgIn_BuilderOpt;
-
 
 //____________________________________________________________________GLOBAL VAR
 
@@ -73,76 +127,395 @@ static const char *ArgIn_BuilderOpt;
 - <argc>[in] command line argument's number.
 - <argv>[in] command line argument's list.
     Ret:
-0 on success.
+0 on success, 1 on wrong arguments or failed export.
 */
 int main (int argc, char *argv[])
 {
+	Options_t opt;
+	Args_t args = ParseArgs (argc, argv, &opt);
+	int ret = (args == L_ARGS_ERROR);
+
+	if (args == L_ARGS_OK)
+	{
+		fontCvtLib_Init ( );
+		if (opt.serve)
+			ret = serve_Run (opt.socket_path, ServeJob);
+		else
+			ret = !Export (&opt, NULL);
+	}
+	FreeOptions (&opt);
+
+	return ret;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Parse the command line options.
+    Args:
+<argc>[in] command line argument's number.
+<argv>[in] command line argument's list, the option arguments are modified.
+<opt>[out] options, to be released with FreeOptions.
+    Ret:
+L_ARGS_OK if all provided arguments are ok.
+*/
+static Args_t ParseArgs (int argc, char *argv[], Options_t *opt)
+{
+	static const struct option long_options[] =
+	{
+		{ "stats", optional_argument, NULL, L_OPT_STATS },
+		{ "profile", optional_argument, NULL, L_OPT_PROFILE },
+		{ "trace", required_argument, NULL, L_OPT_TRACE },
+		{ "report", no_argument, NULL, L_OPT_REPORT },
+		{ "serve", optional_argument, NULL, L_OPT_SERVE },
+		{ "shard", required_argument, NULL, L_OPT_SHARD },
+		{ "threads", required_argument, NULL, L_OPT_THREADS },
+		{ "queue-depth", required_argument, NULL, L_OPT_QUEUE_DEPTH },
+		{ "exact-mono", no_argument, NULL, L_OPT_EXACT_MONO },
+		{ "budget", required_argument, NULL, L_OPT_BUDGET },
+		{ "corpus", required_argument, NULL, L_OPT_CORPUS },
+		{ "drop-glyphs", no_argument, NULL, L_OPT_DROP_GLYPHS },
+		{ "kern-budget", required_argument, NULL, L_OPT_KERN_BUDGET },
+		{ NULL, 0, NULL, 0 },
+	};
 	int c; /* option identifier character */
 	/* flag meaning all provided arguments are ok */
 	bool argsOk = true;
 
-	/* parse command line options */
-	while ((c = getopt (argc, argv, ":b:j:s:r:o:h")) != -1)
+	memset (opt, 0, sizeof (*opt));
+	opt->stats = L_STATS_NONE;
+	fontCvtLib_DefaultOptions (&opt->lib);
+
+	/* parse command line options. 0 restarts the GNU getopt, the daemon parses
+	a command line for every job */
+	optind = 0;
+	while ((c = getopt_long (argc, argv, ":b:j:B:s:r:o:m:d:c:h", long_options, NULL)) != -1)
 	{
 		switch (c)
 		{
-			/* export glyph bitmap bpp option */
-			case 'b':
+			/* conversion statistics */
+			case L_OPT_STATS:
+			{
+				if (optarg == NULL)
+					opt->stats = L_STATS_TEXT;
+				else if (!strcmp (optarg, "json"))
+					opt->stats = L_STATS_JSON;
+				else
+				{
+					argsOk = false;
+					fprintf (stderr, "%s is not a valid --stats option's argument\n", optarg);
+				}
+				break;
+			}
+
+			/* daemon mode, jobs come from the standard input or the socket */
+			case L_OPT_SERVE:
 			{
-				ArgIn_Bpp = atoi (optarg);
-				if (ArgIn_Bpp != 1
-				 && ArgIn_Bpp != 2
-				 && ArgIn_Bpp != 4
-				 && ArgIn_Bpp != 8)
+				opt->serve = true;
+				opt->socket_path = optarg;
+				break;
+			}
+
+			/* render a shard of the font for fontcvt-merge */
+			case L_OPT_SHARD:
+			{
+				if (!shard_Parse (optarg, &opt->lib.shard, &opt->lib.shards_num))
 				{
 					argsOk = false;
-					fprintf (stderr, "%d is not a valid -b option's argument\n", ArgIn_Bpp);
+					fprintf (stderr, "%s is not a valid --shard option's argument\n", optarg);
 				}
 				break;
 			}
+
+			/* render stage threads of the export pipeline */
+			case L_OPT_THREADS:
+			{
+				int threads = atoi (optarg);
+
+				if (threads < 0 || threads > 256)
+				{
+					argsOk = false;
+					fprintf (stderr, "%s is not a valid --threads option's argument\n", optarg);
+				}
+				opt->lib.threads = threads;
+				break;
+			}
+
+			/* batches each pipeline queue holds */
+			case L_OPT_QUEUE_DEPTH:
+			{
+				int depth = atoi (optarg);
+
+				if (depth < 1 || depth > 1024)
+				{
+					argsOk = false;
+					fprintf (stderr, "%s is not a valid --queue-depth option's argument\n", optarg);
+				}
+				opt->lib.queue_depth = depth;
+				break;
+			}
+
+			/* 1 bpp of a multiple depths export rendered in mono mode */
+			case L_OPT_EXACT_MONO:
+			{
+				opt->exact_mono = true;
+				break;
+			}
+
+			/* flash budget in bytes, K or M for KiB or MiB */
+			case L_OPT_BUDGET:
+			{
+				char *end;
+				unsigned long bytes = strtoul (optarg, &end, 10);
+
+				if (*end == 'K' || *end == 'k')
+					bytes *= 1024, end++;
+				else if (*end == 'M' || *end == 'm')
+					bytes *= 1024 * 1024, end++;
+				if (*end != '\0' || bytes == 0 || bytes > UINT32_MAX)
+				{
+					argsOk = false;
+					fprintf (stderr, "%s is not a valid --budget option's argument\n", optarg);
+				}
+				opt->budget = bytes;
+				break;
+			}
+
+			/* text the budget and the kerning pruning weigh the characters with */
+			case L_OPT_CORPUS:
+			{
+				const char **fnames = realloc (opt->fnames_corpus, sizeof (char *) * (opt->fnames_corpus_num + 1));
+
+				if (fnames == NULL)
+				{
+					argsOk = false;
+					fprintf (stderr, "corpus allocation fail\n");
+					break;
+				}
+				opt->fnames_corpus = fnames;
+				opt->fnames_corpus[opt->fnames_corpus_num++] = optarg;
+				break;
+			}
+
+			/* most kerning pairs kept, the ones the corpus needs most */
+			case L_OPT_KERN_BUDGET:
+			{
+				char *end;
+				unsigned long pairs = strtoul (optarg, &end, 10);
+
+				if (*end != '\0' || *optarg == '\0' || pairs > UINT32_MAX)
+				{
+					argsOk = false;
+					fprintf (stderr, "%s is not a valid --kern-budget option's argument\n", optarg);
+				}
+				opt->kern_prune = true;
+				opt->kern_budget = pairs;
+				break;
+			}
+
+			/* the budget can leave characters out */
+			case L_OPT_DROP_GLYPHS:
+			{
+				opt->drop_glyphs = true;
+				break;
+			}
+
+			/* comma separated list of export glyph bitmap bpp */
+			case 'b':
+			{
+				opt->bpps_num = 0;
+				for (char *save, *depth = strtok_r (optarg, ",", &save);
+				     depth;
+				     depth = strtok_r (NULL, ",", &save))
+				{
+					uint8_t bpp = atoi (depth);
+					bool dup = false;
+
+					if (bpp != 1
+					 && bpp != 2
+					 && bpp != 4
+					 && bpp != 8)
+					{
+						argsOk = false;
+						fprintf (stderr, "%s is not a valid -b option's argument\n", depth);
+						break;
+					}
+					for (uint8_t k = 0; k < opt->bpps_num; k++)
+						dup |= (opt->bpps[k] == bpp);
+					if (!dup)
+						opt->bpps[opt->bpps_num++] = bpp;
+				}
+				if (opt->bpps_num)
+					opt->lib.bpp = opt->bpps[0];
+				break;
+			}
 			
 			/* export glyph pixel size option */
 			case 's':
 			{
-				ArgIn_Size = atoi (optarg);
+				int size = atoi (optarg);
+
+				if (size < 1 || size > L_MAX_PXL_SIZE)
+				{
+					argsOk = false;
+					fprintf (stderr, "%s is not a valid -s option's argument\n", optarg);
+				}
+				else
+					opt->lib.size = size;
 				break;
 			}
 
 			/* comma separated list of character ranges */
 			case 'r':
 			{
+				if (!strcmp (optarg, "all"))
+				{
+					opt->ranges_all = true;
+					break;
+				}
 				for (char *save, *range = strtok_r (optarg, ",", &save);
 				     range;
 				     range = strtok_r (NULL, ",", &save))
 				{
 					char *first; /* first character of the range */
 					char *last; /* last character of the range */
+					char *depth = strchr (range, ':'); /* bpp of the range */
 					char *next, *save;
 					
+					if (depth)
+						*depth++ = '\0';
 					first = last = strtok_r (range, "-", &save);
 					while ((next = strtok_r (NULL, "-", &save)) != NULL)
 						last = next;
 
-					ArgIn_UnicodeRanges = realloc (ArgIn_UnicodeRanges, sizeof (UnicodeRange_t) * (ArgIn_UnicodeRangesNum + 1));
-					if (ArgIn_UnicodeRanges == NULL)
+					opt->ranges = realloc (opt->ranges, sizeof (fontCvt_Range_t) * (opt->lib.ranges_num + 1));
+					if (opt->ranges == NULL)
 					{
 						argsOk = false;
 						fprintf (stderr, "ragnes allocation fail\n");
 						break;
 					}
-					ArgIn_UnicodeRanges[ArgIn_UnicodeRangesNum].first = atol (first);
-					ArgIn_UnicodeRanges[ArgIn_UnicodeRangesNum].last = atol (last);
+					memset (&opt->ranges[opt->lib.ranges_num], 0, sizeof (fontCvt_Range_t));
+					opt->ranges[opt->lib.ranges_num].first = atol (first);
+					opt->ranges[opt->lib.ranges_num].last = atol (last);
+					if (depth)
+					{
+						opt->ranges[opt->lib.ranges_num].bpp = atoi (depth);
+						opt->ranges_bpp = true;
+					}
 
-					if (ArgIn_UnicodeRanges[ArgIn_UnicodeRangesNum].first == 0
-					 || ArgIn_UnicodeRanges[ArgIn_UnicodeRangesNum].last == 0
-					 || ArgIn_UnicodeRanges[ArgIn_UnicodeRangesNum].first > ArgIn_UnicodeRanges[ArgIn_UnicodeRangesNum].last)
+					if (opt->ranges[opt->lib.ranges_num].first == 0
+					 || opt->ranges[opt->lib.ranges_num].last == 0
+					 || opt->ranges[opt->lib.ranges_num].first > opt->ranges[opt->lib.ranges_num].last)
 					{
 						argsOk = false;
 						fprintf (stderr, "invalid range\n");
 						break;
 					}
+					if (depth
+					 && opt->ranges[opt->lib.ranges_num].bpp != 1
+					 && opt->ranges[opt->lib.ranges_num].bpp != 2
+					 && opt->ranges[opt->lib.ranges_num].bpp != 4
+					 && opt->ranges[opt->lib.ranges_num].bpp != 8)
+					{
+						argsOk = false;
+						fprintf (stderr, "%s is not a valid range bpp\n", depth);
+						break;
+					}
 					/* range correctly acquired */
-					ArgIn_UnicodeRangesNum++;
+					opt->lib.ranges_num++;
+				}
+				break;
+			}
+
+			/* per glyph profiling */
+			case L_OPT_PROFILE:
+			{
+				opt->profile_top = optarg ? atoi (optarg) : 20;
+				if (opt->profile_top == 0)
+				{
+					argsOk = false;
+					fprintf (stderr, "%s is not a valid --profile option's argument\n", optarg);
+				}
+				break;
+			}
+
+			/* chrome trace of the glyph profile */
+			case L_OPT_TRACE:
+			{
+				opt->fname_trace = optarg;
+				if (opt->profile_top == 0)
+					opt->profile_top = 20;
+				break;
+			}
+
+			/* footprint report */
+			case L_OPT_REPORT:
+			{
+				optarg = "report";
+			}
+			/* fall through */
+
+			/* output builder */
+			case 'B':
+			{
+				const char **builders = realloc (opt->builders, sizeof (char *) * (opt->builders_num + 1));
+
+				if (builders == NULL)
+				{
+					argsOk = false;
+					fprintf (stderr, "builders allocation fail\n");
+					break;
+				}
+				opt->builders = builders;
+				opt->builders[opt->builders_num++] = optarg;
+				break;
+			}
+
+			/* glyph rendering mode */
+			case 'm':
+			{
+				if (!strcmp (optarg, "bitmap"))
+					opt->lib.mode = FONTCVTLIB_MODE_BITMAP;
+				else if (!strcmp (optarg, "sdf"))
+					opt->lib.mode = FONTCVTLIB_MODE_SDF;
+				else if (!strcmp (optarg, "outline"))
+					opt->lib.mode = FONTCVTLIB_MODE_OUTLINE;
+				else if (!strcmp (optarg, "metrics"))
+					opt->lib.mode = FONTCVTLIB_MODE_METRICS;
+				else
+				{
+					argsOk = false;
+					fprintf (stderr, "%s is not a valid -m option's argument\n", optarg);
+				}
+				break;
+			}
+
+			/* signed distance field spread */
+			case 'd':
+			{
+				opt->lib.sdf_spread = atoi (optarg);
+				if (opt->lib.sdf_spread < 2 || opt->lib.sdf_spread > 32)
+				{
+					argsOk = false;
+					fprintf (stderr, "%d is not a valid -d option's argument\n", opt->lib.sdf_spread);
+				}
+				break;
+			}
+
+			/* comma separated list of fixed sizes to compare with */
+			case 'c':
+			{
+				for (char *save, *size = strtok_r (optarg, ",", &save);
+				     size;
+				     size = strtok_r (NULL, ",", &save))
+				{
+					opt->compare_sizes = realloc (opt->compare_sizes, sizeof (uint16_t) * (opt->compare_sizes_num + 1));
+					if (opt->compare_sizes == NULL)
+					{
+						argsOk = false;
+						fprintf (stderr, "sizes allocation fail\n");
+						break;
+					}
+					opt->compare_sizes[opt->compare_sizes_num++] = atoi (size);
 				}
 				break;
 			}
@@ -150,14 +523,14 @@ int main (int argc, char *argv[])
 			/* output destination */
 			case 'o':
 			{
-				ArgIn_FnameOut = optarg;
+				opt->lib.output = optarg;
 				break;
 			}
 
 			/* option string to be passed to the builder */
 			case 'j':
 			{
-				ArgIn_BuilderOpt = optarg;
+				opt->lib.builder_opt = optarg;
 				break;
 			}
 
@@ -165,7 +538,7 @@ int main (int argc, char *argv[])
 			case 'h':
 			{
 				PrintHelp ( );
-				return 0;
+				return L_ARGS_HELP;
 			}
 
 			/* missing option argument */
@@ -186,10 +559,20 @@ int main (int argc, char *argv[])
 		}
 	}
 
+	if (opt->serve)
+	{	/* every job has its own font, output and ranges */
+		if (optind != argc)
+		{
+			argsOk = false;
+			fprintf (stderr, "--serve takes no input font file, jobs provide it\n");
+		}
+		return argsOk ? L_ARGS_OK : L_ARGS_ERROR;
+	}
+
 	/* the user most provide the input font file */
 	if (optind == argc -1)
 	{	/* we get the input font file name */
-		ArgIn_FnameFont = argv[optind];
+		opt->fname_font = argv[optind];
 	}
 	else
 	{	/* the user provided not even one or more than one input file name */
@@ -197,25 +580,198 @@ int main (int argc, char *argv[])
 		fprintf (stderr, "you must porvide at least one and only one input font file\n");
 	}
 
-	if (ArgIn_FnameOut == NULL)
+	if (opt->lib.output == NULL && opt->fname_font && ReportOnly (opt))
+	{	/* the font file names the report, no file is written */
+		const char *slash = strrchr (opt->fname_font, '/');
+
+		opt->lib.output = slash ? slash + 1 : opt->fname_font;
+	}
+	else if (opt->lib.output == NULL)
 	{
 		argsOk = false;
 		fprintf (stderr, "-o with specified output destination is mandatory\n");
 	}
 
-	if (ArgIn_UnicodeRangesNum == 0)
+	if (opt->ranges_all && opt->lib.ranges_num)
+	{
+		argsOk = false;
+		fprintf (stderr, "-r all can't be given with other ranges\n");
+	}
+
+	if (opt->lib.ranges_num == 0 && !opt->ranges_all)
 	{	/* you have provided no character range */
 		argsOk = false;
 		fprintf (stderr, "you must provide at least one character range (-r)\n");
 	}
 
-	if (argsOk)
-		Export ( );
+	if (opt->lib.shards_num && (opt->builders_num || opt->lib.builder_opt))
+	{
+		argsOk = false;
+		fprintf (stderr, "a shard has no builder, select them with fontcvt-merge\n");
+	}
 
-	return 0;
+	if (opt->bpps_num > 1)
+	{	/* render once at 8 bpp, the builders quantize it at their depth */
+		if (opt->lib.mode != FONTCVTLIB_MODE_BITMAP)
+		{
+			argsOk = false;
+			fprintf (stderr, "more -b depths need -m bitmap\n");
+		}
+		if (opt->lib.shards_num)
+		{
+			argsOk = false;
+			fprintf (stderr, "a shard has a single depth, give more -b depths to fontcvt-merge builders\n");
+		}
+		opt->lib.bpp = 8;
+		for (uint8_t k = 0; k < opt->bpps_num; k++)
+			opt->lib.mono_variant |= (opt->bpps[k] == 1 && opt->exact_mono);
+	}
+
+	if (opt->ranges_bpp)
+	{	/* the builders quantize the coverage at the depth of each range */
+		if (opt->lib.mode != FONTCVTLIB_MODE_BITMAP || opt->bpps_num > 1)
+		{
+			argsOk = false;
+			fprintf (stderr, "range bpp needs -m bitmap and a single -b depth\n");
+		}
+		for (uint16_t k = 0; k < opt->lib.ranges_num && opt->lib.bpp == 1; k++)
+		{
+			if (opt->ranges[k].bpp > 1)
+			{	/* there would be no coverage to quantize */
+				argsOk = false;
+				fprintf (stderr, "-b 1 glyphs are rendered black and white, give -b the highest range bpp\n");
+				break;
+			}
+		}
+	}
+
+	if (opt->budget)
+	{	/* the budget is of the C builder output, with the glyphs exact at a
+		lower bpp stored there. Its options come from -j, autobpp=0 added */
+		bool c_only = true;
+
+		for (uint8_t k = 0; k < opt->builders_num; k++)
+			c_only &= !strcmp (opt->builders[k], "c");
+		if (opt->lib.mode != FONTCVTLIB_MODE_BITMAP || opt->bpps_num > 1 || !c_only || opt->lib.shards_num)
+		{
+			argsOk = false;
+			fprintf (stderr, "--budget needs -m bitmap, a single -b depth, the C builder (-B c, options with -j) and no shard\n");
+		}
+		if (opt->bpps_num == 0)
+			opt->lib.bpp = 8; /* no -b: any bpp */
+		opt->budget_builder_opt = malloc (strlen ("autobpp=0,") + (opt->lib.builder_opt ? strlen (opt->lib.builder_opt) : 0) + 1);
+		if (opt->budget_builder_opt == NULL)
+		{
+			argsOk = false;
+			L_PRINT_GEN_ERR;
+		}
+		else
+		{
+			sprintf (opt->budget_builder_opt, "autobpp=0%s%s", opt->lib.builder_opt ? "," : "",
+				opt->lib.builder_opt ? opt->lib.builder_opt : "");
+			opt->lib.builder_opt = opt->budget_builder_opt;
+		}
+	}
+	else if (opt->drop_glyphs)
+	{
+		argsOk = false;
+		fprintf (stderr, "--drop-glyphs needs --budget\n");
+	}
+
+	if (opt->kern_prune)
+	{	/* the export is rendered in memory, pruned and replayed to the builders */
+		if (opt->fnames_corpus_num == 0)
+		{
+			argsOk = false;
+			fprintf (stderr, "--kern-budget needs --corpus\n");
+		}
+		if (opt->lib.shards_num || opt->lib.mono_variant)
+		{
+			argsOk = false;
+			fprintf (stderr, "--kern-budget can't be given with --shard or --exact-mono\n");
+		}
+	}
+	else if (opt->fnames_corpus_num && !opt->budget)
+	{
+		argsOk = false;
+		fprintf (stderr, "--corpus needs --budget or --kern-budget\n");
+	}
+
+	if (opt->lib.threads && opt->profile_top)
+	{
+		argsOk = false;
+		fprintf (stderr, "--profile and --trace need the export in a single thread, drop --threads\n");
+	}
+
+	opt->lib.ranges = opt->ranges;
+	return argsOk ? L_ARGS_OK : L_ARGS_ERROR;
+}
+
+/* Release the options allocated by ParseArgs.
+    Args:
+<opt>[in] options.
+    Ret:
+*/
+static void FreeOptions (Options_t *opt)
+{
+	free (opt->ranges);
+	free (opt->builders);
+	free (opt->compare_sizes);
+	free (opt->budget_builder_opt);
+	free (opt->fnames_corpus);
+	opt->ranges = NULL;
+	opt->builders = NULL;
+	opt->compare_sizes = NULL;
+	opt->budget_builder_opt = NULL;
+	opt->fnames_corpus = NULL;
+}
+
+/* Tell if the options ask only for footprint reports, so that no file is
+written.
+    Args:
+<opt>[in] options.
+    Ret:
+true if every builder is the report one and no statistics or budget file is
+saved.
+*/
+static bool ReportOnly (const Options_t *opt)
+{
+	if (opt->builders_num == 0 || opt->stats == L_STATS_JSON || opt->budget || opt->lib.shards_num)
+		return false;
+	for (uint8_t k = 0; k < opt->builders_num; k++)
+	{
+		if (strncmp (opt->builders[k], "report", strlen ("report"))
+		 || (opt->builders[k][strlen ("report")] != 0 && opt->builders[k][strlen ("report")] != ':'))
+			return false;
+	}
+	return true;
+}
+
+/* Run a daemon job: export with a face kept open by the daemon. The glyphs
+come from the daemon memory too, unless the job wants statistics or a
+profile of the rendering.
+    Args:
+<argc>[in] job argument's number.
+<argv>[in] job argument's list.
+    Ret:
+false if the job failed.
+*/
+static bool ServeJob (int argc, char *argv[])
+{
+	Options_t opt;
+	bool ok = false;
+
+	stats_Reset ( );
+	if (ParseArgs (argc, argv, &opt) == L_ARGS_OK && !opt.serve)
+	{
+		fontCvtLib_Face_t *face = serve_GetFace (opt.fname_font);
+
+		ok = (face != NULL) && Export (&opt, face);
+	}
+	FreeOptions (&opt);
+	return ok;
 }
 
-//_____________________________________________________________PRIVATE FUNCTIONS
 /* Print help using the command line arguments.
     Args:
     Ret:
@@ -228,293 +784,359 @@ fontcvt use:\n\
     fontcvt [OPTIONS] ... FONT_FILE -o OUTPUT_NAME\n");
 	printf ("\n");
 	printf ("\
--b) Set exported glyph bpp. Valid argument are 1,2,4,8. (default 4)\n");
+-b) Set exported glyph bpp. Valid argument are 1,2,4,8. (default 4)\n\
+    A comma separated list, ex. 1,2,4, renders the glyphs once at 8 bpp and\n\
+    every builder writes one output per depth, named OUTPUT_NAME_<bpp>bpp.\n\
+    The kerning is computed once for all of them.\n");
 	printf ("\
 -s) Set exported glyph pixel size. This is the size in pixel of the scaled EM\n\
-    square. (default 30)\n");
+    square, 1 to 1024. (default 30)\n");
 	printf ("\
 -r) Comma separated list of unicode characters to export. Valid range are ex.\n\
     32-128,1020 to export characters between 32 and 128 included and the lonely\n\
-    1020 character.\n");
+    1020 character. 'all' exports every character of the font, in ranges\n\
+    split where the font has no glyphs. :bpp after a range sets its bpp in\n\
+    the C builder, ex. 32-126:4,19968-40959:2; -b is the default.\n");
+	printf ("\
+-m) Set the glyph rendering mode. Valid arguments are:\n\
+      bitmap: anti-aliased coverage bitmaps. (default)\n\
+      sdf: signed distance fields quantized at the -b bpp. A single table can\n\
+        be rendered at any size by the runtime.\n\
+      outline: glyph outlines with flattened curves, rendered at any size by\n\
+        the runtime rasterizer. Good for big glyphs.\n\
+      metrics: advances and kerning only, nothing is rendered. The default\n\
+        builder is metrics: a table for measuring text on a host with the\n\
+        device widths (fontMetrics.h).\n");
+	printf ("\
+-d) Set the signed distance field spread in pixel. Valid arguments are 2 to 32.\n\
+    (default 2)\n");
 	printf ("\
--o) Specify the output filename. (mandatory)\n");
+-c) Comma separated list of pixel sizes. With -m sdf report the flash needed by\n\
+    one bitmap table per size against the single distance field table.\n");
+	printf ("\
+-o) Specify the output filename. (mandatory, but with --report alone)\n");
+	printf ("\
+-B) Select an output builder as name[:options], options are comma separated\n\
+    like -j and override it. Repeat -B to get more outputs from a single\n\
+    render pass. out=<name> sets the output name of the builder, a builder can\n\
+    be selected again with another output. Example: -B c -B report\n\
+    -B cpp:out=arial_cpp -B c:format=bin,out=arial_bin.\n\
+    Builders (default c):\n");
+	builderRegistry_PrintHelp (stdout);
+	printf ("\
+-j) Options for the builders selected without options. Ex. -j format=bin\n");
 	printf ("\
--j) Command separated list of options for the specific builder builder.\n\
-    Example: -j\"format=bin,binpath=S:path/to/bin/file\"\n\
     C builder options:\n\
       format=bin: save the bit.\n\
-      binpath=<path>: set the base path for the binary referenced in the font.\n");
+      binpath=<path>: set the base path for the binary referenced in the font.\n\
+      pixfmt=rgb565|rgb332|l8: pre-blend glyphs in this native pixel format.\n\
+      fg=<RRGGBB>: pre-blending foreground color. (default FFFFFF)\n\
+      bg=<RRGGBB>: pre-blending background color. (default 000000)\n\
+      palette=on: store pre-blended colors as indexes inside a palette.\n\
+      atlas=<width>: pack the bitmaps inside 2D atlas pages this wide.\n\
+      atlasheight=<height>: atlas pages height. (default same as width)\n\
+      atlaspad=<pixels>: empty pixels between atlas glyphs. (default 1)\n\
+      autobpp=<error>: store each glyph at the lowest bpp whose coverage is\n\
+        within <error> (0-255) of the range bpp one. 0 keeps only the exact.\n\
+      order=<file>: lay the bitmaps out by the frequency of the characters in\n\
+        the UTF-8 text <file>, then by first occurrence: a list of characters\n\
+        gives its own order. Descriptors stay in codepoint order.\n\
+      page=<bytes>: flash page of the order locality report. (default 4096)\n");
+	printf ("\
+--exact-mono) With more -b depths, render the 1 bpp output in FreeType mono\n\
+    mode as -b 1 alone does, instead of quantizing the 8 bpp coverage.\n");
+	printf ("\
+--budget=BYTES[K|M]) Fit the C builder output in BYTES of flash: lower the\n\
+    bpp of the ranges (-b or a range :bpp is the highest, any without them),\n\
+    store the glyphs exact at a lower bpp there (autobpp=0) and split the\n\
+    ranges where the font has no glyphs, choosing the least quality loss.\n\
+    The configuration found, with its estimated bytes, coverage and error,\n\
+    is saved in OUTPUT_NAME.budget.txt as a fontcvt command line.\n");
+	printf ("\
+--corpus=FILE) UTF-8 text weighing the characters of --budget and the pairs\n\
+    of --kern-budget: the error of the characters used most counts most.\n\
+    Repeat it to give more texts.\n");
+	printf ("\
+--drop-glyphs) --budget can leave out characters, the least used first.\n");
+	printf ("\
+--kern-budget=N) Keep at most N kerning pairs, the ones moving the --corpus\n\
+    characters most (occurrences times pixels); the pairs the corpus never\n\
+    has are dropped. Print the pairs kept and dropped and the layout error.\n");
+	printf ("\
+--stats[=json]) Print time spent in each conversion phase, counters and peak\n\
+    memory. With json the statistics are saved in OUTPUT_NAME.stats.json.\n");
+	printf ("\
+--profile[=N]) Profile every glyph. Print the N most expensive glyphs (default\n\
+    20) and a glyph cost histogram.\n");
+	printf ("\
+--trace=FILE) Profile every glyph and save a chrome trace JSON in FILE.\n");
+	printf ("\
+--report) Same as -B report: print the flash the output would take by section\n\
+    and by range, and estimate it at every bpp, with identical bitmaps stored\n\
+    once, with compressed bitmaps and with sparse ranges split. Alone it writes\n\
+    no output.\n");
+	printf ("\
+--serve[=SOCKET]) Run as a daemon: read jobs from the standard input, or from\n\
+    the clients of the Unix socket SOCKET, one JSON object per line, e.g.\n\
+      {\"id\": 1, \"args\": [\"-s16\", \"-r32-126\", \"-o\", \"out\", \"font.ttf\"]}\n\
+    Faces and rendered glyphs are kept between jobs. Add \"watch\": true to\n\
+    run a job again when its font changes, \"manifest\": \"FILE\" runs the jobs\n\
+    listed in FILE. Every job is answered with its timings.\n");
+	printf ("\
+--shard=i/N) Render only shard i (from 0) of N and save it in\n\
+    OUTPUT_NAME.shard. The characters are split in batches of 256 going to the\n\
+    shards in turn. fontcvt-merge makes the outputs from all the N shards.\n");
+	printf ("\
+--threads=N) Export through a pipeline: a thread looks up the glyphs, N\n\
+    threads render them and compute the kerning, and the builders pack the\n\
+    bitmaps and write the output in order in the calling thread. N sets the\n\
+    render stage only, the other stages have one thread. The output is the\n\
+    same as without --threads. --stats adds the mean occupancy of the queues\n\
+    and the times they were found full or empty.\n");
+	printf ("\
+--queue-depth=N) Batches of 256 characters each pipeline queue holds.\n\
+    (default 8)\n");
 	printf ("\
 -h) Print this help and exit.\n");
 }
 
-/* Main program function, called after all input oprions are parsed.
+/* Main program function, called after all input oprions are parsed: open the
+face and export it with the selected builders.
     Args:
+<opt>[in] command line options, -r all sets the ranges.
+<face>[in] face kept open by the daemon, NULL to open the font file.
     Ret:
+false on error.
 */
-static void Export (void)
+static bool Export (Options_t *opt, fontCvtLib_Face_t *face)
 {
-	FT_Library library; /* handle to library */
-	FT_Face face; /* handle to face object */
-	FT_Error error;
-
-	/* initialize builders */
-	builderForC_Init ( );
-
-	error = FT_Init_FreeType (&library);
-	if (!error)
+	fontCvt_Builder_t *builder = &builderRegistry_FanOut;
+	fontCvtLib_Face_t *own_face = NULL;
+	corpus_Corpus_t *corpus = NULL;
+	void *builder_ctx;
+	bool selected = true;
+	bool ok = false;
+
+	builder_ctx = builder->create ( );
+	if (builder_ctx == NULL)
 	{
-		/* open the font face specified for the given font file.
-		   Font faces example are Regular, Italic, Bold ...
-		   Most fonts provvide one font face per file.
-		*/
-		error = FT_New_Face (library, ArgIn_FnameFont, 0, &face );
-		if (!error)
-		{
-			/* scale the font to the given pixel size.
-			   scaleing the font means scaling the font's EM square, witch is
-			   the reference grid for the glyph's outlines.
-			*/
-			error = FT_Set_Pixel_Sizes (face, /* handle to face object */
-				0, /* pixel_width (0 means same as pxel_height) */
-				ArgIn_Size); /* pixel_height */
-			if (!error)
-			{
-				DoExportFont (&builderForC_Builder, /* target bulder */
-					face, /* font face pointer */
-					ArgIn_UnicodeRanges,
-					ArgIn_UnicodeRangesNum);
-			}
-			else
-				L_PRINT_GEN_ERR;
-		}
-		else
-			L_PRINT_GEN_ERR;
-	}
-	else
 		L_PRINT_GEN_ERR;
-}
-
-/* Function description.
-    Args:
-    Ret:
-*/
-static void DoExportFont (fontCvt_Builder_t *builder, FT_Face face, UnicodeRange_t *ranges, uint8_t ranges_sz)
-{
-	{
-		fontCvt_Font_t itfc_font;
-
-		itfc_font.bpp = ArgIn_Bpp;
-		itfc_font.pxl_baseline_to_baseline = face->size->metrics.height >> 6;
-		itfc_font.pxl_em_square = face->size->metrics.y_ppem;
-		/* TODO ???
-		check https://www.freetype.org/freetype2/docs/tutorial/step2.html
-		and look for 'ascender' 'descender' */
-		itfc_font.pxl_max_glyph_height = (face->size->metrics.ascender - face->size->metrics.descender) >> 6;
-
-		/* this identifies the builder's export procedure start */
-		builder->startFont (&itfc_font, ArgIn_FnameOut, ArgIn_BuilderOpt);
+		return false;
 	}
-
-	/* for all the specified ranges */
-	for (uint8_t range_idx = 0; range_idx < ranges_sz; range_idx++)
+	/* the C builder is the default one, the metrics one in metrics mode. With
+	more depths every builder is selected at each of them */
+	for (uint8_t j = 0; j < ((opt->bpps_num > 1) ? opt->bpps_num : 1); j++)
 	{
-		UnicodeRange_t *range; /* current uncode range */
+		uint8_t bpp = (opt->bpps_num > 1) ? opt->bpps[j] : 0;
 
-		range = &ranges[range_idx];
+		for (uint8_t k = 0; k < opt->builders_num; k++)
+			selected &= builderRegistry_Select (builder_ctx, opt->builders[k], opt->lib.output, opt->lib.builder_opt, bpp);
+		if (opt->builders_num == 0 && opt->lib.shards_num == 0)
 		{
-			fontCvt_Range_t itfc_range;
-
-			itfc_range.first = range->first;
-			itfc_range.last = range->last;
-			/* we say the builder we are going to export this character range */
-			builder->startRange (&itfc_range);
+			selected &= builderRegistry_Select (builder_ctx, (opt->lib.mode == FONTCVTLIB_MODE_METRICS) ? "metrics" : "c",
+				opt->lib.output, opt->lib.builder_opt, bpp);
 		}
+	}
+	if (!selected)
+	{
+		builder->destroy (builder_ctx);
+		return false;
+	}
 
-		/* for all the characters inside the current range */
-		for (wchar_t letter = range->first; letter <= range->last; letter++)
+	if (opt->stats != L_STATS_NONE)
+		stats_Enable ( );
+	if (opt->profile_top)
+		stats_EnableProfile (opt->fname_trace != NULL);
+
+	if (face == NULL)
+		face = own_face = fontCvtLib_OpenFace (opt->fname_font);
+	if (face && opt->ranges_all)
+	{	/* the ranges come from the font */
+		free (opt->ranges);
+		opt->lib.ranges_num = fontCvtLib_Coverage (face, &opt->ranges);
+		opt->lib.ranges = opt->ranges;
+		if (opt->lib.ranges_num == 0)
 		{
-			FT_Error error;
-			FT_UInt glyph_idx; /* glyph index of this letter */
-			fontCvt_Character_t itfc_character;
-			char *pxlmap = NULL;
-
-			/* set default values for this glyph */
-			memset (&itfc_character, 0, sizeof (itfc_character));
-			itfc_character.unicode = letter;
+			fprintf (stderr, "the font has no character\n");
+			fontCvtLib_CloseFace (own_face);
+			face = NULL;
+		}
+	}
+	if (face && opt->fnames_corpus_num
+	 && (corpus = corpus_Load (opt->fnames_corpus, opt->fnames_corpus_num)) == NULL)
+	{
+		fontCvtLib_CloseFace (own_face);
+		face = NULL;
+	}
+	if (face && opt->budget && !Budget (face, opt, corpus))
+	{
+		fontCvtLib_CloseFace (own_face);
+		face = NULL;
+	}
+	if (face)
+	{
+		uint32_t bitmaps_size;
+
+		if (opt->lib.shards_num)
+			ok = ExportShard (face, opt);
+		else if (opt->kern_prune)
+			ok = ExportPruned (face, opt, corpus, builder, builder_ctx, &bitmaps_size);
+		else if (own_face || opt->stats != L_STATS_NONE || opt->profile_top || opt->lib.mono_variant || opt->budget)
+			ok = fontCvtLib_Export (face, &opt->lib, builder, builder_ctx, &bitmaps_size);
+		else
+		{	/* daemon: the glyphs rendered by a previous job are exported again */
+			const builderMemory_Font_t *font = serve_GetRender (face, &opt->lib);
 
-			glyph_idx = FT_Get_Char_Index (face, letter);
-			if (glyph_idx)
-			{
-				error = FT_Load_Glyph (face, /* handle to face object */
-					glyph_idx, /* glyph index */
-					FT_LOAD_DEFAULT); /* load flags */
-				if (!error)
-				{
-					FT_Render_Mode renderMode = FT_RENDER_MODE_NORMAL;
-
-					/* convert glyph to bitmap */
-					if (ArgIn_Bpp == 1)
-						renderMode = FT_RENDER_MODE_MONO;
-					error = FT_Render_Glyph (face->glyph, /* glyph slot  */
-						renderMode); /* render mode */
-					if (!error)
-					{
-						FT_Bitmap *bitmap;
-
-						bitmap = &face->glyph->bitmap;
-						pxlmap = calloc (bitmap->width, bitmap->rows);
-						if (pxlmap)
-						{
-							itfc_character.pxl_left = face->glyph->bitmap_left;
-							itfc_character.pxl_top = face->glyph->bitmap_top;
-							itfc_character.bmp_pxl_width = bitmap->width;
-							itfc_character.bmp_pxl_height = bitmap->rows;
-							itfc_character.pxl_advance = face->glyph->advance.x >> 6;
-							itfc_character.bmp = pxlmap;
-
-							ConvertBitmap (bitmap, pxlmap);
-						}
-						else
-							L_PRINT_GEN_ERR;
-					}
-					else
-						L_PRINT_GEN_ERR;
-				}
-				else
-					L_PRINT_GEN_ERR;
-			}
-			else
-			{	/* there is no glyph for this character code
-				we export an empty glpyph */
-			}
+			ok = (font != NULL) && fontCvtLib_Replay (font, &opt->lib, builder, builder_ctx, &bitmaps_size);
+		}
+		if (ok && opt->lib.mode == FONTCVTLIB_MODE_SDF && opt->compare_sizes_num)
+			ReportSdfSavings (face, opt, bitmaps_size);
+		fontCvtLib_CloseFace (own_face);
+	}
+	builder->destroy (builder_ctx);
+	corpus_Free (corpus);
 
-			/* give this character to the builder for export. do this also for
-			unavailable glyphs */
-			builder->startCharacter (&itfc_character);
-			DoExportKerinig (builder, face, letter, ranges, ranges_sz);
-			builder->endCharacter ( );
+	if (opt->profile_top)
+		stats_PrintProfile (stdout, opt->profile_top);
+	if (opt->fname_trace && !stats_WriteTrace (opt->fname_trace))
+		L_PRINT_GEN_ERR;
+	if (opt->stats == L_STATS_TEXT)
+		stats_Print (stdout, false);
+	else if (opt->stats == L_STATS_JSON)
+	{
+		char fname[256];
+		FILE *f;
 
-			if (pxlmap)
-				free (pxlmap);
+		snprintf (fname, sizeof (fname), "%s.stats.json", opt->lib.output);
+		if ((f = fopen (fname, "wb")) != NULL)
+		{
+			stats_Print (f, true);
+			fclose (f);
 		}
-
-		/* we say the builder this range it's over */
-		builder->endRange ( );
+		else
+			L_PRINT_GEN_ERR;
 	}
-
-	/* finalize the export procedure. This call should delate any garbage and
-	   put the peces together to conclude the export.
-	*/
-	builder->endFont ( );
+	return ok;
 }
 
-/* Export all the kerning information for this character in respect to all the
-other exported characters.
+/* Render the shard of the options and save it in OUTPUT_NAME.shard, see
+shard.h.
     Args:
+<face>[in] font face.
+<opt>[in] command line options.
     Ret:
+false on error.
 */
-static void DoExportKerinig (fontCvt_Builder_t *builder, FT_Face face, wchar_t left_char, UnicodeRange_t *ranges, uint8_t ranges_sz)
+static bool ExportShard (fontCvtLib_Face_t *face, const Options_t *opt)
 {
-	FT_UInt l_glyph_idx; /* left glyph index */
-
-	l_glyph_idx = FT_Get_Char_Index (face, left_char);
-	if (l_glyph_idx)
-	{
-		for (uint8_t j = 0; j < ranges_sz; j++)
-		{
-			UnicodeRange_t *range = &ranges[j];
-
-			for (wchar_t right_char = range->first; right_char <= range->last; right_char++)
-			{
-				FT_UInt r_glyph_idx; /* right glyph index */
-				FT_Vector delta; /* kerning adjustment */
-				
-				r_glyph_idx = FT_Get_Char_Index (face, right_char);
-				if (r_glyph_idx)
-				{
-					uint16_t x_pxl_adj; /* x pixel adjustment */
-
-					FT_Get_Kerning (face, l_glyph_idx, r_glyph_idx, FT_KERNING_DEFAULT, &delta);
-					x_pxl_adj = delta.x >> 6;
-					if (x_pxl_adj)
-					{
-						fontCvt_Kerning_t kerning;
-
-						kerning.left_char = left_char;
-						kerning.right_char = right_char;
-						kerning.x_pxl_adjust = x_pxl_adj;
-						builder->putKerning (&kerning);
-					}
-				}
-			}
-		}
-	}
+	builderMemory_Font_t *font = fontCvtLib_Render (face, &opt->lib);
+	char fname[256];
+	bool ok;
+
+	if (font == NULL)
+		return false;
+	snprintf (fname, sizeof (fname), "%s.shard", opt->lib.output);
+	stats_Begin (STATS_PHASE_FILE_IO);
+	ok = shard_Save (fname, &opt->lib, font);
+	stats_End (STATS_PHASE_FILE_IO);
+	builderMemory_Free (font);
+	return ok;
 }
 
+/* Fit the export in the flash budget: render it at 8 bpp, look for the
+configuration with the least quality loss and make it the export one. The
+configuration is saved in OUTPUT_NAME.budget.txt.
+    Args:
+<face>[in] font face.
+<opt>[in/out] command line options, the ranges and the bpp are replaced.
+<corpus>[in] corpus, can be NULL.
+    Ret:
+false on error.
+*/
+static bool Budget (fontCvtLib_Face_t *face, Options_t *opt, const corpus_Corpus_t *corpus)
+{
+	fontCvtLib_Options_t render = opt->lib;
+	builderMemory_Font_t *font;
+	kerning_Result_t pruned;
+	budget_Result_t result;
+	char fname[256];
+	bool ok;
+
+	render.bpp = 8; /* every bpp is quantized from it */
+	font = fontCvtLib_Render (face, &render);
+	/* the budget counts the kerning pairs left by the pruning */
+	ok = (font != NULL) && (!opt->kern_prune || kerning_Prune (font, corpus, opt->kern_budget, &pruned))
+	  && budget_Optimize (font, &opt->lib, corpus, opt->budget, opt->drop_glyphs, &result);
+	builderMemory_Free (font);
+	if (!ok)
+		return false;
+
+	free (opt->ranges);
+	opt->ranges = result.ranges;
+	opt->lib.ranges = result.ranges;
+	opt->lib.ranges_num = result.ranges_num;
+	opt->lib.bpp = result.bpp;
+	snprintf (fname, sizeof (fname), "%s.budget.txt", opt->lib.output);
+	budget_Save (fname, &result, &opt->lib, opt->fname_font, opt->budget);
+	if (result.bytes > opt->budget)
+		fprintf (stderr, "budget of %u bytes not reached, %u bytes is the least found\n", opt->budget, result.bytes);
+	printf ("budget: %u of %u bytes (%u as asked), %.2f%% drawn, %u characters left out, error %.2f (%.2f as asked)\n",
+		result.bytes, opt->budget, result.start_bytes, 100.0 * result.coverage, result.dropped,
+		result.error, result.start_error);
+	return true;
+}
 
-/* Convert the bitmap provided by FreeType in a simpler format, if we can say so.
-Always 8bit per pixel (also in monotone) and no padding bytes. This should
-simplify the work inside the builder.
+/* Export with only the kerning pairs the corpus needs: render in memory, prune
+the pairs and replay the font to the builders.
     Args:
-<ft_bmp>[in] FreeType bitmap.
-<pxlmap>[out] destination pxlmap. You must provide an array with enough space.
+<face>[in] font face.
+<opt>[in] command line options.
+<corpus>[in] corpus.
+<builder>[in] target builder.
+<builder_ctx>[in] builder context.
+<bitmaps_size>[out] bitmaps bytes of the exported font.
     Ret:
+false on error.
+*/
+static bool ExportPruned (fontCvtLib_Face_t *face, const Options_t *opt, const corpus_Corpus_t *corpus,
+	fontCvt_Builder_t *builder, void *builder_ctx, uint32_t *bitmaps_size)
+{
+	builderMemory_Font_t *font = fontCvtLib_Render (face, &opt->lib);
+	kerning_Result_t result;
+	bool ok;
+
+	if (font == NULL)
+		return false;
+	ok = kerning_Prune (font, corpus, opt->kern_budget, &result)
+	  && fontCvtLib_Replay (font, &opt->lib, builder, builder_ctx, bitmaps_size);
+	if (ok)
+		kerning_Print (stdout, &result);
+	builderMemory_Free (font);
+	return ok;
+}
 
+/* Print the flash needed by one coverage bitmap table for each of the compare
+sizes against the single signed distance field table just exported.
+    Args:
+<face>[in] font face.
+<opt>[in] command line options.
+<sdf_bytes>[in] bitmaps size of the distance field table.
+    Ret:
 */
-void ConvertBitmap (FT_Bitmap *ft_bmp, char *pxlmap)
+static void ReportSdfSavings (fontCvtLib_Face_t *face, const Options_t *opt, uint32_t sdf_bytes)
 {
-	if (ft_bmp->pixel_mode == FT_PIXEL_MODE_MONO
-	 || ft_bmp->pixel_mode == FT_PIXEL_MODE_GRAY)
-	{
-		char *destPxl; /* destination pixel pointer */
-		/* source byte pointer
-		   based on the source bitmap representation mode this could contain
-		   more than one pixel */
-		const uint8_t *srcByte;
-		uint8_t bpp; /* source bitmap bit per pixel */
-
-		/* 1 - 8 bit per pixel format supported only */
-		if (ft_bmp->pixel_mode == FT_PIXEL_MODE_MONO)
-			bpp = 1;
-		else if (ft_bmp->pixel_mode == FT_PIXEL_MODE_GRAY)
-			bpp = 8;
-
-		destPxl = pxlmap;
-		for (uint8_t y = 0; y < ft_bmp->rows; y++)
-		{
-			/* bit offset of the pixel rappresentation inside the source byte */
-			int8_t bit_pos = 8 - bpp;
+	uint32_t fixed_total = 0;
 
-			/* set the source to the start of the next line */
-			srcByte = ft_bmp->buffer;
-			srcByte += y * ft_bmp->pitch;
-			for (uint8_t x = 0; x < ft_bmp->width; x++)
-			{
-				uint8_t gray_val; /* destination pixel gray value, always from 0 to 255 */
-				/* bitmask of the source pixel rappresentation inside the source
-				   byte */
-				uint8_t bitMask;
-
-				bitMask = (0x01 << bpp) - 1; /* [0b00000001 with bpp = 1] [0b00001111 with bpp = 4] etc */
-				bitMask <<= bit_pos;
-				gray_val = (*srcByte & bitMask) >> bit_pos;
-				gray_val <<= (8 - bpp);
-
-				*destPxl = gray_val;
-
-				bit_pos -= bpp;
-				if (bit_pos < 0)
-				{	/* no more pixels inside this byte, move to the next */
-					bit_pos = 8 - bpp;
-					srcByte++;
-				}
-				destPxl++;
-			}
-		}
-	}
-	else
+	printf ("sdf bitmaps: %u bytes at %d px, spread %d, %d bpp\n",
+		sdf_bytes, opt->lib.size, opt->lib.sdf_spread, opt->lib.bpp);
+	for (uint16_t k = 0; k < opt->compare_sizes_num; k++)
 	{
-		/* other formats not supported */
+		uint32_t bytes = fontCvtLib_FixedSizeBitmapsSize (face, &opt->lib, opt->compare_sizes[k]);
+
+		printf ("  fixed %3d px bitmaps: %u bytes\n", opt->compare_sizes[k], bytes);
+		fixed_total += bytes;
 	}
+	printf ("  fixed sizes total: %u bytes, sdf saves %d bytes (%.1f%%)\n", fixed_total,
+		(int)(fixed_total - sdf_bytes),
+		fixed_total ? 100.0 * ((double)fixed_total - sdf_bytes) / fixed_total : 0.0);
 }
@@ -31,15 +31,27 @@ typedef struct
 	uint16_t pxl_baseline_to_baseline;
 	uint16_t pxl_max_glyph_height;
 	uint16_t pxl_em_square;
+	/* box holding the bitmap of any glyph of the font (pixel), from the font
+	bounding box. 0 if the font has none (bitmap fonts) */
+	uint16_t pxl_max_bmp_width;
+	uint16_t pxl_max_bmp_height;
+	/* signed distance field spread (pixel). 0 means glyph bitmaps are coverage,
+	otherwise they are distances: 128 (before bpp quantization) is the outline */
+	uint16_t sdf_spread;
+	/* not 0 if characters carry outlines instead of bitmaps */
+	uint16_t outline;
 } fontCvt_Font_t;
 
 typedef struct
 {
 	wchar_t first;
 	wchar_t last;
+	/* bpp of the range bitmaps, 0 for the font one. Builders not supporting
+	mixed depths store the range at the font bpp */
+	uint16_t bpp;
 } fontCvt_Range_t;
 
-typedef struct
+typedef struct fontCvt_Character_s
 {	/* character caracteristics */
 	wchar_t unicode; /* character unicode value */
 	uint16_t bmp_pxl_width;
@@ -48,6 +60,22 @@ typedef struct
 	int16_t pxl_left; /* bitmap's left edge position relative to the pen position */
 	int16_t pxl_top; /* bitmap's top edge position relative to the pen position */
 	uint16_t pxl_advance; /* advance the pen position this amount for the next character */
+	/* encoded outline (see FONTBUILDERFORC_PIXFMT_OUTLINE), the bmp_xxx fields
+	are the outline box */
+	const uint8_t *outline;
+	uint32_t outline_sz;
+	/* batched interface only: pairs with this character on the left. They
+	follow the pairs of the previous characters of the batch */
+	uint16_t kerning_num;
+	/* glyph index of the character inside the font, 0 if it has none.
+	Characters with the same glyph have the same bitmap (or outline) and
+	metrics, a builder can store the bitmap once */
+	uint32_t glyph_idx;
+	/* exports with an exact 1 bpp variant (fontCvtLib_Options_t.mono_variant):
+	the glyph rendered in FreeType mono mode, with its own bitmap box. The fan
+	out gives it in place of the character to the builders exporting at 1 bpp.
+	NULL otherwise */
+	const struct fontCvt_Character_s *mono;
 } fontCvt_Character_t;
 
 typedef struct
@@ -58,14 +86,26 @@ typedef struct
 } fontCvt_Kerning_t;
 
 typedef struct
-{
-	void (*startFont) (fontCvt_Font_t *font, const char *output, const char *options);
-	void (*startRange) (fontCvt_Range_t *range);
-	void (*startCharacter) (fontCvt_Character_t *character);
-	void (*putKerning) (fontCvt_Kerning_t *kerning);
-	void (*endCharacter) (void);
-	void (*endRange) (void);
-	void (*endFont) (void);
+{	/* a builder can run many exports at once, even on different threads: the
+	state of an export lives in the context made by create and is given back to
+	every callback */
+	void *(*create) (void); /* new export context, NULL on allocation fail */
+	void (*destroy) (void *ctx);
+	void (*startFont) (void *ctx, fontCvt_Font_t *font, const char *output, const char *options);
+	void (*startRange) (void *ctx, fontCvt_Range_t *range);
+	void (*startCharacter) (void *ctx, fontCvt_Character_t *character);
+	void (*putKerning) (void *ctx, fontCvt_Kerning_t *kerning);
+	void (*endCharacter) (void *ctx);
+	void (*endRange) (void *ctx);
+	void (*endFont) (void *ctx);
+	/* optional batched interface, used in place of startCharacter, putKerning
+	and endCharacter when putCharacters is set. A range is given in batches of
+	consecutive characters: putCharacters with the characters of the batch,
+	their bitmaps in one contiguous arena, then always putKernings with the
+	pairs having those characters on the left, in the same order. The arrays
+	are valid until the callback returns */
+	void (*putCharacters) (void *ctx, fontCvt_Character_t *characters, uint32_t num);
+	void (*putKernings) (void *ctx, fontCvt_Kerning_t *kernings, uint32_t num);
 } fontCvt_Builder_t;
 
 //____________________________________________________________________GLOBAL VAR
@@ -0,0 +1,1948 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* libfontcvt: the whole conversion as a library. Open a face once, then
+export it as many times as needed with different options to any builder, or
+render it in memory with fontCvtLib_Render for previews. The fontcvt command
+line tool is a wrapper around this library.
+
+An export can run as a pipeline (opt->threads): a resolve stage looks up the
+glyph of every character, render stage threads load, render and convert the
+glyphs and compute the kerning pairs, and the calling thread emits the batches
+to the builder in their order. The stages pass batches of L_BATCH_CHARACTERS
+through bounded lock-free queues; the batches go back to the resolve stage
+through a free queue, so the memory of an export is bounded too. Packing the
+bitmaps is up to the builders, so it is part of the emit stage.
+
+The metrics mode renders nothing: the advances of the glyphs of the export are
+read in bulk with FT_Get_Advances before the batches, and the characters carry
+only their advance and kerning pairs. They are the same the bitmap modes give,
+because FT_Get_Advances hints them as FT_Load_Glyph does. */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "fontCvtLib.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+// FreeType 2 library headers
+#include "ft2build.h"
+#include FT_FREETYPE_H
+#include FT_MODULE_H
+#include FT_OUTLINE_H
+#include FT_ADVANCES_H
+
+#include "builderRegistry.h"
+#include "queue.h"
+#include "stats.h"
+
+
+#define L_PRINT_GEN_ERR                                fprintf (stderr, "ERROR ON %s:%d\n", __FILE__, __LINE__)
+#define L_MAX(a, b)                                    (((a) >= (b)) ? (a) : (b))
+#define L_MIN(a, b)                                    (((a) <= (b)) ? (a) : (b))
+
+/* characters rendered before giving them to the builder */
+#define L_BATCH_CHARACTERS                             256
+/* batches each pipeline queue holds when opt->queue_depth is 0 */
+#define L_QUEUE_DEPTH                                  8
+/* characters without a glyph fontCvtLib_Coverage keeps inside a range rather
+than starting a new one: the C builder character and range descriptors take
+the same space */
+#define L_COVERAGE_MAX_GAP                             1
+/* metrics mode: glyphs FT_Get_Advances reads at most in a call, and unused
+glyphs read rather than starting a new call */
+#define L_ADVANCES_RUN                                 4096
+#define L_ADVANCES_GAP                                 32
+
+/* outline coordinates fractional bits, as FONTBUILDERFORC_OUTLINE_FRAC_BITS */
+#define L_OUTLINE_FRAC_BITS                            4
+/* max distance between a flattened curve and its segments (26.6) */
+#define L_OUTLINE_TOLERANCE                            16
+#define L_OUTLINE_MAX_SEGMENTS                         16
+
+typedef struct
+{	/* entry of the character map of a face */
+	uint32_t unicode;
+	FT_UInt glyph_idx;
+} CharGlyph_t;
+
+struct fontCvtLib_Face_s
+{	/* every face has its own library, FreeType libraries can't be shared
+	between threads */
+	FT_Library library;
+	FT_Face face;
+	/* characters of the face with a glyph sorted by unicode, from a single
+	walk of the charmap. Lookups don't touch FreeType, so exports can share
+	it between threads */
+	CharGlyph_t *chars;
+	uint32_t chars_num;
+	/* where the face comes from, to open a copy for each render thread */
+	char *fname; /* NULL for a face in memory */
+	const void *data;
+	size_t size;
+};
+
+typedef struct
+{	/* outline being flattened */
+	FT_Pos x_org; /* outline box left edge (26.6) */
+	FT_Pos y_org; /* outline box top edge (26.6) */
+	FT_Vector last; /* current point (26.6) */
+	int16_t *points; /* flattened x, y pairs relative to the box, y downward */
+	uint32_t points_num;
+	uint32_t points_max;
+	uint32_t *contour_starts; /* first point of each contour */
+	uint16_t contours_num;
+	bool error;
+} FlatOutline_t;
+
+typedef struct
+{	/* bitmaps (or outlines) one after the other */
+	uint8_t *data;
+	uint32_t size;
+	uint32_t max;
+} Arena_t;
+
+typedef struct
+{	/* glyph of many characters of the export, rendered once */
+	FT_UInt glyph_idx;
+	fontCvt_Character_t character; /* metrics, the bitmap is in the shared arena */
+	uint32_t offset; /* shared arena offset of the bitmap, UINT32_MAX if none */
+	uint32_t size; /* bytes of the bitmap in the arena */
+} SharedGlyph_t;
+
+typedef struct
+{	/* batch of consecutive characters going through the export */
+	uint32_t seq; /* batch number inside the export */
+	wchar_t first;
+	wchar_t last;
+	FT_UInt glyph_idxs[L_BATCH_CHARACTERS]; /* glyph of each character, 0 if missing */
+	fontCvt_Character_t characters[L_BATCH_CHARACTERS];
+	uint32_t offsets[L_BATCH_CHARACTERS]; /* arena offset of each bitmap, the arena moves while it grows */
+	fontCvt_Character_t monos[L_BATCH_CHARACTERS]; /* mono variants, opt->mono_variant */
+	uint32_t mono_offsets[L_BATCH_CHARACTERS];
+	uint32_t characters_num;
+	fontCvt_Kerning_t *kernings; /* pairs of the batch characters */
+	uint32_t kernings_num;
+	uint32_t kernings_max;
+	Arena_t arena; /* bitmaps (or outlines) of the batch */
+	uint32_t bitmaps_size; /* bitmaps bytes of the batch, at the font bpp */
+} Batch_t;
+
+typedef struct Export_s Export_t;
+
+typedef struct
+{	/* thread of a pipeline stage */
+	Export_t *ctx;
+	pthread_t thread;
+	fontCvtLib_Face_t *face; /* own copy of the face, NULL for the resolve stage */
+	stats_Totals_t totals; /* statistics of the thread when it is over */
+} Worker_t;
+
+struct Export_s
+{	/* state of one export. Exports share nothing, so many of them can run at
+	once on different threads */
+	const fontCvtLib_Options_t *opt;
+	fontCvtLib_Face_t *lib_face;
+	FT_Face face;
+	/* characters of every range with a glyph, in export order: the right
+	characters of the kerning pairs */
+	CharGlyph_t *rights;
+	uint32_t rights_num;
+	/* glyphs of many characters of the export sorted by glyph index, they are
+	rendered once before the batches */
+	SharedGlyph_t *shared;
+	uint32_t shared_num;
+	Arena_t shared_arena;
+	/* metrics mode: pixel advance of the glyphs advances_first to
+	advances_first + advances_num - 1 */
+	uint16_t *advances;
+	FT_UInt advances_first;
+	uint32_t advances_num;
+	fontCvt_Builder_t *builder;
+	void *builder_ctx;
+	uint32_t bitmaps_size; /* bitmaps bytes of the exported font, at the font bpp */
+	/* pipeline, workers_num is 0 when the export runs in the calling thread */
+	Batch_t **pool; /* every batch of the pipeline */
+	Batch_t **pending; /* rendered batches waiting for their turn, by seq % pool_num */
+	uint16_t pool_num;
+	queue_Queue_t free_queue; /* batches for the resolve stage */
+	queue_Queue_t resolved_queue; /* batches for the render stage */
+	queue_Queue_t rendered_queue; /* batches for the emit stage */
+	Worker_t resolver;
+	Worker_t *workers; /* render stage threads */
+	uint16_t workers_num;
+	bool stats; /* the calling thread collects statistics */
+};
+
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static fontCvtLib_Face_t *OpenFace (const char *fname, const void *data, size_t size);
+static fontCvtLib_Face_t *OpenFaceCharMap (const char *fname, const void *data, size_t size);
+static bool BuildCharMap (fontCvtLib_Face_t *face);
+static int CompareCharGlyph (const void *a, const void *b);
+static const CharGlyph_t *FindChar (const fontCvtLib_Face_t *face, uint32_t unicode);
+static bool BuildRights (Export_t *ctx);
+static uint32_t CollectGlyphs (const Export_t *ctx, FT_UInt **glyph_idxs);
+static bool RenderShared (Export_t *ctx);
+static bool ReadAdvances (Export_t *ctx);
+static int CompareGlyphIdx (const void *a, const void *b);
+static int CompareShared (const void *a, const void *b);
+static const SharedGlyph_t *FindShared (const Export_t *ctx, FT_UInt glyph_idx);
+static bool SetupFace (fontCvtLib_Face_t *face, const fontCvtLib_Options_t *opt);
+static bool DoExportFont (Export_t *ctx);
+static bool IsShardBatch (const fontCvtLib_Options_t *opt, uint32_t batch);
+static bool StartPipeline (Export_t *ctx);
+static void StopPipeline (Export_t *ctx);
+static void *ResolveStage (void *arg);
+static void *RenderStage (void *arg);
+static Batch_t *NextRendered (Export_t *ctx, uint32_t seq);
+static void ResolveBatch (Batch_t *batch, const fontCvtLib_Face_t *face, wchar_t first, wchar_t last);
+static void RenderBatch (Batch_t *batch, FT_Face face, const Export_t *ctx);
+static uint32_t RenderGlyph (FT_Face face, const fontCvtLib_Options_t *opt, FT_UInt glyph_idx,
+	fontCvt_Character_t *itfc_character, Arena_t *arena, uint32_t *offset);
+static void EmitBatch (Export_t *ctx, Batch_t *batch);
+static void FreeBatch (Batch_t *batch);
+static uint8_t *ArenaAlloc (Arena_t *arena, uint32_t size, uint32_t *offset);
+static void DoExportKerinig (Batch_t *batch, FT_Face face, const Export_t *ctx, wchar_t left_char, FT_UInt l_glyph_idx);
+static void ConvertBitmap (FT_Bitmap *ft_bmp, char *pxlmap);
+static uint32_t PackedBitmapSize (uint16_t width, uint16_t height, uint8_t bpp);
+static uint8_t *EncodeOutline (FT_GlyphSlot slot, fontCvt_Character_t *character);
+static void FlatAddPoint (FlatOutline_t *flat, FT_Pos x, FT_Pos y);
+static int FlatMoveTo (const FT_Vector *to, void *user);
+static int FlatLineTo (const FT_Vector *to, void *user);
+static int FlatConicTo (const FT_Vector *control, const FT_Vector *to, void *user);
+static int FlatCubicTo (const FT_Vector *control1, const FT_Vector *control2, const FT_Vector *to, void *user);
+
+//___________________________________________________________________PRIVATE VAR
+/* pushed to the render stage after the last batch, it stops a thread */
+static char StopItem;
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Initialize the library: the builders of the registry and the memory
+builder. Call it once, before any other function of the library.
+    Args:
+    Ret:
+*/
+void fontCvtLib_Init (void)
+{
+	builderRegistry_Init ( );
+	builderMemory_Init ( );
+}
+
+/* Set the default export options: 30 pixel, 4 bpp bitmaps, no character.
+    Args:
+<opt>[out] options.
+    Ret:
+*/
+void fontCvtLib_DefaultOptions (fontCvtLib_Options_t *opt)
+{
+	memset (opt, 0, sizeof (*opt));
+	opt->size = 30;
+	opt->bpp = 4;
+	opt->mode = FONTCVTLIB_MODE_BITMAP;
+	opt->sdf_spread = 2;
+}
+
+/* Open a font face from a file. The face can be exported many times, by one
+thread at a time.
+    Args:
+<fname>[in] font file path.
+    Ret:
+the face, NULL on error.
+*/
+fontCvtLib_Face_t *fontCvtLib_OpenFace (const char *fname)
+{
+	return OpenFaceCharMap (fname, NULL, 0);
+}
+
+/* Open a font face from a font file loaded in memory. The data must stay
+valid until the face is closed.
+    Args:
+<data>[in] font file content.
+<size>[in] font file size.
+    Ret:
+the face, NULL on error.
+*/
+fontCvtLib_Face_t *fontCvtLib_OpenFaceMemory (const void *data, size_t size)
+{
+	return OpenFaceCharMap (NULL, data, size);
+}
+
+/* Close a face.
+    Args:
+<face>[in] face, can be NULL.
+    Ret:
+*/
+void fontCvtLib_CloseFace (fontCvtLib_Face_t *face)
+{
+	if (face == NULL)
+		return;
+	FT_Done_Face (face->face);
+	FT_Done_FreeType (face->library);
+	free (face->chars);
+	free (face->fname);
+	free (face);
+}
+
+/* Export a face to a builder.
+    Args:
+<face>[in] font face.
+<opt>[in] export options.
+<builder>[in] target builder.
+<builder_ctx>[in] builder context, made by builder->create.
+<bitmaps_size>[out] bitmaps bytes of the exported font, at the font bpp. Can be
+    NULL.
+    Ret:
+false on error.
+*/
+bool fontCvtLib_Export (fontCvtLib_Face_t *face, const fontCvtLib_Options_t *opt, fontCvt_Builder_t *builder,
+	void *builder_ctx, uint32_t *bitmaps_size)
+{
+	Export_t ctx; /* export state */
+	bool ok;
+
+	memset (&ctx, 0, sizeof (ctx));
+	ctx.opt = opt;
+	ctx.lib_face = face;
+	ctx.face = face->face;
+	ctx.builder = builder;
+	ctx.builder_ctx = builder_ctx;
+	ctx.stats = stats_Enabled;
+
+	if (!SetupFace (face, opt) || !BuildRights (&ctx))
+		return false;
+
+	ok = (opt->mode == FONTCVTLIB_MODE_METRICS) ? ReadAdvances (&ctx) : RenderShared (&ctx);
+	if (ok)
+		ok = DoExportFont (&ctx);
+	free (ctx.rights);
+	free (ctx.advances);
+	free (ctx.shared);
+	free (ctx.shared_arena.data);
+	if (bitmaps_size)
+		*bitmaps_size = ctx.bitmaps_size;
+	return ok;
+}
+
+/* Render a face in memory with the memory builder, for previews.
+    Args:
+<face>[in] font face.
+<opt>[in] export options, output and builder_opt are not used.
+    Ret:
+the font, to be released with builderMemory_Free. NULL on error.
+*/
+builderMemory_Font_t *fontCvtLib_Render (fontCvtLib_Face_t *face, const fontCvtLib_Options_t *opt)
+{
+	void *ctx = builderMemory_Builder.create ( );
+	builderMemory_Font_t *font = NULL;
+
+	if (ctx == NULL)
+		return NULL;
+	if (fontCvtLib_Export (face, opt, &builderMemory_Builder, ctx, NULL))
+		font = builderMemory_Take (ctx);
+	builderMemory_Builder.destroy (ctx);
+	return font;
+}
+
+/* Export a font rendered by fontCvtLib_Render to a builder, without
+rendering it again. The builder gets the same calls as from fontCvtLib_Export
+with the same options.
+    Args:
+<font>[in] rendered font.
+<opt>[in] options the font was rendered with, output and builder_opt can be
+    changed.
+<builder>[in] target builder.
+<builder_ctx>[in] builder context, made by builder->create.
+<bitmaps_size>[out] bitmaps bytes of the exported font, at the font bpp. Can be
+    NULL.
+    Ret:
+false on error.
+*/
+bool fontCvtLib_Replay (const builderMemory_Font_t *font, const fontCvtLib_Options_t *opt, fontCvt_Builder_t *builder,
+	void *builder_ctx, uint32_t *bitmaps_size)
+{
+	fontCvt_Font_t itfc_font = font->font;
+	fontCvt_Character_t *characters = calloc (L_BATCH_CHARACTERS, sizeof (fontCvt_Character_t));
+	fontCvt_Kerning_t *kernings = NULL;
+	uint32_t kernings_max = 0;
+	uint32_t bytes = 0;
+	/* glyphs with a bitmap, the bitmap of a glyph is counted once */
+	SharedGlyph_t *glyphs = NULL;
+	uint32_t glyphs_num = 0, glyphs_max = 0;
+	bool ok = (characters != NULL);
+
+	stats_Begin (STATS_PHASE_BUILDER);
+	builder->startFont (builder_ctx, &itfc_font, opt->output, opt->builder_opt);
+	for (uint16_t range_idx = 0; range_idx < opt->ranges_num && ok; range_idx++)
+	{
+		fontCvt_Range_t itfc_range = opt->ranges[range_idx];
+
+		builder->startRange (builder_ctx, &itfc_range);
+		for (wchar_t first = itfc_range.first; first <= itfc_range.last && ok; first += L_BATCH_CHARACTERS)
+		{
+			wchar_t last = L_MIN (itfc_range.last, first + L_BATCH_CHARACTERS - 1);
+			uint32_t characters_num = 0, kernings_num = 0;
+
+			for (wchar_t letter = first; letter <= last && ok; letter++)
+			{
+				const builderMemory_Character_t *ch = builderMemory_Find (font, letter);
+				fontCvt_Character_t *itfc_character = &characters[characters_num++];
+				uint32_t k;
+
+				memset (itfc_character, 0, sizeof (*itfc_character));
+				itfc_character->unicode = letter;
+				if (ch == NULL)
+					continue;
+				*itfc_character = ch->character;
+				if (glyphs_num == glyphs_max)
+				{
+					SharedGlyph_t *grown;
+
+					glyphs_max = L_MAX (glyphs_max * 2, 256);
+					grown = realloc (glyphs, sizeof (SharedGlyph_t) * glyphs_max);
+					if (grown == NULL)
+					{
+						ok = false;
+						break;
+					}
+					glyphs = grown;
+				}
+				glyphs[glyphs_num].glyph_idx = itfc_character->glyph_idx;
+				glyphs[glyphs_num++].size = itfc_character->outline ? itfc_character->outline_sz
+					: (itfc_character->bmp ? PackedBitmapSize (itfc_character->bmp_pxl_width,
+					                                           itfc_character->bmp_pxl_height, opt->bpp) : 0);
+				/* copy the pairs, overlapping ranges make them not contiguous */
+				for (k = ch->kerning_index; k < font->kernings_num && font->kernings[k].left_char == letter; k++)
+				{
+					if (kernings_num == kernings_max)
+					{
+						fontCvt_Kerning_t *grown;
+
+						kernings_max = L_MAX (kernings_max * 2, 256);
+						grown = realloc (kernings, sizeof (fontCvt_Kerning_t) * kernings_max);
+						if (grown == NULL)
+						{
+							ok = false;
+							break;
+						}
+						kernings = grown;
+					}
+					kernings[kernings_num++] = font->kernings[k];
+				}
+				itfc_character->kerning_num = k - ch->kerning_index;
+			}
+			if (ok)
+				builderRegistry_PutBatch (builder, builder_ctx, characters, characters_num, kernings, kernings_num);
+		}
+		builder->endRange (builder_ctx);
+	}
+	builder->endFont (builder_ctx);
+	stats_End (STATS_PHASE_BUILDER);
+
+	qsort (glyphs, glyphs_num, sizeof (SharedGlyph_t), CompareShared);
+	for (uint32_t k = 0; k < glyphs_num; k++)
+	{
+		if (k == 0 || glyphs[k].glyph_idx != glyphs[k - 1].glyph_idx || glyphs[k].glyph_idx == 0)
+			bytes += glyphs[k].size;
+	}
+	stats_Add (STATS_COUNTER_BITMAP_BYTES, bytes);
+
+	free (glyphs);
+	free (characters);
+	free (kernings);
+	if (!ok)
+		L_PRINT_GEN_ERR;
+	if (bitmaps_size)
+		*bitmaps_size = bytes;
+	return ok;
+}
+
+/* Compute the bitmaps size of the exported characters rendered as coverage
+at a fixed pixel size. The face is left scaled at the given size.
+    Args:
+<face>[in] font face.
+<opt>[in] export options, the ranges and the bpp are used.
+<size>[in] pixel size.
+    Ret:
+the bitmaps size in bytes.
+*/
+uint32_t fontCvtLib_FixedSizeBitmapsSize (fontCvtLib_Face_t *lib_face, const fontCvtLib_Options_t *opt, uint16_t size)
+{
+	FT_Face face = lib_face->face;
+	uint32_t bytes = 0;
+
+	if (FT_Set_Pixel_Sizes (face, 0, size))
+	{
+		L_PRINT_GEN_ERR;
+		return 0;
+	}
+
+	for (uint16_t range_idx = 0; range_idx < opt->ranges_num; range_idx++)
+	{
+		const CharGlyph_t *ch = FindChar (lib_face, opt->ranges[range_idx].first);
+		const CharGlyph_t *end = lib_face->chars + lib_face->chars_num;
+
+		for (; ch < end && ch->unicode <= (uint32_t)opt->ranges[range_idx].last; ch++)
+		{
+			FT_UInt glyph_idx = ch->glyph_idx;
+
+			if (!FT_Load_Glyph (face, glyph_idx, FT_LOAD_DEFAULT)
+			 && !FT_Render_Glyph (face->glyph, (opt->bpp == 1) ? FT_RENDER_MODE_MONO : FT_RENDER_MODE_NORMAL))
+			{
+				bytes += PackedBitmapSize (face->glyph->bitmap.width, face->glyph->bitmap.rows, opt->bpp);
+			}
+		}
+	}
+	return bytes;
+}
+
+/* Split the characters of a face in ranges, for exporting its whole
+coverage. A range goes on over a hole of up to L_COVERAGE_MAX_GAP characters
+without a glyph. The character 0 is left out, it ends the texts.
+    Args:
+<face>[in] font face.
+<ranges>[out] ranges, to be released with free.
+    Ret:
+the number of ranges, 0 on error or if the face has no character.
+*/
+uint16_t fontCvtLib_Coverage (fontCvtLib_Face_t *face, fontCvt_Range_t **ranges)
+{
+	fontCvt_Range_t *list = NULL;
+	uint32_t num = 0, max = 0;
+
+	*ranges = NULL;
+	for (uint32_t k = 0; k < face->chars_num; k++)
+	{
+		uint32_t unicode = face->chars[k].unicode;
+
+		if (unicode == 0)
+			continue;
+		if (num && unicode - list[num - 1].last <= L_COVERAGE_MAX_GAP + 1)
+		{
+			list[num - 1].last = unicode;
+			continue;
+		}
+		if (num == UINT16_MAX)
+		{
+			fprintf (stderr, "the font has too many ranges\n");
+			free (list);
+			return 0;
+		}
+		if (num == max)
+		{
+			fontCvt_Range_t *grown;
+
+			max = L_MAX (max * 2, 64);
+			grown = realloc (list, sizeof (fontCvt_Range_t) * max);
+			if (grown == NULL)
+			{
+				L_PRINT_GEN_ERR;
+				free (list);
+				return 0;
+			}
+			list = grown;
+		}
+		list[num].first = list[num].last = unicode;
+		list[num].bpp = 0;
+		num++;
+	}
+	*ranges = list;
+	return num;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Open a face from a file or from memory.
+    Args:
+<fname>[in] font file path, NULL to open from memory.
+<data>[in] font file content.
+<size>[in] font file size.
+    Ret:
+the face, NULL on error.
+*/
+static fontCvtLib_Face_t *OpenFace (const char *fname, const void *data, size_t size)
+{
+	fontCvtLib_Face_t *face = calloc (1, sizeof (fontCvtLib_Face_t));
+	FT_Error error;
+
+	if (face == NULL)
+		return NULL;
+	stats_Begin (STATS_PHASE_FACE_OPEN);
+	error = FT_Init_FreeType (&face->library);
+	if (!error)
+	{
+		/* open the font face specified for the given font file.
+		   Font faces example are Regular, Italic, Bold ...
+		   Most fonts provvide one font face per file.
+		*/
+		if (fname)
+			error = FT_New_Face (face->library, fname, 0, &face->face);
+		else
+			error = FT_New_Memory_Face (face->library, data, size, 0, &face->face);
+		if (!error && fname && (face->fname = strdup (fname)) == NULL)
+		{
+			FT_Done_Face (face->face);
+			error = FT_Err_Out_Of_Memory;
+		}
+		if (error)
+			FT_Done_FreeType (face->library);
+	}
+	stats_End (STATS_PHASE_FACE_OPEN);
+	if (error)
+	{
+		L_PRINT_GEN_ERR;
+		free (face);
+		return NULL;
+	}
+	face->data = data;
+	face->size = size;
+	return face;
+}
+
+/* Open a face from a file or from memory, with its character map.
+    Args:
+<fname>[in] font file path, NULL to open from memory.
+<data>[in] font file content.
+<size>[in] font file size.
+    Ret:
+the face, NULL on error.
+*/
+static fontCvtLib_Face_t *OpenFaceCharMap (const char *fname, const void *data, size_t size)
+{
+	fontCvtLib_Face_t *face = OpenFace (fname, data, size);
+
+	if (face && !BuildCharMap (face))
+	{
+		L_PRINT_GEN_ERR;
+		fontCvtLib_CloseFace (face);
+		return NULL;
+	}
+	return face;
+}
+
+/* Walk the charmap of a face once and keep its characters with a glyph
+sorted by unicode.
+    Args:
+<face>[in] font face.
+    Ret:
+false on allocation fail.
+*/
+static bool BuildCharMap (fontCvtLib_Face_t *face)
+{
+	uint32_t max = L_MAX (face->face->num_glyphs, 64);
+	bool sorted = true;
+	FT_ULong unicode;
+	FT_UInt glyph_idx;
+
+	stats_Begin (STATS_PHASE_CHAR_INDEX);
+	face->chars = malloc (sizeof (CharGlyph_t) * max);
+	for (unicode = FT_Get_First_Char (face->face, &glyph_idx);
+	     glyph_idx && face->chars;
+	     unicode = FT_Get_Next_Char (face->face, unicode, &glyph_idx))
+	{
+		if (face->chars_num == max)
+		{
+			CharGlyph_t *grown;
+
+			max *= 2;
+			grown = realloc (face->chars, sizeof (CharGlyph_t) * max);
+			if (grown == NULL)
+			{
+				free (face->chars);
+				face->chars = NULL;
+				break;
+			}
+			face->chars = grown;
+		}
+		if (face->chars_num && unicode <= face->chars[face->chars_num - 1].unicode)
+			sorted = false;
+		face->chars[face->chars_num].unicode = unicode;
+		face->chars[face->chars_num].glyph_idx = glyph_idx;
+		face->chars_num++;
+	}
+	if (face->chars && !sorted)
+	{	/* charmaps are walked in code order, check it anyway */
+		uint32_t num = 0;
+
+		qsort (face->chars, face->chars_num, sizeof (CharGlyph_t), CompareCharGlyph);
+		for (uint32_t k = 0; k < face->chars_num; k++)
+		{
+			if (num == 0 || face->chars[k].unicode != face->chars[num - 1].unicode)
+				face->chars[num++] = face->chars[k];
+		}
+		face->chars_num = num;
+	}
+	stats_End (STATS_PHASE_CHAR_INDEX);
+	if (face->chars == NULL)
+		face->chars_num = 0;
+	return face->chars != NULL;
+}
+
+/* qsort comparator: characters by unicode. */
+static int CompareCharGlyph (const void *a, const void *b)
+{
+	uint32_t unicode_a = ((const CharGlyph_t *)a)->unicode;
+	uint32_t unicode_b = ((const CharGlyph_t *)b)->unicode;
+
+	return (unicode_a > unicode_b) - (unicode_a < unicode_b);
+}
+
+/* Look for the first character of a face with a glyph at or after a unicode.
+    Args:
+<face>[in] font face.
+<unicode>[in] character code.
+    Ret:
+the character, face->chars + face->chars_num if there is none.
+*/
+static const CharGlyph_t *FindChar (const fontCvtLib_Face_t *face, uint32_t unicode)
+{
+	uint32_t low = 0, high = face->chars_num;
+
+	while (low < high)
+	{
+		uint32_t mid = low + (high - low) / 2;
+
+		if (face->chars[mid].unicode < unicode)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return &face->chars[low];
+}
+
+/* List the characters with a glyph of every range of the export, in range
+order: the right characters of the kerning pairs.
+    Args:
+<ctx>[in] export state.
+    Ret:
+false on allocation fail.
+*/
+static bool BuildRights (Export_t *ctx)
+{
+	const fontCvtLib_Options_t *opt = ctx->opt;
+	const fontCvtLib_Face_t *face = ctx->lib_face;
+	const CharGlyph_t *end = face->chars + face->chars_num;
+
+	for (uint16_t pass = 0; pass < 2; pass++)
+	{	/* count them, then copy them */
+		ctx->rights_num = 0;
+		for (uint16_t j = 0; j < opt->ranges_num; j++)
+		{
+			for (const CharGlyph_t *ch = FindChar (face, opt->ranges[j].first);
+			     ch < end && ch->unicode <= (uint32_t)opt->ranges[j].last;
+			     ch++)
+			{
+				if (pass)
+					ctx->rights[ctx->rights_num] = *ch;
+				ctx->rights_num++;
+			}
+		}
+		if (pass == 0)
+		{
+			ctx->rights = malloc (sizeof (CharGlyph_t) * L_MAX (ctx->rights_num, 1));
+			if (ctx->rights == NULL)
+			{
+				L_PRINT_GEN_ERR;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/* Glyphs of the characters of the batches of the export.
+    Args:
+<ctx>[in] export state.
+<glyph_idxs>[out] glyph of every character with one, sorted by glyph index,
+    free it. NULL if there is none.
+    Ret:
+the number of glyphs, UINT32_MAX on allocation fail.
+*/
+static uint32_t CollectGlyphs (const Export_t *ctx, FT_UInt **glyph_idxs)
+{
+	const fontCvtLib_Options_t *opt = ctx->opt;
+	const fontCvtLib_Face_t *face = ctx->lib_face;
+	const CharGlyph_t *end = face->chars + face->chars_num;
+	uint32_t glyphs_num = 0, glyphs_max = 0, batch = 0;
+
+	*glyph_idxs = NULL;
+	for (uint16_t j = 0; j < opt->ranges_num; j++)
+	{
+		const fontCvt_Range_t *range = &opt->ranges[j];
+
+		for (wchar_t first = range->first; first <= range->last; first += L_BATCH_CHARACTERS)
+		{
+			wchar_t last = L_MIN (range->last, first + L_BATCH_CHARACTERS - 1);
+
+			if (!IsShardBatch (opt, batch++))
+				continue;
+			for (const CharGlyph_t *ch = FindChar (face, first); ch < end && ch->unicode <= (uint32_t)last; ch++)
+			{
+				if (glyphs_num == glyphs_max)
+				{
+					FT_UInt *grown;
+
+					glyphs_max = L_MAX (glyphs_max * 2, 256);
+					grown = realloc (*glyph_idxs, sizeof (FT_UInt) * glyphs_max);
+					if (grown == NULL)
+					{
+						L_PRINT_GEN_ERR;
+						free (*glyph_idxs);
+						*glyph_idxs = NULL;
+						return UINT32_MAX;
+					}
+					*glyph_idxs = grown;
+				}
+				(*glyph_idxs)[glyphs_num++] = ch->glyph_idx;
+			}
+		}
+	}
+	if (glyphs_num)
+		qsort (*glyph_idxs, glyphs_num, sizeof (FT_UInt), CompareGlyphIdx);
+	return glyphs_num;
+}
+
+/* Render once the glyphs that many characters of the export are mapped to,
+e.g. space and no-break space or compatibility ideographs. The batches copy
+them instead of rendering them again.
+    Args:
+<ctx>[in] export state, the face is scaled.
+    Ret:
+false on allocation fail.
+*/
+static bool RenderShared (Export_t *ctx)
+{
+	const fontCvtLib_Options_t *opt = ctx->opt;
+	FT_UInt *glyph_idxs;
+	uint32_t glyphs_num = CollectGlyphs (ctx, &glyph_idxs);
+
+	if (glyphs_num == UINT32_MAX)
+		return false;
+
+	for (uint32_t k = 0; k < glyphs_num; )
+	{
+		uint32_t same = 1;
+
+		while (k + same < glyphs_num && glyph_idxs[k + same] == glyph_idxs[k])
+			same++;
+		if (same > 1)
+		{	/* glyph_idxs is not read before k anymore */
+			glyph_idxs[ctx->shared_num++] = glyph_idxs[k];
+			stats_Add (STATS_COUNTER_RENDERS_AVOIDED, same - 1);
+		}
+		k += same;
+	}
+	if (ctx->shared_num)
+		ctx->shared = calloc (ctx->shared_num, sizeof (SharedGlyph_t));
+	for (uint32_t k = 0; k < ctx->shared_num && ctx->shared; k++)
+	{
+		SharedGlyph_t *shared = &ctx->shared[k];
+
+		shared->glyph_idx = glyph_idxs[k];
+		shared->offset = UINT32_MAX;
+		ctx->bitmaps_size += RenderGlyph (ctx->face, opt, shared->glyph_idx, &shared->character,
+			&ctx->shared_arena, &shared->offset);
+		if (shared->offset != UINT32_MAX)
+			shared->size = ctx->shared_arena.size - shared->offset;
+	}
+	free (glyph_idxs);
+	if (ctx->shared_num && ctx->shared == NULL)
+	{
+		L_PRINT_GEN_ERR;
+		return false;
+	}
+	return true;
+}
+
+/* Metrics mode: read the pixel advances of the glyphs of the export, in bulk.
+Glyph indexes far apart are read with separate calls, so that the glyphs
+between them are not loaded when FreeType has no fast advances for the font.
+    Args:
+<ctx>[in] export state, the face is scaled.
+    Ret:
+false on allocation fail.
+*/
+static bool ReadAdvances (Export_t *ctx)
+{
+	FT_UInt *glyph_idxs;
+	uint32_t glyphs_num = CollectGlyphs (ctx, &glyph_idxs);
+	FT_Fixed *advances;
+
+	if (glyphs_num == UINT32_MAX)
+		return false;
+	if (glyphs_num == 0)
+		return true;
+	ctx->advances_first = glyph_idxs[0];
+	ctx->advances_num = glyph_idxs[glyphs_num - 1] - glyph_idxs[0] + 1;
+	ctx->advances = calloc (ctx->advances_num, sizeof (uint16_t));
+	advances = malloc (sizeof (FT_Fixed) * L_MIN (ctx->advances_num, L_ADVANCES_RUN));
+	if (ctx->advances == NULL || advances == NULL)
+	{
+		L_PRINT_GEN_ERR;
+		free (glyph_idxs);
+		free (advances);
+		return false;
+	}
+
+	stats_Begin (STATS_PHASE_GLYPH_LOAD);
+	for (uint32_t k = 0; k < glyphs_num; )
+	{	/* a run of glyphs with small gaps between them */
+		FT_UInt first = glyph_idxs[k];
+		uint32_t j = k + 1;
+
+		while (j < glyphs_num && glyph_idxs[j] - glyph_idxs[j - 1] <= L_ADVANCES_GAP
+		       && glyph_idxs[j] - first < L_ADVANCES_RUN)
+			j++;
+		if (FT_Get_Advances (ctx->face, first, glyph_idxs[j - 1] - first + 1, FT_LOAD_DEFAULT, advances))
+			L_PRINT_GEN_ERR;
+		else
+		{	/* 16.16 pixels, truncated as the bitmap modes do */
+			for (FT_UInt g = 0; g <= glyph_idxs[j - 1] - first; g++)
+				ctx->advances[first - ctx->advances_first + g] = advances[g] >> 16;
+		}
+		k = j;
+	}
+	stats_End (STATS_PHASE_GLYPH_LOAD);
+	free (glyph_idxs);
+	free (advances);
+	return true;
+}
+
+/* qsort comparator: glyph indexes. */
+static int CompareGlyphIdx (const void *a, const void *b)
+{
+	FT_UInt glyph_a = *(const FT_UInt *)a;
+	FT_UInt glyph_b = *(const FT_UInt *)b;
+
+	return (glyph_a > glyph_b) - (glyph_a < glyph_b);
+}
+
+/* qsort comparator: SharedGlyph_t by glyph index. */
+static int CompareShared (const void *a, const void *b)
+{
+	return CompareGlyphIdx (&((const SharedGlyph_t *)a)->glyph_idx, &((const SharedGlyph_t *)b)->glyph_idx);
+}
+
+/* Look for a glyph rendered by RenderShared.
+    Args:
+<ctx>[in] export state.
+<glyph_idx>[in] glyph index.
+    Ret:
+the glyph, NULL if only one character of the export has it.
+*/
+static const SharedGlyph_t *FindShared (const Export_t *ctx, FT_UInt glyph_idx)
+{
+	uint32_t low = 0, high = ctx->shared_num;
+
+	while (low < high)
+	{
+		uint32_t mid = low + (high - low) / 2;
+
+		if (ctx->shared[mid].glyph_idx == glyph_idx)
+			return &ctx->shared[mid];
+		if (ctx->shared[mid].glyph_idx < glyph_idx)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return NULL;
+}
+
+/* Scale a face for an export.
+    Args:
+<face>[in] font face.
+<opt>[in] export options.
+    Ret:
+false on error.
+*/
+static bool SetupFace (fontCvtLib_Face_t *face, const fontCvtLib_Options_t *opt)
+{
+	FT_Error error;
+
+	stats_Begin (STATS_PHASE_FACE_OPEN);
+	/* scale the font to the given pixel size.
+	   scaleing the font means scaling the font's EM square, witch is
+	   the reference grid for the glyph's outlines.
+	*/
+	error = FT_Set_Pixel_Sizes (face->face, /* handle to face object */
+		0, /* pixel_width (0 means same as pxel_height) */
+		opt->size); /* pixel_height */
+	if (!error && opt->mode == FONTCVTLIB_MODE_SDF)
+	{
+		FT_UInt spread = opt->sdf_spread;
+
+		error = FT_Property_Set (face->library, "sdf", "spread", &spread);
+	}
+	stats_End (STATS_PHASE_FACE_OPEN);
+	if (error)
+	{
+		L_PRINT_GEN_ERR;
+		return false;
+	}
+	return true;
+}
+
+/* Export the font to the builder of the export: every character of every
+range, with its kerning pairs. The characters of a range are rendered in
+batches of L_BATCH_CHARACTERS and each batch is given to the builder at once.
+With opt->threads the batches are rendered by the pipeline, otherwise one
+after the other in the calling thread.
+    Args:
+<ctx>[in] export state.
+    Ret:
+false on allocation fail, the builder is not started.
+*/
+static bool DoExportFont (Export_t *ctx)
+{
+	const fontCvtLib_Options_t *opt = ctx->opt;
+	FT_Face face = ctx->face;
+	uint32_t batch = 0; /* batches of all the ranges so far, for the shards */
+	uint32_t seq = 0; /* batches exported so far */
+	Batch_t *single = NULL; /* the batch, without pipeline */
+
+	/* the export runs in this thread when the pipeline can't start */
+	if (opt->threads == 0 || !StartPipeline (ctx))
+	{
+		single = calloc (1, sizeof (Batch_t));
+		if (single == NULL)
+		{
+			L_PRINT_GEN_ERR;
+			return false;
+		}
+	}
+
+	{
+		fontCvt_Font_t itfc_font;
+
+		itfc_font.bpp = opt->bpp;
+		itfc_font.pxl_baseline_to_baseline = face->size->metrics.height >> 6;
+		itfc_font.pxl_em_square = face->size->metrics.y_ppem;
+		/* TODO ???
+		check https://www.freetype.org/freetype2/docs/tutorial/step2.html
+		and look for 'ascender' 'descender' */
+		itfc_font.pxl_max_glyph_height = (face->size->metrics.ascender - face->size->metrics.descender) >> 6;
+		itfc_font.sdf_spread = (opt->mode == FONTCVTLIB_MODE_SDF) ? opt->sdf_spread : 0;
+		itfc_font.outline = (opt->mode == FONTCVTLIB_MODE_OUTLINE);
+		itfc_font.pxl_max_bmp_width = itfc_font.pxl_max_bmp_height = 0;
+		if (FT_IS_SCALABLE (face))
+		{	/* the font box in 26.6 pixel, rounded outwards, with the spread of
+			distance fields around */
+			FT_Pos x_min = FT_MulFix (face->bbox.xMin, face->size->metrics.x_scale) & -64;
+			FT_Pos x_max = (FT_MulFix (face->bbox.xMax, face->size->metrics.x_scale) + 63) & -64;
+			FT_Pos y_min = FT_MulFix (face->bbox.yMin, face->size->metrics.y_scale) & -64;
+			FT_Pos y_max = (FT_MulFix (face->bbox.yMax, face->size->metrics.y_scale) + 63) & -64;
+
+			itfc_font.pxl_max_bmp_width = ((x_max - x_min) >> 6) + 2 * itfc_font.sdf_spread;
+			itfc_font.pxl_max_bmp_height = ((y_max - y_min) >> 6) + 2 * itfc_font.sdf_spread;
+		}
+
+		/* this identifies the builder's export procedure start */
+		stats_Begin (STATS_PHASE_BUILDER);
+		ctx->builder->startFont (ctx->builder_ctx, &itfc_font, opt->output, opt->builder_opt);
+		stats_End (STATS_PHASE_BUILDER);
+	}
+
+	/* for all the specified ranges */
+	for (uint16_t range_idx = 0; range_idx < opt->ranges_num; range_idx++)
+	{
+		const fontCvt_Range_t *range; /* current uncode range */
+
+		range = &opt->ranges[range_idx];
+		{
+			fontCvt_Range_t itfc_range;
+
+			itfc_range.first = range->first;
+			itfc_range.last = range->last;
+			itfc_range.bpp = range->bpp;
+			/* we say the builder we are going to export this character range */
+			stats_Begin (STATS_PHASE_BUILDER);
+			ctx->builder->startRange (ctx->builder_ctx, &itfc_range);
+			stats_End (STATS_PHASE_BUILDER);
+		}
+
+		/* for all the characters inside the current range, a batch at a time.
+		The resolve stage walks the batches in the same order */
+		for (wchar_t first = range->first; first <= range->last; first += L_BATCH_CHARACTERS)
+		{
+			wchar_t last = L_MIN (range->last, first + L_BATCH_CHARACTERS - 1);
+
+			if (!IsShardBatch (opt, batch++))
+				continue;
+			if (single)
+			{
+				ResolveBatch (single, ctx->lib_face, first, last);
+				RenderBatch (single, face, ctx);
+				EmitBatch (ctx, single);
+			}
+			else
+			{
+				Batch_t *rendered = NextRendered (ctx, seq++);
+
+				EmitBatch (ctx, rendered);
+				queue_Push (&ctx->free_queue, rendered);
+			}
+		}
+
+		/* we say the builder this range it's over */
+		stats_Begin (STATS_PHASE_BUILDER);
+		ctx->builder->endRange (ctx->builder_ctx);
+		stats_End (STATS_PHASE_BUILDER);
+	}
+
+	if (single)
+		FreeBatch (single);
+	else
+		StopPipeline (ctx);
+
+	/* finalize the export procedure. This call should delate any garbage and
+	   put the peces together to conclude the export.
+	*/
+	stats_Begin (STATS_PHASE_BUILDER);
+	ctx->builder->endFont (ctx->builder_ctx);
+	stats_End (STATS_PHASE_BUILDER);
+	stats_Add (STATS_COUNTER_BITMAP_BYTES, ctx->bitmaps_size);
+	return true;
+}
+
+/* Tell if a batch belongs to the shard of the export. Shards take the batches
+in turn, so that each gets its part of every script.
+    Args:
+<opt>[in] export options.
+<batch>[in] batch number, counting the batches of all the ranges.
+    Ret:
+true if the batch has to be exported.
+*/
+static bool IsShardBatch (const fontCvtLib_Options_t *opt, uint32_t batch)
+{
+	return opt->shards_num <= 1 || batch % opt->shards_num == opt->shard;
+}
+
+/* Start the pipeline of an export: the batches, the queues, opt->threads
+render stage threads each with its own copy of the face, and the resolve
+stage thread.
+    Args:
+<ctx>[in] export state.
+    Ret:
+false if the pipeline could not start, nothing is left running.
+*/
+static bool StartPipeline (Export_t *ctx)
+{
+	const fontCvtLib_Options_t *opt = ctx->opt;
+	uint16_t depth = opt->queue_depth ? opt->queue_depth : L_QUEUE_DEPTH;
+	bool ok;
+
+	/* batches in the two queues, in the render threads, in the resolve and in
+	the emit stage */
+	ctx->pool_num = 2 * depth + opt->threads + 2;
+	ctx->pool = calloc (ctx->pool_num, sizeof (Batch_t *));
+	ctx->pending = calloc (ctx->pool_num, sizeof (Batch_t *));
+	ctx->workers = calloc (opt->threads, sizeof (Worker_t));
+	ok = ctx->pool && ctx->pending && ctx->workers;
+	ok = queue_Init (&ctx->free_queue, ctx->pool_num) && ok;
+	ok = queue_Init (&ctx->resolved_queue, depth) && ok;
+	ok = queue_Init (&ctx->rendered_queue, depth) && ok;
+	for (uint16_t k = 0; k < ctx->pool_num && ok; k++)
+	{
+		ok = (ctx->pool[k] = calloc (1, sizeof (Batch_t))) != NULL;
+		if (ok)
+			queue_Push (&ctx->free_queue, ctx->pool[k]);
+	}
+	for (uint16_t k = 0; k < opt->threads && ok; k++)
+	{	/* FreeType faces can't be shared between threads */
+		Worker_t *worker = &ctx->workers[k];
+
+		worker->ctx = ctx;
+		worker->face = OpenFace (ctx->lib_face->fname, ctx->lib_face->data, ctx->lib_face->size);
+		ok = worker->face && SetupFace (worker->face, opt);
+		if (ok)
+			ok = !pthread_create (&worker->thread, NULL, RenderStage, worker);
+		if (!ok)
+			fontCvtLib_CloseFace (worker->face);
+		else
+			ctx->workers_num++;
+	}
+	if (ok)
+	{	/* only the batches going around count in the statistics */
+		atomic_store (&ctx->free_queue.pushes, 0);
+		atomic_store (&ctx->free_queue.occupancy_sum, 0);
+		ctx->resolver.ctx = ctx;
+		ok = !pthread_create (&ctx->resolver.thread, NULL, ResolveStage, &ctx->resolver);
+		if (!ok)
+			ctx->resolver.ctx = NULL;
+	}
+	if (!ok)
+	{	/* stop the render threads already running */
+		for (uint16_t k = 0; k < ctx->workers_num; k++)
+			queue_Push (&ctx->resolved_queue, &StopItem);
+		StopPipeline (ctx);
+		return false;
+	}
+	return true;
+}
+
+/* Wait for the stage threads to finish and release the pipeline. The
+statistics of the threads are added to the ones of the calling thread.
+    Args:
+<ctx>[in] export state, every batch has been emitted.
+    Ret:
+*/
+static void StopPipeline (Export_t *ctx)
+{
+	if (ctx->resolver.ctx)
+	{
+		pthread_join (ctx->resolver.thread, NULL);
+		stats_Merge (&ctx->resolver.totals);
+	}
+	for (uint16_t k = 0; k < ctx->workers_num; k++)
+	{
+		pthread_join (ctx->workers[k].thread, NULL);
+		stats_Merge (&ctx->workers[k].totals);
+		fontCvtLib_CloseFace (ctx->workers[k].face);
+	}
+
+	if (ctx->resolver.ctx)
+	{
+		const char *names[] = { "free", "resolved", "rendered" };
+		queue_Queue_t *queues[] = { &ctx->free_queue, &ctx->resolved_queue, &ctx->rendered_queue };
+
+		for (uint8_t k = 0; k < 3; k++)
+		{
+			stats_Queue_t queue;
+
+			queue.name = names[k];
+			queue.capacity = queue_Capacity (queues[k]);
+			queue.pushes = queues[k]->pushes;
+			queue.occupancy_sum = queues[k]->occupancy_sum;
+			queue.full_waits = queues[k]->full_waits;
+			queue.empty_waits = queues[k]->empty_waits;
+			stats_AddQueue (&queue);
+		}
+	}
+
+	for (uint16_t k = 0; ctx->pool && k < ctx->pool_num; k++)
+	{
+		if (ctx->pool[k])
+			FreeBatch (ctx->pool[k]);
+	}
+	queue_Free (&ctx->free_queue);
+	queue_Free (&ctx->resolved_queue);
+	queue_Free (&ctx->rendered_queue);
+	free (ctx->pool);
+	free (ctx->pending);
+	free (ctx->workers);
+	ctx->pool = ctx->pending = NULL;
+	ctx->workers = NULL;
+	ctx->workers_num = 0;
+	memset (&ctx->resolver, 0, sizeof (ctx->resolver));
+}
+
+/* Resolve stage thread: takes the free batches, looks up the glyphs of their
+characters and passes them to the render stage. The batches are walked in the
+order of DoExportFont.
+    Args:
+<arg>[in] Worker_t of the stage.
+    Ret:
+NULL.
+*/
+static void *ResolveStage (void *arg)
+{
+	Worker_t *worker = arg;
+	Export_t *ctx = worker->ctx;
+	const fontCvtLib_Options_t *opt = ctx->opt;
+	uint32_t batch = 0, seq = 0;
+
+	if (ctx->stats)
+		stats_Enable ( );
+	for (uint16_t range_idx = 0; range_idx < opt->ranges_num; range_idx++)
+	{
+		const fontCvt_Range_t *range = &opt->ranges[range_idx];
+
+		for (wchar_t first = range->first; first <= range->last; first += L_BATCH_CHARACTERS)
+		{
+			Batch_t *resolved;
+
+			if (!IsShardBatch (opt, batch++))
+				continue;
+			resolved = queue_Pop (&ctx->free_queue);
+			resolved->seq = seq++;
+			ResolveBatch (resolved, ctx->lib_face, first, L_MIN (range->last, first + L_BATCH_CHARACTERS - 1));
+			queue_Push (&ctx->resolved_queue, resolved);
+		}
+	}
+	for (uint16_t k = 0; k < ctx->workers_num; k++)
+		queue_Push (&ctx->resolved_queue, &StopItem);
+	stats_Take (&worker->totals);
+	stats_Reset ( );
+	return NULL;
+}
+
+/* Render stage thread: renders the resolved batches with its own face and
+passes them to the emit stage, until it gets StopItem.
+    Args:
+<arg>[in] Worker_t of the thread.
+    Ret:
+NULL.
+*/
+static void *RenderStage (void *arg)
+{
+	Worker_t *worker = arg;
+	Export_t *ctx = worker->ctx;
+	void *item;
+
+	if (ctx->stats)
+		stats_Enable ( );
+	while ((item = queue_Pop (&ctx->resolved_queue)) != &StopItem)
+	{
+		RenderBatch (item, worker->face->face, ctx);
+		queue_Push (&ctx->rendered_queue, item);
+	}
+	stats_Take (&worker->totals);
+	stats_Reset ( );
+	return NULL;
+}
+
+/* Get a rendered batch in the emit stage. The render threads finish the
+batches out of order, the ones coming early wait in ctx->pending: at most
+pool_num batches are around, so their seq % pool_num differ.
+    Args:
+<ctx>[in] export state.
+<seq>[in] number of the batch.
+    Ret:
+the batch.
+*/
+static Batch_t *NextRendered (Export_t *ctx, uint32_t seq)
+{
+	Batch_t *batch;
+
+	while (ctx->pending[seq % ctx->pool_num] == NULL)
+	{
+		batch = queue_Pop (&ctx->rendered_queue);
+		ctx->pending[batch->seq % ctx->pool_num] = batch;
+	}
+	batch = ctx->pending[seq % ctx->pool_num];
+	ctx->pending[seq % ctx->pool_num] = NULL;
+	return batch;
+}
+
+/* Look up the glyphs of a batch of consecutive characters in the character
+map of the face.
+    Args:
+<batch>[out] batch.
+<face>[in] face.
+<first>[in] first character of the batch.
+<last>[in] last character of the batch (included).
+    Ret:
+*/
+static void ResolveBatch (Batch_t *batch, const fontCvtLib_Face_t *face, wchar_t first, wchar_t last)
+{
+	const CharGlyph_t *ch = FindChar (face, first);
+	const CharGlyph_t *end = face->chars + face->chars_num;
+
+	stats_Begin (STATS_PHASE_CHAR_INDEX);
+	batch->first = first;
+	batch->last = last;
+	memset (batch->glyph_idxs, 0, sizeof (batch->glyph_idxs));
+	for (; ch < end && ch->unicode <= (uint32_t)last; ch++)
+		batch->glyph_idxs[ch->unicode - first] = ch->glyph_idx;
+	stats_End (STATS_PHASE_CHAR_INDEX);
+}
+
+/* Render a resolved batch, with its bitmaps (or outlines) in the arena and
+its kerning pairs.
+    Args:
+<batch>[in] batch.
+<face>[in] face, scaled for the export.
+<ctx>[in] export state.
+    Ret:
+*/
+static void RenderBatch (Batch_t *batch, FT_Face face, const Export_t *ctx)
+{
+	const fontCvtLib_Options_t *opt = ctx->opt;
+
+	batch->characters_num = 0;
+	batch->kernings_num = 0;
+	batch->arena.size = 0;
+	batch->bitmaps_size = 0;
+	for (wchar_t letter = batch->first; letter <= batch->last; letter++)
+	{
+		FT_UInt glyph_idx = batch->glyph_idxs[letter - batch->first]; /* glyph index of this letter */
+		fontCvt_Character_t *itfc_character = &batch->characters[batch->characters_num];
+		fontCvt_Character_t *mono = &batch->monos[batch->characters_num];
+		uint32_t *mono_offset = &batch->mono_offsets[batch->characters_num];
+		uint32_t *offset = &batch->offsets[batch->characters_num++];
+		uint32_t kernings_num = batch->kernings_num;
+
+		/* set default values for this glyph */
+		memset (itfc_character, 0, sizeof (*itfc_character));
+		itfc_character->unicode = letter;
+		*offset = UINT32_MAX;
+		*mono_offset = UINT32_MAX;
+		stats_GlyphBegin (letter);
+
+		if (glyph_idx)
+		{
+			const SharedGlyph_t *shared = FindShared (ctx, glyph_idx);
+
+			stats_Add (STATS_COUNTER_GLYPHS, 1);
+			if (opt->mode == FONTCVTLIB_MODE_METRICS)
+				itfc_character->pxl_advance = ctx->advances[glyph_idx - ctx->advances_first];
+			else if (shared)
+			{	/* rendered once for all its characters, its bytes are counted
+				once too */
+				uint8_t *dst;
+
+				*itfc_character = shared->character;
+				itfc_character->unicode = letter;
+				if (shared->offset != UINT32_MAX && (dst = ArenaAlloc (&batch->arena, shared->size, offset)) != NULL)
+					memcpy (dst, &ctx->shared_arena.data[shared->offset], shared->size);
+				else if (shared->offset != UINT32_MAX)
+					L_PRINT_GEN_ERR;
+			}
+			else
+				batch->bitmaps_size += RenderGlyph (face, opt, glyph_idx, itfc_character, &batch->arena, offset);
+			itfc_character->glyph_idx = glyph_idx;
+			if (opt->mono_variant && opt->mode == FONTCVTLIB_MODE_BITMAP)
+			{	/* the 1 bpp builders get the glyph rendered as a 1 bpp export
+				would, its bytes are not counted in the export bitmaps */
+				fontCvtLib_Options_t mono_opt = *opt;
+
+				mono_opt.bpp = 1;
+				memset (mono, 0, sizeof (*mono));
+				RenderGlyph (face, &mono_opt, glyph_idx, mono, &batch->arena, mono_offset);
+				itfc_character->mono = mono;
+			}
+		}
+		else
+		{	/* there is no glyph for this character code
+			we export an empty glpyph */
+			stats_Add (STATS_COUNTER_MISSING, 1);
+		}
+
+		/* the pairs with this character on the left follow the ones of the
+		previous characters. do this also for unavailable glyphs */
+		stats_Begin (STATS_PHASE_KERNING);
+		if (glyph_idx)
+			DoExportKerinig (batch, face, ctx, letter, glyph_idx);
+		stats_End (STATS_PHASE_KERNING);
+		itfc_character->kerning_num = batch->kernings_num - kernings_num;
+		stats_GlyphEnd (itfc_character->bmp_pxl_width * itfc_character->bmp_pxl_height,
+			(opt->mode == FONTCVTLIB_MODE_OUTLINE) ? itfc_character->outline_sz
+			: PackedBitmapSize (itfc_character->bmp_pxl_width, itfc_character->bmp_pxl_height, opt->bpp));
+	}
+
+	/* the arena doesn't move anymore */
+	for (uint32_t k = 0; k < batch->characters_num; k++)
+	{
+		if (batch->offsets[k] == UINT32_MAX)
+			continue;
+		if (opt->mode == FONTCVTLIB_MODE_OUTLINE)
+			batch->characters[k].outline = &batch->arena.data[batch->offsets[k]];
+		else
+			batch->characters[k].bmp = (const char *)&batch->arena.data[batch->offsets[k]];
+	}
+	for (uint32_t k = 0; k < batch->characters_num; k++)
+	{
+		if (batch->characters[k].mono && batch->mono_offsets[k] != UINT32_MAX)
+			batch->monos[k].bmp = (const char *)&batch->arena.data[batch->mono_offsets[k]];
+	}
+}
+
+/* Load and render a glyph, or encode its outline, in an arena.
+    Args:
+<face>[in] face, scaled for the export.
+<opt>[in] export options.
+<glyph_idx>[in] glyph index.
+<itfc_character>[out] metrics of the character, the bitmap pointers are not
+    set.
+<arena>[in] arena.
+<offset>[out] arena offset of the bitmap (or outline), untouched if there is
+    none.
+    Ret:
+the bytes of the bitmap at the font bpp (or of the outline).
+*/
+static uint32_t RenderGlyph (FT_Face face, const fontCvtLib_Options_t *opt, FT_UInt glyph_idx,
+	fontCvt_Character_t *itfc_character, Arena_t *arena, uint32_t *offset)
+{
+	FT_Error error;
+	uint32_t bytes = 0;
+
+	stats_Begin (STATS_PHASE_GLYPH_LOAD);
+	error = FT_Load_Glyph (face, /* handle to face object */
+		glyph_idx, /* glyph index */
+		(opt->mode == FONTCVTLIB_MODE_OUTLINE) ? FT_LOAD_NO_BITMAP : FT_LOAD_DEFAULT); /* load flags */
+	stats_End (STATS_PHASE_GLYPH_LOAD);
+	if (!error && opt->mode == FONTCVTLIB_MODE_OUTLINE)
+	{	/* export the outline as it is, nothing to render */
+		uint8_t *outline, *dst;
+
+		stats_Begin (STATS_PHASE_RENDER);
+		outline = EncodeOutline (face->glyph, itfc_character);
+		stats_End (STATS_PHASE_RENDER);
+		if (outline && (dst = ArenaAlloc (arena, itfc_character->outline_sz, offset)) != NULL)
+		{
+			memcpy (dst, outline, itfc_character->outline_sz);
+			bytes = itfc_character->outline_sz;
+		}
+		free (outline);
+	}
+	else if (!error)
+	{
+		FT_Render_Mode renderMode = FT_RENDER_MODE_NORMAL;
+
+		/* convert glyph to bitmap */
+		if (opt->mode == FONTCVTLIB_MODE_SDF)
+			renderMode = FT_RENDER_MODE_SDF;
+		else if (opt->bpp == 1)
+			renderMode = FT_RENDER_MODE_MONO;
+		stats_Begin (STATS_PHASE_RENDER);
+		error = FT_Render_Glyph (face->glyph, /* glyph slot  */
+			renderMode); /* render mode */
+		stats_End (STATS_PHASE_RENDER);
+		if (!error)
+		{
+			FT_Bitmap *bitmap;
+			uint8_t *pxlmap;
+
+			bitmap = &face->glyph->bitmap;
+			pxlmap = ArenaAlloc (arena, bitmap->width * bitmap->rows, offset);
+			if (pxlmap)
+			{
+				itfc_character->pxl_left = face->glyph->bitmap_left;
+				itfc_character->pxl_top = face->glyph->bitmap_top;
+				itfc_character->bmp_pxl_width = bitmap->width;
+				itfc_character->bmp_pxl_height = bitmap->rows;
+				itfc_character->pxl_advance = face->glyph->advance.x >> 6;
+
+				memset (pxlmap, 0, bitmap->width * bitmap->rows);
+				stats_Begin (STATS_PHASE_CONVERT);
+				ConvertBitmap (bitmap, (char *)pxlmap);
+				stats_End (STATS_PHASE_CONVERT);
+				bytes = PackedBitmapSize (bitmap->width, bitmap->rows, opt->bpp);
+			}
+			else
+				L_PRINT_GEN_ERR;
+		}
+		else
+			L_PRINT_GEN_ERR;
+	}
+	else
+		L_PRINT_GEN_ERR;
+	return bytes;
+}
+
+/* Give a rendered batch to the builder of the export.
+    Args:
+<ctx>[in] export state.
+<batch>[in] batch.
+    Ret:
+*/
+static void EmitBatch (Export_t *ctx, Batch_t *batch)
+{
+	stats_Begin (STATS_PHASE_BUILDER);
+	builderRegistry_PutBatch (ctx->builder, ctx->builder_ctx, batch->characters, batch->characters_num,
+		batch->kernings, batch->kernings_num);
+	stats_End (STATS_PHASE_BUILDER);
+	ctx->bitmaps_size += batch->bitmaps_size;
+}
+
+/* Release a batch. */
+static void FreeBatch (Batch_t *batch)
+{
+	free (batch->kernings);
+	free (batch->arena.data);
+	free (batch);
+}
+
+/* Reserve space at the end of an arena.
+    Args:
+<arena>[in] arena.
+<size>[in] bytes to reserve.
+<offset>[out] offset of the reserved space inside the arena.
+    Ret:
+the reserved space, valid until the next reservation. NULL on allocation fail.
+*/
+static uint8_t *ArenaAlloc (Arena_t *arena, uint32_t size, uint32_t *offset)
+{
+	if (arena->data == NULL || arena->size + size > arena->max)
+	{
+		uint32_t max = L_MAX (arena->max * 2, arena->size + size);
+		uint8_t *data = realloc (arena->data, L_MAX (max, 1));
+
+		if (data == NULL)
+			return NULL;
+		arena->data = data;
+		arena->max = max;
+	}
+	*offset = arena->size;
+	arena->size += size;
+	return &arena->data[*offset];
+}
+
+/* Add to the batch all the kerning information for this character in respect
+to all the other exported characters with a glyph.
+    Args:
+<batch>[in] batch.
+<face>[in] face.
+<ctx>[in] export state.
+<left_char>[in] left character of the pairs.
+<l_glyph_idx>[in] glyph of the left character.
+    Ret:
+*/
+static void DoExportKerinig (Batch_t *batch, FT_Face face, const Export_t *ctx, wchar_t left_char, FT_UInt l_glyph_idx)
+{
+	for (uint32_t j = 0; j < ctx->rights_num; j++)
+	{
+		FT_Vector delta; /* kerning adjustment */
+		uint16_t x_pxl_adj; /* x pixel adjustment */
+
+		FT_Get_Kerning (face, l_glyph_idx, ctx->rights[j].glyph_idx, FT_KERNING_DEFAULT, &delta);
+		x_pxl_adj = delta.x >> 6;
+		if (x_pxl_adj)
+		{
+			fontCvt_Kerning_t *kerning;
+
+			if (batch->kernings_num == batch->kernings_max)
+			{
+				uint32_t max = L_MAX (batch->kernings_max * 2, 64);
+				fontCvt_Kerning_t *kernings = realloc (batch->kernings, sizeof (fontCvt_Kerning_t) * max);
+
+				if (kernings == NULL)
+				{
+					L_PRINT_GEN_ERR;
+					continue;
+				}
+				batch->kernings = kernings;
+				batch->kernings_max = max;
+			}
+			kerning = &batch->kernings[batch->kernings_num++];
+			kerning->left_char = left_char;
+			kerning->right_char = ctx->rights[j].unicode;
+			kerning->x_pxl_adjust = x_pxl_adj;
+			stats_Add (STATS_COUNTER_PAIRS, 1);
+		}
+	}
+	stats_Add (STATS_COUNTER_PAIRS_TESTED, ctx->rights_num);
+}
+
+/* Compute the bytes a glyph bitmap takes once packed. Each row starts on a new
+byte, as the builders do.
+    Args:
+<width>[in] bitmap width (pixel).
+<height>[in] bitmap height (pixel).
+<bpp>[in] bit per pixel.
+    Ret:
+the packed bitmap size in bytes.
+*/
+static uint32_t PackedBitmapSize (uint16_t width, uint16_t height, uint8_t bpp)
+{
+	return ((width * bpp + 7) / 8) * height;
+}
+
+/* Flatten the outline of a loaded glyph and encode it in the compact format
+described by FONTBUILDERFORC_PIXFMT_OUTLINE. The character box and metrics
+are set too.
+    Args:
+<slot>[in] glyph slot with an outline loaded.
+<character>[out] character to fill with the outline.
+    Ret:
+the encoded outline, to be released with free. NULL on error.
+*/
+static uint8_t *EncodeOutline (FT_GlyphSlot slot, fontCvt_Character_t *character)
+{
+	static const FT_Outline_Funcs funcs =
+	{
+		.move_to = FlatMoveTo,
+		.line_to = FlatLineTo,
+		.conic_to = FlatConicTo,
+		.cubic_to = FlatCubicTo,
+		.shift = 0,
+		.delta = 0,
+	};
+	FlatOutline_t flat;
+	FT_BBox cbox;
+	uint8_t *enc, *wr;
+
+	if (slot->format != FT_GLYPH_FORMAT_OUTLINE)
+	{
+		L_PRINT_GEN_ERR;
+		return NULL;
+	}
+
+	FT_Outline_Get_CBox (&slot->outline, &cbox);
+	memset (&flat, 0, sizeof (flat));
+	flat.x_org = cbox.xMin & ~63; /* floor */
+	flat.y_org = (cbox.yMax + 63) & ~63; /* ceil */
+
+	character->pxl_left = flat.x_org >> 6;
+	character->pxl_top = flat.y_org >> 6;
+	character->bmp_pxl_width = (((cbox.xMax + 63) & ~63) - flat.x_org) >> 6;
+	character->bmp_pxl_height = (flat.y_org - (cbox.yMin & ~63)) >> 6;
+	character->pxl_advance = slot->advance.x >> 6;
+
+	if (FT_Outline_Decompose (&slot->outline, &funcs, &flat) || flat.error)
+	{
+		L_PRINT_GEN_ERR;
+		free (flat.points);
+		free (flat.contour_starts);
+		return NULL;
+	}
+
+	/* worst case: every point escaped, plus the counters */
+	enc = malloc (flat.points_num * 5 + flat.contours_num * 6 + 2);
+	wr = enc;
+	for (uint16_t c = 0; enc && c < flat.contours_num; c++)
+	{
+		uint32_t first = flat.contour_starts[c];
+		uint32_t end = (c + 1 < flat.contours_num) ? flat.contour_starts[c + 1] : flat.points_num;
+		uint32_t num;
+		int16_t *pt = &flat.points[first * 2];
+
+		/* the closing point is implicit */
+		if (end - first > 1 && pt[0] == flat.points[(end - 1) * 2] && pt[1] == flat.points[(end - 1) * 2 + 1])
+			end--;
+		num = end - first;
+		if (num < 2)
+			continue;
+
+		*wr++ = num & 0xFF;
+		*wr++ = num >> 8;
+		*wr++ = pt[0] & 0xFF;
+		*wr++ = (uint16_t)pt[0] >> 8;
+		*wr++ = pt[1] & 0xFF;
+		*wr++ = (uint16_t)pt[1] >> 8;
+		for (uint32_t k = 1; k < num; k++)
+		{
+			int16_t dx = pt[k * 2] - pt[k * 2 - 2];
+			int16_t dy = pt[k * 2 + 1] - pt[k * 2 - 1];
+
+			if (dx > -128 && dx < 128 && dy > -128 && dy < 128)
+			{
+				*wr++ = (uint8_t)dx;
+				*wr++ = (uint8_t)dy;
+			}
+			else
+			{
+				*wr++ = 0x80; /* escape: 16 bit deltas follow */
+				*wr++ = dx & 0xFF;
+				*wr++ = (uint16_t)dx >> 8;
+				*wr++ = dy & 0xFF;
+				*wr++ = (uint16_t)dy >> 8;
+			}
+		}
+	}
+	if (enc)
+	{	/* contours end */
+		*wr++ = 0;
+		*wr++ = 0;
+		character->outline = enc;
+		character->outline_sz = wr - enc;
+	}
+	else
+		L_PRINT_GEN_ERR;
+
+	free (flat.points);
+	free (flat.contour_starts);
+	return enc;
+}
+
+/* Append a point to the flattened outline.
+    Args:
+<flat>[in] flattened outline.
+<x>[in] x coordinate (26.6).
+<y>[in] y coordinate (26.6).
+    Ret:
+*/
+static void FlatAddPoint (FlatOutline_t *flat, FT_Pos x, FT_Pos y)
+{
+	int16_t qx, qy;
+
+	/* 26.6 to box relative coordinates with L_OUTLINE_FRAC_BITS */
+	qx = (x - flat->x_org + (1 << (5 - L_OUTLINE_FRAC_BITS))) >> (6 - L_OUTLINE_FRAC_BITS);
+	qy = (flat->y_org - y + (1 << (5 - L_OUTLINE_FRAC_BITS))) >> (6 - L_OUTLINE_FRAC_BITS);
+	flat->last.x = x;
+	flat->last.y = y;
+
+	if (flat->points_num > flat->contour_starts[flat->contours_num - 1]
+	 && flat->points[flat->points_num * 2 - 2] == qx
+	 && flat->points[flat->points_num * 2 - 1] == qy)
+		return; /* same point after quantization */
+
+	if (flat->points_num == flat->points_max)
+	{
+		int16_t *points;
+
+		flat->points_max = flat->points_max ? flat->points_max * 2 : 64;
+		points = realloc (flat->points, sizeof (int16_t) * 2 * flat->points_max);
+		if (points == NULL)
+		{
+			flat->error = true;
+			return;
+		}
+		flat->points = points;
+	}
+	flat->points[flat->points_num * 2] = qx;
+	flat->points[flat->points_num * 2 + 1] = qy;
+	flat->points_num++;
+}
+
+/* FT_Outline_Decompose callback: start a new contour. */
+static int FlatMoveTo (const FT_Vector *to, void *user)
+{
+	FlatOutline_t *flat = user;
+	uint32_t *starts;
+
+	starts = realloc (flat->contour_starts, sizeof (uint32_t) * (flat->contours_num + 1));
+	if (starts == NULL || flat->contours_num == UINT16_MAX)
+	{
+		flat->error = true;
+		return 1;
+	}
+	flat->contour_starts = starts;
+	flat->contour_starts[flat->contours_num++] = flat->points_num;
+	FlatAddPoint (flat, to->x, to->y);
+	return flat->error;
+}
+
+/* FT_Outline_Decompose callback: straight segment. */
+static int FlatLineTo (const FT_Vector *to, void *user)
+{
+	FlatOutline_t *flat = user;
+
+	FlatAddPoint (flat, to->x, to->y);
+	return flat->error;
+}
+
+/* FT_Outline_Decompose callback: quadratic bezier, split in segments. The
+number of segments keeps the distance from the curve below
+L_OUTLINE_TOLERANCE. */
+static int FlatConicTo (const FT_Vector *control, const FT_Vector *to, void *user)
+{
+	FlatOutline_t *flat = user;
+	FT_Vector p0 = flat->last;
+	FT_Pos dd; /* second difference, the curve bending */
+	uint16_t n;
+
+	dd = L_MAX (labs (p0.x - 2 * control->x + to->x), labs (p0.y - 2 * control->y + to->y));
+	for (n = 1; n < L_OUTLINE_MAX_SEGMENTS && dd > 4 * L_OUTLINE_TOLERANCE * n * n; n++)
+		;
+	for (uint16_t k = 1; k <= n; k++)
+	{
+		/* B(t) = (1-t)^2 p0 + 2t(1-t) c + t^2 p1 with t = k / n */
+		int64_t a = (n - k) * (n - k), b = 2 * k * (n - k), c = k * k, d = n * n;
+
+		FlatAddPoint (flat, (a * p0.x + b * control->x + c * to->x) / d,
+			(a * p0.y + b * control->y + c * to->y) / d);
+	}
+	return flat->error;
+}
+
+/* FT_Outline_Decompose callback: cubic bezier, split in segments. */
+static int FlatCubicTo (const FT_Vector *control1, const FT_Vector *control2, const FT_Vector *to, void *user)
+{
+	FlatOutline_t *flat = user;
+	FT_Vector p0 = flat->last;
+	FT_Pos dd;
+	uint16_t n;
+
+	dd = L_MAX (L_MAX (labs (p0.x - 2 * control1->x + control2->x), labs (p0.y - 2 * control1->y + control2->y)),
+		L_MAX (labs (control1->x - 2 * control2->x + to->x), labs (control1->y - 2 * control2->y + to->y)));
+	for (n = 1; n < L_OUTLINE_MAX_SEGMENTS && 3 * dd > 4 * L_OUTLINE_TOLERANCE * n * n; n++)
+		;
+	for (uint16_t k = 1; k <= n; k++)
+	{
+		/* B(t) = (1-t)^3 p0 + 3t(1-t)^2 c1 + 3t^2(1-t) c2 + t^3 p1 */
+		int64_t m = n - k;
+		int64_t a = m * m * m, b = 3 * k * m * m, c = 3 * k * k * m, e = (int64_t)k * k * k, d = (int64_t)n * n * n;
+
+		FlatAddPoint (flat, (a * p0.x + b * control1->x + c * control2->x + e * to->x) / d,
+			(a * p0.y + b * control1->y + c * control2->y + e * to->y) / d);
+	}
+	return flat->error;
+}
+
+/* Convert the bitmap provided by FreeType in a simpler format, if we can say so.
+Always 8bit per pixel (also in monotone) and no padding bytes. This should
+simplify the work inside the builder.
+    Args:
+<ft_bmp>[in] FreeType bitmap.
+<pxlmap>[out] destination pxlmap. You must provide an array with enough space.
+    Ret:
+
+*/
+static void ConvertBitmap (FT_Bitmap *ft_bmp, char *pxlmap)
+{
+	if (ft_bmp->pixel_mode == FT_PIXEL_MODE_MONO
+	 || ft_bmp->pixel_mode == FT_PIXEL_MODE_GRAY)
+	{
+		char *destPxl; /* destination pixel pointer */
+		/* source byte pointer
+		   based on the source bitmap representation mode this could contain
+		   more than one pixel */
+		const uint8_t *srcByte;
+		uint8_t bpp; /* source bitmap bit per pixel */
+
+		/* 1 - 8 bit per pixel format supported only */
+		if (ft_bmp->pixel_mode == FT_PIXEL_MODE_MONO)
+			bpp = 1;
+		else if (ft_bmp->pixel_mode == FT_PIXEL_MODE_GRAY)
+			bpp = 8;
+
+		destPxl = pxlmap;
+		for (uint16_t y = 0; y < ft_bmp->rows; y++)
+		{
+			/* bit offset of the pixel rappresentation inside the source byte */
+			int8_t bit_pos = 8 - bpp;
+
+			/* set the source to the start of the next line */
+			srcByte = ft_bmp->buffer;
+			srcByte += y * ft_bmp->pitch;
+			for (uint16_t x = 0; x < ft_bmp->width; x++)
+			{
+				uint8_t gray_val; /* destination pixel gray value, always from 0 to 255 */
+				/* bitmask of the source pixel rappresentation inside the source
+				   byte */
+				uint8_t bitMask;
+
+				bitMask = (0x01 << bpp) - 1; /* [0b00000001 with bpp = 1] [0b00001111 with bpp = 4] etc */
+				bitMask <<= bit_pos;
+				gray_val = (*srcByte & bitMask) >> bit_pos;
+				gray_val <<= (8 - bpp);
+
+				*destPxl = gray_val;
+
+				bit_pos -= bpp;
+				if (bit_pos < 0)
+				{	/* no more pixels inside this byte, move to the next */
+					bit_pos = 8 - bpp;
+					srcByte++;
+				}
+				destPxl++;
+			}
+		}
+	}
+	else
+	{
+		/* other formats not supported */
+	}
+}
@@ -0,0 +1,84 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef FONTCVTLIB_H_INCLUDED
+#define FONTCVTLIB_H_INCLUDED
+
+//____________________________________________________________INCLUDES - DEFINES
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "fontCvt.h"
+#include "builderMemory.h"
+
+typedef enum
+{	/* glyph rendering mode */
+	FONTCVTLIB_MODE_BITMAP, /* anti-aliased coverage bitmaps */
+	FONTCVTLIB_MODE_SDF, /* signed distance fields */
+	FONTCVTLIB_MODE_OUTLINE, /* outlines with flattened curves */
+	FONTCVTLIB_MODE_METRICS, /* advances and kerning only, no glyph is rendered */
+} fontCvtLib_Mode_t;
+
+typedef struct
+{	/* options of an export, see fontCvtLib_DefaultOptions */
+	const fontCvt_Range_t *ranges; /* exported characters */
+	uint16_t ranges_num;
+	uint16_t size; /* font EM square scaled pixel height */
+	uint8_t bpp; /* glyph bit per pixel: 1, 2, 4 or 8 */
+	fontCvtLib_Mode_t mode;
+	uint16_t sdf_spread; /* signed distance field spread (pixel), 2 to 32 */
+	const char *output; /* output name given to the builder */
+	const char *builder_opt; /* options given to the builder, can be NULL */
+	/* export only the batches of shard 'shard' out of 'shards_num' (see
+	shard.h), 0 shards for the whole font. Kerning pairs still look at every
+	range */
+	uint16_t shard;
+	uint16_t shards_num;
+	/* render stage threads of the export pipeline, 0 to export in the
+	calling thread. Only the render stage has many threads: the resolve
+	stage has one, and the builders pack and write the batches in the
+	calling thread (emit stage). The output does not depend on it */
+	uint16_t threads;
+	uint16_t queue_depth; /* batches each pipeline queue holds, 0 for the default */
+	/* bitmap mode: render every glyph in FreeType mono mode too, for builders
+	exporting at 1 bpp from an export at more bpp (see fontCvt_Character_t.mono).
+	Without it they get the 8 bit coverage quantized */
+	bool mono_variant;
+} fontCvtLib_Options_t;
+
+/* font face ready to be exported */
+typedef struct fontCvtLib_Face_s fontCvtLib_Face_t;
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+void fontCvtLib_Init (void);
+void fontCvtLib_DefaultOptions (fontCvtLib_Options_t *opt);
+fontCvtLib_Face_t *fontCvtLib_OpenFace (const char *fname);
+fontCvtLib_Face_t *fontCvtLib_OpenFaceMemory (const void *data, size_t size);
+void fontCvtLib_CloseFace (fontCvtLib_Face_t *face);
+bool fontCvtLib_Export (fontCvtLib_Face_t *face, const fontCvtLib_Options_t *opt, fontCvt_Builder_t *builder,
+	void *builder_ctx, uint32_t *bitmaps_size);
+builderMemory_Font_t *fontCvtLib_Render (fontCvtLib_Face_t *face, const fontCvtLib_Options_t *opt);
+bool fontCvtLib_Replay (const builderMemory_Font_t *font, const fontCvtLib_Options_t *opt, fontCvt_Builder_t *builder,
+	void *builder_ctx, uint32_t *bitmaps_size);
+uint32_t fontCvtLib_FixedSizeBitmapsSize (fontCvtLib_Face_t *face, const fontCvtLib_Options_t *opt, uint16_t size);
+uint16_t fontCvtLib_Coverage (fontCvtLib_Face_t *face, fontCvt_Range_t **ranges);
+
+#endif /* FONTCVTLIB_H_INCLUDED */
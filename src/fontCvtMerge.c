@@ -0,0 +1,225 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* fontcvt-merge: make the outputs of a sharded conversion (see shard.h).
+    fontcvt font.ttf -r 19968-40959 -o part0 --shard 0/2
+    fontcvt font.ttf -r 19968-40959 -o part1 --shard 1/2
+    fontcvt-merge -o font part0.shard part1.shard
+gives the outputs of fontcvt font.ttf -r 19968-40959 -o font. */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "fontCvtLib.h"
+#include "builderRegistry.h"
+#include "shard.h"
+
+#define L_PRINT_GEN_ERR                                fprintf (stderr, "ERROR ON %s:%d\n", __FILE__, __LINE__)
+
+typedef struct
+{	/* command line options */
+	const char *output;
+	const char *builder_opt;
+	const char **builders; /* output builders (-B name[:options]) */
+	uint8_t builders_num;
+} Options_t;
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static void PrintHelp (void);
+static bool Merge (const Options_t *opt, char *fnames[], uint16_t fnames_num);
+
+//___________________________________________________________________PRIVATE VAR
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Executable entry point.
+    Args:
+- <argc>[in] command line argument's number.
+- <argv>[in] command line argument's list.
+    Ret:
+0 on success.
+*/
+int main (int argc, char *argv[])
+{
+	Options_t opt = { 0 };
+	bool argsOk = true;
+	bool ok = false;
+	int c;
+
+	while ((c = getopt (argc, argv, ":o:B:j:h")) != -1)
+	{
+		switch (c)
+		{
+			/* output destination */
+			case 'o':
+			{
+				opt.output = optarg;
+				break;
+			}
+
+			/* output builder */
+			case 'B':
+			{
+				const char **builders = realloc (opt.builders, sizeof (char *) * (opt.builders_num + 1));
+
+				if (builders == NULL)
+				{
+					argsOk = false;
+					fprintf (stderr, "builders allocation fail\n");
+					break;
+				}
+				opt.builders = builders;
+				opt.builders[opt.builders_num++] = optarg;
+				break;
+			}
+
+			/* option string to be passed to the builder */
+			case 'j':
+			{
+				opt.builder_opt = optarg;
+				break;
+			}
+
+			/* print the help */
+			case 'h':
+			{
+				PrintHelp ( );
+				free (opt.builders);
+				return 0;
+			}
+
+			/* missing option argument */
+			case ':':
+			{
+				argsOk = false;
+				fprintf (stderr, "missing option argument for -%c option\n", optopt);
+				break;
+			}
+
+			/* unknown option */
+			default: /* '?' */
+			{
+				argsOk = false;
+				fprintf (stderr, "-%c is not a valid option\n", optopt);
+				break;
+			}
+		}
+	}
+
+	if (opt.output == NULL)
+	{
+		argsOk = false;
+		fprintf (stderr, "-o with specified output destination is mandatory\n");
+	}
+	if (optind == argc)
+	{
+		argsOk = false;
+		fprintf (stderr, "you must provide the shard files\n");
+	}
+
+	if (argsOk)
+	{
+		fontCvtLib_Init ( );
+		ok = Merge (&opt, &argv[optind], argc - optind);
+	}
+	free (opt.builders);
+	return ok ? 0 : 1;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Print help using the command line arguments.
+    Args:
+    Ret:
+*/
+static void PrintHelp (void)
+{
+	printf ("\n");
+	printf ("\
+fontcvt-merge use:\n\
+    fontcvt-merge [OPTIONS] ... -o OUTPUT_NAME SHARD_FILE ...\n\
+    Merge all the shards made by fontcvt --shard and export the whole font.\n");
+	printf ("\n");
+	printf ("\
+-o) Specify the output filename. (mandatory)\n");
+	printf ("\
+-B) Select an output builder as name[:options], as fontcvt -B.\n\
+    Builders (default c):\n");
+	builderRegistry_PrintHelp (stdout);
+	printf ("\
+-j) Options for the builders selected without options, as fontcvt -j.\n");
+	printf ("\
+-h) Print this help and exit.\n");
+}
+
+/* Load the shards, merge them and export the font to the builders.
+    Args:
+<opt>[in] command line options.
+<fnames>[in] shard files.
+<fnames_num>[in] number of shard files.
+    Ret:
+false on error.
+*/
+static bool Merge (const Options_t *opt, char *fnames[], uint16_t fnames_num)
+{
+	fontCvt_Builder_t *builder = &builderRegistry_FanOut;
+	shard_Shard_t *shards = calloc (fnames_num, sizeof (shard_Shard_t));
+	builderMemory_Font_t *font = NULL;
+	void *builder_ctx = NULL;
+	bool ok = (shards != NULL);
+
+	for (uint16_t k = 0; k < fnames_num && ok; k++)
+		ok = shard_Load (fnames[k], &shards[k]);
+	if (ok)
+		ok = (font = shard_Merge (shards, fnames_num)) != NULL;
+	if (ok)
+		ok = (builder_ctx = builder->create ( )) != NULL;
+	if (ok)
+	{	/* the C builder is the default one, the metrics one in metrics mode */
+		fontCvtLib_Options_t lib = shards[0].opt;
+
+		for (uint8_t k = 0; k < opt->builders_num; k++)
+			ok &= builderRegistry_Select (builder_ctx, opt->builders[k], opt->output, opt->builder_opt, 0);
+		if (opt->builders_num == 0)
+		{
+			ok &= builderRegistry_Select (builder_ctx, (lib.mode == FONTCVTLIB_MODE_METRICS) ? "metrics" : "c",
+				opt->output, opt->builder_opt, 0);
+		}
+
+		lib.shard = lib.shards_num = 0;
+		lib.output = opt->output;
+		lib.builder_opt = opt->builder_opt;
+		if (ok)
+			ok = fontCvtLib_Replay (font, &lib, builder, builder_ctx, NULL);
+	}
+
+	if (builder_ctx)
+		builder->destroy (builder_ctx);
+	builderMemory_Free (font);
+	for (uint16_t k = 0; shards && k < fnames_num; k++)
+		shard_Free (&shards[k]);
+	free (shards);
+	return ok;
+}
@@ -0,0 +1,297 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* Host text measurement, see fontMetrics.h. It is fast enough for millions of
+strings per second: the range of the previous character is tried first, then
+the ranges are binary searched, and so are the kerning pairs of a character. */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "fontMetrics.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define L_HEADER_SIZE         22
+#define L_RANGE_SIZE          12
+#define L_KERNING_SIZE        5
+#define L_NONE                UINT32_MAX
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static uint32_t NextUnicode (const uint8_t **text);
+static uint32_t FindCharacter (const fontMetrics_Font_t *font, uint32_t unicode, const fontMetrics_Range_t **hint);
+static int8_t GetKerning (const fontMetrics_Font_t *font, uint32_t left, uint32_t right_unicode);
+static uint32_t Get (const uint8_t **src, uint8_t bytes);
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Load a binary metrics table.
+    Args:
+<fname>[in] table file, OUTPUT.metrics.bin.
+    Ret:
+the font, free it with fontMetrics_Free. NULL if the file can't be read or it
+is not a valid table.
+*/
+fontMetrics_Font_t *fontMetrics_Load (const char *fname)
+{
+	fontMetrics_Font_t *font = NULL;
+	uint8_t *data = NULL;
+	long size;
+	FILE *f;
+
+	if ((f = fopen (fname, "rb")) == NULL)
+		return NULL;
+	if (fseek (f, 0, SEEK_END) == 0 && (size = ftell (f)) > 0 && fseek (f, 0, SEEK_SET) == 0
+	 && (data = malloc (size)) != NULL && fread (data, 1, size, f) == (size_t)size)
+		font = fontMetrics_LoadMemory (data, size);
+	free (data);
+	fclose (f);
+	return font;
+}
+
+/* Load a binary metrics table from memory. The data is copied, it can be
+released after the call.
+    Args:
+<data>[in] content of an OUTPUT.metrics.bin file.
+<size>[in] bytes of data.
+    Ret:
+the font, free it with fontMetrics_Free. NULL if it is not a valid table or
+on allocation fail.
+*/
+fontMetrics_Font_t *fontMetrics_LoadMemory (const void *data, size_t size)
+{
+	const uint8_t *src = data;
+	fontMetrics_Font_t header, *font;
+	fontMetrics_Range_t *ranges;
+	fontMetrics_Kerning_t *kerning;
+	uint32_t *kerning_index;
+	uint8_t *advances;
+	bool valid = true;
+
+	if (size < L_HEADER_SIZE || memcmp (src, FONTMETRICS_BIN_MAGIC, 8))
+		return NULL;
+	src += 8;
+	if (Get (&src, 2) != FONTMETRICS_BIN_VERSION)
+		return NULL;
+	memset (&header, 0, sizeof (header));
+	header.pxl_baseline_to_baseline = Get (&src, 1);
+	header.pxl_max_glyph_height = Get (&src, 1);
+	header.num_ranges = Get (&src, 2);
+	header.num_characters = Get (&src, 4);
+	header.num_kerning = Get (&src, 4);
+	if (size != L_HEADER_SIZE + (uint64_t)header.num_ranges * L_RANGE_SIZE + header.num_characters
+		+ ((uint64_t)header.num_characters + 1) * 4 + (uint64_t)header.num_kerning * L_KERNING_SIZE)
+		return NULL;
+
+	/* one block: font, ranges, kerning index, pairs and advances */
+	font = malloc (sizeof (fontMetrics_Font_t) + sizeof (fontMetrics_Range_t) * header.num_ranges
+		+ sizeof (uint32_t) * ((size_t)header.num_characters + 1)
+		+ sizeof (fontMetrics_Kerning_t) * header.num_kerning + header.num_characters);
+	if (font == NULL)
+		return NULL;
+	*font = header;
+	ranges = (fontMetrics_Range_t *)(font + 1);
+	kerning_index = (uint32_t *)(ranges + header.num_ranges);
+	kerning = (fontMetrics_Kerning_t *)(kerning_index + header.num_characters + 1);
+	advances = (uint8_t *)(kerning + header.num_kerning);
+	font->ranges = ranges;
+	font->kerning_index = kerning_index;
+	font->kerning = kerning;
+	font->advances = advances;
+
+	for (uint16_t k = 0; k < header.num_ranges; k++)
+	{
+		ranges[k].first = Get (&src, 4);
+		ranges[k].num_characters = Get (&src, 4);
+		ranges[k].characters = Get (&src, 4);
+		if ((uint64_t)ranges[k].characters + ranges[k].num_characters > header.num_characters
+		 || (k && ranges[k].first < (uint64_t)ranges[k - 1].first + ranges[k - 1].num_characters))
+			valid = false;
+	}
+	memcpy (advances, src, header.num_characters);
+	src += header.num_characters;
+	for (uint32_t k = 0; k <= header.num_characters; k++)
+	{
+		kerning_index[k] = Get (&src, 4);
+		if (k && kerning_index[k] < kerning_index[k - 1])
+			valid = false;
+	}
+	for (uint32_t k = 0; k < header.num_kerning; k++)
+	{
+		kerning[k].right_ch = Get (&src, 4);
+		kerning[k].pxl_adjust = (int8_t)Get (&src, 1);
+	}
+	/* the ranges must be in order and inside the characters, the pairs must be
+	in order */
+	if (!valid || kerning_index[0] != 0
+	 || kerning_index[header.num_characters] != header.num_kerning)
+	{
+		free (font);
+		return NULL;
+	}
+	return font;
+}
+
+/* Release a font loaded by fontMetrics_Load or fontMetrics_LoadMemory. */
+void fontMetrics_Free (fontMetrics_Font_t *font)
+{
+	free (font);
+}
+
+/* Width of a UTF-8 string as the device runtime draws it: advances plus the
+kerning between consecutive characters. Characters missing from the font are
+skipped and break the kerning, as on the device.
+    Args:
+<font>[in] metrics table.
+<utf8>[in] zero terminated text.
+    Ret:
+the width in pixel.
+*/
+int32_t fontMetrics_Width (const fontMetrics_Font_t *font, const char *utf8)
+{
+	const uint8_t *text = (const uint8_t *)utf8;
+	const fontMetrics_Range_t *hint = font->num_ranges ? font->ranges : NULL;
+	uint32_t prev = L_NONE; /* previous character */
+	int32_t w = 0;
+
+	for (uint32_t unicode = NextUnicode (&text); unicode; unicode = NextUnicode (&text))
+	{
+		uint32_t ch = FindCharacter (font, unicode, &hint);
+
+		if (ch == L_NONE)
+		{
+			prev = L_NONE;
+			continue;
+		}
+		if (prev != L_NONE)
+			w += GetKerning (font, prev, unicode);
+		w += font->advances[ch];
+		prev = ch;
+	}
+	return w;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Decode the next UTF-8 character and advance the text, as NextUnicode of
+fontBuilderForCpp.hpp does. A sequence cut by the end of the text ends it.
+    Args:
+<text>[in/out] text.
+    Ret:
+the unicode character, 0 at the end of the text.
+*/
+static uint32_t NextUnicode (const uint8_t **text)
+{
+	const uint8_t *t = *text;
+	uint32_t unicode = t[0];
+	uint8_t len = 1;
+
+	if (unicode < 0x80)
+	{	/* most of the text */
+		*text += (unicode != 0);
+		return unicode;
+	}
+	if (t[0] >= 0xF0)
+		unicode = t[0] & 0x07, len = 4;
+	else if (t[0] >= 0xE0)
+		unicode = t[0] & 0x0F, len = 3;
+	else
+		unicode = t[0] & 0x1F, len = 2;
+	for (uint8_t k = 1; k < len; k++)
+	{
+		if (t[k] == 0)
+			return 0;
+		unicode = (unicode << 6) | (t[k] & 0x3F);
+	}
+	if (unicode)
+		*text += len;
+	return unicode;
+}
+
+/* Look for a character, in the range of the previous one first.
+    Args:
+<font>[in] metrics table.
+<unicode>[in] character.
+<hint>[in/out] range of the previous character, set to the range of this one.
+    Ret:
+the index of the character, L_NONE if it is not inside the font.
+*/
+static uint32_t FindCharacter (const fontMetrics_Font_t *font, uint32_t unicode, const fontMetrics_Range_t **hint)
+{
+	const fontMetrics_Range_t *range = *hint;
+	uint32_t lo = 0, hi = font->num_ranges;
+
+	if (range && unicode >= range->first && unicode - range->first < range->num_characters)
+		return range->characters + unicode - range->first;
+	while (lo < hi)
+	{	/* last range starting before the character */
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		if (font->ranges[mid].first <= unicode)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0)
+		return L_NONE;
+	range = &font->ranges[lo - 1];
+	if (unicode - range->first >= range->num_characters)
+		return L_NONE;
+	*hint = range;
+	return range->characters + unicode - range->first;
+}
+
+/* Kerning between a character and the next one, binary search of the pairs
+of the left character.
+    Args:
+<font>[in] metrics table.
+<left>[in] index of the left character.
+<right_unicode>[in] right character.
+    Ret:
+the pixels to move the cursor before the right character.
+*/
+static int8_t GetKerning (const fontMetrics_Font_t *font, uint32_t left, uint32_t right_unicode)
+{
+	uint32_t lo = font->kerning_index[left];
+	uint32_t hi = font->kerning_index[left + 1];
+
+	while (lo < hi)
+	{
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		if (font->kerning[mid].right_ch < right_unicode)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < font->kerning_index[left + 1] && font->kerning[lo].right_ch == right_unicode)
+		return font->kerning[lo].pxl_adjust;
+	return 0;
+}
+
+/* Read a little endian unsigned value and advance the source. */
+static uint32_t Get (const uint8_t **src, uint8_t bytes)
+{
+	uint32_t val = 0;
+
+	for (uint8_t k = 0; k < bytes; k++)
+		val |= (uint32_t)(*src)[k] << (8 * k);
+	*src += bytes;
+	return val;
+}
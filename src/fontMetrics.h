@@ -0,0 +1,80 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* Host text measurement on the metrics tables of fontcvt -m metrics. A server
+can tell if a text overflows on the device without rendering anything: the
+advances and the kerning pairs are the ones of the device fonts of the same
+size, and fontMetrics_Width adds them up as the device runtime does, with the
+same 8 bit advances and kerning adjustments. fontMetrics.c needs no FreeType.
+
+A table is compiled in (builder metrics, default format: OUTPUT.c and
+OUTPUT.h) or loaded at run time with fontMetrics_Load (format=bin:
+OUTPUT.metrics.bin). The binary table is little endian:
+    "FCVTMTRC", version (u16), baseline to baseline, max glyph height (u8),
+        ranges (u16), characters, kerning pairs (u32)
+    ranges: first, characters, index of the first character (u32), sorted
+        and not overlapping
+    advances: pixel advance of each character (u8)
+    kerning index: first pair of each character, then the pairs (u32)
+    kerning pairs: right character (u32), adjust (i8) */
+
+#ifndef FONTMETRICS_H_INCLUDED
+#define FONTMETRICS_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FONTMETRICS_BIN_MAGIC               "FCVTMTRC"
+#define FONTMETRICS_BIN_VERSION             1
+
+typedef struct
+{
+	uint32_t first; // unicode value of the first character of this range
+	uint32_t num_characters;
+	uint32_t characters; // index of the first character of the range
+} fontMetrics_Range_t; // sorted by first, they don't overlap
+
+typedef struct
+{	/* move the cursor of 'pxl_adjust' pixels before 'right_ch', the left
+	character is the one owning the pair */
+	uint32_t right_ch;
+	int8_t pxl_adjust;
+} fontMetrics_Kerning_t;
+
+typedef struct
+{
+	uint8_t pxl_baseline_to_baseline;
+	uint8_t pxl_max_glyph_height;
+	uint16_t num_ranges;
+	uint32_t num_characters;
+	uint32_t num_kerning;
+	const fontMetrics_Range_t *ranges;
+	const uint8_t *advances; // pixel advance of each character
+	/* num_characters + 1 entries: the pairs of character k, sorted by right
+	character, are kerning_index[k] to kerning_index[k + 1] - 1 */
+	const uint32_t *kerning_index;
+	const fontMetrics_Kerning_t *kerning;
+} fontMetrics_Font_t;
+
+fontMetrics_Font_t *fontMetrics_Load (const char *fname);
+fontMetrics_Font_t *fontMetrics_LoadMemory (const void *data, size_t size);
+void fontMetrics_Free (fontMetrics_Font_t *font);
+int32_t fontMetrics_Width (const fontMetrics_Font_t *font, const char *utf8);
+
+#endif // FONTMETRICS_H_INCLUDED
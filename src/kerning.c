@@ -0,0 +1,173 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Kerning pruning: most pairs of a big font never occur in the strings of
+the firmware, yet each of them takes table space and lookup time. A pair
+weighs how often the corpus has it times the pixels it moves; the pairs the
+corpus never has are dropped and the heaviest ones are kept up to the pair
+budget. */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "kerning.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{	/* kerning pair of the font */
+	uint32_t index; /* in the font kernings */
+	uint64_t count; /* occurrences in the corpus */
+	uint64_t weight; /* count times the pixels moved */
+} Pair_t;
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static int CompareWeight (const void *a, const void *b);
+
+//___________________________________________________________________PRIVATE VAR
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Drop the kerning pairs of a font the corpus doesn't need: the pairs moving
+nothing, the pairs the corpus never has and, over the budget, the ones
+weighing least.
+    Args:
+<font>[in/out] font exported in memory, its kernings are pruned.
+<corpus>[in] text the font has to draw.
+<budget>[in] most pairs to keep.
+<result>[out] pairs kept and dropped and layout error.
+    Ret:
+false on allocation fail, the font is not changed.
+*/
+bool kerning_Prune (builderMemory_Font_t *font, const corpus_Corpus_t *corpus, uint32_t budget,
+	kerning_Result_t *result)
+{
+	Pair_t *used = malloc (sizeof (Pair_t) * (font->kernings_num + 1));
+	uint32_t *new_index = malloc (sizeof (uint32_t) * (font->kernings_num + 1));
+	bool *keep = calloc (font->kernings_num + 1, sizeof (bool));
+	uint32_t used_num = 0, num = 0;
+
+	memset (result, 0, sizeof (*result));
+	if (used == NULL || new_index == NULL || keep == NULL)
+	{
+		free (used);
+		free (new_index);
+		free (keep);
+		fprintf (stderr, "kerning allocation fail\n");
+		return false;
+	}
+
+	result->pairs = font->kernings_num;
+	for (uint32_t k = 0; k < font->kernings_num; k++)
+	{
+		const fontCvt_Kerning_t *kerning = &font->kernings[k];
+		uint64_t count = corpus_PairCount (corpus, kerning->left_char, kerning->right_char);
+
+		if (kerning->x_pxl_adjust == 0)
+			result->zero++;
+		else if (count == 0)
+			result->unused++;
+		else
+		{
+			used[used_num].index = k;
+			used[used_num].count = count;
+			used[used_num++].weight = count * abs (kerning->x_pxl_adjust);
+		}
+	}
+	qsort (used, used_num, sizeof (Pair_t), CompareWeight);
+	for (uint32_t k = 0; k < used_num; k++)
+	{
+		uint16_t moved = abs (font->kernings[used[k].index].x_pxl_adjust);
+
+		if (k < budget)
+		{
+			keep[used[k].index] = true;
+			continue;
+		}
+		result->over_budget++;
+		result->corpus_pairs_moved += used[k].count;
+		result->error_pxl += used[k].weight;
+		if (moved > result->max_error_pxl)
+			result->max_error_pxl = moved;
+	}
+
+	/* the corpus pairs the font draws: both characters have a glyph */
+	for (uint32_t k = 0; k < corpus->pairs_num; k++)
+	{
+		const builderMemory_Character_t *left = builderMemory_Find (font, corpus->pairs[k] >> 32);
+		const builderMemory_Character_t *right = builderMemory_Find (font, corpus->pairs[k] & UINT32_MAX);
+
+		if (left && right && left->character.glyph_idx && right->character.glyph_idx)
+			result->corpus_pairs += corpus->pair_counts[k];
+	}
+
+	/* compact the pairs, the first pair of a character moves with them */
+	for (uint32_t k = 0; k < font->kernings_num; k++)
+	{
+		new_index[k] = num;
+		if (keep[k])
+			font->kernings[num++] = font->kernings[k];
+	}
+	new_index[font->kernings_num] = num;
+	for (uint32_t k = 0; k < font->characters_num; k++)
+	{
+		builderMemory_Character_t *ch = &font->characters[k];
+
+		ch->kerning_index = new_index[ch->kerning_index];
+	}
+	font->kernings_num = num;
+	result->kept = num;
+
+	free (used);
+	free (new_index);
+	free (keep);
+	return true;
+}
+
+/* Print the pairs kept and dropped and the layout error of kerning_Prune.
+    Args:
+<f>[in] destination.
+<result>[in] kerning_Prune outcome.
+    Ret:
+*/
+void kerning_Print (FILE *f, const kerning_Result_t *result)
+{
+	fprintf (f, "kerning: %u of %u pairs kept, %u dropped unused by the corpus, %u over the budget",
+		result->kept, result->pairs, result->unused, result->over_budget);
+	if (result->zero)
+		fprintf (f, ", %u moving nothing", result->zero);
+	fprintf (f, "\n  layout error: %llu of %llu corpus pairs moved, %llu px in total, %.4f px per pair, %u px at most\n",
+		(unsigned long long)result->corpus_pairs_moved, (unsigned long long)result->corpus_pairs,
+		(unsigned long long)result->error_pxl,
+		result->corpus_pairs ? (double)result->error_pxl / result->corpus_pairs : 0.0, result->max_error_pxl);
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* qsort compare function of the pairs: the heaviest first, then the most
+used, then in font order so that the outcome doesn't depend on qsort. */
+static int CompareWeight (const void *a, const void *b)
+{
+	const Pair_t *pa = a, *pb = b;
+
+	if (pa->weight != pb->weight)
+		return (pa->weight < pb->weight) - (pa->weight > pb->weight);
+	if (pa->count != pb->count)
+		return (pa->count < pb->count) - (pa->count > pb->count);
+	return (pa->index > pb->index) - (pa->index < pb->index);
+}
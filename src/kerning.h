@@ -0,0 +1,53 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KERNING_H_INCLUDED
+#define KERNING_H_INCLUDED
+
+//____________________________________________________________INCLUDES - DEFINES
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "builderMemory.h"
+#include "corpus.h"
+
+typedef struct
+{	/* outcome of kerning_Prune */
+	uint32_t pairs; /* pairs of the font before pruning */
+	uint32_t kept;
+	uint32_t zero; /* pairs dropped because they move nothing */
+	uint32_t unused; /* pairs dropped because the corpus never has them */
+	uint32_t over_budget; /* pairs of the corpus dropped to fit the budget */
+	/* pairs of consecutive characters of the corpus the font draws, and how
+	many of them lost their kerning */
+	uint64_t corpus_pairs;
+	uint64_t corpus_pairs_moved;
+	/* layout error: the sum of the pixels the dropped pairs move the
+	characters of the corpus, and the largest of them */
+	uint64_t error_pxl;
+	uint16_t max_error_pxl;
+} kerning_Result_t;
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+bool kerning_Prune (builderMemory_Font_t *font, const corpus_Corpus_t *corpus, uint32_t budget,
+	kerning_Result_t *result);
+void kerning_Print (FILE *f, const kerning_Result_t *result);
+
+#endif /* KERNING_H_INCLUDED */
@@ -0,0 +1,191 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* Bounded lock-free queue (D. Vyukov's bounded MPMC queue): every cell has a
+sequence number telling if it can be written or read at a position, producers
+and consumers claim positions with a compare and swap. queue_Push and
+queue_Pop wait yielding the processor, and count how often they had to: a
+queue almost always full slows down its producers, one almost always empty
+its consumers. */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "queue.h"
+
+#include <stdlib.h>
+#include <sched.h>
+
+//____________________________________________________________PRIVATE PROTOTYPES
+
+//___________________________________________________________________PRIVATE VAR
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Initialize an empty queue.
+    Args:
+<queue>[out] queue.
+<capacity>[in] items the queue can hold, rounded up to a power of two.
+    Ret:
+false on allocation fail.
+*/
+bool queue_Init (queue_Queue_t *queue, size_t capacity)
+{
+	size_t size = 2;
+
+	while (size < capacity)
+		size *= 2;
+	queue->cells = malloc (sizeof (queue_Cell_t) * size);
+	if (queue->cells == NULL)
+		return false;
+	for (size_t k = 0; k < size; k++)
+		atomic_init (&queue->cells[k].seq, k);
+	queue->mask = size - 1;
+	atomic_init (&queue->head, 0);
+	atomic_init (&queue->tail, 0);
+	atomic_init (&queue->pushes, 0);
+	atomic_init (&queue->occupancy_sum, 0);
+	atomic_init (&queue->full_waits, 0);
+	atomic_init (&queue->empty_waits, 0);
+	return true;
+}
+
+/* Release a queue, its items are not released. */
+void queue_Free (queue_Queue_t *queue)
+{
+	free (queue->cells);
+	queue->cells = NULL;
+}
+
+/* Push an item if the queue is not full.
+    Args:
+<queue>[in] queue.
+<item>[in] item.
+    Ret:
+false if the queue is full.
+*/
+bool queue_TryPush (queue_Queue_t *queue, void *item)
+{
+	size_t pos = atomic_load_explicit (&queue->head, memory_order_relaxed);
+	queue_Cell_t *cell;
+	intptr_t occupancy;
+
+	while (true)
+	{
+		intptr_t dif;
+
+		cell = &queue->cells[pos & queue->mask];
+		dif = (intptr_t)atomic_load_explicit (&cell->seq, memory_order_acquire) - (intptr_t)pos;
+		if (dif == 0)
+		{	/* the cell is free at this position, claim it */
+			if (atomic_compare_exchange_weak_explicit (&queue->head, &pos, pos + 1,
+			                                           memory_order_relaxed, memory_order_relaxed))
+				break;
+		}
+		else if (dif < 0)
+			return false;
+		else
+			pos = atomic_load_explicit (&queue->head, memory_order_relaxed);
+	}
+	cell->item = item;
+	atomic_store_explicit (&cell->seq, pos + 1, memory_order_release);
+
+	atomic_fetch_add_explicit (&queue->pushes, 1, memory_order_relaxed);
+	/* consumers can pop this item and the ones pushed after it before the tail
+	is read: the tail is then past pos + 1 */
+	occupancy = (intptr_t)(pos + 1) - (intptr_t)atomic_load_explicit (&queue->tail, memory_order_relaxed);
+	if (occupancy > 0)
+		atomic_fetch_add_explicit (&queue->occupancy_sum, occupancy, memory_order_relaxed);
+	return true;
+}
+
+/* Pop an item if the queue is not empty.
+    Args:
+<queue>[in] queue.
+    Ret:
+the oldest item, NULL if the queue is empty.
+*/
+void *queue_TryPop (queue_Queue_t *queue)
+{
+	size_t pos = atomic_load_explicit (&queue->tail, memory_order_relaxed);
+	queue_Cell_t *cell;
+	void *item;
+
+	while (true)
+	{
+		intptr_t dif;
+
+		cell = &queue->cells[pos & queue->mask];
+		dif = (intptr_t)atomic_load_explicit (&cell->seq, memory_order_acquire) - (intptr_t)(pos + 1);
+		if (dif == 0)
+		{	/* the cell is written at this position, claim it */
+			if (atomic_compare_exchange_weak_explicit (&queue->tail, &pos, pos + 1,
+			                                           memory_order_relaxed, memory_order_relaxed))
+				break;
+		}
+		else if (dif < 0)
+			return NULL;
+		else
+			pos = atomic_load_explicit (&queue->tail, memory_order_relaxed);
+	}
+	item = cell->item;
+	atomic_store_explicit (&cell->seq, pos + queue->mask + 1, memory_order_release);
+	return item;
+}
+
+/* Push an item, waiting while the queue is full.
+    Args:
+<queue>[in] queue.
+<item>[in] item.
+    Ret:
+*/
+void queue_Push (queue_Queue_t *queue, void *item)
+{
+	if (queue_TryPush (queue, item))
+		return;
+	atomic_fetch_add_explicit (&queue->full_waits, 1, memory_order_relaxed);
+	while (!queue_TryPush (queue, item))
+		sched_yield ( );
+}
+
+/* Pop an item, waiting while the queue is empty.
+    Args:
+<queue>[in] queue, items can't be NULL.
+    Ret:
+the oldest item.
+*/
+void *queue_Pop (queue_Queue_t *queue)
+{
+	void *item = queue_TryPop (queue);
+
+	if (item)
+		return item;
+	atomic_fetch_add_explicit (&queue->empty_waits, 1, memory_order_relaxed);
+	while ((item = queue_TryPop (queue)) == NULL)
+		sched_yield ( );
+	return item;
+}
+
+/* Items a queue can hold. */
+size_t queue_Capacity (const queue_Queue_t *queue)
+{
+	return queue->mask + 1;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
@@ -0,0 +1,59 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef QUEUE_H_INCLUDED
+#define QUEUE_H_INCLUDED
+
+//____________________________________________________________INCLUDES - DEFINES
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+typedef struct
+{
+	_Atomic size_t seq;
+	void *item;
+} queue_Cell_t;
+
+typedef struct
+{	/* bounded lock-free queue of pointers, many producers and consumers */
+	queue_Cell_t *cells;
+	size_t mask; /* capacity - 1, the capacity is a power of two */
+	_Atomic size_t head; /* next push position */
+	_Atomic size_t tail; /* next pop position */
+	/* occupancy statistics */
+	_Atomic uint64_t pushes;
+	_Atomic uint64_t occupancy_sum; /* items in the queue after each push */
+	_Atomic uint64_t full_waits; /* a producer found the queue full */
+	_Atomic uint64_t empty_waits; /* a consumer found the queue empty */
+} queue_Queue_t;
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+bool queue_Init (queue_Queue_t *queue, size_t capacity);
+void queue_Free (queue_Queue_t *queue);
+bool queue_TryPush (queue_Queue_t *queue, void *item);
+void *queue_TryPop (queue_Queue_t *queue);
+void queue_Push (queue_Queue_t *queue, void *item);
+void *queue_Pop (queue_Queue_t *queue);
+size_t queue_Capacity (const queue_Queue_t *queue);
+
+#endif /* QUEUE_H_INCLUDED */
@@ -0,0 +1,1417 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* Daemon mode (fontcvt --serve[=SOCKET]). Jobs are JSON objects, one per
+line, read from the standard input or from the clients of a Unix socket:
+    {"id": 1, "args": ["-s16", "-r32-126", "-o", "lato16", "Lato.ttf"]}
+args is the fontcvt command line. Optional members: "cwd" the directory the
+job paths are relative to, "watch": true to run the job again every time its
+font file changes, "manifest": "<file>" to run the jobs listed one per line in
+a file (relative to its directory) and, with "watch", to run again only the
+changed lines when the file changes, "quit": true to stop the daemon.
+Faces stay open between jobs and the glyphs rendered by a job are kept in
+memory (see fontCvtLib_Replay): a job with the same font, size, bpp, mode and
+ranges only runs the builders. Every job is answered with one line:
+    {"id": 1, "ok": true, "trigger": "request", "face": "warm",
+     "glyphs": "cold", "ms": {"total": 9.1, "face": 0.0, "render": 8.2, "build": 0.9}}
+trigger is "watch" for the jobs run again after a change. With the standard
+input the answers are written to the standard output and anything the
+builders print goes to the standard error. */
+
+//____________________________________________________________INCLUDES - DEFINES
+#define _GNU_SOURCE /* accept4 */
+#include "serve.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <ctype.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define L_PRINT_GEN_ERR       fprintf (stderr, "ERROR ON %s:%d\n", __FILE__, __LINE__)
+
+#define L_MAX_FACES           8 /* faces kept open */
+#define L_MAX_RENDERS         16 /* rendered fonts kept in memory */
+#define L_MAX_CLIENTS         16
+#define L_MAX_INPUTS          4 /* files a job depends on */
+#define L_MAX_ARGS            128
+#define L_MAX_JSON_DEPTH      16
+#define L_LINE_MAX            65536
+/* changes closer than this are handled together, editors write a file in
+many steps */
+#define L_DEBOUNCE_MS         50
+
+typedef struct
+{	/* a face kept open, with the identity of its file */
+	char *path;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	fontCvtLib_Face_t *face;
+	uint64_t used; /* last use, for the LRU eviction */
+} Face_t;
+
+typedef struct
+{	/* a rendered font and the options it was rendered with */
+	const fontCvtLib_Face_t *face;
+	fontCvtLib_Options_t opt; /* owns its ranges */
+	builderMemory_Font_t *font;
+	uint64_t used;
+} Render_t;
+
+typedef struct
+{
+	char *id; /* raw JSON value of the request id, NULL if none */
+	char **argv; /* command line, argv[0] is the program name */
+	int argc;
+	char *cwd; /* NULL for the daemon directory */
+	char *inputs[L_MAX_INPUTS]; /* absolute paths of the files the job depends on */
+	uint8_t inputs_num;
+	char *manifest; /* absolute path of the manifest the job comes from, or NULL */
+	char *line; /* manifest line of the job */
+	int client; /* descriptor the answers are written to, -1 for stderr */
+	bool dirty; /* an input changed */
+	bool keep; /* still inside its manifest */
+} Job_t;
+
+typedef struct
+{	/* a watched manifest */
+	char *path;
+	char *id;
+	int client;
+	bool dirty;
+} Manifest_t;
+
+typedef struct
+{
+	int in;
+	int out;
+	char *buf; /* partial line */
+	size_t len;
+} Client_t;
+
+typedef struct
+{	/* a request line */
+	char *id;
+	char **args;
+	uint16_t args_num;
+	char *cwd;
+	char *manifest;
+	bool watch;
+	bool quit;
+} Request_t;
+
+typedef struct
+{	/* what the running job got from the caches */
+	Job_t *job;
+	double face_ms;
+	double render_ms;
+	const char *face; /* "warm", "cold" or "none" */
+	const char *glyphs;
+} Current_t;
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static void OnSignal (int sig);
+static double NowMs (void);
+static char *AbsolutePath (const char *dir, const char *fname);
+static void CloseFace (Face_t *face);
+static void FreeRender (Render_t *render);
+static bool SameOptions (const fontCvtLib_Options_t *a, const fontCvtLib_Options_t *b);
+static bool SameRanges (const fontCvtLib_Options_t *a, const fontCvtLib_Options_t *b);
+
+static const char *JsonSpaces (const char *p);
+static const char *JsonString (const char *p, char **str);
+static bool JsonHex4 (const char *p, uint32_t *val);
+static const char *JsonValue (const char *p, uint8_t depth);
+static bool ParseRequest (const char *line, Request_t *req);
+static void FreeRequest (Request_t *req);
+static void PrintJsonString (FILE *f, const char *str);
+static void Answer (int client, const char *text, size_t len);
+
+static Job_t *NewJob (const Request_t *req, const char *dir, int client);
+static void FreeJob (Job_t *job);
+static bool RunJob (Job_t *job, const char *trigger);
+static bool RunManifest (const char *path, const char *id, int client, bool watch, const char *trigger);
+static void Watch (const char *path);
+static void Request (Client_t *client, const char *line);
+static void ReadClient (Client_t *client);
+static void CloseClient (Client_t *client);
+static void ReadChanges (void);
+static void RunChanges (void);
+
+//___________________________________________________________________PRIVATE VAR
+static serve_Job_f JobFn;
+static volatile sig_atomic_t Stop;
+static char StartDir[PATH_MAX]; /* daemon directory */
+static uint64_t Clock; /* cache use counter */
+
+static Face_t Faces[L_MAX_FACES];
+static Render_t Renders[L_MAX_RENDERS];
+static Current_t Current;
+
+static Job_t **Watched; /* jobs run again when their inputs change */
+static uint32_t WatchedNum;
+static Manifest_t *Manifests;
+static uint32_t ManifestsNum;
+static int Inotify = -1;
+static int *Wds; /* inotify watch of each directory */
+static char **WdDirs;
+static uint32_t WdsNum;
+static bool Pending; /* changes waiting for the debounce */
+
+static Client_t Clients[L_MAX_CLIENTS];
+static uint8_t ClientsNum;
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Run the daemon until a quit request, SIGINT or SIGTERM. With the standard
+input it also stops at the end of the input, unless some job is watched.
+    Args:
+<socket_path>[in] Unix socket to listen on, NULL for the standard input.
+<job>[in] function running a job.
+    Ret:
+0 on success.
+*/
+int serve_Run (const char *socket_path, serve_Job_f job)
+{
+	struct sigaction sa;
+	int listener = -1;
+
+	JobFn = job;
+	if (getcwd (StartDir, sizeof (StartDir)) == NULL)
+	{
+		L_PRINT_GEN_ERR;
+		return 1;
+	}
+	memset (&sa, 0, sizeof (sa));
+	sa.sa_handler = OnSignal;
+	sigaction (SIGINT, &sa, NULL);
+	sigaction (SIGTERM, &sa, NULL);
+	signal (SIGPIPE, SIG_IGN);
+
+	Inotify = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+	if (Inotify < 0)
+		fprintf (stderr, "inotify not available, watch disabled\n");
+
+	if (socket_path)
+	{
+		struct sockaddr_un addr;
+
+		memset (&addr, 0, sizeof (addr));
+		addr.sun_family = AF_UNIX;
+		if (strlen (socket_path) >= sizeof (addr.sun_path))
+		{
+			fprintf (stderr, "socket path too long\n");
+			return 1;
+		}
+		strcpy (addr.sun_path, socket_path);
+		unlink (socket_path);
+		listener = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (listener < 0
+		 || bind (listener, (struct sockaddr *)&addr, sizeof (addr)) != 0
+		 || listen (listener, L_MAX_CLIENTS) != 0)
+		{
+			fprintf (stderr, "can't listen on %s: %s\n", socket_path, strerror (errno));
+			return 1;
+		}
+	}
+	else
+	{	/* answers on the standard output, the rest on the standard error */
+		Clients[0].in = STDIN_FILENO;
+		Clients[0].out = dup (STDOUT_FILENO);
+		Clients[0].buf = malloc (L_LINE_MAX);
+		if (Clients[0].out < 0 || Clients[0].buf == NULL)
+		{
+			L_PRINT_GEN_ERR;
+			return 1;
+		}
+		fflush (stdout);
+		dup2 (STDERR_FILENO, STDOUT_FILENO);
+		ClientsNum = 1;
+	}
+
+	while (!Stop)
+	{
+		struct pollfd fds[L_MAX_CLIENTS + 2];
+		nfds_t fds_num = 0;
+		int ready;
+
+		if (socket_path == NULL && ClientsNum == 0 && WatchedNum == 0 && ManifestsNum == 0)
+			break;
+		if (listener >= 0)
+			fds[fds_num++] = (struct pollfd){ .fd = listener, .events = POLLIN };
+		if (Inotify >= 0)
+			fds[fds_num++] = (struct pollfd){ .fd = Inotify, .events = POLLIN };
+		for (uint8_t k = 0; k < ClientsNum; k++)
+			fds[fds_num++] = (struct pollfd){ .fd = Clients[k].in, .events = POLLIN };
+
+		ready = poll (fds, fds_num, Pending ? L_DEBOUNCE_MS : -1);
+		if (ready < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			L_PRINT_GEN_ERR;
+			break;
+		}
+		if (ready == 0)
+		{	/* no more changes for a while */
+			RunChanges ( );
+			continue;
+		}
+
+		for (nfds_t k = 0; k < fds_num; k++)
+		{
+			if (fds[k].revents == 0)
+				continue;
+			if (fds[k].fd == listener)
+			{
+				int fd = accept4 (listener, NULL, NULL, SOCK_CLOEXEC);
+				char *buf = malloc (L_LINE_MAX);
+
+				if (fd < 0 || buf == NULL || ClientsNum == L_MAX_CLIENTS)
+				{
+					fprintf (stderr, "client refused\n");
+					if (fd >= 0)
+						close (fd);
+					free (buf);
+					continue;
+				}
+				Clients[ClientsNum++] = (Client_t){ .in = fd, .out = fd, .buf = buf };
+			}
+			else if (fds[k].fd == Inotify)
+				ReadChanges ( );
+			else
+			{	/* clients can be closed by Request, look for it again */
+				for (uint8_t c = 0; c < ClientsNum; c++)
+				{
+					if (Clients[c].in == fds[k].fd)
+					{
+						ReadClient (&Clients[c]);
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	while (ClientsNum)
+		CloseClient (&Clients[0]);
+	if (listener >= 0)
+	{
+		close (listener);
+		unlink (socket_path);
+	}
+	for (uint32_t k = 0; k < WatchedNum; k++)
+		FreeJob (Watched[k]);
+	for (uint32_t k = 0; k < ManifestsNum; k++)
+	{
+		free (Manifests[k].path);
+		free (Manifests[k].id);
+	}
+	for (uint32_t k = 0; k < WdsNum; k++)
+		free (WdDirs[k]);
+	free (Watched);
+	free (Manifests);
+	free (Wds);
+	free (WdDirs);
+	for (uint8_t k = 0; k < L_MAX_FACES; k++)
+		CloseFace (&Faces[k]);
+	if (Inotify >= 0)
+		close (Inotify);
+	return 0;
+}
+
+/* Get the face of a font file for the running job. The face stays open for
+the next jobs, it is opened again when the file changes. The file becomes an
+input of the job.
+    Args:
+<fname>[in] font file path, relative to the job directory.
+    Ret:
+the face, NULL on error. Valid until the job returns.
+*/
+fontCvtLib_Face_t *serve_GetFace (const char *fname)
+{
+	double start = NowMs ( );
+	char cwd[PATH_MAX];
+	char *path = AbsolutePath (getcwd (cwd, sizeof (cwd)) ? cwd : StartDir, fname);
+	Face_t *slot = &Faces[0];
+	struct stat st;
+	Job_t *job = Current.job;
+
+	if (path == NULL)
+		return NULL;
+	if (job)
+	{	/* the file is watched even if it can't be opened now */
+		bool known = false;
+
+		for (uint8_t k = 0; k < job->inputs_num; k++)
+			known |= !strcmp (job->inputs[k], path);
+		if (!known && job->inputs_num < L_MAX_INPUTS)
+			job->inputs[job->inputs_num++] = strdup (path);
+	}
+	if (stat (path, &st) != 0)
+	{
+		fprintf (stderr, "can't open %s\n", path);
+		free (path);
+		return NULL;
+	}
+
+	for (uint8_t k = 0; k < L_MAX_FACES; k++)
+	{
+		Face_t *face = &Faces[k];
+
+		if (face->face && !strcmp (face->path, path))
+		{
+			if (face->dev == st.st_dev && face->ino == st.st_ino && face->size == st.st_size
+			 && face->mtime.tv_sec == st.st_mtim.tv_sec && face->mtime.tv_nsec == st.st_mtim.tv_nsec)
+			{
+				face->used = ++Clock;
+				Current.face = "warm";
+				Current.face_ms += NowMs ( ) - start;
+				free (path);
+				return face->face;
+			}
+			/* the file changed */
+			slot = face;
+			break;
+		}
+		if (face->face == NULL || face->used < slot->used)
+			slot = face;
+	}
+
+	CloseFace (slot);
+	slot->face = fontCvtLib_OpenFace (path);
+	if (slot->face == NULL)
+	{
+		free (path);
+		return NULL;
+	}
+	slot->path = path;
+	slot->dev = st.st_dev;
+	slot->ino = st.st_ino;
+	slot->size = st.st_size;
+	slot->mtime = st.st_mtim;
+	slot->used = ++Clock;
+	Current.face = "cold";
+	Current.face_ms += NowMs ( ) - start;
+	return slot->face;
+}
+
+/* Get the font rendered from a face with the given options. The font is
+rendered by the first job asking for it and kept for the next ones.
+    Args:
+<face>[in] face from serve_GetFace.
+<opt>[in] export options.
+    Ret:
+the font, NULL on error. Valid until the job returns.
+*/
+const builderMemory_Font_t *serve_GetRender (fontCvtLib_Face_t *face, const fontCvtLib_Options_t *opt)
+{
+	double start = NowMs ( );
+	Render_t *slot = &Renders[0];
+	fontCvt_Range_t *ranges;
+
+	for (uint8_t k = 0; k < L_MAX_RENDERS; k++)
+	{
+		Render_t *render = &Renders[k];
+
+		if (render->font && render->face == face && SameOptions (&render->opt, opt))
+		{
+			render->used = ++Clock;
+			Current.glyphs = "warm";
+			Current.render_ms += NowMs ( ) - start;
+			return render->font;
+		}
+		if (render->font == NULL || render->used < slot->used)
+			slot = render;
+	}
+
+	FreeRender (slot);
+	ranges = malloc (sizeof (fontCvt_Range_t) * opt->ranges_num);
+	if (ranges == NULL)
+		return NULL;
+	memcpy (ranges, opt->ranges, sizeof (fontCvt_Range_t) * opt->ranges_num);
+	slot->font = fontCvtLib_Render (face, opt);
+	if (slot->font == NULL)
+	{
+		free (ranges);
+		return NULL;
+	}
+	slot->face = face;
+	slot->opt = *opt;
+	slot->opt.ranges = ranges;
+	slot->opt.output = NULL;
+	slot->opt.builder_opt = NULL;
+	slot->used = ++Clock;
+	Current.glyphs = "cold";
+	Current.render_ms += NowMs ( ) - start;
+	return slot->font;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* SIGINT and SIGTERM handler: stop the daemon. */
+static void OnSignal (int sig)
+{
+	(void)sig;
+	Stop = 1;
+}
+
+/* Monotonic time in milliseconds. */
+static double NowMs (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+/* Absolute path of a file, with the directory resolved so that it can be
+compared with the paths of the inotify events.
+    Args:
+<dir>[in] directory fname is relative to.
+<fname>[in] file path.
+    Ret:
+the path to be freed, NULL on allocation fail.
+*/
+static char *AbsolutePath (const char *dir, const char *fname)
+{
+	char joined[PATH_MAX * 2], resolved[PATH_MAX];
+	char *slash, *path;
+
+	if (fname[0] == '/')
+		snprintf (joined, sizeof (joined), "%s", fname);
+	else
+		snprintf (joined, sizeof (joined), "%s/%s", dir, fname);
+	slash = strrchr (joined, '/');
+	*slash = '\0';
+	if (realpath (joined[0] ? joined : "/", resolved) == NULL)
+	{	/* keep it as it is */
+		*slash = '/';
+		return strdup (joined);
+	}
+	path = malloc (strlen (resolved) + strlen (slash + 1) + 2);
+	if (path)
+		sprintf (path, "%s/%s", strcmp (resolved, "/") ? resolved : "", slash + 1);
+	return path;
+}
+
+/* Close a cached face and drop the fonts rendered from it.
+    Args:
+<face>[in] cache slot.
+    Ret:
+*/
+static void CloseFace (Face_t *face)
+{
+	if (face->face == NULL)
+		return;
+	for (uint8_t k = 0; k < L_MAX_RENDERS; k++)
+	{
+		if (Renders[k].face == face->face)
+			FreeRender (&Renders[k]);
+	}
+	fontCvtLib_CloseFace (face->face);
+	free (face->path);
+	memset (face, 0, sizeof (*face));
+}
+
+/* Release a cached font.
+    Args:
+<render>[in] cache slot.
+    Ret:
+*/
+static void FreeRender (Render_t *render)
+{
+	builderMemory_Free (render->font);
+	free ((void *)render->opt.ranges);
+	memset (render, 0, sizeof (*render));
+}
+
+/* Compare the options that change the rendered glyphs.
+    Args:
+<a>[in] options.
+<b>[in] options.
+    Ret:
+true if a font rendered with a can be exported with b.
+*/
+static bool SameOptions (const fontCvtLib_Options_t *a, const fontCvtLib_Options_t *b)
+{
+	return a->size == b->size && a->bpp == b->bpp && a->mode == b->mode
+	    && (a->mode != FONTCVTLIB_MODE_SDF || a->sdf_spread == b->sdf_spread)
+	    && a->ranges_num == b->ranges_num && SameRanges (a, b);
+}
+
+/* Compare the ranges of two exports. Their bpp is left out: the builders
+quantize the bitmaps, the render is the same.
+    Args:
+<a>[in] options.
+<b>[in] options with as many ranges as a.
+    Ret:
+true if the ranges have the same characters.
+*/
+static bool SameRanges (const fontCvtLib_Options_t *a, const fontCvtLib_Options_t *b)
+{
+	for (uint16_t k = 0; k < a->ranges_num; k++)
+	{
+		if (a->ranges[k].first != b->ranges[k].first || a->ranges[k].last != b->ranges[k].last)
+			return false;
+	}
+	return true;
+}
+
+/* Skip JSON white spaces. */
+static const char *JsonSpaces (const char *p)
+{
+	while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+		p++;
+	return p;
+}
+
+/* Parse a JSON string.
+    Args:
+<p>[in] the opening quote.
+<str>[out] decoded UTF-8 string to be freed, NULL to skip the string.
+    Ret:
+the text after the closing quote, NULL if the string is not valid.
+*/
+static const char *JsonString (const char *p, char **str)
+{
+	char *out = NULL;
+	size_t len = 0;
+
+	if (*p++ != '"')
+		return NULL;
+	if (str && (out = malloc (strlen (p) + 1)) == NULL)
+		return NULL;
+	while (*p != '"')
+	{
+		uint32_t unicode;
+
+		if (*p == '\0' || (uint8_t)*p < 0x20)
+		{
+			free (out);
+			return NULL;
+		}
+		if (*p != '\\')
+		{
+			if (out)
+				out[len++] = *p;
+			p++;
+			continue;
+		}
+		p++;
+		switch (*p)
+		{
+			case 'b': unicode = '\b'; break;
+			case 'f': unicode = '\f'; break;
+			case 'n': unicode = '\n'; break;
+			case 'r': unicode = '\r'; break;
+			case 't': unicode = '\t'; break;
+			case 'u':
+			{
+				uint32_t low;
+
+				if (!JsonHex4 (p + 1, &unicode))
+				{
+					free (out);
+					return NULL;
+				}
+				p += 4;
+				if (unicode >= 0xD800 && unicode < 0xDC00 && p[1] == '\\' && p[2] == 'u'
+				 && JsonHex4 (p + 3, &low) && low >= 0xDC00 && low < 0xE000)
+				{	/* surrogate pair */
+					unicode = 0x10000 + ((unicode - 0xD800) << 10) + (low - 0xDC00);
+					p += 6;
+				}
+				break;
+			}
+			case '"':
+			case '\\':
+			case '/':
+				unicode = *p;
+				break;
+			default:
+				free (out);
+				return NULL;
+		}
+		p++;
+		if (out == NULL)
+			continue;
+		/* UTF-8 encoding, never longer than the escape sequence */
+		if (unicode < 0x80)
+			out[len++] = unicode;
+		else if (unicode < 0x800)
+		{
+			out[len++] = 0xC0 | (unicode >> 6);
+			out[len++] = 0x80 | (unicode & 0x3F);
+		}
+		else if (unicode < 0x10000)
+		{
+			out[len++] = 0xE0 | (unicode >> 12);
+			out[len++] = 0x80 | ((unicode >> 6) & 0x3F);
+			out[len++] = 0x80 | (unicode & 0x3F);
+		}
+		else
+		{
+			out[len++] = 0xF0 | (unicode >> 18);
+			out[len++] = 0x80 | ((unicode >> 12) & 0x3F);
+			out[len++] = 0x80 | ((unicode >> 6) & 0x3F);
+			out[len++] = 0x80 | (unicode & 0x3F);
+		}
+	}
+	if (out)
+	{
+		out[len] = '\0';
+		*str = out;
+	}
+	return p + 1;
+}
+
+/* Parse the 4 hex digits of a \u escape. A shorter escape is not valid, the
+text is never read past its end.
+    Args:
+<p>[in] first digit.
+<val>[out] code unit.
+    Ret:
+false if the 4 characters are not all hex digits.
+*/
+static bool JsonHex4 (const char *p, uint32_t *val)
+{
+	*val = 0;
+	for (uint8_t k = 0; k < 4; k++)
+	{
+		if (!isxdigit ((uint8_t)p[k]))
+			return false;
+		*val = (*val << 4) | (isdigit ((uint8_t)p[k]) ? p[k] - '0' : (tolower ((uint8_t)p[k]) - 'a' + 10));
+	}
+	return true;
+}
+
+/* Skip a JSON value.
+    Args:
+<p>[in] first character of the value.
+<depth>[in] nesting level of the value.
+    Ret:
+the text after the value, NULL if the value is not valid.
+*/
+static const char *JsonValue (const char *p, uint8_t depth)
+{
+	if (depth > L_MAX_JSON_DEPTH)
+		return NULL;
+	if (*p == '"')
+		return JsonString (p, NULL);
+	if (*p == '{' || *p == '[')
+	{
+		char close = (*p == '{') ? '}' : ']';
+
+		p = JsonSpaces (p + 1);
+		if (*p == close)
+			return p + 1;
+		while (p)
+		{
+			if (close == '}')
+			{
+				p = JsonString (p, NULL);
+				if (p == NULL || *(p = JsonSpaces (p)) != ':')
+					return NULL;
+				p = JsonSpaces (p + 1);
+			}
+			p = JsonValue (p, depth + 1);
+			if (p == NULL)
+				return NULL;
+			p = JsonSpaces (p);
+			if (*p == close)
+				return p + 1;
+			if (*p != ',')
+				return NULL;
+			p = JsonSpaces (p + 1);
+		}
+		return NULL;
+	}
+	/* number, true, false or null */
+	if (strchr ("-0123456789tfn", *p) == NULL || *p == '\0')
+		return NULL;
+	while (*p && strchr ("+-.0123456789eEtruefalsn", *p))
+		p++;
+	return p;
+}
+
+/* Parse a request line, see the file description.
+    Args:
+<line>[in] request.
+<req>[out] request, to be released with FreeRequest.
+    Ret:
+false if the request is not a valid JSON object.
+*/
+static bool ParseRequest (const char *line, Request_t *req)
+{
+	const char *p = JsonSpaces (line);
+
+	memset (req, 0, sizeof (*req));
+	if (*p++ != '{')
+		return false;
+	p = JsonSpaces (p);
+	if (*p == '}')
+		return *JsonSpaces (p + 1) == '\0';
+	while (true)
+	{
+		char *name = NULL;
+		const char *value;
+
+		p = JsonString (p, &name);
+		if (p == NULL || *(p = JsonSpaces (p)) != ':')
+		{
+			free (name);
+			return false;
+		}
+		value = p = JsonSpaces (p + 1);
+		if (!strcmp (name, "id"))
+		{
+			p = JsonValue (p, 1);
+			if (p && *value != '{' && *value != '[')
+				req->id = strndup (value, p - value);
+		}
+		else if (!strcmp (name, "args") && *p == '[')
+		{
+			if (req->args == NULL && (req->args = malloc (sizeof (char *) * L_MAX_ARGS)) == NULL)
+				p = NULL;
+			else
+				p = JsonSpaces (p + 1);
+			while (p && *p != ']')
+			{
+				char *arg = NULL;
+
+				if (req->args_num == L_MAX_ARGS || (p = JsonString (p, &arg)) == NULL)
+				{
+					p = NULL;
+					break;
+				}
+				req->args[req->args_num++] = arg;
+				p = JsonSpaces (p);
+				if (*p == ',')
+					p = JsonSpaces (p + 1);
+				else if (*p != ']')
+					p = NULL;
+			}
+			if (p)
+				p++;
+		}
+		else if (!strcmp (name, "cwd") && *p == '"')
+			p = JsonString (p, &req->cwd);
+		else if (!strcmp (name, "manifest") && *p == '"')
+			p = JsonString (p, &req->manifest);
+		else if (!strcmp (name, "watch") || !strcmp (name, "quit"))
+		{
+			bool *flag = !strcmp (name, "watch") ? &req->watch : &req->quit;
+
+			p = JsonValue (p, 1);
+			*flag = !strncmp (value, "true", 4);
+		}
+		else
+			p = JsonValue (p, 1);
+		free (name);
+		if (p == NULL)
+			return false;
+		p = JsonSpaces (p);
+		if (*p == '}')
+			return *JsonSpaces (p + 1) == '\0';
+		if (*p != ',')
+			return false;
+		p = JsonSpaces (p + 1);
+	}
+}
+
+/* Release a request. */
+static void FreeRequest (Request_t *req)
+{
+	for (uint16_t k = 0; k < req->args_num; k++)
+		free (req->args[k]);
+	free (req->args);
+	free (req->id);
+	free (req->cwd);
+	free (req->manifest);
+	memset (req, 0, sizeof (*req));
+}
+
+/* Print a string as a JSON string. */
+static void PrintJsonString (FILE *f, const char *str)
+{
+	fputc ('"', f);
+	for (; *str; str++)
+	{
+		if (*str == '"' || *str == '\\')
+			fprintf (f, "\\%c", *str);
+		else if ((uint8_t)*str < 0x20)
+			fprintf (f, "\\u%04x", *str);
+		else
+			fputc (*str, f);
+	}
+	fputc ('"', f);
+}
+
+/* Write an answer line to a client, or to the standard error when the client
+is gone.
+    Args:
+<client>[in] client output descriptor, -1 for the standard error.
+<text>[in] answer, with its new line.
+<len>[in] answer length.
+    Ret:
+*/
+static void Answer (int client, const char *text, size_t len)
+{
+	int fd = (client >= 0) ? client : STDERR_FILENO;
+
+	while (len)
+	{
+		ssize_t written = write (fd, text, len);
+
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return;
+		text += written;
+		len -= written;
+	}
+}
+
+/* Make a job from a request.
+    Args:
+<req>[in] request with args.
+<dir>[in] directory the cwd of the request is relative to, NULL for the
+    daemon directory.
+<client>[in] client output descriptor.
+    Ret:
+the job, NULL on allocation fail.
+*/
+static Job_t *NewJob (const Request_t *req, const char *dir, int client)
+{
+	Job_t *job = calloc (1, sizeof (Job_t));
+
+	if (job == NULL)
+		return NULL;
+	job->client = client;
+	job->argv = calloc (req->args_num + 2, sizeof (char *));
+	job->id = req->id ? strdup (req->id) : NULL;
+	if (req->cwd)
+		job->cwd = AbsolutePath (dir ? dir : StartDir, req->cwd);
+	else if (dir)
+		job->cwd = strdup (dir);
+	if (job->argv == NULL || (req->id && job->id == NULL) || ((req->cwd || dir) && job->cwd == NULL))
+	{
+		FreeJob (job);
+		return NULL;
+	}
+	job->argv[job->argc++] = strdup ("fontcvt");
+	for (uint16_t k = 0; k < req->args_num; k++)
+		job->argv[job->argc++] = strdup (req->args[k]);
+	for (int k = 0; k < job->argc; k++)
+	{
+		if (job->argv[k] == NULL)
+		{
+			FreeJob (job);
+			return NULL;
+		}
+	}
+	return job;
+}
+
+/* Release a job. */
+static void FreeJob (Job_t *job)
+{
+	if (job == NULL)
+		return;
+	for (int k = 0; job->argv && k < job->argc; k++)
+		free (job->argv[k]);
+	for (uint8_t k = 0; k < job->inputs_num; k++)
+		free (job->inputs[k]);
+	free (job->argv);
+	free (job->id);
+	free (job->cwd);
+	free (job->manifest);
+	free (job->line);
+	free (job);
+}
+
+/* Run a job inside its directory and answer with its timings.
+    Args:
+<job>[in] job.
+<trigger>[in] "request" or "watch".
+    Ret:
+false if the job failed.
+*/
+static bool RunJob (Job_t *job, const char *trigger)
+{
+	char *argv[job->argc + 1];
+	double start = NowMs ( ), total;
+	char *text = NULL;
+	size_t len = 0;
+	FILE *f;
+	bool ok = false;
+
+	/* the job gets its own copy, getopt and strtok modify the arguments */
+	memset (argv, 0, sizeof (argv));
+	for (int k = 0; k < job->argc; k++)
+		argv[k] = strdup (job->argv[k]);
+	memset (&Current, 0, sizeof (Current));
+	Current.job = job;
+	Current.face = Current.glyphs = "none";
+
+	if (job->cwd && chdir (job->cwd) != 0)
+		fprintf (stderr, "can't enter %s\n", job->cwd);
+	else
+		ok = JobFn (job->argc, argv);
+	if (chdir (StartDir) != 0)
+		L_PRINT_GEN_ERR;
+	fflush (stdout);
+	total = NowMs ( ) - start;
+	for (int k = 0; k < job->argc; k++)
+		free (argv[k]);
+
+	f = open_memstream (&text, &len);
+	if (f == NULL)
+		return ok;
+	fprintf (f, "{\"id\": %s, \"ok\": %s, \"trigger\": \"%s\", ", job->id ? job->id : "null",
+		ok ? "true" : "false", trigger);
+	if (job->manifest)
+	{
+		fprintf (f, "\"manifest\": ");
+		PrintJsonString (f, job->manifest);
+		fprintf (f, ", ");
+	}
+	fprintf (f, "\"face\": \"%s\", \"glyphs\": \"%s\", "
+		"\"ms\": {\"total\": %.3f, \"face\": %.3f, \"render\": %.3f, \"build\": %.3f}}\n",
+		Current.face, Current.glyphs, total, Current.face_ms, Current.render_ms,
+		total - Current.face_ms - Current.render_ms);
+	fclose (f);
+	Answer (job->client, text, len);
+	free (text);
+	memset (&Current, 0, sizeof (Current));
+
+	for (uint8_t k = 0; k < job->inputs_num; k++)
+		Watch (job->inputs[k]);
+	return ok;
+}
+
+/* Run the jobs of a manifest, one JSON request per line. Watched, the jobs
+are run again when their inputs change and the manifest is read again when it
+changes: only the new and changed lines are run then.
+    Args:
+<path>[in] absolute manifest path.
+<id>[in] raw JSON id of the request, can be NULL.
+<client>[in] client output descriptor.
+<watch>[in] true to watch the manifest and its jobs.
+<trigger>[in] "request" or "watch".
+    Ret:
+false if the manifest can't be read or a job failed.
+*/
+static bool RunManifest (const char *path, const char *id, int client, bool watch, const char *trigger)
+{
+	double start = NowMs ( );
+	char dir[PATH_MAX];
+	char *line = NULL;
+	size_t line_max = 0;
+	uint32_t jobs_num = 0, run_num = 0;
+	bool ok = true, readable;
+	FILE *f = fopen (path, "r");
+	char *text = NULL;
+	size_t len = 0;
+
+	readable = (f != NULL);
+	snprintf (dir, sizeof (dir), "%s", path);
+	*strrchr (dir, '/') = '\0';
+	for (uint32_t k = 0; k < WatchedNum; k++)
+		Watched[k]->keep = false;
+
+	while (f && getline (&line, &line_max, f) > 0)
+	{
+		Request_t req;
+		Job_t *job = NULL;
+
+		line[strcspn (line, "\r\n")] = '\0';
+		if (*JsonSpaces (line) == '\0')
+			continue;
+		jobs_num++;
+		/* an unchanged line keeps its job */
+		for (uint32_t k = 0; k < WatchedNum && watch; k++)
+		{
+			if (Watched[k]->manifest && !strcmp (Watched[k]->manifest, path) && !Watched[k]->keep
+			 && !strcmp (Watched[k]->line, line))
+			{
+				Watched[k]->keep = true;
+				Watched[k]->client = client;
+				job = Watched[k];
+				break;
+			}
+		}
+		if (job)
+			continue;
+
+		if (!ParseRequest (line, &req) || req.args_num == 0)
+		{
+			fprintf (stderr, "%s: invalid job %s\n", path, line);
+			ok = false;
+		}
+		else if ((job = NewJob (&req, dir, client)) != NULL
+		      && (job->manifest = strdup (path)) != NULL
+		      && (job->line = strdup (line)) != NULL)
+		{
+			run_num++;
+			ok &= RunJob (job, trigger);
+			if (watch)
+			{
+				Job_t **watched = realloc (Watched, sizeof (Job_t *) * (WatchedNum + 1));
+
+				if (watched)
+				{
+					Watched = watched;
+					Watched[WatchedNum++] = job;
+					job->keep = true;
+					job = NULL;
+				}
+			}
+		}
+		else
+			ok = false;
+		FreeJob (job);
+		FreeRequest (&req);
+	}
+	free (line);
+	if (f)
+		fclose (f);
+
+	if (watch && readable)
+	{	/* drop the jobs of the lines gone */
+		uint32_t kept = 0;
+
+		for (uint32_t k = 0; k < WatchedNum; k++)
+		{
+			if (Watched[k]->manifest && !strcmp (Watched[k]->manifest, path) && !Watched[k]->keep)
+				FreeJob (Watched[k]);
+			else
+				Watched[kept++] = Watched[k];
+		}
+		WatchedNum = kept;
+	}
+	if (watch)
+		Watch (path);
+
+	f = open_memstream (&text, &len);
+	if (f == NULL)
+		return ok;
+	fprintf (f, "{\"id\": %s, \"ok\": %s, \"trigger\": \"%s\", \"manifest\": ", id ? id : "null",
+		(ok && readable) ? "true" : "false", trigger);
+	PrintJsonString (f, path);
+	if (!readable)
+		fprintf (f, ", \"error\": \"can't read the manifest\"");
+	fprintf (f, ", \"jobs\": %u, \"run\": %u, \"ms\": {\"total\": %.3f}}\n", jobs_num, run_num, NowMs ( ) - start);
+	fclose (f);
+	Answer (client, text, len);
+	free (text);
+	return ok && readable;
+}
+
+/* Watch the directory of a file, editors often replace a file instead of
+writing it.
+    Args:
+<path>[in] absolute file path.
+    Ret:
+*/
+static void Watch (const char *path)
+{
+	char dir[PATH_MAX];
+	int wd;
+	int *wds;
+	char **dirs;
+
+	if (Inotify < 0)
+		return;
+	snprintf (dir, sizeof (dir), "%s", path);
+	*strrchr (dir, '/') = '\0';
+	wd = inotify_add_watch (Inotify, dir[0] ? dir : "/", IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (wd < 0)
+	{
+		fprintf (stderr, "can't watch %s: %s\n", dir, strerror (errno));
+		return;
+	}
+	for (uint32_t k = 0; k < WdsNum; k++)
+	{
+		if (Wds[k] == wd)
+			return;
+	}
+	wds = realloc (Wds, sizeof (int) * (WdsNum + 1));
+	if (wds)
+		Wds = wds;
+	dirs = realloc (WdDirs, sizeof (char *) * (WdsNum + 1));
+	if (dirs)
+		WdDirs = dirs;
+	if (wds == NULL || dirs == NULL || (WdDirs[WdsNum] = strdup (dir)) == NULL)
+	{
+		L_PRINT_GEN_ERR;
+		return;
+	}
+	Wds[WdsNum++] = wd;
+}
+
+/* Handle a request line of a client.
+    Args:
+<client>[in] client.
+<line>[in] request.
+    Ret:
+*/
+static void Request (Client_t *client, const char *line)
+{
+	Request_t req;
+
+	if (*JsonSpaces (line) == '\0')
+		return;
+	if (!ParseRequest (line, &req) || (req.args_num == 0 && req.manifest == NULL && !req.quit))
+	{
+		static const char error[] = "{\"id\": null, \"ok\": false, \"error\": \"invalid request\"}\n";
+
+		Answer (client->out, error, sizeof (error) - 1);
+		FreeRequest (&req);
+		return;
+	}
+
+	if (req.manifest)
+	{
+		char *path = AbsolutePath (req.cwd ? req.cwd : StartDir, req.manifest);
+		bool known = false;
+
+		if (path)
+		{
+			for (uint32_t k = 0; k < ManifestsNum && req.watch; k++)
+			{
+				if (!strcmp (Manifests[k].path, path))
+				{
+					Manifests[k].client = client->out;
+					known = true;
+				}
+			}
+			if (known)
+			{	/* asked again: all its jobs run again */
+				uint32_t kept = 0;
+
+				for (uint32_t k = 0; k < WatchedNum; k++)
+				{
+					if (Watched[k]->manifest && !strcmp (Watched[k]->manifest, path))
+						FreeJob (Watched[k]);
+					else
+						Watched[kept++] = Watched[k];
+				}
+				WatchedNum = kept;
+			}
+			if (req.watch && !known)
+			{
+				Manifest_t *manifests = realloc (Manifests, sizeof (Manifest_t) * (ManifestsNum + 1));
+
+				if (manifests)
+				{
+					Manifests = manifests;
+					Manifests[ManifestsNum++] = (Manifest_t){ .path = strdup (path),
+						.id = req.id ? strdup (req.id) : NULL, .client = client->out };
+				}
+			}
+			RunManifest (path, req.id, client->out, req.watch, "request");
+			free (path);
+		}
+	}
+	else if (req.args_num)
+	{
+		Job_t *job = NewJob (&req, NULL, client->out);
+
+		if (job)
+		{
+			RunJob (job, "request");
+			if (req.watch)
+			{
+				Job_t **watched = realloc (Watched, sizeof (Job_t *) * (WatchedNum + 1));
+
+				if (watched)
+				{
+					Watched = watched;
+					Watched[WatchedNum++] = job;
+					job = NULL;
+				}
+			}
+			FreeJob (job);
+		}
+		else
+			L_PRINT_GEN_ERR;
+	}
+	if (req.quit)
+	{
+		static const char bye[] = "{\"id\": null, \"ok\": true, \"quit\": true}\n";
+
+		Answer (client->out, bye, sizeof (bye) - 1);
+		Stop = 1;
+	}
+	FreeRequest (&req);
+}
+
+/* Read what a client sent and handle its complete lines.
+    Args:
+<client>[in] client.
+    Ret:
+*/
+static void ReadClient (Client_t *client)
+{
+	ssize_t got = read (client->in, client->buf + client->len, L_LINE_MAX - 1 - client->len);
+	char *line, *end;
+
+	if (got < 0 && errno == EINTR)
+		return;
+	if (got <= 0)
+	{	/* a last line without its new line */
+		if (client->len)
+		{
+			client->buf[client->len] = '\0';
+			client->len = 0;
+			Request (client, client->buf);
+		}
+		CloseClient (client);
+		return;
+	}
+	client->len += got;
+	client->buf[client->len] = '\0';
+	line = client->buf;
+	while ((end = strchr (line, '\n')) != NULL)
+	{
+		*end = '\0';
+		Request (client, line);
+		line = end + 1;
+	}
+	client->len -= line - client->buf;
+	memmove (client->buf, line, client->len);
+	if (client->len == L_LINE_MAX - 1)
+	{
+		static const char error[] = "{\"id\": null, \"ok\": false, \"error\": \"line too long\"}\n";
+
+		Answer (client->out, error, sizeof (error) - 1);
+		client->len = 0;
+	}
+}
+
+/* Close a client. Its watched jobs keep running, with the answers on the
+standard error.
+    Args:
+<client>[in] client.
+    Ret:
+*/
+static void CloseClient (Client_t *client)
+{
+	for (uint32_t k = 0; k < WatchedNum; k++)
+	{
+		if (Watched[k]->client == client->out)
+			Watched[k]->client = -1;
+	}
+	for (uint32_t k = 0; k < ManifestsNum; k++)
+	{
+		if (Manifests[k].client == client->out)
+			Manifests[k].client = -1;
+	}
+	if (client->in != client->out)
+		close (client->in);
+	close (client->out);
+	free (client->buf);
+	*client = Clients[--ClientsNum];
+}
+
+/* Read the inotify events and mark the watched jobs and manifests whose file
+changed. They run once the changes stop for L_DEBOUNCE_MS.
+    Args:
+    Ret:
+*/
+static void ReadChanges (void)
+{
+	char buf[4096] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+	ssize_t got;
+
+	while ((got = read (Inotify, buf, sizeof (buf))) > 0)
+	{
+		for (char *p = buf; p < buf + got; p += sizeof (struct inotify_event) + ((struct inotify_event *)p)->len)
+		{
+			const struct inotify_event *event = (const struct inotify_event *)p;
+			char path[PATH_MAX * 2];
+			const char *dir = NULL;
+
+			if (event->len == 0)
+				continue;
+			for (uint32_t k = 0; k < WdsNum; k++)
+			{
+				if (Wds[k] == event->wd)
+					dir = WdDirs[k];
+			}
+			if (dir == NULL)
+				continue;
+			snprintf (path, sizeof (path), "%s/%s", dir, event->name);
+			for (uint32_t k = 0; k < ManifestsNum; k++)
+			{
+				if (!strcmp (Manifests[k].path, path))
+					Manifests[k].dirty = Pending = true;
+			}
+			for (uint32_t k = 0; k < WatchedNum; k++)
+			{
+				for (uint8_t j = 0; j < Watched[k]->inputs_num; j++)
+				{
+					if (!strcmp (Watched[k]->inputs[j], path))
+						Watched[k]->dirty = Pending = true;
+				}
+			}
+		}
+	}
+}
+
+/* Read the changed manifests again and run the jobs whose inputs changed,
+each once.
+    Args:
+    Ret:
+*/
+static void RunChanges (void)
+{
+	Pending = false;
+	for (uint32_t k = 0; k < ManifestsNum; k++)
+	{
+		if (Manifests[k].dirty)
+		{
+			Manifests[k].dirty = false;
+			RunManifest (Manifests[k].path, Manifests[k].id, Manifests[k].client, true, "watch");
+		}
+	}
+	for (uint32_t k = 0; k < WatchedNum; k++)
+	{
+		if (Watched[k]->dirty)
+		{
+			Watched[k]->dirty = false;
+			RunJob (Watched[k], "watch");
+		}
+	}
+}
@@ -0,0 +1,38 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SERVE_H_INCLUDED
+#define SERVE_H_INCLUDED
+
+//____________________________________________________________INCLUDES - DEFINES
+#include <stdbool.h>
+#include "fontCvtLib.h"
+
+/* run one job given as a command line, argv[0] is the program name. The
+arguments can be modified. Ret: false if the job failed */
+typedef bool (*serve_Job_f) (int argc, char *argv[]);
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+int serve_Run (const char *socket_path, serve_Job_f job);
+fontCvtLib_Face_t *serve_GetFace (const char *fname);
+const builderMemory_Font_t *serve_GetRender (fontCvtLib_Face_t *face, const fontCvtLib_Options_t *opt);
+
+#endif /* SERVE_H_INCLUDED */
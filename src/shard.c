@@ -0,0 +1,441 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* Sharded conversion. fontcvt --shard i/N renders only the batches of
+L_BATCH_CHARACTERS characters (see fontCvtLib.c) that go to shard i: batch b
+of the requested ranges belongs to shard b % N. The glyphs are not given to the
+builders but saved with their kerning pairs in OUTPUT_NAME.shard. fontcvt-merge
+loads the N shard files, merges them rebasing the bitmap offsets and kerning
+indexes, and exports the whole font to the builders: the output is the same a
+single fontcvt run produces.
+
+A shard file is little endian:
+    "FCVTSHRD", version (u16), shard, shards (u16)
+    size, bpp, mode (u8), sdf spread (u16), ranges (u16), ranges first, last (u32),
+        bpp (u8)
+    font: bpp, baseline to baseline, max glyph height, em square, sdf spread,
+        outline (u16)
+    characters, arena size, kerning pairs (u32)
+    characters: unicode, glyph index (u32), width, height (u16), left, top (i16),
+        advance (u16), kind (u8: 0 none, 1 bitmap, 2 outline), arena offset,
+        outline size, kerning index (u32)
+    arena: 8 bit bitmaps and outlines
+    kerning pairs: left, right (u32), adjust (i16) */
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "shard.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define L_MAGIC               "FCVTSHRD"
+#define L_VERSION             5
+#define L_MAX_SHARDS          4096
+
+typedef enum
+{	/* what a character carries */
+	L_KIND_NONE,
+	L_KIND_BITMAP,
+	L_KIND_OUTLINE,
+} Kind_t;
+
+typedef struct
+{
+	FILE *f;
+	bool error;
+} Stream_t;
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static void Put (Stream_t *s, uint32_t value, uint8_t bytes);
+static uint32_t Get (Stream_t *s, uint8_t bytes);
+static bool SameExport (const shard_Shard_t *a, const shard_Shard_t *b);
+static int CompareUnicode (const void *a, const void *b);
+
+//___________________________________________________________________PRIVATE VAR
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Parse a shard specification.
+    Args:
+<spec>[in] "i/N", shard i (from 0) of N.
+<shard>[out] shard index.
+<shards_num>[out] number of shards.
+    Ret:
+false if the specification is not valid.
+*/
+bool shard_Parse (const char *spec, uint16_t *shard, uint16_t *shards_num)
+{
+	unsigned index, num;
+	char end;
+
+	if (sscanf (spec, "%u/%u%c", &index, &num, &end) != 2 || num == 0 || num > L_MAX_SHARDS || index >= num)
+		return false;
+	*shard = index;
+	*shards_num = num;
+	return true;
+}
+
+/* Save the font rendered for a shard.
+    Args:
+<fname>[in] shard file path.
+<opt>[in] export options, with the shard.
+<font>[in] font rendered by fontCvtLib_Render with opt.
+    Ret:
+false on error.
+*/
+bool shard_Save (const char *fname, const fontCvtLib_Options_t *opt, const builderMemory_Font_t *font)
+{
+	Stream_t s = { fopen (fname, "wb"), false };
+
+	if (s.f == NULL)
+	{
+		fprintf (stderr, "can't create %s\n", fname);
+		return false;
+	}
+	fwrite (L_MAGIC, 1, strlen (L_MAGIC), s.f);
+	Put (&s, L_VERSION, 2);
+	Put (&s, opt->shard, 2);
+	Put (&s, opt->shards_num, 2);
+	Put (&s, opt->size, 2);
+	Put (&s, opt->bpp, 1);
+	Put (&s, opt->mode, 1);
+	Put (&s, opt->sdf_spread, 2);
+	Put (&s, opt->ranges_num, 2);
+	for (uint16_t k = 0; k < opt->ranges_num; k++)
+	{
+		Put (&s, opt->ranges[k].first, 4);
+		Put (&s, opt->ranges[k].last, 4);
+		Put (&s, opt->ranges[k].bpp, 1);
+	}
+
+	Put (&s, font->font.bpp, 2);
+	Put (&s, font->font.pxl_baseline_to_baseline, 2);
+	Put (&s, font->font.pxl_max_glyph_height, 2);
+	Put (&s, font->font.pxl_em_square, 2);
+	Put (&s, font->font.pxl_max_bmp_width, 2);
+	Put (&s, font->font.pxl_max_bmp_height, 2);
+	Put (&s, font->font.sdf_spread, 2);
+	Put (&s, font->font.outline, 2);
+	Put (&s, font->characters_num, 4);
+	Put (&s, font->arena_size, 4);
+	Put (&s, font->kernings_num, 4);
+
+	for (uint32_t k = 0; k < font->characters_num; k++)
+	{
+		const builderMemory_Character_t *ch = &font->characters[k];
+		const fontCvt_Character_t *c = &ch->character;
+		Kind_t kind = c->outline ? L_KIND_OUTLINE : (c->bmp ? L_KIND_BITMAP : L_KIND_NONE);
+		const uint8_t *data = c->outline ? c->outline : (const uint8_t *)c->bmp;
+
+		Put (&s, c->unicode, 4);
+		Put (&s, c->glyph_idx, 4);
+		Put (&s, c->bmp_pxl_width, 2);
+		Put (&s, c->bmp_pxl_height, 2);
+		Put (&s, (uint16_t)c->pxl_left, 2);
+		Put (&s, (uint16_t)c->pxl_top, 2);
+		Put (&s, c->pxl_advance, 2);
+		Put (&s, kind, 1);
+		Put (&s, data ? (uint32_t)(data - font->arena) : 0, 4);
+		Put (&s, c->outline_sz, 4);
+		Put (&s, ch->kerning_index, 4);
+	}
+	if (font->arena_size)
+		fwrite (font->arena, 1, font->arena_size, s.f);
+	for (uint32_t k = 0; k < font->kernings_num; k++)
+	{
+		Put (&s, font->kernings[k].left_char, 4);
+		Put (&s, font->kernings[k].right_char, 4);
+		Put (&s, (uint16_t)font->kernings[k].x_pxl_adjust, 2);
+	}
+
+	s.error |= ferror (s.f) != 0;
+	s.error |= fclose (s.f) != 0;
+	if (s.error)
+		fprintf (stderr, "can't write %s\n", fname);
+	return !s.error;
+}
+
+/* Load a shard file.
+    Args:
+<fname>[in] shard file path.
+<shard>[out] shard, to be released with shard_Free.
+    Ret:
+false if the file can't be read or is not a valid shard.
+*/
+bool shard_Load (const char *fname, shard_Shard_t *shard)
+{
+	Stream_t s = { fopen (fname, "rb"), false };
+	char magic[sizeof (L_MAGIC) - 1];
+	builderMemory_Font_t *font;
+	fontCvt_Range_t *ranges = NULL;
+	fontCvtLib_Options_t *opt = &shard->opt;
+
+	memset (shard, 0, sizeof (*shard));
+	if (s.f == NULL)
+	{
+		fprintf (stderr, "can't open %s\n", fname);
+		return false;
+	}
+	if (fread (magic, 1, sizeof (magic), s.f) != sizeof (magic) || memcmp (magic, L_MAGIC, sizeof (magic))
+	 || Get (&s, 2) != L_VERSION)
+	{
+		fprintf (stderr, "%s is not a fontcvt shard\n", fname);
+		fclose (s.f);
+		return false;
+	}
+
+	fontCvtLib_DefaultOptions (opt);
+	opt->shard = Get (&s, 2);
+	opt->shards_num = Get (&s, 2);
+	opt->size = Get (&s, 2);
+	opt->bpp = Get (&s, 1);
+	opt->mode = Get (&s, 1);
+	opt->sdf_spread = Get (&s, 2);
+	opt->ranges_num = Get (&s, 2);
+	ranges = calloc (opt->ranges_num + 1, sizeof (fontCvt_Range_t));
+	for (uint16_t k = 0; k < opt->ranges_num && ranges; k++)
+	{
+		ranges[k].first = Get (&s, 4);
+		ranges[k].last = Get (&s, 4);
+		ranges[k].bpp = Get (&s, 1);
+	}
+	opt->ranges = ranges;
+
+	shard->font = font = calloc (1, sizeof (builderMemory_Font_t));
+	if (ranges == NULL || font == NULL)
+		s.error = true;
+	else
+	{
+		font->font.bpp = Get (&s, 2);
+		font->font.pxl_baseline_to_baseline = Get (&s, 2);
+		font->font.pxl_max_glyph_height = Get (&s, 2);
+		font->font.pxl_em_square = Get (&s, 2);
+		font->font.pxl_max_bmp_width = Get (&s, 2);
+		font->font.pxl_max_bmp_height = Get (&s, 2);
+		font->font.sdf_spread = Get (&s, 2);
+		font->font.outline = Get (&s, 2);
+		font->characters_num = Get (&s, 4);
+		font->arena_size = Get (&s, 4);
+		font->kernings_num = Get (&s, 4);
+		if (!s.error)
+		{
+			font->characters = calloc (font->characters_num + 1, sizeof (builderMemory_Character_t));
+			font->arena = malloc (font->arena_size + 1);
+			font->kernings = calloc (font->kernings_num + 1, sizeof (fontCvt_Kerning_t));
+			s.error = (font->characters == NULL || font->arena == NULL || font->kernings == NULL);
+		}
+	}
+
+	for (uint32_t k = 0; !s.error && k < font->characters_num; k++)
+	{
+		builderMemory_Character_t *ch = &font->characters[k];
+		fontCvt_Character_t *c = &ch->character;
+		Kind_t kind;
+		uint32_t offset, size;
+
+		c->unicode = Get (&s, 4);
+		c->glyph_idx = Get (&s, 4);
+		c->bmp_pxl_width = Get (&s, 2);
+		c->bmp_pxl_height = Get (&s, 2);
+		c->pxl_left = (int16_t)Get (&s, 2);
+		c->pxl_top = (int16_t)Get (&s, 2);
+		c->pxl_advance = Get (&s, 2);
+		kind = Get (&s, 1);
+		offset = Get (&s, 4);
+		c->outline_sz = Get (&s, 4);
+		ch->kerning_index = Get (&s, 4);
+		size = (kind == L_KIND_OUTLINE) ? c->outline_sz : (uint32_t)c->bmp_pxl_width * c->bmp_pxl_height;
+		if (kind > L_KIND_OUTLINE || (kind != L_KIND_NONE && (offset > font->arena_size || size > font->arena_size - offset))
+		 || ch->kerning_index > font->kernings_num)
+			s.error = true;
+		else if (kind == L_KIND_BITMAP)
+			c->bmp = (const char *)&font->arena[offset];
+		else if (kind == L_KIND_OUTLINE)
+			c->outline = &font->arena[offset];
+	}
+	if (!s.error && fread (font->arena, 1, font->arena_size, s.f) != font->arena_size)
+		s.error = true;
+	for (uint32_t k = 0; !s.error && k < font->kernings_num; k++)
+	{
+		font->kernings[k].left_char = Get (&s, 4);
+		font->kernings[k].right_char = Get (&s, 4);
+		font->kernings[k].x_pxl_adjust = (int16_t)Get (&s, 2);
+	}
+	fclose (s.f);
+
+	if (s.error || opt->shards_num == 0 || opt->shard >= opt->shards_num)
+	{
+		fprintf (stderr, "%s is not a valid shard\n", fname);
+		shard_Free (shard);
+		return false;
+	}
+	return true;
+}
+
+/* Release a shard loaded by shard_Load.
+    Args:
+<shard>[in] shard.
+    Ret:
+*/
+void shard_Free (shard_Shard_t *shard)
+{
+	builderMemory_Free (shard->font);
+	free ((void *)shard->opt.ranges);
+	memset (shard, 0, sizeof (*shard));
+}
+
+/* Merge all the shards of an export in one font: the characters of every
+shard with their bitmap offsets and kerning indexes rebased on the merged
+arena and pairs.
+    Args:
+<shards>[in] shards, in any order.
+<shards_num>[in] number of shards, they must be all the shards of the export.
+    Ret:
+the font, to be released with builderMemory_Free. NULL if the shards don't
+make a whole export.
+*/
+builderMemory_Font_t *shard_Merge (const shard_Shard_t *shards, uint16_t shards_num)
+{
+	builderMemory_Font_t *font;
+	uint32_t characters_num = 0, arena_size = 0, kernings_num = 0;
+	bool seen[L_MAX_SHARDS] = { false };
+
+	if (shards_num == 0 || shards[0].opt.shards_num != shards_num)
+	{
+		fprintf (stderr, "%d shards given, the export has %d\n", shards_num, shards_num ? shards[0].opt.shards_num : 0);
+		return NULL;
+	}
+	for (uint16_t k = 0; k < shards_num; k++)
+	{
+		const builderMemory_Font_t *part = shards[k].font;
+
+		if (!SameExport (&shards[0], &shards[k]))
+		{
+			fprintf (stderr, "shard %d is not of the same export of shard %d\n", shards[k].opt.shard, shards[0].opt.shard);
+			return NULL;
+		}
+		if (seen[shards[k].opt.shard])
+		{
+			fprintf (stderr, "shard %d given twice\n", shards[k].opt.shard);
+			return NULL;
+		}
+		seen[shards[k].opt.shard] = true;
+		characters_num += part->characters_num;
+		arena_size += part->arena_size;
+		kernings_num += part->kernings_num;
+	}
+
+	font = calloc (1, sizeof (builderMemory_Font_t));
+	if (font == NULL)
+		return NULL;
+	font->font = shards[0].font->font;
+	font->characters = calloc (characters_num + 1, sizeof (builderMemory_Character_t));
+	font->arena = malloc (arena_size + 1);
+	font->kernings = calloc (kernings_num + 1, sizeof (fontCvt_Kerning_t));
+	if (font->characters == NULL || font->arena == NULL || font->kernings == NULL)
+	{
+		builderMemory_Free (font);
+		return NULL;
+	}
+
+	for (uint16_t k = 0; k < shards_num; k++)
+	{
+		const builderMemory_Font_t *part = shards[k].font;
+
+		for (uint32_t j = 0; j < part->characters_num; j++)
+		{
+			builderMemory_Character_t *ch = &font->characters[font->characters_num++];
+			fontCvt_Character_t *c = &ch->character;
+
+			*ch = part->characters[j];
+			ch->kerning_index += font->kernings_num;
+			if (c->outline)
+				c->outline = &font->arena[font->arena_size + (c->outline - part->arena)];
+			else if (c->bmp)
+				c->bmp = (const char *)&font->arena[font->arena_size + ((const uint8_t *)c->bmp - part->arena)];
+		}
+		memcpy (&font->arena[font->arena_size], part->arena, part->arena_size);
+		memcpy (&font->kernings[font->kernings_num], part->kernings, sizeof (fontCvt_Kerning_t) * part->kernings_num);
+		font->arena_size += part->arena_size;
+		font->kernings_num += part->kernings_num;
+	}
+	qsort (font->characters, font->characters_num, sizeof (builderMemory_Character_t), CompareUnicode);
+	return font;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Write a little endian value, errors are kept in the stream. */
+static void Put (Stream_t *s, uint32_t value, uint8_t bytes)
+{
+	for (uint8_t k = 0; k < bytes; k++)
+	{
+		if (fputc ((value >> (8 * k)) & 0xFF, s->f) == EOF)
+			s->error = true;
+	}
+}
+
+/* Read a little endian value, 0 after an error. */
+static uint32_t Get (Stream_t *s, uint8_t bytes)
+{
+	uint32_t value = 0;
+
+	for (uint8_t k = 0; k < bytes && !s->error; k++)
+	{
+		int c = fgetc (s->f);
+
+		if (c == EOF)
+			s->error = true;
+		else
+			value |= (uint32_t)c << (8 * k);
+	}
+	return s->error ? 0 : value;
+}
+
+/* Check that two shards come from the same export.
+    Args:
+<a>[in] shard.
+<b>[in] shard.
+    Ret:
+true if the shards have the same options and font.
+*/
+static bool SameExport (const shard_Shard_t *a, const shard_Shard_t *b)
+{
+	const fontCvt_Font_t *fa = &a->font->font, *fb = &b->font->font;
+
+	return a->opt.shards_num == b->opt.shards_num && a->opt.size == b->opt.size && a->opt.bpp == b->opt.bpp
+	    && a->opt.mode == b->opt.mode && a->opt.sdf_spread == b->opt.sdf_spread
+	    && a->opt.ranges_num == b->opt.ranges_num
+	    && !memcmp (a->opt.ranges, b->opt.ranges, sizeof (fontCvt_Range_t) * a->opt.ranges_num)
+	    && fa->bpp == fb->bpp && fa->pxl_baseline_to_baseline == fb->pxl_baseline_to_baseline
+	    && fa->pxl_max_glyph_height == fb->pxl_max_glyph_height && fa->pxl_em_square == fb->pxl_em_square
+	    && fa->pxl_max_bmp_width == fb->pxl_max_bmp_width && fa->pxl_max_bmp_height == fb->pxl_max_bmp_height
+	    && fa->sdf_spread == fb->sdf_spread && fa->outline == fb->outline;
+}
+
+/* qsort comparison of two characters by unicode value. */
+static int CompareUnicode (const void *a, const void *b)
+{
+	wchar_t ua = ((const builderMemory_Character_t *)a)->character.unicode;
+	wchar_t ub = ((const builderMemory_Character_t *)b)->character.unicode;
+
+	return (ua > ub) - (ua < ub);
+}
@@ -0,0 +1,44 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SHARD_H_INCLUDED
+#define SHARD_H_INCLUDED
+
+//____________________________________________________________INCLUDES - DEFINES
+#include <stdint.h>
+#include <stdbool.h>
+#include "fontCvtLib.h"
+
+typedef struct
+{	/* a shard file: the glyphs and kerning pairs of the batches of one shard,
+	with the options of the whole export */
+	fontCvtLib_Options_t opt; /* owns its ranges */
+	builderMemory_Font_t *font;
+} shard_Shard_t;
+
+//____________________________________________________________________GLOBAL VAR
+
+//______________________________________________________________GLOBAL FUNCTIONS
+bool shard_Parse (const char *spec, uint16_t *shard, uint16_t *shards_num);
+bool shard_Save (const char *fname, const fontCvtLib_Options_t *opt, const builderMemory_Font_t *font);
+bool shard_Load (const char *fname, shard_Shard_t *shard);
+void shard_Free (shard_Shard_t *shard);
+builderMemory_Font_t *shard_Merge (const shard_Shard_t *shards, uint16_t shards_num);
+
+#endif /* SHARD_H_INCLUDED */
@@ -0,0 +1,545 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//____________________________________________________________INCLUDES - DEFINES
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#define L_MAX_NESTING         8
+#define L_HISTOGRAM_BUCKETS   16
+#define L_HISTOGRAM_BAR       50
+#define L_MAX_QUEUES          4
+
+typedef struct
+{	/* per glyph profile */
+	uint32_t unicode;
+	uint64_t ns[STATS_PHASE_NUM]; /* exclusive time in each phase */
+	uint32_t area; /* bitmap pixels */
+	uint32_t bytes; /* packed bytes */
+} GlyphProfile_t;
+
+typedef struct
+{	/* a continuous time slice spent in a phase for a glyph */
+	uint64_t start_ns;
+	uint64_t dur_ns;
+	uint32_t glyph; /* GlyphProfile_t index */
+	stats_Phase_t phase;
+} TraceEvent_t;
+
+//____________________________________________________________PRIVATE PROTOTYPES
+static uint64_t NowNs (void);
+static void Charge (uint64_t now);
+static uint64_t GlyphCost (const GlyphProfile_t *glyph);
+static int CompareCost (const void *a, const void *b);
+
+//___________________________________________________________________PRIVATE VAR
+static const char *PhaseNames[STATS_PHASE_NUM] =
+{
+	"face_open",
+	"char_index",
+	"glyph_load",
+	"render",
+	"convert",
+	"kerning",
+	"builder",
+	"file_io",
+};
+static const char *CounterNames[STATS_COUNTER_NUM] =
+{
+	"glyphs",
+	"missing_glyphs",
+	"kerning_pairs_tested",
+	"kerning_pairs",
+	"renders_avoided",
+	"bitmap_bytes",
+	"output_bytes",
+};
+
+static _Thread_local uint64_t PhaseNs[STATS_PHASE_NUM]; /* exclusive time spent in each phase */
+static _Thread_local uint64_t PhaseCalls[STATS_PHASE_NUM];
+static _Thread_local uint64_t Counters[STATS_COUNTER_NUM];
+/* running phases, the last one is being timed */
+static _Thread_local stats_Phase_t Stack[L_MAX_NESTING];
+static _Thread_local uint8_t StackNum;
+static _Thread_local uint64_t LastNs; /* last time the running phase has been charged */
+static _Thread_local uint64_t StartNs; /* statistics start time */
+/* pipeline queues of the exports */
+static _Thread_local stats_Queue_t Queues[L_MAX_QUEUES];
+static _Thread_local uint8_t QueuesNum;
+/* per glyph profiling */
+static _Thread_local bool Profiling;
+static _Thread_local bool Tracing;
+static _Thread_local bool GlyphActive; /* the last Glyphs entry is being profiled */
+static _Thread_local GlyphProfile_t *Glyphs;
+static _Thread_local uint32_t GlyphsNum;
+static _Thread_local uint32_t GlyphsMax;
+static _Thread_local TraceEvent_t *Trace;
+static _Thread_local uint32_t TraceNum;
+static _Thread_local uint32_t TraceMax;
+
+//____________________________________________________________________GLOBAL VAR
+_Thread_local bool stats_Enabled;
+
+//______________________________________________________________GLOBAL FUNCTIONS
+
+/* Start collecting statistics.
+    Args:
+    Ret:
+*/
+void stats_Enable (void)
+{
+	stats_Enabled = true;
+	StartNs = LastNs = NowNs ( );
+}
+
+/* Stop collecting statistics and forget the collected ones, so that the
+next export of the thread starts from scratch.
+    Args:
+    Ret:
+*/
+void stats_Reset (void)
+{
+	stats_Enabled = false;
+	memset (PhaseNs, 0, sizeof (PhaseNs));
+	memset (PhaseCalls, 0, sizeof (PhaseCalls));
+	memset (Counters, 0, sizeof (Counters));
+	StackNum = 0;
+	QueuesNum = 0;
+	Profiling = Tracing = GlyphActive = false;
+	free (Glyphs);
+	free (Trace);
+	Glyphs = NULL;
+	Trace = NULL;
+	GlyphsNum = GlyphsMax = TraceNum = TraceMax = 0;
+}
+
+/* Start timing a phase. The running phase, if any, is paused.
+    Args:
+<phase>[in] phase.
+    Ret:
+*/
+void stats_Begin (stats_Phase_t phase)
+{
+	if (!stats_Enabled)
+		return;
+
+	Charge (NowNs ( ));
+	PhaseCalls[phase]++;
+	if (StackNum < L_MAX_NESTING)
+		Stack[StackNum++] = phase;
+}
+
+/* Stop timing a phase. The paused phase, if any, is resumed.
+    Args:
+<phase>[in] phase, it must be the last one started.
+    Ret:
+*/
+void stats_End (stats_Phase_t phase)
+{
+	if (!stats_Enabled)
+		return;
+
+	Charge (NowNs ( ));
+	if (StackNum && Stack[StackNum - 1] == phase)
+		StackNum--;
+}
+
+/* Increment a counter.
+    Args:
+<counter>[in] counter.
+<value>[in] increment.
+    Ret:
+*/
+void stats_Add (stats_Counter_t counter, uint64_t value)
+{
+	if (stats_Enabled)
+		Counters[counter] += value;
+}
+
+/* Get the statistics of the thread, e.g. from a worker thread before it
+exits.
+    Args:
+<totals>[out] phase times and counters of the thread.
+    Ret:
+*/
+void stats_Take (stats_Totals_t *totals)
+{
+	memcpy (totals->phase_ns, PhaseNs, sizeof (PhaseNs));
+	memcpy (totals->phase_calls, PhaseCalls, sizeof (PhaseCalls));
+	memcpy (totals->counters, Counters, sizeof (Counters));
+}
+
+/* Add the statistics of another thread to the ones of this thread. Phase
+times add up, so with many threads they can exceed the total time.
+    Args:
+<totals>[in] statistics taken with stats_Take.
+    Ret:
+*/
+void stats_Merge (const stats_Totals_t *totals)
+{
+	if (!stats_Enabled)
+		return;
+	for (uint8_t k = 0; k < STATS_PHASE_NUM; k++)
+	{
+		PhaseNs[k] += totals->phase_ns[k];
+		PhaseCalls[k] += totals->phase_calls[k];
+	}
+	for (uint8_t k = 0; k < STATS_COUNTER_NUM; k++)
+		Counters[k] += totals->counters[k];
+}
+
+/* Record the occupancy of a pipeline queue. The occupancy of a queue with the
+same name is added up.
+    Args:
+<queue>[in] queue statistics.
+    Ret:
+*/
+void stats_AddQueue (const stats_Queue_t *queue)
+{
+	stats_Queue_t *dst = NULL;
+
+	if (!stats_Enabled)
+		return;
+	for (uint8_t k = 0; k < QueuesNum; k++)
+	{
+		if (!strcmp (Queues[k].name, queue->name))
+			dst = &Queues[k];
+	}
+	if (dst == NULL)
+	{
+		if (QueuesNum == L_MAX_QUEUES)
+			return;
+		dst = &Queues[QueuesNum++];
+		*dst = *queue;
+		return;
+	}
+	dst->pushes += queue->pushes;
+	dst->occupancy_sum += queue->occupancy_sum;
+	dst->full_waits += queue->full_waits;
+	dst->empty_waits += queue->empty_waits;
+}
+
+/* Print the collected statistics.
+    Args:
+<f>[in] destination file.
+<json>[in] true to print a JSON object, false for a human readable table.
+    Ret:
+*/
+void stats_Print (FILE *f, bool json)
+{
+	uint64_t total_ns = NowNs ( ) - StartNs;
+	uint64_t phases_ns = 0, other_ns;
+	struct rusage usage;
+	long peak_rss_kb = 0;
+
+	if (getrusage (RUSAGE_SELF, &usage) == 0)
+		peak_rss_kb = usage.ru_maxrss; /* kilobytes on linux */
+	for (uint8_t k = 0; k < STATS_PHASE_NUM; k++)
+		phases_ns += PhaseNs[k];
+	/* phases of many threads can take more than the total time */
+	other_ns = (phases_ns < total_ns) ? total_ns - phases_ns : 0;
+
+	if (json)
+	{
+		fprintf (f, "{\n\t\"total_ms\": %.3f,\n\t\"phases\": {\n", total_ns / 1e6);
+		for (uint8_t k = 0; k < STATS_PHASE_NUM; k++)
+		{
+			fprintf (f, "\t\t\"%s\": { \"ms\": %.3f, \"calls\": %llu },\n", PhaseNames[k],
+				PhaseNs[k] / 1e6, (unsigned long long)PhaseCalls[k]);
+		}
+		fprintf (f, "\t\t\"other\": { \"ms\": %.3f }\n\t},\n\t\"counters\": {\n", other_ns / 1e6);
+		for (uint8_t k = 0; k < STATS_COUNTER_NUM; k++)
+		{
+			fprintf (f, "\t\t\"%s\": %llu,\n", CounterNames[k], (unsigned long long)Counters[k]);
+		}
+		fprintf (f, "\t\t\"peak_rss_kb\": %ld\n\t}", peak_rss_kb);
+		if (QueuesNum)
+		{
+			fprintf (f, ",\n\t\"queues\": {\n");
+			for (uint8_t k = 0; k < QueuesNum; k++)
+			{
+				stats_Queue_t *q = &Queues[k];
+
+				fprintf (f, "\t\t\"%s\": { \"capacity\": %u, \"mean_occupancy\": %.2f, \"pushes\": %llu, "
+					"\"full_waits\": %llu, \"empty_waits\": %llu }%s\n", q->name, q->capacity,
+					q->pushes ? (double)q->occupancy_sum / q->pushes : 0.0, (unsigned long long)q->pushes,
+					(unsigned long long)q->full_waits, (unsigned long long)q->empty_waits,
+					(k + 1 < QueuesNum) ? "," : "");
+			}
+			fprintf (f, "\t}");
+		}
+		fprintf (f, "\n}\n");
+	}
+	else
+	{
+		fprintf (f, "%-22s %12s %7s %12s\n", "phase", "ms", "%", "calls");
+		for (uint8_t k = 0; k < STATS_PHASE_NUM; k++)
+		{
+			fprintf (f, "%-22s %12.3f %6.1f%% %12llu\n", PhaseNames[k], PhaseNs[k] / 1e6,
+				total_ns ? 100.0 * PhaseNs[k] / total_ns : 0.0, (unsigned long long)PhaseCalls[k]);
+		}
+		fprintf (f, "%-22s %12.3f %6.1f%%\n", "other", other_ns / 1e6,
+			total_ns ? 100.0 * other_ns / total_ns : 0.0);
+		fprintf (f, "%-22s %12.3f\n", "total", total_ns / 1e6);
+		for (uint8_t k = 0; k < STATS_COUNTER_NUM; k++)
+			fprintf (f, "%-22s %12llu\n", CounterNames[k], (unsigned long long)Counters[k]);
+		fprintf (f, "%-22s %12ld\n", "peak_rss_kb", peak_rss_kb);
+		if (QueuesNum)
+		{
+			fprintf (f, "%-22s %8s %9s %10s %10s %10s\n", "queue", "capacity", "mean occ",
+				"pushes", "full wait", "empty wait");
+			for (uint8_t k = 0; k < QueuesNum; k++)
+			{
+				stats_Queue_t *q = &Queues[k];
+
+				fprintf (f, "%-22s %8u %9.2f %10llu %10llu %10llu\n", q->name, q->capacity,
+					q->pushes ? (double)q->occupancy_sum / q->pushes : 0.0, (unsigned long long)q->pushes,
+					(unsigned long long)q->full_waits, (unsigned long long)q->empty_waits);
+			}
+		}
+	}
+}
+
+/* Start profiling every glyph. Statistics are enabled too.
+    Args:
+<trace>[in] true to record every phase time slice for a chrome trace dump.
+    Ret:
+*/
+void stats_EnableProfile (bool trace)
+{
+	Profiling = true;
+	Tracing = trace;
+	if (!stats_Enabled)
+		stats_Enable ( );
+}
+
+/* Start profiling a glyph. Phase time is charged to it until stats_GlyphEnd.
+    Args:
+<unicode>[in] character code.
+    Ret:
+*/
+void stats_GlyphBegin (uint32_t unicode)
+{
+	if (!Profiling)
+		return;
+
+	if (GlyphsNum == GlyphsMax)
+	{
+		GlyphProfile_t *glyphs;
+
+		GlyphsMax = GlyphsMax ? GlyphsMax * 2 : 1024;
+		glyphs = realloc (Glyphs, sizeof (GlyphProfile_t) * GlyphsMax);
+		if (glyphs == NULL)
+		{	/* stop profiling, keep what we have */
+			Profiling = false;
+			return;
+		}
+		Glyphs = glyphs;
+	}
+	Charge (NowNs ( ));
+	memset (&Glyphs[GlyphsNum], 0, sizeof (GlyphProfile_t));
+	Glyphs[GlyphsNum].unicode = unicode;
+	GlyphsNum++;
+	GlyphActive = true;
+}
+
+/* Stop profiling the current glyph.
+    Args:
+<area>[in] bitmap area (pixel).
+<bytes>[in] packed bitmap bytes.
+    Ret:
+*/
+void stats_GlyphEnd (uint32_t area, uint32_t bytes)
+{
+	if (!Profiling || !GlyphActive)
+		return;
+
+	Charge (NowNs ( ));
+	Glyphs[GlyphsNum - 1].area = area;
+	Glyphs[GlyphsNum - 1].bytes = bytes;
+	GlyphActive = false;
+}
+
+/* Print the most expensive glyphs and the glyph cost histogram. The cost of a
+glyph is its load, render, convert and builder time.
+    Args:
+<f>[in] destination file.
+<top_n>[in] number of glyphs to list.
+    Ret:
+*/
+void stats_PrintProfile (FILE *f, uint16_t top_n)
+{
+	GlyphProfile_t *sorted;
+	uint32_t histogram[L_HISTOGRAM_BUCKETS] = { 0 };
+	uint32_t max_bucket = 0;
+	uint64_t total = 0;
+
+	if (GlyphsNum == 0)
+		return;
+	sorted = malloc (sizeof (GlyphProfile_t) * GlyphsNum);
+	if (sorted == NULL)
+		return;
+	memcpy (sorted, Glyphs, sizeof (GlyphProfile_t) * GlyphsNum);
+	qsort (sorted, GlyphsNum, sizeof (GlyphProfile_t), CompareCost);
+
+	for (uint32_t k = 0; k < GlyphsNum; k++)
+	{	/* log2 buckets of microseconds */
+		uint64_t us = GlyphCost (&sorted[k]) / 1000;
+		uint8_t bucket = 0;
+
+		total += GlyphCost (&sorted[k]);
+		while (us && bucket < L_HISTOGRAM_BUCKETS - 1)
+		{
+			us >>= 1;
+			bucket++;
+		}
+		histogram[bucket]++;
+		if (histogram[bucket] > max_bucket)
+			max_bucket = histogram[bucket];
+	}
+
+	fprintf (f, "%d most expensive glyphs (mean %.1f us)\n", top_n, total / 1e3 / GlyphsNum);
+	fprintf (f, "%-8s %10s %10s %10s %10s %10s %8s %8s\n",
+		"unicode", "total us", "load us", "render us", "convert us", "builder us", "area", "bytes");
+	for (uint32_t k = 0; k < top_n && k < GlyphsNum; k++)
+	{
+		GlyphProfile_t *g = &sorted[k];
+
+		fprintf (f, "0x%04X   %10.1f %10.1f %10.1f %10.1f %10.1f %8u %8u\n", g->unicode, GlyphCost (g) / 1e3,
+			g->ns[STATS_PHASE_GLYPH_LOAD] / 1e3, g->ns[STATS_PHASE_RENDER] / 1e3,
+			g->ns[STATS_PHASE_CONVERT] / 1e3, g->ns[STATS_PHASE_BUILDER] / 1e3, g->area, g->bytes);
+	}
+
+	fprintf (f, "glyph cost histogram\n");
+	for (uint8_t b = 0; b < L_HISTOGRAM_BUCKETS; b++)
+	{
+		char bar[L_HISTOGRAM_BAR + 1];
+		uint8_t len;
+
+		if (histogram[b] == 0)
+			continue;
+		len = (histogram[b] * L_HISTOGRAM_BAR + max_bucket - 1) / max_bucket;
+		memset (bar, '#', len);
+		bar[len] = 0;
+		if (b == 0)
+			fprintf (f, "%16s", "< 1 us");
+		else
+			fprintf (f, "%7u - %5u us", 1u << (b - 1), 1u << b);
+		fprintf (f, " %8u %s\n", histogram[b], bar);
+	}
+	free (sorted);
+}
+
+/* Dump the recorded time slices as a chrome trace (chrome://tracing or
+https://ui.perfetto.dev).
+    Args:
+<fname>[in] destination file name.
+    Ret:
+true on success.
+*/
+bool stats_WriteTrace (const char *fname)
+{
+	FILE *f;
+
+	if ((f = fopen (fname, "wb")) == NULL)
+		return false;
+
+	fprintf (f, "{\"traceEvents\":[\n");
+	for (uint32_t k = 0; k < TraceNum; k++)
+	{
+		TraceEvent_t *ev = &Trace[k];
+
+		fprintf (f, "{\"name\":\"%s\",\"cat\":\"glyph\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+			"\"pid\":1,\"tid\":1,\"args\":{\"unicode\":\"0x%04X\"}}%s\n",
+			PhaseNames[ev->phase], (ev->start_ns - StartNs) / 1e3, ev->dur_ns / 1e3,
+			Glyphs[ev->glyph].unicode, (k + 1 < TraceNum) ? "," : "");
+	}
+	fprintf (f, "]}\n");
+	fclose (f);
+	return true;
+}
+
+//_____________________________________________________________PRIVATE FUNCTIONS
+/* Monotonic time in nanoseconds. */
+static uint64_t NowNs (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* Charge the time elapsed since the last charge to the running phase.
+    Args:
+<now>[in] current time (ns).
+    Ret:
+*/
+static void Charge (uint64_t now)
+{
+	if (StackNum)
+	{
+		stats_Phase_t phase = Stack[StackNum - 1];
+
+		PhaseNs[phase] += now - LastNs;
+		if (GlyphActive)
+			Glyphs[GlyphsNum - 1].ns[phase] += now - LastNs;
+		if (GlyphActive && Tracing && now > LastNs)
+		{
+			if (TraceNum == TraceMax)
+			{
+				TraceEvent_t *trace;
+
+				TraceMax = TraceMax ? TraceMax * 2 : 4096;
+				trace = realloc (Trace, sizeof (TraceEvent_t) * TraceMax);
+				if (trace == NULL)
+					Tracing = false;
+				else
+					Trace = trace;
+			}
+			if (Tracing)
+			{
+				Trace[TraceNum].start_ns = LastNs;
+				Trace[TraceNum].dur_ns = now - LastNs;
+				Trace[TraceNum].glyph = GlyphsNum - 1;
+				Trace[TraceNum].phase = phase;
+				TraceNum++;
+			}
+		}
+	}
+	LastNs = now;
+}
+
+/* Glyph cost used for ranking: load, render, convert and builder time. */
+static uint64_t GlyphCost (const GlyphProfile_t *glyph)
+{
+	return glyph->ns[STATS_PHASE_GLYPH_LOAD] + glyph->ns[STATS_PHASE_RENDER]
+		+ glyph->ns[STATS_PHASE_CONVERT] + glyph->ns[STATS_PHASE_BUILDER];
+}
+
+/* qsort comparator: most expensive glyph first. */
+static int CompareCost (const void *a, const void *b)
+{
+	uint64_t cost_a = GlyphCost (a);
+	uint64_t cost_b = GlyphCost (b);
+
+	return (cost_a < cost_b) - (cost_a > cost_b);
+}
@@ -0,0 +1,91 @@
+/*  Copyright 2019 Giacomo Dal Sasso
+
+    This file is part of fontcvt.
+
+    fontcvt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    fontcvt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with fontcvt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STATS_H_INCLUDED
+#define STATS_H_INCLUDED
+
+//____________________________________________________________INCLUDES - DEFINES
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef enum
+{	/* conversion phases. Phase timers are exclusive: a phase started inside
+	another one pauses it */
+	STATS_PHASE_FACE_OPEN,
+	STATS_PHASE_CHAR_INDEX,
+	STATS_PHASE_GLYPH_LOAD,
+	STATS_PHASE_RENDER,
+	STATS_PHASE_CONVERT,
+	STATS_PHASE_KERNING,
+	STATS_PHASE_BUILDER,
+	STATS_PHASE_FILE_IO,
+	STATS_PHASE_NUM,
+} stats_Phase_t;
+
+typedef enum
+{
+	STATS_COUNTER_GLYPHS, /* exported characters with a glyph */
+	STATS_COUNTER_MISSING, /* exported characters without a glyph */
+	STATS_COUNTER_PAIRS_TESTED, /* kerning pairs looked up */
+	STATS_COUNTER_PAIRS, /* kerning pairs exported */
+	STATS_COUNTER_RENDERS_AVOIDED, /* characters sharing a glyph rendered once */
+	STATS_COUNTER_BITMAP_BYTES, /* bytes of the bitmaps table */
+	STATS_COUNTER_OUTPUT_BYTES, /* bytes of all the output files */
+	STATS_COUNTER_NUM,
+} stats_Counter_t;
+
+typedef struct
+{	/* statistics of a thread, to be merged into another one */
+	uint64_t phase_ns[STATS_PHASE_NUM];
+	uint64_t phase_calls[STATS_PHASE_NUM];
+	uint64_t counters[STATS_COUNTER_NUM];
+} stats_Totals_t;
+
+typedef struct
+{	/* occupancy of a queue between two pipeline stages */
+	const char *name;
+	uint32_t capacity;
+	uint64_t pushes;
+	uint64_t occupancy_sum; /* items in the queue after each push */
+	uint64_t full_waits; /* the producer stage found the queue full */
+	uint64_t empty_waits; /* the consumer stage found the queue empty */
+} stats_Queue_t;
+
+//____________________________________________________________________GLOBAL VAR
+/* true when statistics are collected. Check it before expensive counts. The
+statistics are per thread: every thread running an export collects its own */
+extern _Thread_local bool stats_Enabled;
+
+//______________________________________________________________GLOBAL FUNCTIONS
+void stats_Enable (void);
+void stats_Reset (void);
+void stats_Begin (stats_Phase_t phase);
+void stats_End (stats_Phase_t phase);
+void stats_Add (stats_Counter_t counter, uint64_t value);
+void stats_Take (stats_Totals_t *totals);
+void stats_Merge (const stats_Totals_t *totals);
+void stats_AddQueue (const stats_Queue_t *queue);
+void stats_Print (FILE *f, bool json);
+void stats_EnableProfile (bool trace);
+void stats_GlyphBegin (uint32_t unicode);
+void stats_GlyphEnd (uint32_t area, uint32_t bytes);
+void stats_PrintProfile (FILE *f, uint16_t top_n);
+bool stats_WriteTrace (const char *fname);
+
+#endif /* STATS_H_INCLUDED */